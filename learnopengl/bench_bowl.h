@@ -0,0 +1,239 @@
+#ifndef BENCH_BOWL_H
+#define BENCH_BOWL_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "bowl_mesh.h"
+#include "camera_model.h"
+#include "synthetic_cameras.h"
+#include "shader.h"
+#include "headless.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Micro-benchmark of the surround-view bowl at several tessellations, with
+   the 4 cameras of the synthetic rig. Reports the time to build the bowl on
+   one thread and on the thread pool, to recalibrate one camera
+   incrementally, to move the ground, the background update and the part of
+   it on the render thread (start, swap and upload), the bytes uploaded by
+   each, the vertices where the incremental paths disagree with a full
+   build, and the time to draw the bowl with shader_bowl.fs. The vertex size
+   is compared with the same data in floats (12 + 4 * 12 bytes). */
+inline int runBowlBenchmark(std::ostream& out, int iterations)
+{
+	const int width = 1280, height = 720;
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		return -1;
+	}
+	OffscreenTarget target;
+	if (!target.create(width, height))
+	{
+		return -1;
+	}
+
+	ThreadPool& pool = defaultThreadPool();
+	CameraModel rig[BOWL_CAMERAS];
+	surroundViewRig(640, 360, rig);
+	GLuint cameraImages;
+	glGenTextures(1, &cameraImages);
+	glState().bindTexture(GL_TEXTURE_2D_ARRAY, cameraImages);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, rig[0].width, rig[0].height, BOWL_CAMERAS, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	std::vector<unsigned char> image;
+	for (int c = 0; c < BOWL_CAMERAS; c++)
+	{
+		renderSyntheticCamera(rig[c], 0.0f, image, &pool);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, c, rig[c].width, rig[c].height, 1, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+	}
+	Shader shader("shader_bowl.vs", "shader_bowl.fs");
+	if (!shader.ID || !validateVertexLayout(bowlVertexLayout(), shader.ID))
+	{
+		return -1;
+	}
+	shader.use();
+	shader.setInt("cameras", 0);
+	shader.setMat4(shader.uniform("view"), glm::lookAt(glm::vec3(0.0f, 7.0f, 9.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	shader.setMat4(shader.uniform("projection"), glm::perspective(glm::radians(60.0f), (float)width / height, 0.1f, 100.0f));
+	glState().bindTextureUnit(0, GL_TEXTURE_2D_ARRAY, cameraImages);
+	glState().enable(GL_DEPTH_TEST);
+	target.bind();
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto millis = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+	// vertices of 'a' that differ from those of a full build 'b'
+	auto differences = [](const BowlMesh& a, const BowlMesh& b) {
+		long long count = 0;
+		for (size_t v = 0; v < a.geometry.vertices.size(); v++)
+		{
+			count += memcmp(&a.geometry.vertices[v], &b.geometry.vertices[v], sizeof(BowlVertex)) != 0 ? 1 : 0;
+		}
+		return count;
+	};
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("bowl"));
+	json.value("iterations", (long long)iterations);
+	json.value("cameras", (long long)BOWL_CAMERAS);
+	json.value("width", (long long)width);
+	json.value("height", (long long)height);
+	json.value("threads", (long long)pool.size() + 1);
+	json.value("vertex_bytes", (long long)sizeof(BowlVertex));
+	json.value("float_vertex_bytes", (long long)(3 * sizeof(float) + BOWL_CAMERAS * 3 * sizeof(float)));
+	json.beginArray("results");
+	const int tessellations[4][2] = { { 32, 64 }, { 64, 128 }, { 128, 256 }, { 256, 512 } };
+	for (int t = 0; t < 4; t++)
+	{
+		BowlParameters parameters = defaultBowlParameters();
+		parameters.rings = tessellations[t][0];
+		parameters.sectors = tessellations[t][1];
+		BowlMesh bowl;
+		std::vector<double> singleTimes, pooledTimes, cameraTimes, groundTimes, asyncTimes, asyncBlockTimes, drawTimes;
+		std::vector<double> cameraBytes, groundBytes;
+		long long mismatches = 0;
+		for (int it = 0; it < iterations; it++)
+		{
+			BowlMesh single;
+			Clock::time_point start = Clock::now();
+			single.build(parameters, rig, NULL);
+			singleTimes.push_back(millis(start));
+			start = Clock::now();
+			bowl.build(parameters, rig, &pool);
+			pooledTimes.push_back(millis(start));
+			mismatches += differences(bowl, single);
+		}
+		bowl.upload();
+
+		/* Recalibration of one camera: a yaw drift of half a degree */
+		CameraModel cameras[BOWL_CAMERAS];
+		for (int it = 0; it < iterations; it++)
+		{
+			int c = it % BOWL_CAMERAS;
+			for (int i = 0; i < BOWL_CAMERAS; i++)
+			{
+				cameras[i] = bowl.geometry.cameras[i];
+			}
+			cameras[c].rotation = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(it & 1 ? -0.5f : 0.5f), glm::vec3(0.0f, 1.0f, 0.0f))) * cameras[c].rotation;
+			Clock::time_point start = Clock::now();
+			bowl.setCamera(c, cameras[c], &pool);
+			cameraTimes.push_back(millis(start));
+			bowl.upload();
+			cameraBytes.push_back((double)bowl.stats.uploadedBytes);
+		}
+		BowlMesh full;
+		full.build(parameters, bowl.geometry.cameras, NULL);
+		mismatches += differences(bowl, full);
+
+		/* Ground height: every vertex moves */
+		for (int it = 0; it < iterations; it++)
+		{
+			Clock::time_point start = Clock::now();
+			bowl.setGroundHeight(0.02f * (it + 1), &pool);
+			groundTimes.push_back(millis(start));
+			bowl.upload();
+			groundBytes.push_back((double)bowl.stats.uploadedBytes);
+		}
+		parameters.groundHeight = bowl.geometry.parameters.groundHeight;
+		full.build(parameters, bowl.geometry.cameras, NULL);
+		mismatches += differences(bowl, full);
+
+		/* In the background: the render thread only starts it and swaps it in */
+		for (int it = 0; it < iterations; it++)
+		{
+			for (int i = 0; i < BOWL_CAMERAS; i++)
+			{
+				cameras[i] = bowl.geometry.cameras[i];
+			}
+			int c = it % BOWL_CAMERAS;
+			cameras[c].rotation = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(0.3f), glm::vec3(1.0f, 0.0f, 0.0f))) * cameras[c].rotation;
+			Clock::time_point start = Clock::now();
+			bowl.updateAsync(cameras, bowl.geometry.parameters.groundHeight, pool);
+			double blocked = millis(start);
+			for (;;)
+			{
+				Clock::time_point poll = Clock::now();
+				if (bowl.finishUpdate())
+				{
+					blocked += millis(poll); // the swap and the upload
+					break;
+				}
+				std::this_thread::yield();
+			}
+			asyncTimes.push_back(millis(start));
+			asyncBlockTimes.push_back(blocked);
+		}
+		full.build(parameters, bowl.geometry.cameras, NULL);
+		mismatches += differences(bowl, full);
+
+		/* Coverage: vertices some camera sees, cameras blended per vertex */
+		long long seen = 0, blended = 0, badSums = 0;
+		for (size_t v = 0; v < bowl.geometry.vertices.size(); v++)
+		{
+			const glm::u8vec4& w = bowl.geometry.vertices[v].weight.value;
+			int sum = w.x + w.y + w.z + w.w;
+			badSums += sum != 0 && sum != 255 ? 1 : 0;
+			seen += sum > 0 ? 1 : 0;
+			blended += (w.x > 0) + (w.y > 0) + (w.z > 0) + (w.w > 0);
+		}
+
+		for (int it = -1; it < iterations; it++) // 1 warm-up draw
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glFinish();
+			Clock::time_point start = Clock::now();
+			bowl.draw();
+			glFinish();
+			if (it >= 0)
+			{
+				drawTimes.push_back(millis(start));
+			}
+		}
+
+		json.beginObject();
+		json.value("rings", (long long)parameters.rings);
+		json.value("sectors", (long long)parameters.sectors);
+		json.value("vertices", (long long)bowl.vertexCount());
+		json.value("triangles", (long long)(bowl.indexCount / 3));
+		json.value("vertex_kb", bowl.vertexCount() * sizeof(BowlVertex) / 1024.0);
+		json.value("seen_percent", 100.0 * seen / bowl.vertexCount());
+		json.value("cameras_per_seen_vertex", seen > 0 ? (double)blended / seen : 0.0);
+		json.value("bad_weight_sums", badSums);
+		json.stats("build_single_ms", computeStats(singleTimes));
+		json.stats("build_pool_ms", computeStats(pooledTimes));
+		json.stats("camera_update_ms", computeStats(cameraTimes));
+		json.value("camera_update_kb", computeStats(cameraBytes).mean / 1024.0);
+		json.stats("ground_update_ms", computeStats(groundTimes));
+		json.value("ground_update_kb", computeStats(groundBytes).mean / 1024.0);
+		json.stats("async_update_ms", computeStats(asyncTimes));
+		json.stats("async_render_thread_ms", computeStats(asyncBlockTimes));
+		json.value("mismatches", mismatches);
+		json.stats("draw_ms", computeStats(drawTimes));
+		json.endObject();
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+
+	glDeleteTextures(1, &cameraImages);
+	glState().textureDeleted(cameraImages);
+	return 0;
+}
+
+#endif
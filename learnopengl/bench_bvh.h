@@ -0,0 +1,331 @@
+#ifndef BENCH_BVH_H
+#define BENCH_BVH_H
+
+#include "bvh.h"
+#include "frustum_culling.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/* Objects of the BVH benchmark: boxes of 0.2 to 1.5 units scattered over a
+   400 x 40 x 400 units area, the first 'dynamic' of them moving */
+struct BvhScene
+{
+	BoundsBatch objects;
+	std::vector<glm::vec3> velocities;
+};
+
+inline void generateBvhScene(int objects, int dynamic, BvhScene& scene)
+{
+	uint32_t random = 4242u;
+	auto next = [&]() {
+		random = random * 1664525u + 1013904223u;
+		return (float)(random >> 8) / 16777216.0f;
+	};
+	scene.objects.resize(objects);
+	scene.velocities.assign(dynamic, glm::vec3(0.0f));
+	for (int i = 0; i < objects; i++)
+	{
+		glm::vec3 center(-200.0f + 400.0f * next(), 40.0f * next(), -200.0f + 400.0f * next());
+		glm::vec3 extent(0.1f + 0.65f * next(), 0.1f + 0.65f * next(), 0.1f + 0.65f * next());
+		scene.objects.set(i, center, glm::length(extent), extent);
+		if (i < dynamic)
+		{
+			scene.velocities[i] = glm::vec3(-2.0f + 4.0f * next(), -0.2f + 0.4f * next(), -2.0f + 4.0f * next());
+		}
+	}
+}
+
+// move the dynamic objects one step, bouncing off the sides of the area
+inline void moveBvhScene(BvhScene& scene)
+{
+	BoundsBatch& objects = scene.objects;
+	for (size_t i = 0; i < scene.velocities.size(); i++)
+	{
+		glm::vec3& velocity = scene.velocities[i];
+		glm::vec3 center = glm::vec3(objects.centerX[i], objects.centerY[i], objects.centerZ[i]) + velocity;
+		const glm::vec3 low(-200.0f, 0.0f, -200.0f), high(200.0f, 40.0f, 200.0f);
+		for (int a = 0; a < 3; a++)
+		{
+			if (center[a] < low[a] || center[a] > high[a])
+			{
+				velocity[a] = -velocity[a];
+				center[a] = glm::clamp(center[a], low[a], high[a]);
+			}
+		}
+		objects.centerX[i] = center.x; objects.centerY[i] = center.y; objects.centerZ[i] = center.z;
+	}
+}
+
+/* Reference queries testing every object, with the same arithmetic as the
+   BVH so the results must match exactly */
+inline void bruteForceFrustum(const BoundsBatch& objects, const Frustum& frustum, std::vector<int>& out)
+{
+	for (int i = 0; i < objects.size(); i++)
+	{
+		float low[3] = { objects.centerX[i] - objects.extentX[i], objects.centerY[i] - objects.extentY[i], objects.centerZ[i] - objects.extentZ[i] };
+		float high[3] = { objects.centerX[i] + objects.extentX[i], objects.centerY[i] + objects.extentY[i], objects.centerZ[i] + objects.extentZ[i] };
+		bool visible = true;
+		for (int p = 0; p < 6 && visible; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = ((plane.x * (plane.x > 0.0f ? high[0] : low[0]) + plane.y * (plane.y > 0.0f ? high[1] : low[1]))
+				+ plane.z * (plane.z > 0.0f ? high[2] : low[2])) + plane.w;
+			visible = distance >= 0.0f;
+		}
+		if (visible)
+		{
+			out.push_back(i);
+		}
+	}
+}
+
+inline void bruteForceSphere(const BoundsBatch& objects, const glm::vec3& center, float radius, std::vector<int>& out)
+{
+	for (int i = 0; i < objects.size(); i++)
+	{
+		float dx = std::max(std::max((objects.centerX[i] - objects.extentX[i]) - center.x, center.x - (objects.centerX[i] + objects.extentX[i])), 0.0f);
+		float dy = std::max(std::max((objects.centerY[i] - objects.extentY[i]) - center.y, center.y - (objects.centerY[i] + objects.extentY[i])), 0.0f);
+		float dz = std::max(std::max((objects.centerZ[i] - objects.extentZ[i]) - center.z, center.z - (objects.centerZ[i] + objects.extentZ[i])), 0.0f);
+		if ((dx * dx + dy * dy) + dz * dz <= radius * radius)
+		{
+			out.push_back(i);
+		}
+	}
+}
+
+// nearest box hit, -1 if none
+inline int bruteForcePick(const BoundsBatch& objects, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+{
+	glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	int nearest = -1;
+	float best = maxDistance;
+	for (int i = 0; i < objects.size(); i++)
+	{
+		float x0 = ((objects.centerX[i] - objects.extentX[i]) - origin.x) * inverse.x, x1 = ((objects.centerX[i] + objects.extentX[i]) - origin.x) * inverse.x;
+		float y0 = ((objects.centerY[i] - objects.extentY[i]) - origin.y) * inverse.y, y1 = ((objects.centerY[i] + objects.extentY[i]) - origin.y) * inverse.y;
+		float z0 = ((objects.centerZ[i] - objects.extentZ[i]) - origin.z) * inverse.z, z1 = ((objects.centerZ[i] + objects.extentZ[i]) - origin.z) * inverse.z;
+		float enter = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+		float leave = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), best));
+		if (enter <= leave && (nearest < 0 || enter < best))
+		{
+			best = enter;
+			nearest = i;
+		}
+	}
+	return nearest;
+}
+
+/* Micro-benchmark of the BVH over 100k objects, 2% of them moving.
+
+   Build: time of the SAH build, nodes and cost. Queries: 'queries' frustums
+   (cameras looking over the area), rays (picking from the cameras) and
+   spheres (radius 2 to 20), timed against testing every object and, for the
+   frustums, against the SIMD FrustumCuller; the results are compared with
+   the brute force ones ('mismatches' must be 0, one ray in 8 is checked).
+   Motion: 'frames' steps of the dynamic objects, each refitting only their
+   paths, with the time of a full refit for comparison; the cost drifts up
+   and crossing 1.5 times the cost of the build starts a rebuild on the
+   thread pool, swapped in at the first frame after it is done. The queries
+   are run again at the end, on the refitted and on a freshly built tree. */
+inline int runBvhBenchmark(std::ostream& out, int frames)
+{
+	const int objectCount = 100000, dynamicCount = objectCount / 50, queries = 64;
+	BvhScene scene;
+	generateBvhScene(objectCount, dynamicCount, scene);
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto millis = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	Bvh bvh;
+	std::vector<double> buildTimes;
+	for (int it = 0; it < 3; it++)
+	{
+		Clock::time_point start = Clock::now();
+		bvh.build(scene.objects);
+		buildTimes.push_back(millis(start));
+	}
+
+	/* Query cameras at 2 to 40 units above the area looking over it */
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+	std::vector<glm::mat4> cameras(queries);
+	std::vector<glm::vec3> eyes(queries), sphereCenters(queries);
+	std::vector<float> sphereRadii(queries);
+	uint32_t random = 777u;
+	auto next = [&]() {
+		random = random * 1664525u + 1013904223u;
+		return (float)(random >> 8) / 16777216.0f;
+	};
+	for (int q = 0; q < queries; q++)
+	{
+		eyes[q] = glm::vec3(-180.0f + 360.0f * next(), 2.0f + 38.0f * next(), -180.0f + 360.0f * next());
+		glm::vec3 target(-200.0f + 400.0f * next(), 0.0f, -200.0f + 400.0f * next());
+		cameras[q] = projection * glm::lookAt(eyes[q], target, glm::vec3(0.0f, 1.0f, 0.0f));
+		sphereCenters[q] = glm::vec3(-200.0f + 400.0f * next(), 40.0f * next(), -200.0f + 400.0f * next());
+		sphereRadii[q] = 2.0f + 18.0f * next();
+	}
+	const int raysPerCamera = 256;
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("bvh"));
+	json.value("objects", (long long)objectCount);
+	json.value("dynamic", (long long)dynamicCount);
+	json.value("frames", (long long)frames);
+	json.value("queries", (long long)queries);
+	json.value("threads", (long long)defaultThreadPool().size() + 1);
+	json.stats("build_ms", computeStats(buildTimes));
+	json.value("nodes", (long long)bvh.nodes.size());
+	json.value("build_cost", (double)bvh.buildCost);
+
+	auto runQueries = [&](const char* name) {
+		std::vector<int> found, reference;
+		std::vector<double> frustumTimes, flatTimes, bruteFrustumTimes, rayTimes, bruteRayTimes, sphereTimes, bruteSphereTimes;
+		long long mismatches = 0, visible = 0, picked = 0, sphereHits = 0;
+		FrustumCuller culler;
+		for (int q = 0; q < queries; q++)
+		{
+			Frustum frustum = extractFrustum(cameras[q]);
+			found.clear();
+			reference.clear();
+			Clock::time_point start = Clock::now();
+			bvh.queryFrustum(frustum, found);
+			frustumTimes.push_back(millis(start));
+			start = Clock::now();
+			culler.cull(frustum, scene.objects, CULL_BOXES);
+			flatTimes.push_back(millis(start));
+			start = Clock::now();
+			bruteForceFrustum(scene.objects, frustum, reference);
+			bruteFrustumTimes.push_back(millis(start));
+			std::sort(found.begin(), found.end());
+			mismatches += found != reference ? 1 : 0;
+			visible += (long long)found.size();
+
+			/* Rays through a grid of the screen of the camera */
+			glm::mat4 inverse = glm::inverse(cameras[q]);
+			std::vector<glm::vec3> directions(raysPerCamera);
+			for (int r = 0; r < raysPerCamera; r++)
+			{
+				glm::vec4 clip(-0.9f + 1.8f * (r % 16) / 15.0f, -0.9f + 1.8f * (r / 16) / 15.0f, 1.0f, 1.0f);
+				glm::vec4 world = inverse * clip;
+				directions[r] = glm::normalize(glm::vec3(world) / world.w - eyes[q]);
+			}
+			std::vector<int> nearest(raysPerCamera);
+			start = Clock::now();
+			for (int r = 0; r < raysPerCamera; r++)
+			{
+				nearest[r] = bvh.pick(eyes[q], directions[r], 150.0f);
+			}
+			rayTimes.push_back(millis(start));
+			start = Clock::now();
+			for (int r = 0; r < raysPerCamera; r += 8) // the brute force is slow, check a part of them
+			{
+				int expected = bruteForcePick(scene.objects, eyes[q], directions[r], 150.0f);
+				mismatches += expected != nearest[r] ? 1 : 0;
+				picked += expected >= 0 ? 1 : 0;
+			}
+			bruteRayTimes.push_back(millis(start));
+
+			found.clear();
+			reference.clear();
+			start = Clock::now();
+			bvh.querySphere(sphereCenters[q], sphereRadii[q], found);
+			sphereTimes.push_back(millis(start));
+			start = Clock::now();
+			bruteForceSphere(scene.objects, sphereCenters[q], sphereRadii[q], reference);
+			bruteSphereTimes.push_back(millis(start));
+			std::sort(found.begin(), found.end());
+			mismatches += found != reference ? 1 : 0;
+			sphereHits += (long long)found.size();
+		}
+		json.beginObject(name);
+		json.value("cost", (double)bvh.cost());
+		json.value("frustum_visible", (double)visible / queries);
+		json.stats("frustum_ms", computeStats(frustumTimes));
+		json.stats("frustum_flat_simd_ms", computeStats(flatTimes));
+		json.stats("frustum_brute_ms", computeStats(bruteFrustumTimes));
+		json.value("rays_hit_percent", 100.0 * (double)picked / (queries * raysPerCamera / 8));
+		json.value("pick_mrays_per_s", raysPerCamera / (computeStats(rayTimes).mean * 1.0e3));
+		json.value("pick_brute_mrays_per_s", raysPerCamera / 8 / (computeStats(bruteRayTimes).mean * 1.0e3));
+		json.value("sphere_hits", (double)sphereHits / queries);
+		json.stats("sphere_ms", computeStats(sphereTimes));
+		json.stats("sphere_brute_ms", computeStats(bruteSphereTimes));
+		json.value("mismatches", mismatches);
+		json.endObject();
+	};
+	runQueries("queries_after_build");
+
+	/* Motion: incremental refit every frame, rebuild in the background when degraded */
+	std::vector<int> moved(dynamicCount);
+	for (int i = 0; i < dynamicCount; i++)
+	{
+		moved[i] = i;
+	}
+	std::vector<double> refitTimes, fullRefitTimes, costRatios, swapTimes;
+	long long rebuildsStarted = 0, rebuildsSwapped = 0, rebuildFrames = 0;
+	int rebuildStart = -1;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		moveBvhScene(scene);
+		Clock::time_point start = Clock::now();
+		if (bvh.finishRebuild(scene.objects))
+		{
+			swapTimes.push_back(millis(start));
+			rebuildsSwapped++;
+			rebuildFrames += frame - rebuildStart;
+		}
+		else
+		{
+			bvh.refit(scene.objects, moved.data(), dynamicCount);
+			refitTimes.push_back(millis(start));
+		}
+		costRatios.push_back(bvh.cost() / bvh.buildCost);
+		if (!bvh.rebuilding() && bvh.degraded(1.5f))
+		{
+			bvh.rebuildAsync(scene.objects, defaultThreadPool());
+			rebuildsStarted++;
+			rebuildStart = frame;
+		}
+		if (frame % 8 == 0)
+		{
+			Bvh full; // same tree, only to time the full refit
+			full.build(scene.objects);
+			start = Clock::now();
+			full.refit(scene.objects);
+			fullRefitTimes.push_back(millis(start));
+		}
+	}
+	bvh.finishRebuild(scene.objects, true);
+	json.beginObject("motion");
+	json.stats("refit_ms", computeStats(refitTimes));
+	json.stats("full_refit_ms", computeStats(fullRefitTimes));
+	json.stats("cost_ratio", computeStats(costRatios));
+	json.value("rebuilds_started", rebuildsStarted);
+	json.value("rebuilds_swapped", rebuildsSwapped);
+	json.value("frames_per_rebuild", rebuildsSwapped > 0 ? (double)rebuildFrames / rebuildsSwapped : 0.0);
+	json.stats("swap_ms", computeStats(swapTimes));
+	json.endObject();
+
+	/* Let the tree degrade without rebuilds, then compare with a new build */
+	for (int frame = 0; frame < frames; frame++)
+	{
+		moveBvhScene(scene);
+		bvh.refit(scene.objects, moved.data(), dynamicCount);
+	}
+	runQueries("queries_degraded");
+	bvh.build(scene.objects);
+	runQueries("queries_rebuilt");
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
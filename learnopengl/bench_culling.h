@@ -0,0 +1,100 @@
+#ifndef BENCH_CULLING_H
+#define BENCH_CULLING_H
+
+#include "frustum_culling.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/* Instances of the culling benchmark: 'count' random spheres and boxes in
+   a box around the camera at the origin, about 2% of them in its frustum */
+inline void generateCullingScene(int count, BoundsBatch& bounds)
+{
+	bounds.resize(count);
+	uint32_t random = 4242u;
+	auto next = [&]() {
+		random = random * 1664525u + 1013904223u;
+		return (float)(random >> 8) / 16777216.0f;
+	};
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 center(-150.0f + 300.0f * next(), -100.0f + 200.0f * next(), -150.0f + 300.0f * next());
+		glm::vec3 extent(0.5f + 1.5f * next(), 0.5f + 1.5f * next(), 0.5f + 1.5f * next());
+		bounds.set(i, center, glm::length(extent), extent);
+	}
+}
+
+/* Micro-benchmark of FrustumCuller on 10k, 100k and 1M instances: spheres
+   and boxes, on the scalar path, on the SIMD path and on the SIMD path split
+   over the thread pool. Reports the time per cull, the nanoseconds per
+   instance and the culls where a path returned another list than the
+   scalar one. */
+inline int runCullingBenchmark(std::ostream& out, int iterations)
+{
+	const int counts[3] = { 10000, 100000, 1000000 };
+	const CullShape shapes[2] = { CULL_SPHERES, CULL_BOXES };
+	const char* shapeNames[2] = { "spheres", "boxes" };
+	const char* pathNames[3] = { "scalar", "simd", "simd_pool" };
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("culling"));
+	json.value("iterations", (long long)iterations);
+	json.value("simd", std::string(FrustumCuller::simdName()));
+	json.value("threads", (long long)defaultThreadPool().size() + 1);
+	json.beginArray("results");
+	for (int c = 0; c < 3; c++)
+	{
+		BoundsBatch bounds;
+		generateCullingScene(counts[c], bounds);
+		for (int s = 0; s < 2; s++)
+		{
+			json.beginObject();
+			json.value("instances", (long long)counts[c]);
+			json.value("shape", std::string(shapeNames[s]));
+			FrustumCuller reference, culler;
+			for (int path = 0; path < 3; path++)
+			{
+				std::vector<double> times;
+				long long mismatches = 0; // culls with another list than the scalar path
+				for (int it = 0; it < iterations; it++)
+				{
+					// the camera turns a little every iteration
+					glm::mat4 view = glm::rotate(glm::mat4(1.0f), 0.05f * (float)it, glm::vec3(0.0f, 1.0f, 0.0f));
+					Frustum frustum = extractFrustum(projection * view);
+					std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+					culler.cull(frustum, bounds, shapes[s], path == 2 ? &defaultThreadPool() : NULL, path > 0);
+					times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+					reference.cull(frustum, bounds, shapes[s], NULL, false);
+					if (reference.visibleCount != culler.visibleCount
+						|| memcmp(reference.visible.data(), culler.visible.data(), culler.visibleCount * sizeof(int)) != 0)
+					{
+						mismatches++;
+					}
+				}
+				SampleStats stats = computeStats(times);
+				json.beginObject(pathNames[path]);
+				json.stats("ms", stats);
+				json.value("ns_per_instance", stats.mean * 1.0e6 / counts[c]);
+				json.value("visible", (long long)culler.visibleCount);
+				json.value("mismatches", mismatches);
+				json.endObject();
+			}
+			json.endObject();
+		}
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef BENCH_LOD_H
+#define BENCH_LOD_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "mesh_lod.h"
+#include "bench_mesh.h"
+#include "bench_vertex_formats.h"
+#include "headless.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Objects of the LOD benchmark scattered in the view frustum of a camera
+   looking down -z, from 'nearest' to 'farthest' in front of it */
+inline void generateLodScene(int count, float nearest, float farthest, float aspect, std::vector<glm::vec3>& positions)
+{
+	const float tanHalfFov = tanf(glm::radians(45.0f) * 0.5f);
+	uint32_t random = 777u;
+	auto next = [&]() {
+		random = random * 1664525u + 1013904223u;
+		return (float)(random >> 8) / 16777216.0f;
+	};
+	positions.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		float depth = nearest + (farthest - nearest) * next();
+		float x = (2.0f * next() - 1.0f) * 0.8f * tanHalfFov * aspect * depth;
+		float y = (2.0f * next() - 1.0f) * 0.8f * tanHalfFov * depth;
+		positions[i] = glm::vec3(x, y, -depth);
+	}
+}
+
+/* LOD chain of a torus and its effect on a scene of 'objects' copies spread
+   from 2 to 100 units in front of the camera, which moves 0.1 units
+   forwards per frame: time to build the chain, triangles and error of each
+   level, then triangles, CPU and GPU time per frame drawing the full mesh
+   against the levels picked by LodSelector (1 pixel). The switches per
+   frame are counted with and without hysteresis over a 600 frame camera
+   path, on the CPU only. */
+inline int runLodBenchmark(std::ostream& out, int frames, int objects)
+{
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		return -1;
+	}
+	const int width = 800, height = 600;
+	OffscreenTarget target;
+	if (!target.create(width, height))
+	{
+		return -1;
+	}
+	target.bind();
+	glEnable(GL_DEPTH_TEST);
+
+	std::vector<float> input;
+	generateShuffledTorus(100, 100, input);
+	Mesh mesh;
+	optimizeMesh(input.data(), (int)(input.size() / 8), 8, mesh);
+	LodChain chain;
+	std::vector<double> buildTimes;
+	for (int it = 0; it < 3; it++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		buildLodChain(mesh.vertices.data(), mesh.vertexCount(), mesh.stride, mesh.indices.data(), mesh.indices.size(), chain);
+		buildTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+
+	GLuint program = buildVertexFormatProgram(false);
+	if (!program)
+	{
+		return -1;
+	}
+	GLuint vertexArray, buffers[2];
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(2, buffers);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, chain.indices.size() * sizeof(unsigned int), chain.indices.data(), GL_STATIC_DRAW);
+	for (int a = 0; a < 3; a++)
+	{
+		const int components[3] = { 3, 3, 2 }, offsets[3] = { 0, 3, 6 };
+		glVertexAttribPointer(a, components[a], GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(offsets[a] * sizeof(float)));
+		glEnableVertexAttribArray(a);
+	}
+	glUseProgram(program);
+	glUniform3f(glGetUniformLocation(program, "positionScale"), 1.0f, 1.0f, 1.0f);
+	glUniform3f(glGetUniformLocation(program, "positionOffset"), 0.0f, 0.0f, 0.0f);
+	GLint mvpLocation = glGetUniformLocation(program, "mvp");
+
+	std::vector<glm::vec3> positions;
+	generateLodScene(objects, 2.0f, 100.0f, (float)width / height, positions);
+	const float radius = 1.35f; // bounding sphere of the torus
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 200.0f);
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("lod"));
+	json.value("frames", (long long)frames);
+	json.value("objects", (long long)objects);
+	json.stats("build_ms", computeStats(buildTimes));
+	json.beginArray("levels");
+	for (int l = 0; l < chain.levelCount(); l++)
+	{
+		json.beginObject();
+		json.value("triangles", (long long)chain.triangleCount(l));
+		json.value("error", (double)chain.levels[l].error);
+		json.endObject();
+	}
+	json.endArray();
+
+	const char* names[2] = { "full", "lod" };
+	for (int run = 0; run < 2; run++)
+	{
+		LodSelector selector(1.0f);
+		selector.resize(objects);
+		FrameProfiler profiler;
+		std::vector<double> triangles, selectTimes;
+		for (int frame = -2; frame < frames; frame++) // 2 warm-up frames
+		{
+			if (frame >= 0)
+			{
+				profiler.beginFrame();
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			float camera = 0.1f * (float)std::max(frame, 0);
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			long long frameTriangles = 0;
+			for (int i = 0; i < objects; i++)
+			{
+				float depth = -positions[i].z - camera - radius;
+				int level = run == 0 ? 0 : selector.select(i, chain, lodPixelsPerUnit(projection, height, depth, 0.1f));
+				frameTriangles += chain.triangleCount(level);
+			}
+			selectTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+			for (int i = 0; i < objects; i++)
+			{
+				glm::mat4 mvp = projection * glm::translate(glm::mat4(1.0f), positions[i] + glm::vec3(0.0f, 0.0f, camera))
+					* glm::rotate(glm::mat4(1.0f), 0.7f * (float)i, glm::vec3(1.0f, 0.3f, 0.5f));
+				const MeshLod& lod = chain.levels[run == 0 ? 0 : selector.level(i)];
+				glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+				glDrawElements(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, (void*)(lod.first * sizeof(unsigned int)));
+			}
+			if (frame >= 0)
+			{
+				profiler.endFrame(objects);
+				triangles.push_back((double)frameTriangles);
+			}
+			else
+			{
+				glFinish();
+			}
+		}
+		profiler.finish();
+
+		json.beginObject(names[run]);
+		json.stats("triangles_per_frame", computeStats(triangles));
+		json.stats("select_ms", computeStats(selectTimes));
+		json.stats("cpu_ms", computeStats(profiler.cpuTimes));
+		json.stats("gpu_ms", computeStats(profiler.gpuTimes));
+		json.endObject();
+	}
+
+	/* Level switches along a longer camera path, the objects near a
+	   switching distance flip back and forth without hysteresis when the
+	   camera sways */
+	const float hysteresis[2] = { 0.0f, 0.25f };
+	const char* switchNames[2] = { "switches_no_hysteresis", "switches_hysteresis" };
+	for (int h = 0; h < 2; h++)
+	{
+		LodSelector selector(1.0f, hysteresis[h]);
+		selector.resize(objects);
+		std::vector<double> switches;
+		for (int frame = 0; frame < 600; frame++)
+		{
+			float camera = 0.05f * (float)frame + 0.3f * sinf(0.5f * (float)frame);
+			int changed = 0;
+			for (int i = 0; i < objects; i++)
+			{
+				int before = selector.level(i);
+				changed += selector.select(i, chain, lodPixelsPerUnit(projection, height, -positions[i].z - camera - radius, 0.1f)) != before;
+			}
+			if (frame > 0)
+			{
+				switches.push_back((double)changed);
+			}
+		}
+		json.stats(switchNames[h], computeStats(switches));
+	}
+	json.endObject();
+	out << std::endl;
+
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteBuffers(2, buffers);
+	glDeleteProgram(program);
+	return 0;
+}
+
+#endif
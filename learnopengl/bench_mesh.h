@@ -0,0 +1,135 @@
+#ifndef BENCH_MESH_H
+#define BENCH_MESH_H
+
+#include "mesh_optimizer.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Non-indexed torus of 2 * rings * sides triangles, position + normal + uv
+   (8 floats per vertex), with the triangles shuffled like the output of an
+   exporter which does not care about the order */
+inline void generateShuffledTorus(int rings, int sides, std::vector<float>& vertices)
+{
+	const float pi = 3.14159265358979f;
+	const float major = 1.0f, minor = 0.35f;
+	auto vertex = [&](int ring, int side, float* out) {
+		float u = (float)ring / rings, v = (float)side / sides;
+		float a = u * 2.0f * pi, b = v * 2.0f * pi;
+		float nx = cosf(a) * cosf(b), ny = sinf(a) * cosf(b), nz = sinf(b);
+		out[0] = cosf(a) * major + nx * minor;
+		out[1] = sinf(a) * major + ny * minor;
+		out[2] = nz * minor;
+		out[3] = nx; out[4] = ny; out[5] = nz;
+		out[6] = u; out[7] = v;
+	};
+
+	int triangles = 2 * rings * sides;
+	std::vector<float> ordered((size_t)triangles * 3 * 8);
+	float* out = ordered.data();
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < sides; s++)
+		{
+			// the seam vertices repeat the first ring/side with u or v = 1
+			vertex(r, s, out); vertex(r + 1, s, out + 8); vertex(r + 1, s + 1, out + 16);
+			vertex(r, s, out + 24); vertex(r + 1, s + 1, out + 32); vertex(r, s + 1, out + 40);
+			out += 48;
+		}
+	}
+
+	std::vector<int> order(triangles);
+	for (int t = 0; t < triangles; t++)
+	{
+		order[t] = t;
+	}
+	uint32_t random = 12345u;
+	for (int t = triangles - 1; t > 0; t--)
+	{
+		random = random * 1664525u + 1013904223u;
+		std::swap(order[t], order[(random >> 8) % (t + 1)]);
+	}
+	vertices.resize(ordered.size());
+	for (int t = 0; t < triangles; t++)
+	{
+		memcpy(&vertices[(size_t)t * 24], &ordered[(size_t)order[t] * 24], 24 * sizeof(float));
+	}
+}
+
+inline void writeCacheStats(JsonWriter& json, const char* key, const MeshCacheStats& stats)
+{
+	json.beginObject(key);
+	json.value("acmr", stats.acmr);
+	json.value("atvr", stats.atvr);
+	json.value("overfetch", stats.overfetch);
+	json.endObject();
+}
+
+/* Micro-benchmark of the mesh optimizer on a shuffled torus of about 200k
+   triangles: time of each stage and the vertex cache / fetch statistics
+   after it (FIFO cache of MESH_CACHE_SIZE vertices) */
+inline int runMeshBenchmark(std::ostream& out, int iterations)
+{
+	const int rings = 400, sides = 250, stride = 8;
+	std::vector<float> input;
+	generateShuffledTorus(rings, sides, input);
+	int inputVertices = (int)(input.size() / stride);
+	int vertexBytes = stride * (int)sizeof(float);
+
+	std::vector<double> indexTimes, cacheTimes, overdrawTimes, fetchTimes;
+	Mesh mesh;
+	MeshCacheStats indexed = {}, cacheOptimized = {}, overdrawOptimized = {}, fetchOptimized = {};
+	for (int it = 0; it < iterations; it++)
+	{
+		std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+		meshGenerateIndices(input.data(), inputVertices, stride, mesh);
+		std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+		indexed = meshAnalyzeCache(mesh.indices, mesh.vertexCount(), vertexBytes);
+
+		std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+		meshOptimizeVertexCache(mesh.indices, mesh.vertexCount());
+		std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+		cacheOptimized = meshAnalyzeCache(mesh.indices, mesh.vertexCount(), vertexBytes);
+
+		std::chrono::high_resolution_clock::time_point t4 = std::chrono::high_resolution_clock::now();
+		meshOptimizeOverdraw(mesh, 1.05f);
+		std::chrono::high_resolution_clock::time_point t5 = std::chrono::high_resolution_clock::now();
+		overdrawOptimized = meshAnalyzeCache(mesh.indices, mesh.vertexCount(), vertexBytes);
+
+		std::chrono::high_resolution_clock::time_point t6 = std::chrono::high_resolution_clock::now();
+		meshOptimizeVertexFetch(mesh);
+		std::chrono::high_resolution_clock::time_point t7 = std::chrono::high_resolution_clock::now();
+		fetchOptimized = meshAnalyzeCache(mesh.indices, mesh.vertexCount(), vertexBytes);
+
+		indexTimes.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+		cacheTimes.push_back(std::chrono::duration<double, std::milli>(t3 - t2).count());
+		overdrawTimes.push_back(std::chrono::duration<double, std::milli>(t5 - t4).count());
+		fetchTimes.push_back(std::chrono::duration<double, std::milli>(t7 - t6).count());
+	}
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("mesh"));
+	json.value("iterations", (long long)iterations);
+	json.value("triangles", (long long)mesh.triangleCount());
+	json.value("input_vertices", (long long)inputVertices);
+	json.value("unique_vertices", (long long)mesh.vertexCount());
+	json.value("cache_size", (long long)MESH_CACHE_SIZE);
+	json.stats("index_ms", computeStats(indexTimes));
+	json.stats("vertex_cache_ms", computeStats(cacheTimes));
+	json.stats("overdraw_ms", computeStats(overdrawTimes));
+	json.stats("vertex_fetch_ms", computeStats(fetchTimes));
+	writeCacheStats(json, "indexed", indexed);
+	writeCacheStats(json, "vertex_cache", cacheOptimized);
+	writeCacheStats(json, "overdraw", overdrawOptimized);
+	writeCacheStats(json, "vertex_fetch", fetchOptimized);
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
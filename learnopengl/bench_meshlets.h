@@ -0,0 +1,189 @@
+#ifndef BENCH_MESHLETS_H
+#define BENCH_MESHLETS_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "meshlets.h"
+#include "bench_mesh.h"
+#include "bench_vertex_formats.h"
+#include "headless.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Meshlets of a 100k triangle torus: build time and shape of the meshlets,
+   then 'views' cameras around it at 3 distances (the nearest sees only part
+   of it). For each distance reports the share of the triangles rejected by
+   the frustum and by the normal cones, the index ranges left, the time to
+   cull on the scalar and the SSE2 path (and the views where they disagree),
+   and the time to draw the whole mesh against drawing the ranges with
+   glMultiDrawElements, back faces culled by the GPU in both. The draws are
+   timed up to glFinish: the timer queries of a software renderer do not
+   measure its rasterizer threads. */
+inline int runMeshletBenchmark(std::ostream& out, int views)
+{
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		return -1;
+	}
+	const int width = 256, height = 256;
+	OffscreenTarget target;
+	if (!target.create(width, height))
+	{
+		return -1;
+	}
+	target.bind();
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	std::vector<float> input;
+	generateShuffledTorus(200, 250, input);
+	Mesh mesh;
+	optimizeMesh(input.data(), (int)(input.size() / 8), 8, mesh);
+	MeshletSet meshlets;
+	std::vector<unsigned int> indices;
+	std::vector<double> buildTimes;
+	for (int it = 0; it < 3; it++)
+	{
+		indices = mesh.indices;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		buildMeshlets(mesh.vertices.data(), mesh.vertexCount(), mesh.stride, indices.data(), indices.size(), meshlets);
+		buildTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	long long meshletVertices = 0, noCone = 0;
+	for (int m = 0; m < meshlets.size(); m++)
+	{
+		meshletVertices += meshlets.meshlets[m].vertexCount;
+		noCone += meshlets.cutoff[m] >= 1.0f ? 1 : 0;
+	}
+
+	GLuint program = buildVertexFormatProgram(false);
+	if (!program)
+	{
+		return -1;
+	}
+	GLuint vertexArray, buffers[2];
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(2, buffers);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	for (int a = 0; a < 3; a++)
+	{
+		const int components[3] = { 3, 3, 2 }, offsets[3] = { 0, 3, 6 };
+		glVertexAttribPointer(a, components[a], GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(offsets[a] * sizeof(float)));
+		glEnableVertexAttribArray(a);
+	}
+	glUseProgram(program);
+	glUniform3f(glGetUniformLocation(program, "positionScale"), 1.0f, 1.0f, 1.0f);
+	glUniform3f(glGetUniformLocation(program, "positionOffset"), 0.0f, 0.0f, 0.0f);
+	GLint mvpLocation = glGetUniformLocation(program, "mvp");
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("meshlets"));
+	json.value("views", (long long)views);
+	json.value("triangles", (long long)(indices.size() / 3));
+	json.stats("build_ms", computeStats(buildTimes));
+	json.value("meshlets", (long long)meshlets.size());
+	json.value("triangles_per_meshlet", (double)(indices.size() / 3) / meshlets.size());
+	json.value("vertices_per_meshlet", (double)meshletVertices / meshlets.size());
+	json.value("meshlets_without_cone", noCone);
+	json.beginArray("results");
+	const float distances[3] = { 1.2f, 3.0f, 8.0f };
+	for (int d = 0; d < 3; d++)
+	{
+		MeshletCullStats stats;
+		memset(&stats, 0, sizeof(stats));
+		std::vector<MeshletRange> ranges, reference;
+		std::vector<GLsizei> counts;
+		std::vector<const void*> offsets;
+		std::vector<double> scalarTimes, simdTimes, fullTimes, meshletTimes;
+		long long mismatches = 0; // views where the scalar and SSE2 paths disagree
+		for (int view = -2; view < views; view++) // 2 warm-up views
+		{
+			float angle = 6.2831853f * (float)std::max(view, 0) / (float)views;
+			glm::vec3 eye(distances[d] * cosf(angle), 0.6f * distances[d] * sinf(1.7f * angle), distances[d] * sinf(angle));
+			glm::mat4 viewMatrix = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.3f * distances[d]), glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::mat4 mvp = projection * viewMatrix; // the torus is not transformed, mesh space is world space
+			Frustum frustum = extractFrustum(mvp);
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			cullMeshlets(meshlets, frustum, eye, 0, reference, NULL, false);
+			std::chrono::high_resolution_clock::time_point scalarDone = std::chrono::high_resolution_clock::now();
+			cullMeshlets(meshlets, frustum, eye, 0, ranges, view >= 0 ? &stats : NULL, true);
+			std::chrono::high_resolution_clock::time_point simdDone = std::chrono::high_resolution_clock::now();
+			glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+			if (view < 0)
+			{
+				glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0);
+				glFinish();
+				continue;
+			}
+			scalarTimes.push_back(std::chrono::duration<double, std::milli>(scalarDone - start).count());
+			simdTimes.push_back(std::chrono::duration<double, std::milli>(simdDone - scalarDone).count());
+			if (ranges.size() != reference.size() || (!ranges.empty() && memcmp(ranges.data(), reference.data(), ranges.size() * sizeof(MeshletRange)) != 0))
+			{
+				mismatches++;
+			}
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glFinish();
+			std::chrono::high_resolution_clock::time_point drawStart = std::chrono::high_resolution_clock::now();
+			glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0);
+			glFinish();
+			fullTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - drawStart).count());
+
+			counts.resize(ranges.size());
+			offsets.resize(ranges.size());
+			for (size_t r = 0; r < ranges.size(); r++)
+			{
+				counts[r] = (GLsizei)ranges[r].count;
+				offsets[r] = (const void*)(ranges[r].firstIndex * sizeof(unsigned int));
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glFinish();
+			drawStart = std::chrono::high_resolution_clock::now();
+			glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)ranges.size());
+			glFinish();
+			meshletTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - drawStart).count());
+		}
+
+		json.beginObject();
+		json.value("distance", (double)distances[d]);
+		json.value("frustum_rejected_percent", 100.0 * (double)stats.frustumCulled / (double)stats.meshlets);
+		json.value("cone_rejected_percent", 100.0 * (double)stats.coneCulled / (double)stats.meshlets);
+		json.value("triangles_rejected_percent", 100.0 * (double)stats.trianglesRejected / (double)stats.triangles);
+		json.value("ranges_per_view", (double)stats.ranges / views);
+		json.stats("scalar_ms", computeStats(scalarTimes));
+		json.stats("simd_ms", computeStats(simdTimes));
+		json.value("simd_ns_per_meshlet", computeStats(simdTimes).mean * 1.0e6 / meshlets.size());
+		json.value("mismatches", mismatches);
+		json.stats("full_draw_ms", computeStats(fullTimes));
+		json.stats("meshlets_draw_ms", computeStats(meshletTimes));
+		json.endObject();
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteBuffers(2, buffers);
+	glDeleteProgram(program);
+	return 0;
+}
+
+#endif
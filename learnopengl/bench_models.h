@@ -0,0 +1,289 @@
+#ifndef BENCH_MODELS_H
+#define BENCH_MODELS_H
+
+#include "model_loader.h"
+#include "thread_pool.h"
+#include "file_utils.h"
+#include "headless.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const char* const DEFAULT_MODEL_CORPUS = "model_corpus";
+
+/* Indexed torus of 2 * rings * sides triangles, the seam vertices are
+   repeated with u or v = 1 */
+inline void generateTorusModel(int rings, int sides, std::vector<ModelVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const float pi = 3.14159265358979f;
+	const float major = 1.0f, minor = 0.35f;
+	vertices.resize((size_t)(rings + 1) * (sides + 1));
+	for (int r = 0; r <= rings; r++)
+	{
+		for (int s = 0; s <= sides; s++)
+		{
+			float u = (float)r / rings, v = (float)s / sides;
+			float a = u * 2.0f * pi, b = v * 2.0f * pi;
+			ModelVertex& vertex = vertices[(size_t)r * (sides + 1) + s];
+			vertex.normal = glm::vec3(cosf(a) * cosf(b), sinf(a) * cosf(b), sinf(b));
+			vertex.position = glm::vec3(cosf(a) * major, sinf(a) * major, 0.0f) + vertex.normal * minor;
+			vertex.texCoord = glm::vec2(u, v);
+		}
+	}
+	indices.clear();
+	indices.reserve((size_t)rings * sides * 6);
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < sides; s++)
+		{
+			uint32_t i0 = (uint32_t)(r * (sides + 1) + s), i1 = i0 + (uint32_t)(sides + 1);
+			uint32_t quad[6] = { i0, i1, i1 + 1, i0, i1 + 1, i0 + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+// OBJ with v, vt and vn lines and "f p/t/n" faces sharing the same index
+inline bool writeObjModel(const std::string& path, const std::vector<ModelVertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+	fprintf(file, "# synthetic torus, %d triangles\no torus\n", (int)(indices.size() / 3));
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		fprintf(file, "v %.6f %.6f %.6f\n", vertices[i].position.x, vertices[i].position.y, vertices[i].position.z);
+	}
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		fprintf(file, "vt %.6f %.6f\n", vertices[i].texCoord.x, vertices[i].texCoord.y);
+	}
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		fprintf(file, "vn %.6f %.6f %.6f\n", vertices[i].normal.x, vertices[i].normal.y, vertices[i].normal.z);
+	}
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned a = indices[i] + 1, b = indices[i + 1] + 1, c = indices[i + 2] + 1;
+		fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+	}
+	return fclose(file) == 0;
+}
+
+// binary glTF, one buffer view per attribute and 32-bit indices
+inline bool writeGlbModel(const std::string& path, const std::vector<ModelVertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	size_t count = vertices.size();
+	std::vector<unsigned char> bin(count * (12 + 12 + 8) + indices.size() * 4);
+	glm::vec3 low(0.0f), high(0.0f);
+	for (size_t i = 0; i < count; i++)
+	{
+		memcpy(&bin[i * 12], &vertices[i].position, 12);
+		memcpy(&bin[count * 12 + i * 12], &vertices[i].normal, 12);
+		memcpy(&bin[count * 24 + i * 8], &vertices[i].texCoord, 8);
+		low = i == 0 ? vertices[i].position : glm::min(low, vertices[i].position);
+		high = i == 0 ? vertices[i].position : glm::max(high, vertices[i].position);
+	}
+	memcpy(&bin[count * 32], indices.data(), indices.size() * 4);
+
+	std::ostringstream json;
+	json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"learnopengl bench_models.h\"},"
+		<< "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+		<< "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+		<< "\"buffers\":[{\"byteLength\":" << bin.size() << "}],"
+		<< "\"bufferViews\":["
+		<< "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << count * 12 << ",\"target\":34962},"
+		<< "{\"buffer\":0,\"byteOffset\":" << count * 12 << ",\"byteLength\":" << count * 12 << ",\"target\":34962},"
+		<< "{\"buffer\":0,\"byteOffset\":" << count * 24 << ",\"byteLength\":" << count * 8 << ",\"target\":34962},"
+		<< "{\"buffer\":0,\"byteOffset\":" << count * 32 << ",\"byteLength\":" << indices.size() * 4 << ",\"target\":34963}],"
+		<< "\"accessors\":["
+		<< "{\"bufferView\":0,\"componentType\":5126,\"count\":" << count << ",\"type\":\"VEC3\",\"min\":[" << low.x << "," << low.y << "," << low.z
+		<< "],\"max\":[" << high.x << "," << high.y << "," << high.z << "]},"
+		<< "{\"bufferView\":1,\"componentType\":5126,\"count\":" << count << ",\"type\":\"VEC3\"},"
+		<< "{\"bufferView\":2,\"componentType\":5126,\"count\":" << count << ",\"type\":\"VEC2\"},"
+		<< "{\"bufferView\":3,\"componentType\":5125,\"count\":" << indices.size() << ",\"type\":\"SCALAR\"}]}";
+	std::string text = json.str();
+	text.resize((text.size() + 3) & ~(size_t)3, ' ');
+	bin.resize((bin.size() + 3) & ~(size_t)3, 0);
+
+	uint32_t header[5] = { 0x46546C67u /* glTF */, 2, (uint32_t)(12 + 8 + text.size() + 8 + bin.size()), (uint32_t)text.size(), 0x4E4F534Au /* JSON */ };
+	uint32_t binHeader[2] = { (uint32_t)bin.size(), 0x004E4942u /* BIN */ };
+	std::ofstream file(path.c_str(), std::ios::binary);
+	file.write((const char*)header, sizeof(header));
+	file.write(text.data(), text.size());
+	file.write((const char*)binHeader, sizeof(binHeader));
+	file.write((const char*)bin.data(), bin.size());
+	return (bool)file;
+}
+
+/* The synthetic corpus: the same torus of 'rings' * 'sides' * 2 triangles as
+   OBJ and as GLB, written to 'directory' when missing. 'paths' gets the
+   OBJ then the GLB file. */
+inline bool ensureModelCorpus(const std::string& directory, int rings, int sides, std::vector<std::string>& paths, double& generateMs)
+{
+	std::ostringstream name;
+	name << directory << "/torus_" << rings << "x" << sides;
+	paths.clear();
+	paths.push_back(name.str() + ".obj");
+	paths.push_back(name.str() + ".glb");
+	generateMs = 0.0;
+	if (std::ifstream(paths[0].c_str()).good() && std::ifstream(paths[1].c_str()).good())
+	{
+		return true;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<ModelVertex> vertices;
+	std::vector<uint32_t> indices;
+	generateTorusModel(rings, sides, vertices, indices);
+	if (!makeDirectory(directory) || !writeObjModel(paths[0], vertices, indices) || !writeGlbModel(paths[1], vertices, indices))
+	{
+		std::cout << "ERROR::MODEL::CANNOT_WRITE_CORPUS " << directory << std::endl;
+		return false;
+	}
+	generateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+inline void removeModelCorpus(const std::vector<std::string>& paths)
+{
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		std::remove(paths[i].c_str());
+	}
+}
+
+/* Load throughput of the model loaders on the synthetic corpus (a torus of
+   2M triangles, about 200 MB of OBJ and 53 MB of GLB), on one thread and on
+   the thread pool, into memory. The first load of each file also pays the
+   page faults of the mapping; the files stay in the page cache after it.
+   Then each file is loaded on the pool into mapped buffer objects
+   (ModelBuffers, what --model does) in a headless context, and the buffers
+   read back are compared with the load into memory: 'mismatches' counts the
+   indices and vertices which differ. The corpus is removed at the end. */
+inline int runModelBenchmark(std::ostream& out, int iterations, const std::string& directory)
+{
+	const int rings = 1000, sides = 1000;
+	std::vector<std::string> paths;
+	double generateMs = 0.0;
+	if (!ensureModelCorpus(directory, rings, sides, paths, generateMs))
+	{
+		return -1;
+	}
+
+	ModelLoader loader;
+	ModelMemory memory;
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("models"));
+	json.value("iterations", (long long)iterations);
+	json.value("threads", (long long)defaultThreadPool().size() + 1);
+	json.value("corpus_generate_ms", generateMs);
+	const char* names[4] = { "obj_1_thread", "obj_pool", "glb_1_thread", "glb_pool" };
+	for (int run = 0; run < 4; run++)
+	{
+		const std::string& path = paths[run / 2];
+		ThreadPool* pool = run % 2 ? &defaultThreadPool() : NULL;
+		std::vector<double> total, map, count, parse, write, megabytes, triangles;
+		ModelLoadStats stats;
+		for (int it = 0; it < iterations; it++)
+		{
+			if (!loader.load(path.c_str(), memory, stats, pool))
+			{
+				removeModelCorpus(paths);
+				return -1;
+			}
+			total.push_back(stats.totalMs);
+			map.push_back(stats.mapMs);
+			count.push_back(stats.countMs);
+			parse.push_back(stats.parseMs);
+			write.push_back(stats.writeMs);
+			megabytes.push_back(stats.megabytesPerSecond());
+			triangles.push_back(stats.trianglesPerSecond());
+		}
+		json.beginObject(names[run]);
+		json.value("file", path);
+		json.value("file_mb", (double)stats.fileBytes / (1024.0 * 1024.0));
+		json.value("vertices", stats.vertices);
+		json.value("triangles", stats.triangles);
+		json.value("chunks", (long long)stats.chunks);
+		json.stats("total_ms", computeStats(total));
+		json.stats("map_ms", computeStats(map));
+		json.stats("count_ms", computeStats(count));
+		json.stats("parse_ms", computeStats(parse));
+		json.stats("write_ms", computeStats(write));
+		json.stats("mb_per_second", computeStats(megabytes));
+		json.stats("triangles_per_second", computeStats(triangles));
+		json.endObject();
+	}
+
+	/* Into mapped buffer objects, checked against the load into memory */
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		removeModelCorpus(paths);
+		return -1;
+	}
+	const char* bufferNames[2] = { "obj_buffers", "glb_buffers" };
+	for (int file = 0; file < 2; file++)
+	{
+		const std::string& path = paths[file];
+		ModelBuffers buffers;
+		ModelLoadStats stats;
+		std::vector<double> total, megabytes;
+		bool loaded = loader.load(path.c_str(), memory, stats, &defaultThreadPool());
+		for (int it = 0; it < iterations && loaded; it++)
+		{
+			loaded = loader.load(path.c_str(), buffers, stats, &defaultThreadPool());
+			loaded = buffers.finish() && loaded;
+			total.push_back(stats.totalMs);
+			megabytes.push_back(stats.megabytesPerSecond());
+		}
+		if (!loaded || buffers.indexCount != memory.indexCount || buffers.vertexCount != memory.vertexCount)
+		{
+			std::cout << "ERROR::MODEL::BUFFER_LOAD_FAILED " << path << std::endl;
+			removeModelCorpus(paths);
+			return -1;
+		}
+		std::vector<uint32_t> indices(buffers.indexCount);
+		std::vector<ModelVertex> vertices(buffers.vertexCount);
+		glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffers.indexBuffer);
+		glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)(indices.size() * sizeof(uint32_t)), indices.data());
+		glState().bindBuffer(GL_COPY_READ_BUFFER, buffers.vertexBuffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)(vertices.size() * sizeof(ModelVertex)), vertices.data());
+		long long mismatches = 0;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			mismatches += indices[i] != memory.indexData()[i] ? 1 : 0;
+		}
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			mismatches += memcmp(&vertices[i], &memory.vertexData()[i], sizeof(ModelVertex)) != 0 ? 1 : 0;
+		}
+		json.beginObject(bufferNames[file]);
+		json.value("file", path);
+		json.value("vertices", stats.vertices);
+		json.value("triangles", stats.triangles);
+		json.stats("total_ms", computeStats(total));
+		json.stats("mb_per_second", computeStats(megabytes));
+		json.value("mismatches", mismatches);
+		json.endObject();
+	}
+	json.endObject();
+	out << std::endl;
+
+	removeModelCorpus(paths);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef BENCH_OCCLUSION_H
+#define BENCH_OCCLUSION_H
+
+#include "occlusion_culler.h"
+#include "frustum_culling.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <string>
+#include <vector>
+
+/* Occluders and occludees of the occlusion benchmark, a street seen from a
+   car: rows of buildings with alleys on both sides, a building across the
+   street 80 units ahead, parked cars along the sidewalks and small objects
+   scattered everywhere around */
+struct OcclusionScene
+{
+	std::vector<glm::vec3> occluderCenters, occluderExtents; // boxes
+	BoundsBatch objects;
+};
+
+inline void generateOcclusionScene(int objects, OcclusionScene& scene)
+{
+	for (int side = -1; side <= 1; side += 2)
+	{
+		for (int block = 0; block < 10; block++)
+		{
+			// 18 units long buildings, 2 units wide alleys between them
+			scene.occluderCenters.push_back(glm::vec3(10.0f * side, 6.0f, -13.0f - 20.0f * block));
+			scene.occluderExtents.push_back(glm::vec3(2.0f, 6.0f, 9.0f));
+		}
+		for (int car = 0; car < 9; car++)
+		{
+			scene.occluderCenters.push_back(glm::vec3(5.5f * side, 0.75f, -10.0f - 8.0f * car));
+			scene.occluderExtents.push_back(glm::vec3(1.0f, 0.75f, 2.0f));
+		}
+	}
+	scene.occluderCenters.push_back(glm::vec3(0.0f, 6.0f, -80.0f));
+	scene.occluderExtents.push_back(glm::vec3(8.0f, 6.0f, 1.0f));
+
+	uint32_t random = 31337u;
+	auto next = [&]() {
+		random = random * 1664525u + 1013904223u;
+		return (float)(random >> 8) / 16777216.0f;
+	};
+	scene.objects.resize(objects);
+	for (int i = 0; i < objects; i++)
+	{
+		glm::vec3 center(-60.0f + 120.0f * next(), 4.0f * next(), -2.0f - 198.0f * next());
+		glm::vec3 extent(0.3f + 0.7f * next(), 0.3f + 0.7f * next(), 0.3f + 0.7f * next());
+		scene.objects.set(i, center, glm::length(extent), extent);
+	}
+}
+
+/* Micro-benchmark of OcclusionCuller on a street of 39 box occluders and
+   20k objects: each iteration the camera drives 0.5 units further, the
+   objects are frustum culled, the occluders rasterized and the objects left
+   tested. Reports the share of the objects in the frustum found occluded
+   and the time of each step, for two depth buffer sizes, on the calling
+   thread and on the thread pool. */
+inline int runOcclusionBenchmark(std::ostream& out, int iterations)
+{
+	const int objectCount = 20000;
+	const int sizes[2][2] = { { 256, 128 }, { 512, 256 } };
+	const float box[8 * 3] = {
+		-1.0f, -1.0f, -1.0f,  1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,  1.0f, -1.0f,
+		-1.0f, -1.0f,  1.0f,  1.0f, -1.0f,  1.0f,  1.0f,  1.0f,  1.0f, -1.0f,  1.0f,  1.0f
+	};
+	// counter-clockwise seen from outside
+	const unsigned int boxIndices[36] = {
+		0, 2, 1, 0, 3, 2, // -z
+		4, 5, 6, 4, 6, 7, // +z
+		0, 4, 7, 0, 7, 3, // -x
+		1, 2, 6, 1, 6, 5, // +x
+		0, 1, 5, 0, 5, 4, // -y
+		3, 7, 6, 3, 6, 2  // +y
+	};
+
+	OcclusionScene scene;
+	generateOcclusionScene(objectCount, scene);
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 250.0f);
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("occlusion"));
+	json.value("iterations", (long long)iterations);
+	json.value("objects", (long long)objectCount);
+	json.value("occluders", (long long)scene.occluderCenters.size());
+	json.value("threads", (long long)defaultThreadPool().size() + 1);
+	json.beginArray("results");
+	for (int s = 0; s < 2; s++)
+	{
+		for (int pooled = 0; pooled < 2; pooled++)
+		{
+			ThreadPool* pool = pooled ? &defaultThreadPool() : NULL;
+			OcclusionCuller occlusion(sizes[s][0], sizes[s][1]);
+			FrustumCuller culler;
+			std::vector<int> visible;
+			std::vector<double> inFrustum, occluded, binTimes, rasterTimes, pyramidTimes, testTimes, totalTimes;
+			for (int it = 0; it < iterations; it++)
+			{
+				glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.7f, -0.5f * it), glm::vec3(0.0f, 1.7f, -0.5f * it - 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+				int count = culler.cull(extractFrustum(projection * view), scene.objects, CULL_BOXES, pool);
+
+				occlusion.beginFrame(projection * view);
+				for (size_t o = 0; o < scene.occluderCenters.size(); o++)
+				{
+					glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), scene.occluderCenters[o]), scene.occluderExtents[o]);
+					occlusion.addOccluder(box, 8, 3, boxIndices, 36, model);
+				}
+				occlusion.render(pool);
+				occlusion.cullBoxes(scene.objects, culler.visible.data(), count, visible, pool);
+
+				const OcclusionStats& stats = occlusion.stats;
+				inFrustum.push_back((double)count);
+				occluded.push_back(stats.occludedPercent());
+				binTimes.push_back(stats.binMs);
+				rasterTimes.push_back(stats.rasterMs);
+				pyramidTimes.push_back(stats.pyramidMs);
+				testTimes.push_back(stats.testMs);
+				totalTimes.push_back(stats.totalMs());
+			}
+			json.beginObject();
+			json.value("width", (long long)sizes[s][0]);
+			json.value("height", (long long)sizes[s][1]);
+			json.value("pool", std::string(pooled ? "yes" : "no"));
+			json.value("raster_triangles", (long long)occlusion.stats.rasterTriangles);
+			json.value("binned_triangles", (long long)occlusion.stats.binnedTriangles);
+			json.value("in_frustum", computeStats(inFrustum).mean);
+			json.value("occluded_percent", computeStats(occluded).mean);
+			json.stats("bin_ms", computeStats(binTimes));
+			json.stats("raster_ms", computeStats(rasterTimes));
+			json.stats("pyramid_ms", computeStats(pyramidTimes));
+			json.stats("test_ms", computeStats(testTimes));
+			json.stats("total_ms", computeStats(totalTimes));
+			json.endObject();
+		}
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef BENCH_QUEUE_H
+#define BENCH_QUEUE_H
+
+#include "render_queue.h"
+#include "bench_state.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/* Object of the synthetic scene of the queue benchmark */
+struct QueueBenchObject
+{
+	GLuint program;
+	GLuint textures[2];
+	GLuint vertexArray;
+	bool transparent;
+	glm::vec3 position;
+};
+
+inline bool sortItemLess(const RenderQueue::SortItem& a, const RenderQueue::SortItem& b)
+{
+	return a.key < b.key;
+}
+
+/* Micro-benchmark of the render queue on a scene of 'objectCount' objects
+   with mixed state: 8 programs, 64 texture pairs, 4 vertex arrays and one
+   object in five transparent, in random order. Compares immediate
+   submission in scene order (through glState(), so only the real changes
+   reach the driver) with the queue: record, radix sort and submit, recorded
+   on one thread and on the thread pool. Runs on the mock dispatch table, the
+   state calls are the ones which would reach the driver.
+
+   The radix sort is checked against std::stable_sort on the same keys, and
+   the merged order of the pooled queue against the scene order that stable
+   sort gives: every position where the key or the item differs counts in
+   'mismatches', which must be 0. */
+inline int runQueueBenchmark(std::ostream& out, int frames, int objectCount)
+{
+	const int programs = 8, materials = 64, vertexArrays = 4;
+	const float farPlane = 100.0f;
+
+	std::vector<QueueBenchObject> objects(objectCount);
+	uint32_t random = 12345u;
+	for (int i = 0; i < objectCount; i++)
+	{
+		QueueBenchObject& object = objects[i];
+		random = random * 1664525u + 1013904223u;
+		object.program = 1 + (random >> 8) % programs;
+		int material = (random >> 16) % materials;
+		object.textures[0] = 1 + 2 * material;
+		object.textures[1] = 2 + 2 * material;
+		object.vertexArray = 1 + (random >> 24) % vertexArrays;
+		random = random * 1664525u + 1013904223u;
+		object.transparent = (random >> 8) % 5 == 0;
+		object.position = glm::vec3(((random >> 12) % 200) * 0.1f - 10.0f, ((random >> 20) % 100) * 0.1f - 5.0f, -1.0f - ((random >> 4) % 900) * 0.1f);
+	}
+	glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f));
+
+	auto recordObjects = [&](RenderBucket& bucket, int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			const QueueBenchObject& object = objects[i];
+			RenderPacket packet;
+			packet.model = glm::translate(glm::mat4(1.0f), object.position);
+			uint32_t depth = RenderKey::quantizeDepth(-(view * glm::vec4(object.position, 1.0f)).z, farPlane);
+			uint32_t material = (object.textures[0] - 1) / 2;
+			packet.key = object.transparent ? RenderKey::transparent(object.program, material, object.vertexArray, depth) : RenderKey::opaque(object.program, material, object.vertexArray, depth);
+			packet.program = object.program;
+			packet.modelLocation = 0;
+			packet.vertexArray = object.vertexArray;
+			packet.textures[0] = object.textures[0];
+			packet.textures[1] = object.textures[1];
+			packet.primitive = GL_TRIANGLES;
+			packet.indexType = 0;
+			packet.first = 0;
+			packet.count = 36;
+			bucket.add(packet);
+		}
+	};
+
+	GLDispatchMock& mock = GLDispatchMock::instance();
+	mock.install();
+	GLStateCache& state = glState();
+
+	/* IMMEDIATE: state and draw of each object in scene order */
+	state.reset();
+	mock.resetCounters();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (int i = 0; i < objectCount; i++)
+		{
+			const QueueBenchObject& object = objects[i];
+			state.setEnabled(GL_BLEND, object.transparent);
+			state.useProgram(object.program);
+			state.bindTextureUnit(0, GL_TEXTURE_2D, object.textures[0]);
+			state.bindTextureUnit(1, GL_TEXTURE_2D, object.textures[1]);
+			state.bindVertexArray(object.vertexArray);
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), object.position);
+			glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(model));
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}
+	}
+	std::chrono::duration<double, std::milli> immediateTime = std::chrono::high_resolution_clock::now() - start;
+	unsigned long long immediateState = mockStateCalls(mock);
+
+	/* QUEUE: on one thread, then with one bucket per worker */
+	const char* names[2] = { "queue_1_thread", "queue_pool" };
+	RenderQueue singleQueue(1);
+	RenderQueue poolQueue(defaultThreadPool().size() + 1);
+	RenderQueue* queues[2] = { &singleQueue, &poolQueue };
+	std::vector<double> recordTimes[2], sortTimes[2], submitTimes[2];
+	unsigned long long queueState[2];
+	RenderQueueStats queueStats[2];
+	for (int q = 0; q < 2; q++)
+	{
+		RenderQueue& queue = *queues[q];
+		state.reset();
+		mock.resetCounters();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+			queue.clear();
+			queue.record(objectCount, recordObjects, q == 1 ? &defaultThreadPool() : NULL);
+			std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+			queue.sort();
+			std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+			queue.submit();
+			std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+			recordTimes[q].push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+			sortTimes[q].push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+			submitTimes[q].push_back(std::chrono::duration<double, std::milli>(t3 - t2).count());
+		}
+		queueState[q] = mockStateCalls(mock);
+		queueStats[q] = queue.stats;
+	}
+	state.reset(); // the mock bindings mean nothing for a real context
+
+	/* Radix sort against std::stable_sort on the keys in scene order */
+	std::vector<RenderQueue::SortItem> keys, radixSorted, sorted, scratch;
+	const std::vector<RenderPacket>& recorded = singleQueue.bucket(0).packets; // scene order
+	for (size_t i = 0; i < recorded.size(); i++)
+	{
+		RenderQueue::SortItem item;
+		item.key = recorded[i].key;
+		item.packet = (uint32_t)i;
+		keys.push_back(item);
+	}
+	std::vector<double> radixTimes, stdTimes;
+	long long mismatches = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		radixSorted = keys;
+		start = std::chrono::high_resolution_clock::now();
+		RenderQueue::radixSort(radixSorted, scratch);
+		radixTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		sorted = keys;
+		start = std::chrono::high_resolution_clock::now();
+		std::stable_sort(sorted.begin(), sorted.end(), sortItemLess);
+		stdTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			mismatches += radixSorted[i].key != sorted[i].key || radixSorted[i].packet != sorted[i].packet ? 1 : 0;
+		}
+	}
+	/* The pooled queue recorded the same packets into several buckets: its
+	   order must still be the stable one, told apart by the model position */
+	mismatches += poolQueue.size() != (int)sorted.size() ? 1 : 0;
+	for (int i = 0; i < poolQueue.size() && i < (int)sorted.size(); i++)
+	{
+		const RenderPacket& packet = poolQueue.packet(i);
+		const RenderPacket& expected = recorded[sorted[i].packet];
+		mismatches += packet.key != expected.key || packet.model[3] != expected.model[3] ? 1 : 0;
+	}
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("queue"));
+	json.value("frames", (long long)frames);
+	json.value("objects", (long long)objectCount);
+	json.value("programs", (long long)programs);
+	json.value("materials", (long long)materials);
+	json.value("vertex_arrays", (long long)vertexArrays);
+	json.beginObject("immediate");
+	json.value("ms_per_frame", immediateTime.count() / frames);
+	json.value("state_calls_per_frame", (double)immediateState / frames);
+	json.endObject();
+	for (int q = 0; q < 2; q++)
+	{
+		json.beginObject(names[q]);
+		json.value("buckets", (long long)queues[q]->bucketCount());
+		json.stats("record_ms", computeStats(recordTimes[q]));
+		json.stats("sort_ms", computeStats(sortTimes[q]));
+		json.stats("submit_ms", computeStats(submitTimes[q]));
+		json.value("state_calls_per_frame", (double)queueState[q] / frames);
+		json.value("program_changes", (long long)queueStats[q].programChanges);
+		json.value("texture_changes", (long long)queueStats[q].textureChanges);
+		json.value("vertex_array_changes", (long long)queueStats[q].vertexArrayChanges);
+		json.endObject();
+	}
+	json.stats("radix_sort_ms", computeStats(radixTimes));
+	json.stats("std_stable_sort_ms", computeStats(stdTimes));
+	json.value("mismatches", mismatches);
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef BENCH_REMAP_H
+#define BENCH_REMAP_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "remap_lut.h"
+#include "camera_model.h"
+#include "shader.h"
+#include "headless.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Pixel of view pixel (x, y) in 'camera' in double precision with the exact
+   atan2, the reference of the accuracy of the LUTs (fisheye cameras only) */
+inline bool referenceRemapPixel(const CameraModel& camera, const CameraModel& view, int x, int y, glm::dvec2& pixel)
+{
+	glm::dmat3 toCamera = glm::dmat3(camera.rotation) * glm::transpose(glm::dmat3(view.rotation));
+	glm::dvec3 p = toCamera * glm::dvec3((x - (double)view.cx) / view.fx, (y - (double)view.cy) / view.fy, 1.0);
+	double r = sqrt(p.x * p.x + p.y * p.y);
+	double theta = atan2(r, p.z);
+	double t2 = theta * theta;
+	double distorted = theta * (1.0 + t2 * (camera.k[0] + t2 * (camera.k[1] + t2 * (camera.k[2] + t2 * camera.k[3]))));
+	double scale = r > 0.0 ? distorted / r : 0.0;
+	pixel = glm::dvec2(camera.fx * p.x * scale + camera.cx, camera.fy * p.y * scale + camera.cy);
+	return theta <= camera.maxAngle && pixel.x > -0.5 && pixel.x < camera.width - 0.5 && pixel.y > -0.5 && pixel.y < camera.height - 0.5;
+}
+
+/* Micro-benchmark of the remap LUTs of a surround-view rig: 4 fisheye
+   cameras of 190 degrees, each undistorted into a pinhole view of 140
+   degrees at the same resolution. For each LUT encoding reports the time to
+   rebuild the 4 LUTs (what a recalibration costs) on the scalar path, with
+   SSE2 and with SSE2 on the thread pool, the LUTs where the paths disagree,
+   the error of the stored coordinates against a double precision reference
+   in camera pixels, and on the GPU the time to create and to update the LUT
+   textures and to draw one undistorted view with shader_remap.fs. */
+inline int runRemapBenchmark(std::ostream& out, int iterations, int width, int height)
+{
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		return -1;
+	}
+	OffscreenTarget target;
+	if (!target.create(width, height))
+	{
+		return -1;
+	}
+
+	CameraModel cameras[4], views[4];
+	surroundViewRig(width, height, cameras);
+	for (int c = 0; c < 4; c++)
+	{
+		views[c] = pinholeCamera(width, height, glm::radians(140.0f), cameras[c].rotation, cameras[c].position);
+	}
+
+	/* Camera image: a checkerboard of 32 pixel squares, red and green ramps */
+	std::vector<unsigned char> image((size_t)width * height * 3);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char* pixel = &image[((size_t)y * width + x) * 3];
+			pixel[0] = (unsigned char)(x * 255 / width);
+			pixel[1] = (unsigned char)(y * 255 / height);
+			pixel[2] = ((x / 32 + y / 32) & 1) ? 255 : 0;
+		}
+	}
+	GLuint cameraTexture;
+	glGenTextures(1, &cameraTexture);
+	glState().bindTexture(GL_TEXTURE_2D, cameraTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+
+	/* Full screen quad, texture coordinate (0, 0) at the top-left like the rows of the LUT */
+	const float quad[4 * 8] = {
+		-1.0f,  1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f,
+		 1.0f,  1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  1.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f,
+		 1.0f, -1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  1.0f, 1.0f
+	};
+	GLuint vertexArray, vertexBuffer;
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(1, &vertexBuffer);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	for (int a = 0; a < 3; a++)
+	{
+		const int components[3] = { 3, 3, 2 }, offsets[3] = { 0, 3, 6 };
+		glVertexAttribPointer(a, components[a], GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(offsets[a] * sizeof(float)));
+		glEnableVertexAttribArray(a);
+	}
+	Shader shader("shader.vs", "shader_remap.fs");
+	if (!shader.ID)
+	{
+		return -1;
+	}
+	shader.use();
+	shader.setMat4(shader.uniform("model"), glm::mat4(1.0f));
+	shader.setMat4(shader.uniform("view"), glm::mat4(1.0f));
+	shader.setMat4(shader.uniform("projection"), glm::mat4(1.0f));
+	shader.setInt("texture1", 0);
+	shader.setInt("remapLut", 1);
+	target.bind();
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto millis = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("remap"));
+	json.value("iterations", (long long)iterations);
+	json.value("cameras", 4LL);
+	json.value("width", (long long)width);
+	json.value("height", (long long)height);
+	json.value("threads", (long long)defaultThreadPool().size() + 1);
+	json.beginArray("results");
+	const LutEncoding encodings[2] = { LUT_UNORM16, LUT_HALF };
+	for (int e = 0; e < 2; e++)
+	{
+		RemapLut luts[4];
+		std::vector<double> scalarTimes, simdTimes, pooledTimes;
+		long long mismatches = 0;
+		for (int it = 0; it < iterations; it++)
+		{
+			Clock::time_point start = Clock::now();
+			if (it == 0) // slow, once
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					buildRemapLut(cameras[c], views[c], encodings[e], luts[c], NULL, false);
+				}
+				scalarTimes.push_back(millis(start));
+			}
+			start = Clock::now();
+			for (int c = 0; c < 4; c++)
+			{
+				buildRemapLut(cameras[c], views[c], encodings[e], luts[c], NULL, true);
+			}
+			simdTimes.push_back(millis(start));
+			start = Clock::now();
+			for (int c = 0; c < 4; c++)
+			{
+				buildRemapLut(cameras[c], views[c], encodings[e], luts[c], &defaultThreadPool(), true);
+			}
+			pooledTimes.push_back(millis(start));
+		}
+		for (int c = 0; c < 4; c++)
+		{
+			RemapLut scalar;
+			buildRemapLut(cameras[c], views[c], encodings[e], scalar, NULL, false);
+			mismatches += scalar.texels != luts[c].texels ? 1 : 0;
+		}
+
+		/* Error of the stored coordinates, every 7th pixel of every 7th row */
+		double maxError = 0.0, sumError = 0.0;
+		long long samples = 0, coverage = 0, disagreements = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			for (int y = 0; y < height; y += 7)
+			{
+				for (int x = 0; x < width; x += 7)
+				{
+					glm::dvec2 exact;
+					glm::vec2 stored;
+					bool seen = referenceRemapPixel(cameras[c], views[c], x, y, exact);
+					bool storedSeen = luts[c].lookup(x, y, stored);
+					if (seen != storedSeen)
+					{
+						disagreements++; // at the border of the image or the field of view
+						continue;
+					}
+					if (!seen)
+					{
+						continue;
+					}
+					glm::dvec2 pixel(stored.x * width - 0.5, stored.y * height - 0.5);
+					double error = glm::length(pixel - exact);
+					maxError = std::max(maxError, error);
+					sumError += error;
+					samples++;
+				}
+			}
+		}
+		for (size_t i = 0; i < luts[0].texels.size(); i += 2)
+		{
+			coverage += luts[0].encoding == LUT_HALF ? (luts[0].texels[i] != 0xbc00 ? 1 : 0) : (luts[0].texels[i] != 65535 ? 1 : 0);
+		}
+
+		/* GPU: create the textures, update them as after a recalibration, draw the front view */
+		Clock::time_point start = Clock::now();
+		for (int c = 0; c < 4; c++)
+		{
+			luts[c].upload();
+		}
+		glFinish();
+		double createMs = millis(start);
+		std::vector<double> updateTimes, drawTimes;
+		for (int it = 0; it < iterations; it++)
+		{
+			start = Clock::now();
+			for (int c = 0; c < 4; c++)
+			{
+				luts[c].upload();
+			}
+			glFinish();
+			updateTimes.push_back(millis(start));
+		}
+		shader.use();
+		shader.setFloat("lutScale", luts[0].shaderScale());
+		glState().bindTextureUnit(0, GL_TEXTURE_2D, cameraTexture);
+		glState().bindTextureUnit(1, GL_TEXTURE_2D, luts[0].texture);
+		std::vector<unsigned char> frame((size_t)width * height * 4);
+		for (int it = -1; it < iterations; it++) // 1 warm-up draw
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+			glFinish();
+			start = Clock::now();
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			glFinish();
+			if (it >= 0)
+			{
+				drawTimes.push_back(millis(start));
+			}
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, frame.data());
+		/* Compare with the camera pixel the CPU reads from the LUT (the framebuffer rows go up) */
+		long long gpuDiffers = 0, gpuSamples = 0;
+		for (int y = 0; y < height; y += 7)
+		{
+			for (int x = 0; x < width; x += 7)
+			{
+				glm::vec2 coordinates;
+				unsigned char expected[3] = { 0, 0, 0 };
+				if (luts[0].lookup(x, y, coordinates))
+				{
+					int sx = std::min(width - 1, (int)(coordinates.x * width)), sy = std::min(height - 1, (int)(coordinates.y * height));
+					memcpy(expected, &image[((size_t)sy * width + sx) * 3], 3);
+				}
+				const unsigned char* drawn = &frame[((size_t)(height - 1 - y) * width + x) * 4];
+				gpuDiffers += memcmp(drawn, expected, 3) != 0 ? 1 : 0;
+				gpuSamples++;
+			}
+		}
+
+		json.beginObject();
+		json.value("encoding", std::string(lutEncodingName(encodings[e])));
+		json.value("lut_mb", 4.0 * luts[0].texels.size() * sizeof(uint16_t) / (1024.0 * 1024.0));
+		json.value("coverage_percent", 100.0 * (double)coverage / ((double)width * height));
+		json.stats("scalar_ms", computeStats(scalarTimes));
+		json.stats("simd_ms", computeStats(simdTimes));
+		json.stats("simd_pool_ms", computeStats(pooledTimes));
+		json.value("mpixels_per_s", 4.0 * width * height / (computeStats(pooledTimes).mean * 1.0e3));
+		json.value("mismatches", mismatches);
+		json.value("mean_error_px", samples > 0 ? sumError / samples : 0.0);
+		json.value("max_error_px", maxError);
+		json.value("visibility_disagreements", disagreements);
+		json.value("texture_create_ms", createMs);
+		json.stats("texture_update_ms", computeStats(updateTimes));
+		json.stats("draw_ms", computeStats(drawTimes));
+		json.value("gpu_differs_percent", 100.0 * (double)gpuDiffers / gpuSamples);
+		json.endObject();
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteTextures(1, &cameraTexture);
+	glState().textureDeleted(cameraTexture);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef BENCH_REPLAY_H
+#define BENCH_REPLAY_H
+
+#include "drive_recording.h"
+#include "camera_frames.h"
+#include "camera_model.h"
+#include "file_utils.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/* Default directory of the recording written by the replay benchmark */
+const char* const DEFAULT_DRIVE_CORPUS = "drive_corpus";
+
+/* Drop the pages of a file from the OS cache, so the next read comes from
+   the disk (posix_fadvise, Linux / BSD). False where that is not possible. */
+inline bool evictFileCache(const std::string& path)
+{
+#if !defined(_WIN32) && !defined(__APPLE__)
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	fdatasync(fd); // only clean pages can be dropped
+	bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	::close(fd);
+	return evicted;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+/* Micro-benchmark of recorded drives: 'seconds' of the 4 cameras of the
+   synthetic rig (640 x 360 NV12, 30 Hz) and vehicle signals (100 Hz)
+   written to 'directory', then replayed. Reports the write rate, the
+   replay rate as fast as possible (frames/s, MB/s) with and without the
+   read-ahead of DriveRecording, from the OS cache and after evicting the
+   file from it, the frames whose bytes differ from the recorded ones, the
+   frames dropped by real-time replays rendered at 60 and 20 Hz (simulated
+   clock), and the cost of a seek through the bucket table against a binary
+   search of the index. The recording is removed at the end. */
+inline int runReplayBenchmark(std::ostream& out, int seconds, const std::string& directory)
+{
+	const int cameras = 4, width = 640, height = 360;
+	const float fps = 30.0f, signalHz = 100.0f;
+	const size_t readAhead = 16 << 20;
+	if (!makeDirectory(directory))
+	{
+		std::cout << "ERROR::DRIVE_RECORDING::CANNOT_CREATE_DIRECTORY " << directory << std::endl;
+		return -1;
+	}
+	std::string path = directory + "/bench.ldrv";
+
+	CameraModel rig[cameras];
+	surroundViewRig(width, height, rig);
+	SyntheticFrameSource source;
+	source.create(rig, cameras, PIXEL_NV12, 4, fps, &defaultThreadPool());
+	std::vector<uint64_t> hashes(source.loopFrames * cameras); // of the loop frames
+	for (int f = 0; f < source.loopFrames; f++)
+	{
+		for (int c = 0; c < cameras; c++)
+		{
+			hashes[f * cameras + c] = hashBytes(source.frame(c, f), source.frameBytes);
+		}
+	}
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto millis = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+	const double MB = 1024.0 * 1024.0;
+
+	/* Write */
+	DriveRecorder recorder;
+	Clock::time_point start = Clock::now();
+	if (!recorder.open(path, cameras, PIXEL_NV12, width, height) || !recordSyntheticDrive(recorder, source, seconds, signalHz) || !recorder.close())
+	{
+		return -1;
+	}
+	double writeMs = millis(start);
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("replay"));
+	json.value("seconds", (long long)seconds);
+	json.value("cameras", (long long)cameras);
+	json.value("width", (long long)width);
+	json.value("height", (long long)height);
+	json.value("format", std::string("nv12"));
+	json.value("frames", recorder.frameCount());
+	json.value("signals", recorder.signalCount());
+	json.value("file_mb", recorder.size() / MB);
+	json.value("write_ms", writeMs);
+	json.value("write_mb_per_second", recorder.size() / MB / (writeMs / 1000.0));
+	json.beginArray("results");
+
+	/* Replays as fast as possible: every frame read once, copied like an upload does */
+	std::vector<unsigned char> staging[cameras];
+	for (int c = 0; c < cameras; c++)
+	{
+		staging[c].resize(source.frameBytes);
+	}
+	for (int run = 0; run < 4; run++)
+	{
+		bool cold = run >= 2, advise = (run & 1) != 0;
+		bool evicted = cold && evictFileCache(path);
+		DriveRecording recording;
+		start = Clock::now();
+		if (!recording.open(path))
+		{
+			return -1;
+		}
+		double openMs = millis(start);
+		recording.setReadAhead(advise ? readAhead : 0);
+		DriveReplay replay;
+		replay.start(recording, REPLAY_FAST);
+		ReplayFrameSet set;
+		long long sets = 0;
+		start = Clock::now();
+		while (replay.stats.frames < recording.frameCount() && replay.next(0.0, set))
+		{
+			for (int c = 0; c < cameras; c++)
+			{
+				if (set.updated[c])
+				{
+					memcpy(staging[c].data(), set.frames[c], source.frameBytes); // what the upload does
+				}
+			}
+			sets++;
+		}
+		double replayMs = millis(start);
+		ReplayStats timed = replay.stats;
+
+		/* Then every frame checked against the source */
+		long long mismatches = 0;
+		replay.start(recording, REPLAY_FAST);
+		while (replay.stats.frames < recording.frameCount() && replay.next(0.0, set))
+		{
+			for (int c = 0; c < cameras; c++)
+			{
+				if (set.updated[c])
+				{
+					long long frame = (long long)llround(set.timestampUs[c] * fps / 1e6) % source.loopFrames;
+					mismatches += hashBytes(set.frames[c], source.frameBytes) != hashes[frame * cameras + c] ? 1 : 0;
+				}
+			}
+		}
+
+		json.beginObject();
+		json.value("mode", std::string("fast"));
+		json.value("cache", std::string(cold ? "evicted" : "warm"));
+		json.value("evicted", std::string(evicted ? "yes" : "no"));
+		json.value("read_ahead", std::string(advise ? "madvise" : "none"));
+		json.value("open_ms", openMs);
+		json.value("frames_per_second", timed.frames / (replayMs / 1000.0));
+		json.value("sets_per_second", sets / (replayMs / 1000.0));
+		json.value("mb_per_second", timed.bytes / MB / (replayMs / 1000.0));
+		json.value("frames", timed.frames);
+		json.value("drops", timed.drops);
+		json.value("mismatches", mismatches);
+		json.endObject();
+	}
+
+	/* Real time at a render rate: the frames that come between two render frames are dropped */
+	DriveRecording recording;
+	if (!recording.open(path))
+	{
+		return -1;
+	}
+	recording.setReadAhead(readAhead);
+	const double renderRates[2] = { 60.0, 20.0 };
+	for (int r = 0; r < 2; r++)
+	{
+		DriveReplay replay;
+		replay.start(recording, REPLAY_REALTIME);
+		ReplayFrameSet set;
+		std::vector<double> latencies; // render time - capture time of the frames drawn
+		long long renderFrames = (long long)(seconds * renderRates[r]);
+		for (long long f = 0; f < renderFrames; f++)
+		{
+			double now = f / renderRates[r];
+			replay.next(now, set);
+			for (int c = 0; c < cameras; c++)
+			{
+				if (set.updated[c])
+				{
+					latencies.push_back(now * 1000.0 - set.timestampUs[c] / 1000.0);
+				}
+			}
+		}
+		json.beginObject();
+		json.value("mode", std::string("realtime"));
+		json.value("render_hz", renderRates[r]);
+		json.value("frames", replay.stats.frames);
+		json.value("delivered", replay.stats.frames - replay.stats.drops);
+		json.value("drops", replay.stats.drops);
+		json.value("drop_percent", replay.stats.frames > 0 ? 100.0 * replay.stats.drops / replay.stats.frames : 0.0);
+		json.value("signals", replay.stats.signals);
+		json.stats("frame_age_ms", computeStats(latencies));
+		json.endObject();
+	}
+	json.endArray();
+
+	/* Seeks to random times: the bucket table against a binary search of the index */
+	const int seeks = 200000;
+	std::mt19937 random(7);
+	std::uniform_int_distribution<int64_t> times(recording.firstTimestamp() - 1000, recording.lastTimestamp() + 1000);
+	std::vector<int64_t> targets(seeks);
+	for (int i = 0; i < seeks; i++)
+	{
+		targets[i] = times(random);
+	}
+	std::vector<size_t> bucketResults(seeks), binaryResults(seeks);
+	start = Clock::now();
+	for (int i = 0; i < seeks; i++)
+	{
+		bucketResults[i] = recording.seek(targets[i]);
+	}
+	double bucketMs = millis(start);
+	start = Clock::now();
+	for (int i = 0; i < seeks; i++)
+	{
+		size_t low = 0, high = recording.recordCount();
+		while (low < high)
+		{
+			size_t middle = (low + high) / 2;
+			if (recording.entry(middle).timestampUs < targets[i])
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		binaryResults[i] = low;
+	}
+	double binaryMs = millis(start);
+	long long seekMismatches = 0;
+	for (int i = 0; i < seeks; i++)
+	{
+		seekMismatches += bucketResults[i] != binaryResults[i] ? 1 : 0;
+	}
+	json.beginObject("seek");
+	json.value("records", (long long)recording.recordCount());
+	json.value("seeks", (long long)seeks);
+	json.value("bucket_ns", bucketMs * 1e6 / seeks);
+	json.value("binary_search_ns", binaryMs * 1e6 / seeks);
+	json.value("mismatches", seekMismatches);
+	json.endObject();
+	json.endObject();
+	out << std::endl;
+
+	recording.close();
+	std::remove(path.c_str());
+	return 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef BENCH_SHADERS_H
+#define BENCH_SHADERS_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "shader.h"
+#include "shader_cache.h"
+#include "headless.h"
+#include "instancing.h"
+#include "gl_extensions.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+inline std::string readTextFile(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+/* Startup cost of the programs of the scene (one per draw mode), in a
+   headless context:
+   - sequential: compiled and linked one after the other (the old Shader),
+   - parallel: all started, then all finished (GL_KHR_parallel_shader_compile),
+   - cold: parallel with an empty ShaderCache, the binaries are saved,
+   - warm: loaded from the ShaderCache with glProgramBinary.
+   Drivers have their own shader cache as well (for Mesa set
+   MESA_SHADER_CACHE_DISABLE=true), or the "cold" builds are not cold. */
+inline int runShaderBenchmark(std::ostream& out, int iterations, const char* cacheDirectory)
+{
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		return -1;
+	}
+	glExtensions().load(context.getProcLoader());
+
+	ShaderCache cache;
+	bool cacheOpen = cache.open(cacheDirectory);
+
+	const int programCount = 3;
+	const DrawMode modes[programCount] = { DRAW_PER_OBJECT, DRAW_INSTANCED, DRAW_INSTANCED_TBO };
+	uint64_t keys[programCount];
+	for (int p = 0; p < programCount; p++)
+	{
+		keys[p] = cache.key(readTextFile(drawModeVertexShader(modes[p])), readTextFile("shader.fs"));
+	}
+
+	const char* names[4] = { "sequential", "parallel", "cold_cache", "warm_cache" };
+	std::vector<double> times[4]; // ms to build all the programs
+	for (int it = 0; it < iterations; it++)
+	{
+		for (int variant = 0; variant < 4; variant++)
+		{
+			if (variant >= 2 && !cacheOpen)
+			{
+				continue;
+			}
+			if (variant == 2)
+			{
+				for (int p = 0; p < programCount; p++)
+				{
+					cache.remove(keys[p]);
+				}
+			}
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			Shader shaders[programCount];
+			for (int p = 0; p < programCount; p++)
+			{
+				shaders[p].start(drawModeVertexShader(modes[p]), "shader.fs", variant >= 2 ? &cache : NULL);
+				if (variant == 0)
+				{
+					shaders[p].finish();
+				}
+			}
+			for (int p = 0; p < programCount; p++)
+			{
+				shaders[p].finish();
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			times[variant].push_back(elapsed.count());
+
+			for (int p = 0; p < programCount; p++)
+			{
+				glDeleteProgram(shaders[p].ID);
+			}
+		}
+	}
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("shaders"));
+	json.value("programs", (long long)programCount);
+	json.value("iterations", (long long)iterations);
+	json.value("renderer", std::string((const char*)glGetString(GL_RENDERER)));
+	json.value("program_binary", (long long)glExtensions().programBinary);
+	json.value("parallel_shader_compile", (long long)glExtensions().parallelShaderCompile);
+	for (int variant = 0; variant < 4; variant++)
+	{
+		if (!times[variant].empty())
+		{
+			json.stats(names[variant], computeStats(times[variant]));
+		}
+	}
+	if (!times[3].empty())
+	{
+		json.value("warm_speedup", computeStats(times[2]).mean / computeStats(times[3]).mean);
+	}
+	json.value("cache_hits", (long long)cache.hits);
+	json.value("cache_misses", (long long)cache.misses);
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
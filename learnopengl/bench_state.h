@@ -0,0 +1,229 @@
+#ifndef BENCH_STATE_H
+#define BENCH_STATE_H
+
+#include "gl_state.h"
+#include "gl_dispatch_mock.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+/* State calls of the benchmark, for the counts of the mock */
+static const GLDispatchFunction STATE_FUNCTIONS[] = {
+	GL_DISPATCH_UseProgram, GL_DISPATCH_BindVertexArray, GL_DISPATCH_ActiveTexture, GL_DISPATCH_BindTexture,
+	GL_DISPATCH_BindBuffer, GL_DISPATCH_Enable, GL_DISPATCH_Disable, GL_DISPATCH_ClearColor
+};
+
+inline unsigned long long mockStateCalls(const GLDispatchMock& mock)
+{
+	unsigned long long total = 0;
+	for (size_t i = 0; i < sizeof(STATE_FUNCTIONS) / sizeof(STATE_FUNCTIONS[0]); i++)
+	{
+		total += mock.calls[STATE_FUNCTIONS[i]];
+	}
+	return total;
+}
+
+/* Differences between what glState() believes is bound and the bindings of
+   the mock context: every value the cache knows must be the bound one */
+inline int stateCacheMismatches(const GLStateCache& state, const GLDispatchMock& mock)
+{
+	static const GLenum textureTargets[3] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP };
+	static const GLenum bufferTargets[4] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_UNPACK_BUFFER };
+	static const GLenum caps[2] = { GL_DEPTH_TEST, GL_BLEND };
+	auto differs = [](GLuint cached, GLuint bound) { return cached != GLStateCache::UNKNOWN && cached != bound ? 1 : 0; };
+	int mismatches = differs(state.currentProgram(), mock.program) + differs(state.currentVertexArray(), mock.vertexArray)
+		+ differs(state.currentActiveTexture(), mock.activeTexture);
+	for (unsigned int unit = 0; unit < 4; unit++)
+	{
+		for (int t = 0; t < 3; t++)
+		{
+			mismatches += differs(state.currentTexture(unit, textureTargets[t]), mock.texture(GL_TEXTURE0 + unit, textureTargets[t]));
+		}
+	}
+	for (int b = 0; b < 4; b++)
+	{
+		mismatches += differs(state.currentBuffer(bufferTargets[b]), mock.buffer(bufferTargets[b]));
+	}
+	for (int c = 0; c < 2; c++)
+	{
+		int enabled = state.currentEnabled(caps[c]);
+		mismatches += enabled >= 0 && (enabled != 0) != mock.isEnabled(caps[c]) ? 1 : 0;
+	}
+	return mismatches;
+}
+
+/* Check of glState() against the mock context, step by step: each step
+   must send exactly the expected number of calls to the dispatch table (0
+   for the redundant ones), and the state the cache believes in must then be
+   the bound one, through VAO switches (the element array buffer is VAO
+   state), unit changes and deleted objects. A last step deletes a texture
+   without textureDeleted() and must be caught. Returns the failed steps,
+   printed as ERROR::GL_STATE::CHECK_FAILED. */
+inline int checkStateCache(int& steps)
+{
+	GLDispatchMock& mock = GLDispatchMock::instance();
+	mock.install(true);
+	GLStateCache& state = glState();
+	state.reset();
+	int failures = 0;
+	steps = 0;
+	auto step = [&](const char* name, long long expectedCalls, bool expectStale, const std::function<void()>& body) {
+		unsigned long long before = mock.totalCalls();
+		body();
+		long long calls = (long long)(mock.totalCalls() - before);
+		int mismatches = stateCacheMismatches(state, mock);
+		steps++;
+		if (calls != expectedCalls || (mismatches > 0) != expectStale)
+		{
+			failures++;
+			std::cout << "ERROR::GL_STATE::CHECK_FAILED " << name << ": " << calls << " calls (expected " << expectedCalls << "), "
+				<< mismatches << " stale bindings" << std::endl;
+		}
+	};
+	GLuint texture = 10, buffer = 5, elementBuffer = 7, vertexArray = 2;
+
+	/* Programs, capabilities, clear colour */
+	step("useProgram", 1, false, [&]() { state.useProgram(3); });
+	step("useProgram again", 0, false, [&]() { state.useProgram(3); });
+	step("useProgram other", 1, false, [&]() { state.useProgram(4); });
+	step("enable", 1, false, [&]() { state.enable(GL_DEPTH_TEST); });
+	step("enable again", 0, false, [&]() { state.enable(GL_DEPTH_TEST); });
+	step("disable", 1, false, [&]() { state.disable(GL_DEPTH_TEST); });
+	step("clearColor", 1, false, [&]() { state.clearColor(0.2f, 0.3f, 0.3f, 1.0f); });
+	step("clearColor again", 0, false, [&]() { state.clearColor(0.2f, 0.3f, 0.3f, 1.0f); });
+
+	/* Buffers and VAOs: the element array buffer follows the VAO, the array buffer does not */
+	step("bindVertexArray", 1, false, [&]() { state.bindVertexArray(1); });
+	step("bindBuffer element", 1, false, [&]() { state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer); });
+	step("bindBuffer element again", 0, false, [&]() { state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer); });
+	step("bindBuffer array", 1, false, [&]() { state.bindBuffer(GL_ARRAY_BUFFER, buffer); });
+	step("bindVertexArray switch", 1, false, [&]() { state.bindVertexArray(vertexArray); });
+	step("bindBuffer array after switch", 0, false, [&]() { state.bindBuffer(GL_ARRAY_BUFFER, buffer); });
+	step("bindBuffer element after switch", 1, false, [&]() { state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer); });
+	step("bindVertexArray again", 0, false, [&]() { state.bindVertexArray(vertexArray); });
+
+	/* Texture units */
+	step("bindTextureUnit 0", 2, false, [&]() { state.bindTextureUnit(0, GL_TEXTURE_2D, texture); });
+	step("bindTextureUnit 1", 2, false, [&]() { state.bindTextureUnit(1, GL_TEXTURE_2D, 11); });
+	step("bindTextureUnit 0 again", 0, false, [&]() { state.bindTextureUnit(0, GL_TEXTURE_2D, texture); });
+	step("bindTexture on the active unit", 0, false, [&]() { state.bindTexture(GL_TEXTURE_2D, 11); });
+	step("activeTexture", 1, false, [&]() { state.activeTexture(GL_TEXTURE0); });
+	step("bindTexture after the unit change", 1, false, [&]() { state.bindTexture(GL_TEXTURE_2D, 11); });
+	step("bindTextureUnit other target", 2, false, [&]() { state.bindTextureUnit(1, GL_TEXTURE_2D_ARRAY, 12); });
+	step("bindTextureUnit back", 2, false, [&]() { state.bindTextureUnit(0, GL_TEXTURE_2D, texture); });
+
+	/* Deleted objects are unbound by OpenGL, the hooks must forget them */
+	step("textureDeleted", 1, false, [&]() { glDeleteTextures(1, &texture); state.textureDeleted(texture); });
+	step("bindTextureUnit deleted name", 1, false, [&]() { state.bindTextureUnit(0, GL_TEXTURE_2D, texture); });
+	step("bufferDeleted", 1, false, [&]() { glDeleteBuffers(1, &buffer); state.bufferDeleted(buffer); });
+	step("bindBuffer deleted name", 1, false, [&]() { state.bindBuffer(GL_ARRAY_BUFFER, buffer); });
+	step("bufferDeleted element", 1, false, [&]() { glDeleteBuffers(1, &elementBuffer); state.bufferDeleted(elementBuffer); });
+	step("vertexArrayDeleted", 1, false, [&]() { glDeleteVertexArrays(1, &vertexArray); state.vertexArrayDeleted(vertexArray); });
+	step("bindVertexArray deleted name", 1, false, [&]() { state.bindVertexArray(vertexArray); });
+	step("programDeleted", 1, false, [&]() { glDeleteProgram(4); state.programDeleted(4); });
+	step("useProgram deleted name", 1, false, [&]() { state.useProgram(4); });
+
+	/* The check itself: a texture deleted behind the cache is stale */
+	step("texture deleted without the hook", 1, true, [&]() { GLuint stale = 12; glDeleteTextures(1, &stale); });
+
+	state.reset(); // the mock bindings mean nothing for a real context
+	mock.install();
+	return failures;
+}
+
+/* Micro-benchmark of the state changes of one frame of the cube scene, where
+   every cube binds its whole "material" (program, 2 textures, VAO, depth
+   test) before its draw, like a renderer which does not know what the
+   previous draw left bound. Issued directly and through glState(). Runs on
+   the mock dispatch table, so the counts are the calls which would reach the
+   driver, and the time is only the CPU work on our side. Then runs
+   checkStateCache(), and fails if a step of it does. */
+inline int runStateBenchmark(std::ostream& out, int frames)
+{
+	const int cubes = 10;
+	const GLuint program = 3, vertexArray = 1, texture1 = 1, texture2 = 2;
+	const GLint modelLoc = 0;
+	const GLfloat model[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+	GLDispatchMock& mock = GLDispatchMock::instance();
+	mock.install();
+
+	/* DIRECT: every call reaches the driver */
+	mock.resetCounters();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		for (int i = 0; i < cubes; i++)
+		{
+			glEnable(GL_DEPTH_TEST);
+			glUseProgram(program);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, texture1);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, texture2);
+			glBindVertexArray(vertexArray);
+			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}
+	}
+	std::chrono::duration<double, std::nano> directTime = std::chrono::high_resolution_clock::now() - start;
+	unsigned long long directState = mockStateCalls(mock);
+	unsigned long long directTotal = mock.totalCalls();
+
+	/* CACHED: the same sequence through the state cache */
+	GLStateCache& state = glState();
+	state.reset();
+	state.resetCounters();
+	mock.resetCounters();
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		for (int i = 0; i < cubes; i++)
+		{
+			state.enable(GL_DEPTH_TEST);
+			state.useProgram(program);
+			state.bindTextureUnit(0, GL_TEXTURE_2D, texture1);
+			state.bindTextureUnit(1, GL_TEXTURE_2D, texture2);
+			state.bindVertexArray(vertexArray);
+			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}
+	}
+	std::chrono::duration<double, std::nano> cachedTime = std::chrono::high_resolution_clock::now() - start;
+	unsigned long long cachedState = mockStateCalls(mock);
+	unsigned long long cachedTotal = mock.totalCalls();
+	state.reset(); // the mock bindings mean nothing for a real context
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("state"));
+	json.value("frames", (long long)frames);
+	json.value("draws_per_frame", (long long)cubes);
+	json.beginObject("direct");
+	json.value("ns_per_frame", directTime.count() / frames);
+	json.value("state_calls_per_frame", (double)directState / frames);
+	json.value("gl_calls_per_frame", (double)directTotal / frames);
+	json.endObject();
+	json.beginObject("cached");
+	json.value("ns_per_frame", cachedTime.count() / frames);
+	json.value("state_calls_per_frame", (double)cachedState / frames);
+	json.value("gl_calls_per_frame", (double)cachedTotal / frames);
+	json.value("saved_calls_per_frame", (double)state.savedCalls / frames);
+	json.endObject();
+	json.value("speedup", cachedTime.count() > 0.0 ? directTime.count() / cachedTime.count() : 0.0);
+	int checkSteps = 0;
+	int checkFailures = checkStateCache(checkSteps);
+	json.value("check_steps", (long long)checkSteps);
+	json.value("check_failures", (long long)checkFailures);
+	json.endObject();
+	out << std::endl;
+	return checkFailures == 0 ? 0 : -1;
+}
+
+#endif
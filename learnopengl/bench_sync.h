@@ -0,0 +1,246 @@
+#ifndef BENCH_SYNC_H
+#define BENCH_SYNC_H
+
+#include "frame_sync.h"
+#include "camera_frames.h"
+#include "benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Micro-benchmark of the multi-camera frame synchronizer: 4 free-running
+   cameras (CameraProducerThreads, 30 frames per second, drifting clocks,
+   3 ms of jitter) delivering 640x360 NV12 frames on their own threads, and
+   a render thread that takes a set on every frame at 60 and at 20 Hz for
+   'seconds' each and copies the new frames (what the upload does). Reports
+   the render-thread time of that exchange, the skew of the sets against
+   taking the newest frame of every camera, the age of the sets, drops
+   (stale frames, frames lost on a full ring) and frames torn or out of
+   order (each frame carries its number at both ends). The same run with a
+   mutex and a latest-frame buffer per camera, the producer copying under
+   the lock, shows the render thread blocked by the producers. Last, the
+   producers deliver 4 KB frames as fast as they can for 1 s against a
+   render thread polling without pause. */
+inline int runSyncBenchmark(std::ostream& out, int seconds)
+{
+	const int cameras = 4, width = 640, height = 360;
+	const float fps = 30.0f;
+	const int64_t jitterUs = 3000;
+	typedef std::chrono::steady_clock Clock;
+	auto micros = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+	};
+	// every frame starts and ends with its number, and the camera data in between
+	std::vector<unsigned char> pattern(cameraFrameBytes(PIXEL_NV12, width, height), 128);
+	auto stamp = [&pattern](long long frame, unsigned char* data, size_t size) {
+		memcpy(data, pattern.data(), size);
+		memcpy(data, &frame, sizeof(frame));
+		memcpy(data + size - sizeof(frame), &frame, sizeof(frame));
+	};
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("sync"));
+	json.value("seconds", (long long)seconds);
+	json.value("cameras", (long long)cameras);
+	json.value("camera_fps", (double)fps);
+	json.value("jitter_ms", jitterUs / 1000.0);
+	json.value("frame_kb", pattern.size() / 1024.0);
+	json.value("slots_per_camera", (long long)FrameSlotRing::SLOTS);
+	json.value("hardware_threads", (long long)std::thread::hardware_concurrency());
+	json.beginArray("results");
+
+	/* Lock-free rings and synchronizer, at 2 render rates, then unthrottled */
+	const double renderRates[3] = { 60.0, 20.0, 0.0 };
+	for (int r = 0; r < 3; r++)
+	{
+		bool stress = renderRates[r] == 0.0;
+		size_t frameBytes = stress ? 4096 : pattern.size();
+		FrameSynchronizer synchronizer;
+		synchronizer.create(cameras, frameBytes, fps);
+		std::vector<unsigned char> staging(frameBytes);
+		std::vector<double> exchangeUs, skewMs, latestSkewMs, ageMs;
+		long long torn = 0, outOfOrder = 0, lastFrame[cameras];
+		for (int c = 0; c < cameras; c++)
+		{
+			lastFrame[c] = -1;
+		}
+		CameraProducerThreads producers;
+		producers.start(synchronizer, stress ? 0.0f : fps, stress ? 0 : jitterUs, [&stamp, frameBytes](int, long long frame, unsigned char* data) {
+			stamp(frame, data, frameBytes);
+		});
+		Clock::time_point start = Clock::now();
+		double runSeconds = stress ? 1.0 : seconds;
+		for (long long f = 0; ; f++)
+		{
+			if (!stress)
+			{
+				std::this_thread::sleep_until(start + std::chrono::microseconds((long long)(f * 1e6 / renderRates[r])));
+			}
+			if (std::chrono::duration<double>(Clock::now() - start).count() >= runSeconds)
+			{
+				break;
+			}
+			Clock::time_point exchange = Clock::now();
+			SyncedFrameSet set;
+			bool selected = synchronizer.select(set);
+			if (selected)
+			{
+				for (int c = 0; c < cameras; c++)
+				{
+					if (set.updated[c])
+					{
+						memcpy(staging.data(), set.frames[c], frameBytes);
+					}
+				}
+			}
+			exchangeUs.push_back(micros(exchange));
+			if (!selected)
+			{
+				continue;
+			}
+			int64_t newest = INT64_MIN;
+			for (int c = 0; c < cameras; c++)
+			{
+				long long head, tail;
+				memcpy(&head, set.frames[c], sizeof(head));
+				memcpy(&tail, set.frames[c] + frameBytes - sizeof(tail), sizeof(tail));
+				torn += head != tail ? 1 : 0;
+				outOfOrder += set.updated[c] && head <= lastFrame[c] ? 1 : 0;
+				lastFrame[c] = head;
+				newest = set.timestampUs[c] > newest ? set.timestampUs[c] : newest;
+			}
+			skewMs.push_back(set.skewUs / 1000.0);
+			latestSkewMs.push_back(set.latestSkewUs / 1000.0);
+			ageMs.push_back((producers.now() - newest) / 1000.0);
+		}
+		producers.stop();
+		FrameSyncStats stats = synchronizer.stats();
+
+		json.beginObject();
+		json.value("path", std::string(stress ? "lock_free_unthrottled" : "lock_free"));
+		json.value("render_hz", renderRates[r]);
+		json.value("frame_kb", frameBytes / 1024.0);
+		json.value("published", stats.published);
+		json.value("published_per_second", stats.published / runSeconds);
+		json.value("ring_full", stats.ringFull);
+		json.value("sets", stats.sets);
+		json.value("incomplete", stats.incomplete);
+		json.value("delivered", stats.delivered);
+		json.value("repeated", stats.repeated);
+		json.value("stale", stats.stale);
+		json.value("drop_percent", stats.published > 0 ? 100.0 * (stats.stale + stats.ringFull) / (stats.published + stats.ringFull) : 0.0);
+		json.stats("exchange_us", computeStats(exchangeUs));
+		json.stats("skew_ms", computeStats(skewMs));
+		json.stats("latest_frames_skew_ms", computeStats(latestSkewMs));
+		json.stats("age_ms", computeStats(ageMs));
+		json.value("torn", torn);
+		json.value("out_of_order", outOfOrder);
+		json.endObject();
+	}
+
+	/* Baseline: a mutex and the latest frame per camera, copied under the lock on both sides */
+	{
+		struct LatestFrame
+		{
+			std::mutex mutex;
+			std::vector<unsigned char> data;
+			int64_t timestampUs;
+			bool fresh;
+			long long published, overwritten;
+		};
+		LatestFrame latest[cameras];
+		for (int c = 0; c < cameras; c++)
+		{
+			latest[c].data.resize(pattern.size());
+			latest[c].timestampUs = 0;
+			latest[c].fresh = false;
+			latest[c].published = latest[c].overwritten = 0;
+		}
+		std::vector<unsigned char> staging(pattern.size()), capture[cameras];
+		std::atomic<bool> stopping(false);
+		Clock::time_point epoch = Clock::now();
+		std::vector<std::thread> threads;
+		for (int c = 0; c < cameras; c++)
+		{
+			capture[c].resize(pattern.size());
+			threads.push_back(std::thread([&, c]() {
+				std::mt19937 random(1234 + c);
+				std::uniform_int_distribution<int64_t> jitter(-jitterUs, jitterUs), delay(0, jitterUs);
+				double cameraFps = fps * (1.0 + c / 1000.0);
+				for (long long frame = 0; !stopping.load(std::memory_order_relaxed); frame++)
+				{
+					int64_t captureUs = (int64_t)c * 2000 + (int64_t)(frame * 1e6 / cameraFps);
+					std::this_thread::sleep_until(epoch + std::chrono::microseconds(captureUs + delay(random)));
+					stamp(frame, capture[c].data(), pattern.size());
+					std::lock_guard<std::mutex> lock(latest[c].mutex);
+					memcpy(latest[c].data.data(), capture[c].data(), pattern.size());
+					latest[c].overwritten += latest[c].fresh ? 1 : 0;
+					latest[c].timestampUs = captureUs + jitter(random);
+					latest[c].fresh = true;
+					latest[c].published++;
+				}
+			}));
+		}
+		std::vector<double> exchangeUs, waitUs, skewMs;
+		Clock::time_point start = Clock::now();
+		for (long long f = 0; ; f++)
+		{
+			std::this_thread::sleep_until(start + std::chrono::microseconds((long long)(f * 1e6 / renderRates[0])));
+			if (std::chrono::duration<double>(Clock::now() - start).count() >= seconds)
+			{
+				break;
+			}
+			Clock::time_point exchange = Clock::now();
+			int64_t lowest = INT64_MAX, highest = INT64_MIN;
+			for (int c = 0; c < cameras; c++)
+			{
+				Clock::time_point wait = Clock::now();
+				std::lock_guard<std::mutex> lock(latest[c].mutex);
+				waitUs.push_back(micros(wait));
+				if (latest[c].fresh)
+				{
+					memcpy(staging.data(), latest[c].data.data(), pattern.size());
+					latest[c].fresh = false;
+				}
+				lowest = latest[c].timestampUs < lowest ? latest[c].timestampUs : lowest;
+				highest = latest[c].timestampUs > highest ? latest[c].timestampUs : highest;
+			}
+			exchangeUs.push_back(micros(exchange));
+			skewMs.push_back((highest - lowest) / 1000.0);
+		}
+		stopping.store(true);
+		long long published = 0, overwritten = 0;
+		for (int c = 0; c < cameras; c++)
+		{
+			threads[c].join();
+			published += latest[c].published;
+			overwritten += latest[c].overwritten;
+		}
+
+		json.beginObject();
+		json.value("path", std::string("mutex_latest_frame"));
+		json.value("render_hz", renderRates[0]);
+		json.value("frame_kb", pattern.size() / 1024.0);
+		json.value("published", published);
+		json.value("stale", overwritten);
+		json.stats("exchange_us", computeStats(exchangeUs));
+		json.stats("lock_wait_us", computeStats(waitUs));
+		json.stats("skew_ms", computeStats(skewMs));
+		json.endObject();
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef BENCH_TRANSFORMS_H
+#define BENCH_TRANSFORMS_H
+
+#include "transforms.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/* Model matrices of 100k instances per iteration: the scalar glm::translate +
+   glm::rotate loop of the per-object path against TransformBatch on one
+   thread and on the default thread pool. CPU only, no OpenGL context.
+
+   Afterwards both batch variants are compared with the glm path, with and
+   without a parent matrix and at a late time where the angles are large: an
+   instance whose matrix differs by more than 1e-4 (relative to the element,
+   or absolute below 1) counts in 'mismatches', which must be 0. */
+inline int runTransformBenchmark(std::ostream& out, int iterations)
+{
+	const int count = 100000;
+	const glm::vec3 axis(0.5f, 1.0f, 1.0f);
+	const float speed = glm::radians(-55.0f);
+
+	std::vector<glm::vec3> positions(count);
+	TransformBatch batch;
+	batch.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		positions[i] = glm::vec3((float)(i % 100), (float)(i / 100 % 100), -(float)(i / 10000));
+		batch.set(i, positions[i], axis, 0.0f, speed);
+	}
+	std::vector<glm::mat4> models(count);
+
+	double times[3]; // ns per iteration: glm loop, batch on 1 thread, batch on the pool
+	for (int variant = 0; variant < 3; variant++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int it = 0; it < iterations; it++)
+		{
+			float time = it * (1.0f / 60.0f);
+			if (variant == 0)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+					models[i] = glm::rotate(model, time * speed, axis);
+				}
+			}
+			else
+			{
+				batch.update(time, glm::mat4(1.0f), models.data(), variant == 2 ? &defaultThreadPool() : NULL);
+			}
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+		times[variant] = elapsed.count() / iterations;
+	}
+
+	/* Correctness against the per-instance glm path */
+	const glm::mat4 parents[2] = { glm::mat4(1.0f),
+		glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, -2.0f, 5.0f)), 0.7f, glm::vec3(0.0f, 1.0f, 0.0f)) };
+	const float checkTimes[2] = { (iterations - 1) * (1.0f / 60.0f), 1234.5f };
+	std::vector<glm::mat4> reference(count);
+	long long mismatches = 0;
+	float maxError = 0.0f;
+	for (int p = 0; p < 2; p++)
+	{
+		for (int t = 0; t < 2; t++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				glm::mat4 model = glm::translate(parents[p], positions[i]);
+				reference[i] = glm::rotate(model, checkTimes[t] * speed, axis);
+			}
+			for (int variant = 1; variant < 3; variant++)
+			{
+				batch.update(checkTimes[t], parents[p], models.data(), variant == 2 ? &defaultThreadPool() : NULL);
+				for (int i = 0; i < count; i++)
+				{
+					bool same = true;
+					for (int c = 0; c < 4; c++)
+					{
+						for (int r = 0; r < 4; r++)
+						{
+							float expected = reference[i][c][r];
+							float error = std::fabs(models[i][c][r] - expected) / std::max(1.0f, std::fabs(expected));
+							maxError = std::max(maxError, error);
+							same = same && error <= 1e-4f;
+						}
+					}
+					mismatches += same ? 0 : 1;
+				}
+			}
+		}
+	}
+
+	const char* names[3] = { "glm_scalar", "batch_single_thread", "batch_thread_pool" };
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("transforms"));
+	json.value("instances", (long long)count);
+	json.value("iterations", (long long)iterations);
+	json.value("threads", (long long)defaultThreadPool().size() + 1);
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	json.value("simd", std::string("sse2"));
+#else
+	json.value("simd", std::string("none"));
+#endif
+	for (int variant = 0; variant < 3; variant++)
+	{
+		json.beginObject(names[variant]);
+		json.value("ms_per_update", times[variant] / 1.0e6);
+		json.value("ns_per_instance", times[variant] / count);
+		json.value("output_gb_per_s", (double)count * sizeof(glm::mat4) / times[variant]);
+		json.endObject();
+	}
+	json.value("speedup_single_thread", times[0] / times[1]);
+	json.value("speedup_thread_pool", times[0] / times[2]);
+	json.value("max_error", (double)maxError);
+	json.value("mismatches", mismatches);
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
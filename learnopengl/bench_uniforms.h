@@ -0,0 +1,101 @@
+#ifndef BENCH_UNIFORMS_H
+#define BENCH_UNIFORMS_H
+
+#include "shader.h"
+#include "gl_dispatch_mock.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <string>
+
+/* Uniform update path of the render loop before the uniform cache: a by-name
+   lookup in the driver for every upload */
+inline void legacySetInt(unsigned int ID, const std::string& name, int value)
+{
+	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+}
+
+/* Micro-benchmark of one frame of the cube scene (2 samplers, view, projection
+   and one model matrix per cube) with the by-name path against the
+   pre-resolved handles. Runs on the mock GL dispatch, so it only measures the
+   CPU work on our side of the driver boundary plus the number of calls. */
+inline int runUniformBenchmark(std::ostream& out, int frames)
+{
+	const int cubes = 10;
+
+	GLDispatchMock& mock = GLDispatchMock::instance();
+	mock.uniforms.clear();
+	mock.uniforms.push_back("model");
+	mock.uniforms.push_back("view");
+	mock.uniforms.push_back("projection");
+	mock.uniforms.push_back("texture1");
+	mock.uniforms.push_back("texture2");
+	mock.install();
+
+	Shader shader("shader.vs", "shader.fs");
+	glm::mat4 view(1.0f), projection(1.0f), model(1.0f);
+
+	/* OLD: string + glGetUniformLocation for every upload */
+	mock.resetCounters();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		legacySetInt(shader.ID, "texture1", 0);
+		legacySetInt(shader.ID, "texture2", 1);
+		glUniformMatrix4fv(glGetUniformLocation(shader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
+		glUniformMatrix4fv(glGetUniformLocation(shader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+		for (int i = 0; i < cubes; i++)
+		{
+			model[3][0] = (float)i;
+			glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));
+		}
+	}
+	std::chrono::duration<double, std::nano> legacyTime = std::chrono::high_resolution_clock::now() - start;
+	unsigned long long legacyLookups = mock.calls[GL_DISPATCH_GetUniformLocation];
+	unsigned long long legacyUploads = mock.uniformUploads();
+
+	/* NEW: handles resolved once, typed setters in the loop */
+	mock.resetCounters();
+	start = std::chrono::high_resolution_clock::now();
+	UniformHandle texture1Loc = shader.uniform("texture1");
+	UniformHandle texture2Loc = shader.uniform("texture2");
+	UniformHandle viewLoc = shader.uniform("view");
+	UniformHandle projectionLoc = shader.uniform("projection");
+	UniformHandle modelLoc = shader.uniform("model");
+	for (int frame = 0; frame < frames; frame++)
+	{
+		shader.setInt(texture1Loc, 0);
+		shader.setInt(texture2Loc, 1);
+		shader.setMat4(viewLoc, view);
+		shader.setMat4(projectionLoc, projection);
+		for (int i = 0; i < cubes; i++)
+		{
+			model[3][0] = (float)i;
+			shader.setMat4(modelLoc, model);
+		}
+	}
+	std::chrono::duration<double, std::nano> cachedTime = std::chrono::high_resolution_clock::now() - start;
+	unsigned long long cachedLookups = mock.calls[GL_DISPATCH_GetUniformLocation];
+	unsigned long long cachedUploads = mock.uniformUploads();
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("uniforms"));
+	json.value("frames", (long long)frames);
+	json.beginObject("legacy");
+	json.value("ns_per_frame", legacyTime.count() / frames);
+	json.value("lookups_per_frame", (double)legacyLookups / frames);
+	json.value("uploads_per_frame", (double)legacyUploads / frames);
+	json.endObject();
+	json.beginObject("cached");
+	json.value("ns_per_frame", cachedTime.count() / frames);
+	json.value("lookups_per_frame", (double)cachedLookups / frames);
+	json.value("uploads_per_frame", (double)cachedUploads / frames);
+	json.endObject();
+	json.value("speedup", cachedTime.count() > 0.0 ? legacyTime.count() / cachedTime.count() : 0.0);
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef BENCH_UPLOAD_H
+#define BENCH_UPLOAD_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "frame_upload.h"
+#include "camera_frames.h"
+#include "camera_model.h"
+#include "synthetic_cameras.h"
+#include "shader.h"
+#include "headless.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Micro-benchmark of the camera frame uploads: 'frames' frames of the 4
+   cameras of the synthetic rig at width x height. The path of main.cpp
+   before frame_upload.h (NV12 converted to RGB on the CPU, then a
+   glTexImage2D per camera) against the PBO ring of CameraFrameUploader in
+   RGB, NV12 and YUYV, each frame sampled by shader_yuv.fs. Reports the
+   streaming rate (frames/s and MB/s of camera data, the CPU time per frame,
+   the fence waits), the latency from the start of an upload to the end of
+   its GPU copy, and the error of the converted colours against the RGB
+   images and against the CPU conversion of the same frames. */
+inline int runUploadBenchmark(std::ostream& out, int frames, int width, int height)
+{
+	const int cameras = 4;
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		return -1;
+	}
+	glExtensions().load(context.getProcLoader());
+	glState().reset();
+	OffscreenTarget target;
+	if (!target.create(width, height))
+	{
+		return -1;
+	}
+
+	/* 2 frames of every camera, the car moving by half a metre */
+	CameraModel rig[cameras];
+	surroundViewRig(width, height, rig);
+	std::vector<unsigned char> rgb[2][cameras];
+	for (int f = 0; f < 2; f++)
+	{
+		for (int c = 0; c < cameras; c++)
+		{
+			renderSyntheticCamera(rig[c], 0.5f * f, rgb[f][c], &defaultThreadPool());
+		}
+	}
+
+	/* Full screen quad, texture coordinate (0, 0) at the top-left like the rows of the frames */
+	const float quad[4 * 8] = {
+		-1.0f,  1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f,
+		 1.0f,  1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  1.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f,
+		 1.0f, -1.0f, 0.0f,  1.0f, 1.0f, 1.0f,  1.0f, 1.0f
+	};
+	GLuint vertexArray, vertexBuffer;
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(1, &vertexBuffer);
+	glState().bindVertexArray(vertexArray);
+	glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	for (int a = 0; a < 3; a++)
+	{
+		const int components[3] = { 3, 3, 2 }, offsets[3] = { 0, 3, 6 };
+		glVertexAttribPointer(a, components[a], GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(offsets[a] * sizeof(float)));
+		glEnableVertexAttribArray(a);
+	}
+	Shader shader("shader.vs", "shader_yuv.fs");
+	if (!shader.ID)
+	{
+		return -1;
+	}
+	shader.use();
+	shader.setMat4(shader.uniform("model"), glm::mat4(1.0f));
+	shader.setMat4(shader.uniform("view"), glm::mat4(1.0f));
+	shader.setMat4(shader.uniform("projection"), glm::mat4(1.0f));
+	shader.setInt("cameras", 0);
+	shader.setInt("chroma", 1);
+	UniformHandle layerLoc = shader.uniform("layer");
+	target.bind();
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto millis = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("upload"));
+	json.value("frames", (long long)frames);
+	json.value("cameras", (long long)cameras);
+	json.value("width", (long long)width);
+	json.value("height", (long long)height);
+	json.value("persistent_mapping", std::string(glExtensions().bufferStorage ? "yes" : "no"));
+	json.value("immutable_textures", std::string(glExtensions().textureStorage ? "yes" : "no"));
+	json.beginArray("results");
+
+	/* Before: NV12 converted on the CPU, one glTexImage2D per camera and frame */
+	{
+		std::vector<unsigned char> nv12[2][cameras], converted((size_t)width * height * 3);
+		for (int f = 0; f < 2; f++)
+		{
+			for (int c = 0; c < cameras; c++)
+			{
+				nv12[f][c].resize(cameraFrameBytes(PIXEL_NV12, width, height));
+				encodeCameraFrame(rgb[f][c].data(), width, height, PIXEL_NV12, nv12[f][c].data());
+			}
+		}
+		GLuint textures[cameras];
+		glGenTextures(cameras, textures);
+		std::vector<double> frameTimes, convertTimes, latencies;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		auto uploadFrame = [&](int f) {
+			for (int c = 0; c < cameras; c++)
+			{
+				Clock::time_point start = Clock::now();
+				decodeCameraFrame(nv12[f & 1][c].data(), width, height, PIXEL_NV12, converted.data());
+				convertTimes.push_back(millis(start));
+				glState().bindTexture(GL_TEXTURE_2D, textures[c]);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, converted.data());
+			}
+		};
+		glFinish();
+		Clock::time_point start = Clock::now();
+		for (int f = 0; f < frames; f++)
+		{
+			Clock::time_point frameStart = Clock::now();
+			uploadFrame(f);
+			glFlush();
+			frameTimes.push_back(millis(frameStart));
+		}
+		glFinish();
+		double wallMs = millis(start);
+		for (int f = 0; f < std::max(1, frames / 4); f++)
+		{
+			Clock::time_point frameStart = Clock::now();
+			uploadFrame(f);
+			glFinish();
+			latencies.push_back(millis(frameStart));
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glDeleteTextures(cameras, textures);
+		for (int c = 0; c < cameras; c++)
+		{
+			glState().textureDeleted(textures[c]);
+		}
+
+		json.beginObject();
+		json.value("path", std::string("cpu_convert_teximage"));
+		json.value("format", std::string("nv12"));
+		json.value("frame_mb", cameras * cameraFrameBytes(PIXEL_NV12, width, height) / (1024.0 * 1024.0));
+		json.value("frames_per_second", 1000.0 * frames / wallMs);
+		json.value("mb_per_second", frames * cameras * cameraFrameBytes(PIXEL_NV12, width, height) / (1024.0 * 1024.0) / (wallMs / 1000.0));
+		json.stats("cpu_ms_per_frame", computeStats(frameTimes));
+		json.stats("cpu_convert_ms_per_camera", computeStats(convertTimes));
+		json.stats("latency_ms", computeStats(latencies));
+		json.endObject();
+	}
+
+	/* The PBO ring, no conversion on the CPU */
+	const CameraPixelFormat formats[3] = { PIXEL_RGB, PIXEL_NV12, PIXEL_YUYV };
+	for (int p = 0; p < 3; p++)
+	{
+		CameraPixelFormat format = formats[p];
+		size_t frameBytes = cameraFrameBytes(format, width, height);
+		std::vector<unsigned char> encoded[2][cameras];
+		for (int f = 0; f < 2; f++)
+		{
+			for (int c = 0; c < cameras; c++)
+			{
+				encoded[f][c].resize(frameBytes);
+				encodeCameraFrame(rgb[f][c].data(), width, height, format, encoded[f][c].data());
+			}
+		}
+		CameraFrameUploader uploader;
+		if (!uploader.create(format, width, height, cameras))
+		{
+			return -1;
+		}
+		shader.use();
+		shader.setInt("cameraFormat", (int)format);
+		uploader.bind(0, 1);
+		auto uploadFrame = [&](int f) {
+			uploader.beginFrame();
+			for (int c = 0; c < cameras; c++)
+			{
+				uploader.upload(c, encoded[f & 1][c].data());
+			}
+			uploader.endFrame();
+		};
+
+		/* Streaming: every frame uploaded, then one camera drawn from it */
+		std::vector<double> frameTimes, latencies;
+		glFinish();
+		Clock::time_point start = Clock::now();
+		for (int f = 0; f < frames; f++)
+		{
+			Clock::time_point frameStart = Clock::now();
+			uploadFrame(f);
+			shader.setInt(layerLoc, f % cameras);
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			glFlush();
+			frameTimes.push_back(millis(frameStart));
+		}
+		glFinish();
+		double wallMs = millis(start);
+		FrameUploadStats streaming = uploader.stats;
+
+		/* Latency: one frame at a time, until the GPU has copied it */
+		for (int f = 0; f < std::max(1, frames / 4); f++)
+		{
+			Clock::time_point frameStart = Clock::now();
+			uploadFrame(f);
+			glFinish();
+			latencies.push_back(millis(frameStart));
+		}
+
+		/* Colours of camera 0, frame 0: against the RGB image and the CPU conversion */
+		uploadFrame(0);
+		shader.setInt(layerLoc, 0);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		std::vector<unsigned char> drawn((size_t)width * height * 4), reference((size_t)width * height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, drawn.data());
+		decodeCameraFrame(encoded[0][0].data(), width, height, format, reference.data());
+		double sumError = 0.0;
+		int maxError = 0;
+		long long close = 0;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const unsigned char* gpu = &drawn[((size_t)(height - 1 - y) * width + x) * 4]; // the framebuffer rows go up
+				const unsigned char* source = &rgb[0][0][((size_t)y * width + x) * 3];
+				const unsigned char* cpu = &reference[((size_t)y * width + x) * 3];
+				int decodeError = 0;
+				for (int i = 0; i < 3; i++)
+				{
+					int error = abs((int)gpu[i] - (int)source[i]);
+					sumError += error;
+					maxError = std::max(maxError, error);
+					decodeError = std::max(decodeError, abs((int)gpu[i] - (int)cpu[i]));
+				}
+				close += decodeError <= 2 ? 1 : 0;
+			}
+		}
+
+		json.beginObject();
+		json.value("path", std::string("pbo_ring"));
+		json.value("format", std::string(cameraPixelFormatName(format)));
+		json.value("frame_mb", cameras * frameBytes / (1024.0 * 1024.0));
+		json.value("persistent", std::string(uploader.persistent ? "yes" : "no"));
+		json.value("frames_per_second", 1000.0 * frames / wallMs);
+		json.value("mb_per_second", streaming.bytes / (1024.0 * 1024.0) / (wallMs / 1000.0));
+		json.stats("cpu_ms_per_frame", computeStats(frameTimes));
+		json.value("copy_ms_per_frame", streaming.copyMs / frames);
+		json.value("submit_ms_per_frame", streaming.submitMs / frames);
+		json.value("fence_waits", streaming.fenceWaits);
+		json.value("fence_wait_ms", streaming.waitMs);
+		json.stats("latency_ms", computeStats(latencies));
+		json.value("mean_error", sumError / ((double)width * height * 3));
+		json.value("max_error", (long long)maxError);
+		json.value("matches_cpu_conversion_percent", 100.0 * close / ((double)width * height));
+		json.endObject();
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+
+	glState().bindVertexArray(0);
+	glDeleteVertexArrays(1, &vertexArray);
+	glState().vertexArrayDeleted(vertexArray);
+	glDeleteBuffers(1, &vertexBuffer);
+	glState().bufferDeleted(vertexBuffer);
+	return 0;
+}
+
+#endif
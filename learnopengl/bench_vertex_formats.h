@@ -0,0 +1,221 @@
+#ifndef BENCH_VERTEX_FORMATS_H
+#define BENCH_VERTEX_FORMATS_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "vertex_format.h"
+#include "mesh_optimizer.h"
+#include "bench_mesh.h"
+#include "headless.h"
+#include "benchmark.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Lit torus: the normal is a vec3 (NORMAL_FLOAT3) or decoded from the
+   octahedral vec2 (NORMAL_OCT16, OCT_NORMAL defined) */
+const char* const VERTEX_FORMAT_BENCH_VS =
+	"layout (location = 0) in vec3 aPos;\n"
+	"#ifdef OCT_NORMAL\n"
+	"layout (location = 1) in vec2 aNormal;\n"
+	"#else\n"
+	"layout (location = 1) in vec3 aNormal;\n"
+	"#endif\n"
+	"layout (location = 2) in vec2 aTexCoord;\n"
+	"uniform mat4 mvp;\n"
+	"uniform vec3 positionScale;\n"
+	"uniform vec3 positionOffset;\n"
+	"out vec3 normal;\n"
+	"out vec2 texCoord;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = mvp * vec4(positionOffset + positionScale * aPos, 1.0);\n"
+	"#ifdef OCT_NORMAL\n"
+	"	normal = octDecode(aNormal);\n"
+	"#else\n"
+	"	normal = aNormal;\n"
+	"#endif\n"
+	"	texCoord = aTexCoord;\n"
+	"}\n";
+
+const char* const VERTEX_FORMAT_BENCH_FS =
+	"#version 330 core\n"
+	"in vec3 normal;\n"
+	"in vec2 texCoord;\n"
+	"out vec4 FragColor;\n"
+	"void main()\n"
+	"{\n"
+	"	float light = max(dot(normalize(normal), normalize(vec3(0.3, 0.5, 1.0))), 0.1);\n"
+	"	FragColor = vec4(light * vec3(texCoord, 0.5), 1.0);\n"
+	"}\n";
+
+// compile and link the benchmark program, 0 on failure
+inline GLuint buildVertexFormatProgram(bool octNormals)
+{
+	std::string vertexCode = std::string("#version 330 core\n") + (octNormals ? "#define OCT_NORMAL\n" : "") + OCT_DECODE_GLSL + VERTEX_FORMAT_BENCH_VS;
+	const char* sources[2] = { vertexCode.c_str(), VERTEX_FORMAT_BENCH_FS };
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	GLuint program = glCreateProgram();
+	for (int s = 0; s < 2; s++)
+	{
+		GLuint shader = glCreateShader(types[s]);
+		glShaderSource(shader, 1, &sources[s], NULL);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		glDeleteShader(shader); // deleted with the program
+	}
+	glLinkProgram(program);
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+inline void writeVertexError(JsonWriter& json, const char* key, const VertexError& error)
+{
+	json.beginObject(key);
+	json.value("position", (double)error.position);
+	json.value("normal_degrees", (double)error.normalDegrees);
+	json.value("tex_coord", (double)error.texCoord);
+	json.endObject();
+}
+
+/* Vertex bandwidth of the presets of vertex_format.h: the optimized torus of
+   the mesh benchmark (position, normal, uv) drawn 'drawsPerFrame' times per
+   frame into a small headless target, so the vertex fetch and not the
+   rasterization dominates. Reports the encoded size, the encode time, the
+   GPU time per frame (GL_TIME_ELAPSED) and the error bounds of each preset. */
+inline int runVertexFormatBenchmark(std::ostream& out, int frames, int drawsPerFrame)
+{
+	HeadlessContext context;
+	if (!context.create(3, 3) || !gladLoadGLLoader(context.getProcLoader()))
+	{
+		std::cout << "Failed to create headless OpenGL context" << std::endl;
+		return -1;
+	}
+	OffscreenTarget target;
+	if (!target.create(128, 128))
+	{
+		return -1;
+	}
+	target.bind();
+	glEnable(GL_DEPTH_TEST);
+
+	std::vector<float> input;
+	generateShuffledTorus(200, 250, input);
+	Mesh mesh;
+	optimizeMesh(input.data(), (int)(input.size() / 8), 8, mesh);
+	const VertexSource source = { 8 /* floats per vertex */, 0 /* position */, 3 /* normal */, -1 /* no color */, 6 /* tex coords */ };
+	const VertexAttributeLocations locations = { 0, 1, -1, 2 };
+
+	GLuint indexBuffer;
+	glGenBuffers(1, &indexBuffer);
+
+	const VertexFormatPreset presets[3] = { VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_HALF, VERTEX_FORMAT_PACKED };
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("vertex-formats"));
+	json.value("frames", (long long)frames);
+	json.value("draws_per_frame", (long long)drawsPerFrame);
+	json.value("vertices", (long long)mesh.vertexCount());
+	json.value("triangles", (long long)mesh.triangleCount());
+	double floatBytes = 0.0;
+	for (int p = 0; p < 3; p++)
+	{
+		VertexFormat format = vertexFormatFor(presets[p], source);
+		EncodedVertices encoded;
+		std::vector<double> encodeTimes;
+		for (int it = 0; it < 5; it++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			encodeVertices(mesh.vertices.data(), mesh.vertexCount(), source, format, encoded);
+			encodeTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		}
+
+		GLuint program = buildVertexFormatProgram(format.normal == NORMAL_OCT16);
+		if (!program)
+		{
+			return -1;
+		}
+		GLuint vertexArray, vertexBuffer;
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, encoded.data.size(), encoded.data.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+		vertexFormatLayout(format, locations).apply();
+
+		glUseProgram(program);
+		glUniform3fv(glGetUniformLocation(program, "positionScale"), 1, glm::value_ptr(encoded.positionScale));
+		glUniform3fv(glGetUniformLocation(program, "positionOffset"), 1, glm::value_ptr(encoded.positionOffset));
+		GLint mvpLocation = glGetUniformLocation(program, "mvp");
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+
+		FrameProfiler profiler;
+		for (int frame = -2; frame < frames; frame++) // 2 warm-up frames
+		{
+			if (frame >= 0)
+			{
+				profiler.beginFrame();
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			for (int d = 0; d < drawsPerFrame; d++)
+			{
+				glm::mat4 mvp = projection * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -4.0f))
+					* glm::rotate(glm::mat4(1.0f), 0.3f * (float)d + 0.01f * (float)frame, glm::vec3(1.0f, 0.3f, 0.5f));
+				glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+				glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+			}
+			if (frame >= 0)
+			{
+				profiler.endFrame(drawsPerFrame);
+			}
+			else
+			{
+				glFinish();
+			}
+		}
+		profiler.finish();
+
+		double bytes = (double)encoded.data.size();
+		if (p == 0)
+		{
+			floatBytes = bytes;
+		}
+		json.beginObject(vertexFormatName(presets[p]));
+		json.value("bytes_per_vertex", (long long)format.stride);
+		json.value("vertex_buffer_mb", bytes / (1024.0 * 1024.0));
+		json.value("size_vs_float", bytes / floatBytes);
+		json.stats("encode_ms", computeStats(encodeTimes));
+		json.stats("cpu_ms", computeStats(profiler.cpuTimes));
+		json.stats("gpu_ms", computeStats(profiler.gpuTimes));
+		json.value("vertex_mb_per_frame", bytes * drawsPerFrame / (1024.0 * 1024.0));
+		writeVertexError(json, "error_bound", encoded.bound);
+		writeVertexError(json, "error_measured", encoded.measured);
+		json.endObject();
+
+		glBindVertexArray(0);
+		glDeleteVertexArrays(1, &vertexArray);
+		glDeleteBuffers(1, &vertexBuffer);
+		glDeleteProgram(program);
+	}
+	glDeleteBuffers(1, &indexBuffer);
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Summary statistics of a list of samples (all values in milliseconds) */
+struct SampleStats
+{
+	double mean;
+	double min;
+	double p50;
+	double p90;
+	double p95;
+	double p99;
+	double max;
+};
+
+// nearest-rank percentile of an already sorted list
+inline double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+	{
+		return 0.0;
+	}
+	size_t rank = (size_t)(p / 100.0 * (double)(sorted.size() - 1) + 0.5);
+	return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+inline SampleStats computeStats(std::vector<double> samples)
+{
+	SampleStats stats = {};
+	if (samples.empty())
+	{
+		return stats;
+	}
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		sum += samples[i];
+	}
+	stats.mean = sum / (double)samples.size();
+	stats.min = samples.front();
+	stats.p50 = percentile(samples, 50.0);
+	stats.p90 = percentile(samples, 90.0);
+	stats.p95 = percentile(samples, 95.0);
+	stats.p99 = percentile(samples, 99.0);
+	stats.max = samples.back();
+	return stats;
+}
+
+/* Very small JSON writer, just enough for flat benchmark reports */
+class JsonWriter
+{
+public:
+	JsonWriter(std::ostream& out) : out(out), first(true)
+	{
+	}
+
+	void beginObject(const char* key = NULL) { open(key, '{'); }
+	void endObject() { out << '}'; first = false; }
+	void beginArray(const char* key = NULL) { open(key, '['); }
+	void endArray() { out << ']'; first = false; }
+
+	void value(const char* key, double v) { writeKey(key); out << v; }
+	void value(const char* key, long long v) { writeKey(key); out << v; }
+	void value(const char* key, const std::string& v) { writeKey(key); writeString(v); }
+	void value(double v) { writeKey(NULL); out << v; }
+
+	void stats(const char* key, const SampleStats& s)
+	{
+		beginObject(key);
+		value("mean", s.mean);
+		value("min", s.min);
+		value("p50", s.p50);
+		value("p90", s.p90);
+		value("p95", s.p95);
+		value("p99", s.p99);
+		value("max", s.max);
+		endObject();
+	}
+
+private:
+	std::ostream& out;
+	bool first; // no comma needed before the next element
+
+	void open(const char* key, char bracket)
+	{
+		writeKey(key);
+		out << bracket;
+		first = true;
+	}
+
+	void writeKey(const char* key)
+	{
+		if (!first)
+		{
+			out << ',';
+		}
+		first = false;
+		if (key)
+		{
+			writeString(key);
+			out << ':';
+		}
+	}
+
+	void writeString(const std::string& s)
+	{
+		out << '"';
+		for (size_t i = 0; i < s.size(); i++)
+		{
+			if (s[i] == '"' || s[i] == '\\')
+			{
+				out << '\\';
+			}
+			out << s[i];
+		}
+		out << '"';
+	}
+};
+
+/* Measures the CPU time and the GPU time (GL_TIME_ELAPSED timer queries) of
+   every frame. GPU results are read back a few frames later so the profiler
+   never forces the CPU to wait for the GPU; each query remembers the frame
+   it timed and its result is stored in that frame's slot, so gpuTimes[i]
+   and cpuTimes[i] always describe the same frame (complete after finish()). */
+class FrameProfiler
+{
+public:
+	std::vector<double> cpuTimes; // milliseconds per frame
+	std::vector<double> gpuTimes; // milliseconds per frame, 0 until read back
+	std::vector<double> drawCalls; // draw calls per frame
+
+	FrameProfiler() : frameIndex(0), pending(0)
+	{
+		glGenQueries(QUERY_COUNT, queries);
+	}
+
+	~FrameProfiler()
+	{
+		glDeleteQueries(QUERY_COUNT, queries);
+	}
+
+	void beginFrame()
+	{
+		/* The query we are about to reuse is QUERY_COUNT frames old, fetch it first */
+		if (pending == QUERY_COUNT)
+		{
+			collect();
+		}
+		queryFrames[frameIndex % QUERY_COUNT] = cpuTimes.size();
+		glBeginQuery(GL_TIME_ELAPSED, queries[frameIndex % QUERY_COUNT]);
+		cpuStart = std::chrono::high_resolution_clock::now();
+	}
+
+	void endFrame(int frameDrawCalls)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - cpuStart;
+		cpuTimes.push_back(elapsed.count());
+		gpuTimes.push_back(0.0); // filled in by collect()
+		drawCalls.push_back((double)frameDrawCalls);
+		glEndQuery(GL_TIME_ELAPSED);
+		frameIndex++;
+		pending++;
+	}
+
+	// read back all outstanding GPU timings (call once after the last frame)
+	void finish()
+	{
+		while (pending > 0)
+		{
+			collect();
+		}
+	}
+
+	// add the frame statistics to an open JSON object
+	void writeFields(JsonWriter& json, double wallTimeMs) const
+	{
+		json.value("renderer", glString(GL_RENDERER));
+		json.value("version", glString(GL_VERSION));
+		json.value("frames", (long long)cpuTimes.size());
+		json.value("wall_time_ms", wallTimeMs);
+		json.value("frames_per_second", wallTimeMs > 0.0 ? 1000.0 * (double)cpuTimes.size() / wallTimeMs : 0.0);
+		json.value("draw_calls_per_frame", computeStats(drawCalls).mean);
+		json.stats("cpu_ms", computeStats(cpuTimes));
+		json.stats("gpu_ms", computeStats(gpuTimes));
+		json.beginArray("cpu_ms_per_frame");
+		for (size_t i = 0; i < cpuTimes.size(); i++)
+		{
+			json.value(cpuTimes[i]);
+		}
+		json.endArray();
+		json.beginArray("gpu_ms_per_frame");
+		for (size_t i = 0; i < gpuTimes.size(); i++)
+		{
+			json.value(gpuTimes[i]);
+		}
+		json.endArray();
+	}
+
+private:
+	static const unsigned int QUERY_COUNT = 4; // frames in flight
+	unsigned int queries[QUERY_COUNT];
+	size_t queryFrames[QUERY_COUNT]; // index in cpuTimes / gpuTimes of the frame each query times
+	unsigned int frameIndex; // number of frames begun so far
+	unsigned int pending;	 // frames whose GPU time was not read back yet
+	std::chrono::high_resolution_clock::time_point cpuStart;
+
+	void collect()
+	{
+		unsigned int oldest = (frameIndex - pending) % QUERY_COUNT;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &nanoseconds);
+		gpuTimes[queryFrames[oldest]] = (double)nanoseconds / 1.0e6;
+		pending--;
+	}
+
+	static std::string glString(GLenum name)
+	{
+		const GLubyte* s = glGetString(name);
+		return s ? std::string((const char*)s) : std::string();
+	}
+};
+
+#endif
@@ -0,0 +1,473 @@
+#ifndef BOWL_MESH_H
+#define BOWL_MESH_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include "camera_model.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+#include "vertex_layout.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <vector>
+
+const int BOWL_CAMERAS = 4;
+
+/* Shape and tessellation of the surround-view bowl, in the vehicle frame of
+   camera_model.h (y up, metres) */
+struct BowlParameters
+{
+	float flatRadius;	// radius of the flat bottom around the car
+	float outerRadius;	// the wall ends there
+	float curvature;	// the wall rises curvature * (r - flatRadius)^2 above the bottom
+	float elongation;	// z radii over x radii, the bowl follows the length of the car
+	float groundHeight; // y of the flat bottom
+	int rings;			// vertex rings from the center to outerRadius
+	int sectors;		// vertices around each ring
+};
+
+inline BowlParameters defaultBowlParameters()
+{
+	BowlParameters parameters;
+	parameters.flatRadius = 5.0f;
+	parameters.outerRadius = 12.0f;
+	parameters.curvature = 0.12f;
+	parameters.elongation = 1.3f;
+	parameters.groundHeight = 0.0f;
+	parameters.rings = 64;
+	parameters.sectors = 128;
+	return parameters;
+}
+
+/* Vertex of the bowl, 28 bytes: where every camera sees it and how much
+   each contributes, so the fragment shader only samples and blends */
+struct BowlVertex
+{
+	HalfVec<4> position;							   // x, y, z, 1
+	Normalized<glm::u16vec2> texCoord[BOWL_CAMERAS]; // coordinates in each camera image
+	Normalized<glm::u8vec4> weight;				   // blend weights adding up to 255, all 0 where no camera sees the vertex
+};
+
+// position at location 0, the coordinates in camera c at 1 + c and the weights at 5
+inline const VertexLayout& bowlVertexLayout()
+{
+	typedef Normalized<glm::u16vec2> TexCoord;
+	static const VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(BowlVertex, position, 0, "aPos"),
+		vertexAttribute<TexCoord>("aCamera0", 1, offsetof(BowlVertex, texCoord) + 0 * sizeof(TexCoord)),
+		vertexAttribute<TexCoord>("aCamera1", 2, offsetof(BowlVertex, texCoord) + 1 * sizeof(TexCoord)),
+		vertexAttribute<TexCoord>("aCamera2", 3, offsetof(BowlVertex, texCoord) + 2 * sizeof(TexCoord)),
+		vertexAttribute<TexCoord>("aCamera3", 4, offsetof(BowlVertex, texCoord) + 3 * sizeof(TexCoord)),
+		VERTEX_ATTRIBUTE(BowlVertex, weight, 5, "aWeights")
+	};
+	static const VertexLayout layout = vertexLayout<BowlVertex>(attributes);
+	return layout;
+}
+
+/* CPU side of a bowl mesh: the float positions, the unnormalized weight of
+   every camera at every vertex and the packed vertices. Vertices are stored
+   sector by sector (vertex (ring, sector) at sector * (rings + 1) + ring),
+   so the vertices a camera sees are a run or two of sectors. */
+struct BowlGeometry
+{
+	BowlParameters parameters;
+	CameraModel cameras[BOWL_CAMERAS];
+	std::vector<glm::vec3> positions;
+	std::vector<float> rawWeights; // BOWL_CAMERAS per vertex
+	std::vector<BowlVertex> vertices;
+	std::vector<unsigned char> dirty; // per sector, its packed vertices changed since the last upload
+
+	int ringVertices() const
+	{
+		return parameters.rings + 1;
+	}
+
+	void resize()
+	{
+		size_t count = (size_t)parameters.sectors * ringVertices();
+		positions.resize(count);
+		rawWeights.resize(count * BOWL_CAMERAS);
+		vertices.resize(count);
+		dirty.assign(parameters.sectors, 1);
+	}
+
+	void computePositions(int sectorBegin, int sectorEnd)
+	{
+		const BowlParameters& p = parameters;
+		for (int s = sectorBegin; s < sectorEnd; s++)
+		{
+			float angle = 6.2831853f * s / p.sectors;
+			for (int r = 0; r < ringVertices(); r++)
+			{
+				float radius = p.outerRadius * r / p.rings;
+				float wall = radius > p.flatRadius ? p.curvature * (radius - p.flatRadius) * (radius - p.flatRadius) : 0.0f;
+				positions[(size_t)s * ringVertices() + r] = glm::vec3(radius * cosf(angle), p.groundHeight + wall, radius * p.elongation * sinf(angle));
+			}
+		}
+	}
+
+	/* Coordinates of the vertices in camera 'c' and its unnormalized weight:
+	   highest on the axis of the lens, falling to 0 at the edge of its field
+	   and within 48 pixels of the border of the image */
+	void projectCamera(int c, int sectorBegin, int sectorEnd)
+	{
+		const CameraModel& camera = cameras[c];
+		const float fade = 48.0f;
+		for (int s = sectorBegin; s < sectorEnd; s++)
+		{
+			for (int r = 0; r < ringVertices(); r++)
+			{
+				size_t v = (size_t)s * ringVertices() + r;
+				glm::vec3 local = camera.rotation * (positions[v] - camera.position);
+				glm::vec2 pixel;
+				bool visible = projectCameraPoint(camera, local, pixel);
+				glm::vec2 coordinates = glm::clamp((pixel + 0.5f) / glm::vec2((float)camera.width, (float)camera.height), 0.0f, 1.0f);
+				vertices[v].texCoord[c].value = glm::u16vec2(coordinates * 65535.0f + 0.5f);
+				float weight = 0.0f;
+				if (visible)
+				{
+					float angle = acosf(glm::clamp(local.z / glm::length(local), -1.0f, 1.0f));
+					float border = glm::min(glm::min(pixel.x + 0.5f, camera.width - 0.5f - pixel.x), glm::min(pixel.y + 0.5f, camera.height - 0.5f - pixel.y));
+					weight = glm::max(0.0f, 1.0f - angle / camera.maxAngle) * glm::min(1.0f, border / fade);
+					weight *= weight; // narrower seams
+				}
+				rawWeights[v * BOWL_CAMERAS + c] = weight;
+			}
+		}
+	}
+
+	// normalize the weights and pack the positions, flagging the sectors whose vertices changed
+	void packSectors(int sectorBegin, int sectorEnd)
+	{
+		for (int s = sectorBegin; s < sectorEnd; s++)
+		{
+			bool changed = false;
+			for (int r = 0; r < ringVertices(); r++)
+			{
+				size_t v = (size_t)s * ringVertices() + r;
+				BowlVertex packed = vertices[v]; // keeps the coordinates
+				const glm::vec3& p = positions[v];
+				packed.position.value[0] = glm::packHalf1x16(p.x);
+				packed.position.value[1] = glm::packHalf1x16(p.y);
+				packed.position.value[2] = glm::packHalf1x16(p.z);
+				packed.position.value[3] = glm::packHalf1x16(1.0f);
+				const float* raw = &rawWeights[v * BOWL_CAMERAS];
+				float total = 0.0f;
+				int largest = 0;
+				for (int c = 0; c < BOWL_CAMERAS; c++)
+				{
+					total += raw[c];
+					largest = raw[c] > raw[largest] ? c : largest;
+				}
+				int sum = 0;
+				for (int c = 0; c < BOWL_CAMERAS; c++)
+				{
+					packed.weight.value[c] = total > 0.0f ? (uint8_t)(raw[c] / total * 255.0f + 0.5f) : 0;
+					sum += packed.weight.value[c];
+				}
+				if (total > 0.0f)
+				{
+					packed.weight.value[largest] = (uint8_t)(packed.weight.value[largest] + 255 - sum); // exactly 255 in all
+				}
+				if (memcmp(&packed, &vertices[v], sizeof(BowlVertex)) != 0)
+				{
+					vertices[v] = packed;
+					changed = true;
+				}
+			}
+			dirty[s] = dirty[s] || changed;
+		}
+	}
+};
+
+/* Timings of the last change of the bowl */
+struct BowlUpdateStats
+{
+	double computeMs;	  // positions, projections and packing, on the thread that did them
+	int camerasProjected; // cameras whose coordinates were recomputed
+	int changedSectors;	  // sectors uploaded
+	size_t uploadedBytes;
+};
+
+/* Surround-view bowl: a flat disk around the car whose border rises into a
+   wall, textured from the 4 cameras of the rig. Every vertex stores its
+   coordinates in the 4 camera images and the blend weight of each
+   (BowlVertex), computed when the mesh is built, so the whole bowl is one
+   indexed draw whose fragment shader (shader_bowl.fs) samples only the
+   cameras with a weight and blends them, without any lens model on the GPU.
+
+   A new calibration of one camera reprojects only that camera; a new ground
+   height moves all the vertices and reprojects them all. Either way the
+   packed vertices are compared with the previous ones and only the sectors
+   that changed are uploaded, with glBufferSubData into the buffer allocated
+   by the first upload. build() and the set functions split the work over
+   a thread pool; updateAsync() does it on a worker thread while the old
+   mesh keeps being drawn, and finishUpdate() swaps the result in. */
+class BowlMesh
+{
+public:
+	BowlGeometry geometry;
+	BowlUpdateStats stats;
+	GLuint VAO, VBO, EBO;
+	GLsizei indexCount;
+
+	BowlMesh() : VAO(0), VBO(0), EBO(0), indexCount(0)
+	{
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	~BowlMesh()
+	{
+		if (pendingDone.valid())
+		{
+			pendingDone.wait();
+		}
+		if (VAO)
+		{
+			glDeleteVertexArrays(1, &VAO);
+			glState().vertexArrayDeleted(VAO);
+			GLuint buffers[2] = { VBO, EBO };
+			glDeleteBuffers(2, buffers);
+			glState().bufferDeleted(VBO);
+			glState().bufferDeleted(EBO);
+		}
+	}
+
+	int vertexCount() const
+	{
+		return (int)geometry.vertices.size();
+	}
+
+	// everything from scratch (CPU only, upload() sends it)
+	void build(const BowlParameters& parameters, const CameraModel cameras[BOWL_CAMERAS], ThreadPool* pool)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		geometry.parameters = parameters;
+		for (int c = 0; c < BOWL_CAMERAS; c++)
+		{
+			geometry.cameras[c] = cameras[c];
+		}
+		geometry.resize();
+		buildIndices();
+		forSectors(pool, [&](int begin, int end) {
+			geometry.computePositions(begin, end);
+			for (int c = 0; c < BOWL_CAMERAS; c++)
+			{
+				geometry.projectCamera(c, begin, end);
+			}
+			geometry.packSectors(begin, end);
+		});
+		finishStats(start, BOWL_CAMERAS);
+	}
+
+	// new calibration of camera 'c': only its coordinates and the weights change
+	void setCamera(int c, const CameraModel& camera, ThreadPool* pool)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		geometry.cameras[c] = camera;
+		forSectors(pool, [&](int begin, int end) {
+			geometry.projectCamera(c, begin, end);
+			geometry.packSectors(begin, end);
+		});
+		finishStats(start, 1);
+	}
+
+	// the car sits higher or lower: every vertex moves
+	void setGroundHeight(float height, ThreadPool* pool)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		geometry.parameters.groundHeight = height;
+		forSectors(pool, [&](int begin, int end) {
+			geometry.computePositions(begin, end);
+			for (int c = 0; c < BOWL_CAMERAS; c++)
+			{
+				geometry.projectCamera(c, begin, end);
+			}
+			geometry.packSectors(begin, end);
+		});
+		finishStats(start, BOWL_CAMERAS);
+	}
+
+	/* Recompute the mesh for 'cameras' and 'groundHeight' on a worker of
+	   'pool', only the cameras that changed unless the ground moved. The
+	   worker does it alone: waiting on the pool from one of its own tasks
+	   could wait forever. False when an update is still running. */
+	bool updateAsync(const CameraModel cameras[BOWL_CAMERAS], float groundHeight, ThreadPool& pool)
+	{
+		if (pendingDone.valid())
+		{
+			return false;
+		}
+		pending.reset(new BowlGeometry(geometry));
+		std::fill(pending->dirty.begin(), pending->dirty.end(), 0);
+		bool moved = groundHeight != geometry.parameters.groundHeight;
+		pending->parameters.groundHeight = groundHeight;
+		bool changed[BOWL_CAMERAS];
+		for (int c = 0; c < BOWL_CAMERAS; c++)
+		{
+			changed[c] = moved || memcmp(&cameras[c], &geometry.cameras[c], sizeof(CameraModel)) != 0;
+			pending->cameras[c] = cameras[c];
+		}
+		BowlGeometry* target = pending.get();
+		BowlUpdateStats* result = &pendingStats;
+		pendingDone = pool.submit([target, result, moved, changed]() {
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			int sectors = target->parameters.sectors;
+			if (moved)
+			{
+				target->computePositions(0, sectors);
+			}
+			result->camerasProjected = 0;
+			for (int c = 0; c < BOWL_CAMERAS; c++)
+			{
+				if (changed[c])
+				{
+					target->projectCamera(c, 0, sectors);
+					result->camerasProjected++;
+				}
+			}
+			target->packSectors(0, sectors);
+			result->computeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		});
+		return true;
+	}
+
+	bool updating() const
+	{
+		return pendingDone.valid();
+	}
+
+	/* Take the result of updateAsync() once it is done ('wait' blocks until
+	   then) and upload the sectors that changed. True when it was swapped. */
+	bool finishUpdate(bool wait = false)
+	{
+		if (!pendingDone.valid() || (!wait && pendingDone.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+		{
+			return false;
+		}
+		pendingDone.get();
+		for (size_t s = 0; s < geometry.dirty.size(); s++)
+		{
+			pending->dirty[s] = pending->dirty[s] || geometry.dirty[s]; // not uploaded yet either
+		}
+		std::swap(geometry, *pending);
+		pending.reset();
+		stats.computeMs = pendingStats.computeMs;
+		stats.camerasProjected = pendingStats.camerasProjected;
+		upload();
+		return true;
+	}
+
+	/* Send the changed sectors to the GPU; the first call creates the VAO and
+	   the buffers, sized for good */
+	void upload()
+	{
+		if (VAO == 0)
+		{
+			glGenVertexArrays(1, &VAO);
+			GLuint buffers[2];
+			glGenBuffers(2, buffers);
+			VBO = buffers[0];
+			EBO = buffers[1];
+			glState().bindVertexArray(VAO);
+			glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+			glBufferData(GL_ARRAY_BUFFER, geometry.vertices.size() * sizeof(BowlVertex), NULL, GL_DYNAMIC_DRAW);
+			glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+			bowlVertexLayout().apply();
+		}
+		else
+		{
+			glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+		}
+
+		/* One glBufferSubData per run of changed sectors */
+		stats.changedSectors = 0;
+		stats.uploadedBytes = 0;
+		size_t sectorBytes = (size_t)geometry.ringVertices() * sizeof(BowlVertex);
+		int sectors = geometry.parameters.sectors;
+		for (int s = 0; s < sectors;)
+		{
+			if (!geometry.dirty[s])
+			{
+				s++;
+				continue;
+			}
+			int end = s;
+			while (end < sectors && geometry.dirty[end])
+			{
+				geometry.dirty[end++] = 0;
+			}
+			glBufferSubData(GL_ARRAY_BUFFER, s * sectorBytes, (end - s) * sectorBytes, &geometry.vertices[(size_t)s * geometry.ringVertices()]);
+			stats.changedSectors += end - s;
+			stats.uploadedBytes += (end - s) * sectorBytes;
+			s = end;
+		}
+	}
+
+	// the whole bowl, with the bound program (shader_bowl.vs / shader_bowl.fs)
+	void draw() const
+	{
+		glState().bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	}
+
+private:
+	std::vector<unsigned int> indices;
+	std::unique_ptr<BowlGeometry> pending; // geometry of the running updateAsync()
+	BowlUpdateStats pendingStats;
+	std::future<void> pendingDone;
+
+	template <class F>
+	void forSectors(ThreadPool* pool, F work)
+	{
+		if (pool)
+		{
+			pool->parallelFor(geometry.parameters.sectors, 4, work);
+		}
+		else
+		{
+			work(0, geometry.parameters.sectors);
+		}
+	}
+
+	void finishStats(std::chrono::high_resolution_clock::time_point start, int cameras)
+	{
+		stats.computeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		stats.camerasProjected = cameras;
+	}
+
+	/* A triangle per sector around the center (the vertices of ring 0 are
+	   all at the center), two per sector between the other rings */
+	void buildIndices()
+	{
+		int rings = geometry.parameters.rings, sectors = geometry.parameters.sectors, ring = geometry.ringVertices();
+		indices.clear();
+		for (int s = 0; s < sectors; s++)
+		{
+			unsigned int a = s * ring, b = ((s + 1) % sectors) * ring;
+			indices.push_back(a);
+			indices.push_back(b + 1);
+			indices.push_back(a + 1);
+			for (int r = 1; r < rings; r++)
+			{
+				indices.push_back(a + r);
+				indices.push_back(b + r);
+				indices.push_back(b + r + 1);
+				indices.push_back(a + r);
+				indices.push_back(b + r + 1);
+				indices.push_back(a + r + 1);
+			}
+		}
+		indexCount = (GLsizei)indices.size();
+	}
+};
+
+#endif
@@ -0,0 +1,824 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "glm/glm.hpp"
+
+#include "frustum_culling.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <vector>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#endif
+
+const int BVH_LEAF_SIZE = 4; // max objects per leaf, tested 4 at a time like the node children
+const int BVH_BINS = 16;	 // SAH split candidates per axis
+
+/* Depth limits that keep the traversal stacks fixed: below BVH_SAH_DEPTH
+   the nodes split at the median instead, which at least halves the largest
+   part, so no int-sized object count gets deeper than BVH_MAX_DEPTH. A
+   traversal pops one node and pushes up to 4, 3 more per level. */
+const int BVH_SAH_DEPTH = 48;
+const int BVH_MAX_DEPTH = 85;
+const int BVH_STACK_SIZE = 3 * BVH_MAX_DEPTH + 1;
+
+/* Node of the 4-wide BVH, 128 bytes: the boxes of its 4 children as
+   structure of arrays, so one SSE2 test covers all of them */
+struct BvhNode
+{
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	int child[4]; // inner child: node index; leaf: first entry in Bvh::objects
+	int count[4]; // 0: inner child; > 0: leaf of 'count' objects; -1: empty slot
+};
+
+/* Bounding volume hierarchy over the boxes of a BoundsBatch.
+
+   build() splits the objects with a binned SAH (BVH_BINS candidates on each
+   axis), twice per node so every node has up to 4 children, down to leaves
+   of BVH_LEAF_SIZE objects (median splits past BVH_SAH_DEPTH, so sorted or
+   clustered input cannot make a degenerate chain). The nodes are flattened in depth-first order,
+   children after their parent, and the object boxes are copied in leaf
+   order so the leaves are tested like the nodes.
+
+   When objects move, refit() grows the boxes again bottom-up, for all the
+   nodes or only for the paths above the moved objects. The tree keeps its
+   topology and slowly degrades; cost() tracks its SAH cost against the one
+   right after the build, and rebuildAsync() / finishRebuild() build a new
+   tree on the thread pool and swap it in when it is ready.
+
+   The queries append the indices of the matching objects to 'out' in tree
+   order: frustum (subtrees fully inside are taken without more tests), ray
+   (every box hit, or the nearest with pick()) and sphere. */
+class Bvh
+{
+public:
+	std::vector<BvhNode> nodes; // nodes[0] is the root
+	std::vector<int> objects;	// object indices in leaf order
+	float buildCost;			// cost() right after the build (or the swap of a rebuild)
+
+	Bvh() : buildCost(0.0f)
+	{
+	}
+
+	~Bvh()
+	{
+		if (pendingDone.valid())
+		{
+			pendingDone.wait();
+		}
+	}
+
+	int objectCount() const
+	{
+		return (int)objects.size();
+	}
+
+	void build(const BoundsBatch& bounds)
+	{
+		int count = bounds.size();
+		nodes.clear();
+		parents.clear();
+		objects.resize(count);
+		objectSlot.resize(count);
+		objectNode.assign(count, 0);
+		centroids.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			objects[i] = i;
+			centroids[i] = glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+		}
+		boxes.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+			boxes[i].low = centroids[i] - extent;
+			boxes[i].high = centroids[i] + extent;
+		}
+		nodes.reserve(count / 2 + 1);
+		buildNode(0, count, -1, 0);
+
+		resizeLeafBoxes(count);
+		for (int j = 0; j < count; j++)
+		{
+			objectSlot[objects[j]] = j;
+			setLeafBox(j, boxes[objects[j]].low, boxes[objects[j]].high);
+		}
+		centroids.clear();
+		centroids.shrink_to_fit();
+		boxes.clear();
+		boxes.shrink_to_fit();
+		buildCost = cost();
+	}
+
+	// grow all the boxes to the current 'bounds' (same objects as the build)
+	void refit(const BoundsBatch& bounds)
+	{
+		for (int j = 0; j < objectCount(); j++)
+		{
+			setLeafBox(j, objectLow(bounds, objects[j]), objectHigh(bounds, objects[j]));
+		}
+		for (int n = (int)nodes.size() - 1; n >= 0; n--)
+		{
+			refitNode(n);
+		}
+	}
+
+	// grow the boxes of the paths above the objects 'moved'[0 .. count)
+	void refit(const BoundsBatch& bounds, const int* moved, int count)
+	{
+		dirty.resize(nodes.size(), 0);
+		dirtyNodes.clear();
+		for (int m = 0; m < count; m++)
+		{
+			int object = moved[m];
+			setLeafBox(objectSlot[object], objectLow(bounds, object), objectHigh(bounds, object));
+			for (int n = objectNode[object]; n >= 0 && !dirty[n]; n = parents[n])
+			{
+				dirty[n] = 1;
+				dirtyNodes.push_back(n);
+			}
+		}
+		// children have higher indices than their parent
+		std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<int>());
+		for (size_t d = 0; d < dirtyNodes.size(); d++)
+		{
+			refitNode(dirtyNodes[d]);
+			dirty[dirtyNodes[d]] = 0;
+		}
+	}
+
+	/* SAH cost of the tree relative to its root box: the area of every inner
+	   child, plus the area of every leaf times its objects */
+	float cost() const
+	{
+		if (nodes.empty())
+		{
+			return 0.0f;
+		}
+		glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+		double total = 0.0;
+		for (size_t n = 0; n < nodes.size(); n++)
+		{
+			const BvhNode& node = nodes[n];
+			for (int c = 0; c < 4; c++)
+			{
+				if (node.count[c] < 0)
+				{
+					continue;
+				}
+				glm::vec3 childLow(node.minX[c], node.minY[c], node.minZ[c]), childHigh(node.maxX[c], node.maxY[c], node.maxZ[c]);
+				total += (double)halfArea(childLow, childHigh) * (node.count[c] > 0 ? node.count[c] : 1);
+				if (n == 0)
+				{
+					low = glm::min(low, childLow);
+					high = glm::max(high, childHigh);
+				}
+			}
+		}
+		float rootArea = halfArea(low, high);
+		return rootArea > 0.0f ? (float)(total / rootArea) : 0.0f;
+	}
+
+	// has the tree degraded past 'ratio' times its cost after the build
+	bool degraded(float ratio = 1.5f) const
+	{
+		return cost() > ratio * buildCost;
+	}
+
+	// build a new tree from a copy of 'bounds' on 'pool', unless one is already being built
+	void rebuildAsync(const BoundsBatch& bounds, ThreadPool& pool)
+	{
+		if (pendingDone.valid())
+		{
+			return;
+		}
+		pending.reset(new Bvh());
+		pendingBounds.reset(new BoundsBatch(bounds));
+		Bvh* target = pending.get();
+		const BoundsBatch* source = pendingBounds.get();
+		pendingDone = pool.submit([target, source]() { target->build(*source); });
+	}
+
+	bool rebuilding() const
+	{
+		return pendingDone.valid();
+	}
+
+	/* Take the tree of rebuildAsync() once it is done ('wait' blocks until
+	   then) and refit it to 'bounds', which may have moved during the build.
+	   Returns true when the tree was replaced. */
+	bool finishRebuild(const BoundsBatch& bounds, bool wait = false)
+	{
+		if (!pendingDone.valid() || (!wait && pendingDone.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+		{
+			return false;
+		}
+		pendingDone.get();
+		nodes.swap(pending->nodes);
+		objects.swap(pending->objects);
+		parents.swap(pending->parents);
+		objectSlot.swap(pending->objectSlot);
+		objectNode.swap(pending->objectNode);
+		for (int a = 0; a < 6; a++)
+		{
+			leafBoxes[a].swap(pending->leafBoxes[a]);
+		}
+		pending.reset();
+		pendingBounds.reset();
+		refit(bounds);
+		buildCost = cost();
+		return true;
+	}
+
+	// objects whose box is at least partly in 'frustum'
+	int queryFrustum(const Frustum& frustum, std::vector<int>& out) const
+	{
+		size_t before = out.size();
+		if (nodes.empty())
+		{
+			return 0;
+		}
+		int stack[BVH_STACK_SIZE];
+		bool stackInside[BVH_STACK_SIZE];
+		int top = 0;
+		stack[top] = 0;
+		stackInside[top++] = false;
+		while (top > 0)
+		{
+			top--;
+			const BvhNode& node = nodes[stack[top]];
+			bool parentInside = stackInside[top];
+			int inside = 0xF, visible = 0xF;
+			if (!parentInside)
+			{
+				visible = frustumMask(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, frustum, inside);
+			}
+			for (int c = 0; c < 4; c++)
+			{
+				if (node.count[c] < 0 || !((visible >> c) & 1))
+				{
+					continue;
+				}
+				bool childInside = ((inside >> c) & 1) != 0;
+				if (node.count[c] == 0)
+				{
+					stack[top] = node.child[c];
+					stackInside[top++] = childInside;
+					continue;
+				}
+				int first = node.child[c];
+				int objectsVisible = 0xF, objectsInside = 0;
+				if (!childInside)
+				{
+					objectsVisible = frustumMask(&leafBoxes[0][first], &leafBoxes[1][first], &leafBoxes[2][first],
+						&leafBoxes[3][first], &leafBoxes[4][first], &leafBoxes[5][first], frustum, objectsInside);
+				}
+				for (int o = 0; o < node.count[c]; o++)
+				{
+					if ((objectsVisible >> o) & 1)
+					{
+						out.push_back(objects[first + o]);
+					}
+				}
+			}
+		}
+		return (int)(out.size() - before);
+	}
+
+	// objects whose box is hit by the ray within 'maxDistance' (in units of 'direction')
+	int queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<int>& out) const
+	{
+		size_t before = out.size();
+		traverseRay(origin, direction, maxDistance, [&](int first, int count, int hits, const float*) {
+			for (int o = 0; o < count; o++)
+			{
+				if ((hits >> o) & 1)
+				{
+					out.push_back(objects[first + o]);
+				}
+			}
+			return maxDistance;
+		});
+		return (int)(out.size() - before);
+	}
+
+	// nearest object whose box is hit by the ray, -1 if none; its entry distance goes to 'distance'
+	int pick(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance = NULL) const
+	{
+		int nearest = -1;
+		float best = maxDistance;
+		traverseRay(origin, direction, maxDistance, [&](int first, int count, int hits, const float* entry) {
+			for (int o = 0; o < count; o++)
+			{
+				if (((hits >> o) & 1) && (nearest < 0 || entry[o] < best))
+				{
+					best = entry[o];
+					nearest = objects[first + o];
+				}
+			}
+			return best;
+		});
+		if (distance)
+		{
+			*distance = best;
+		}
+		return nearest;
+	}
+
+	// objects whose box is within 'radius' of 'center'
+	int querySphere(const glm::vec3& center, float radius, std::vector<int>& out) const
+	{
+		size_t before = out.size();
+		if (nodes.empty())
+		{
+			return 0;
+		}
+		int stack[BVH_STACK_SIZE];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			const BvhNode& node = nodes[stack[--top]];
+			int hits = sphereMask(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, center, radius);
+			for (int c = 0; c < 4; c++)
+			{
+				if (node.count[c] < 0 || !((hits >> c) & 1))
+				{
+					continue;
+				}
+				if (node.count[c] == 0)
+				{
+					stack[top++] = node.child[c];
+					continue;
+				}
+				int first = node.child[c];
+				int objectHits = sphereMask(&leafBoxes[0][first], &leafBoxes[1][first], &leafBoxes[2][first],
+					&leafBoxes[3][first], &leafBoxes[4][first], &leafBoxes[5][first], center, radius);
+				for (int o = 0; o < node.count[c]; o++)
+				{
+					if ((objectHits >> o) & 1)
+					{
+						out.push_back(objects[first + o]);
+					}
+				}
+			}
+		}
+		return (int)(out.size() - before);
+	}
+
+private:
+	struct Box
+	{
+		glm::vec3 low, high;
+	};
+
+	std::vector<int> parents;	  // per node, -1 for the root
+	std::vector<int> objectSlot;  // per object, its entry in 'objects'
+	std::vector<int> objectNode;  // per object, the node holding its leaf
+	std::vector<float> leafBoxes[6]; // minX, minY, minZ, maxX, maxY, maxZ in leaf order, padded by 4
+	std::vector<glm::vec3> centroids; // build only
+	std::vector<Box> boxes;			  // build only
+	std::vector<unsigned char> dirty; // refit only
+	std::vector<int> dirtyNodes;	  // refit only
+	std::unique_ptr<Bvh> pending;	  // tree of the background rebuild
+	std::unique_ptr<BoundsBatch> pendingBounds;
+	std::future<void> pendingDone;
+
+	static float halfArea(const glm::vec3& low, const glm::vec3& high)
+	{
+		glm::vec3 size = glm::max(high - low, glm::vec3(0.0f));
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	static glm::vec3 objectLow(const BoundsBatch& bounds, int i)
+	{
+		return glm::vec3(bounds.centerX[i] - bounds.extentX[i], bounds.centerY[i] - bounds.extentY[i], bounds.centerZ[i] - bounds.extentZ[i]);
+	}
+
+	static glm::vec3 objectHigh(const BoundsBatch& bounds, int i)
+	{
+		return glm::vec3(bounds.centerX[i] + bounds.extentX[i], bounds.centerY[i] + bounds.extentY[i], bounds.centerZ[i] + bounds.extentZ[i]);
+	}
+
+	void resizeLeafBoxes(int count)
+	{
+		// the padding entries are empty boxes, never hit
+		for (int a = 0; a < 3; a++)
+		{
+			leafBoxes[a].assign(count + 4, FLT_MAX);
+			leafBoxes[a + 3].assign(count + 4, -FLT_MAX);
+		}
+	}
+
+	void setLeafBox(int slot, const glm::vec3& low, const glm::vec3& high)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			leafBoxes[a][slot] = low[a];
+			leafBoxes[a + 3][slot] = high[a];
+		}
+	}
+
+	// recompute the child boxes of node 'n' from its leaves and child nodes
+	void refitNode(int n)
+	{
+		BvhNode& node = nodes[n];
+		for (int c = 0; c < 4; c++)
+		{
+			if (node.count[c] < 0)
+			{
+				continue;
+			}
+			glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+			if (node.count[c] > 0)
+			{
+				for (int j = node.child[c]; j < node.child[c] + node.count[c]; j++)
+				{
+					low = glm::min(low, glm::vec3(leafBoxes[0][j], leafBoxes[1][j], leafBoxes[2][j]));
+					high = glm::max(high, glm::vec3(leafBoxes[3][j], leafBoxes[4][j], leafBoxes[5][j]));
+				}
+			}
+			else
+			{
+				const BvhNode& child = nodes[node.child[c]];
+				for (int k = 0; k < 4; k++)
+				{
+					if (child.count[k] >= 0)
+					{
+						low = glm::min(low, glm::vec3(child.minX[k], child.minY[k], child.minZ[k]));
+						high = glm::max(high, glm::vec3(child.maxX[k], child.maxY[k], child.maxZ[k]));
+					}
+				}
+			}
+			node.minX[c] = low.x; node.minY[c] = low.y; node.minZ[c] = low.z;
+			node.maxX[c] = high.x; node.maxY[c] = high.y; node.maxZ[c] = high.z;
+		}
+	}
+
+	Box rangeBox(int begin, int end) const
+	{
+		Box box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+		for (int j = begin; j < end; j++)
+		{
+			box.low = glm::min(box.low, boxes[objects[j]].low);
+			box.high = glm::max(box.high, boxes[objects[j]].high);
+		}
+		return box;
+	}
+
+	// partition objects[begin, end) by the best binned SAH plane, returns the first of the second half
+	int splitSah(int begin, int end)
+	{
+		glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+		for (int j = begin; j < end; j++)
+		{
+			low = glm::min(low, centroids[objects[j]]);
+			high = glm::max(high, centroids[objects[j]]);
+		}
+		float bestCost = FLT_MAX;
+		int bestAxis = -1, bestBin = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = high[axis] - low[axis];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+			float scale = BVH_BINS / extent;
+			Box bins[BVH_BINS];
+			int counts[BVH_BINS] = {};
+			for (int b = 0; b < BVH_BINS; b++)
+			{
+				bins[b].low = glm::vec3(FLT_MAX);
+				bins[b].high = glm::vec3(-FLT_MAX);
+			}
+			for (int j = begin; j < end; j++)
+			{
+				int object = objects[j];
+				int b = std::min(BVH_BINS - 1, (int)((centroids[object][axis] - low[axis]) * scale));
+				counts[b]++;
+				bins[b].low = glm::min(bins[b].low, boxes[object].low);
+				bins[b].high = glm::max(bins[b].high, boxes[object].high);
+			}
+			// areas of the left sides swept forwards, costs completed backwards
+			float leftArea[BVH_BINS];
+			int leftCount[BVH_BINS];
+			Box sweep = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+			int count = 0;
+			for (int b = 0; b < BVH_BINS - 1; b++)
+			{
+				sweep.low = glm::min(sweep.low, bins[b].low);
+				sweep.high = glm::max(sweep.high, bins[b].high);
+				count += counts[b];
+				leftArea[b] = halfArea(sweep.low, sweep.high);
+				leftCount[b] = count;
+			}
+			sweep.low = glm::vec3(FLT_MAX);
+			sweep.high = glm::vec3(-FLT_MAX);
+			count = 0;
+			for (int b = BVH_BINS - 1; b > 0; b--)
+			{
+				sweep.low = glm::min(sweep.low, bins[b].low);
+				sweep.high = glm::max(sweep.high, bins[b].high);
+				count += counts[b];
+				if (leftCount[b - 1] == 0 || count == 0)
+				{
+					continue;
+				}
+				float splitCost = leftArea[b - 1] * leftCount[b - 1] + halfArea(sweep.low, sweep.high) * count;
+				if (splitCost < bestCost)
+				{
+					bestCost = splitCost;
+					bestAxis = axis;
+					bestBin = b; // bins [0, b) go left
+				}
+			}
+		}
+
+		int mid = begin + (end - begin) / 2;
+		if (bestAxis >= 0)
+		{
+			float scale = BVH_BINS / (high[bestAxis] - low[bestAxis]);
+			float base = low[bestAxis];
+			int axis = bestAxis, bin = bestBin;
+			const std::vector<glm::vec3>& centers = centroids;
+			mid = (int)(std::partition(objects.begin() + begin, objects.begin() + end, [&](int object) {
+				return std::min(BVH_BINS - 1, (int)((centers[object][axis] - base) * scale)) < bin;
+			}) - objects.begin());
+		}
+		if (mid == begin || mid == end)
+		{
+			// all the centroids in one place: split by count
+			mid = begin + (end - begin) / 2;
+		}
+		return mid;
+	}
+
+	// partition objects[begin, end) at the median centroid along the longest axis
+	int splitMedian(int begin, int end)
+	{
+		glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+		for (int j = begin; j < end; j++)
+		{
+			low = glm::min(low, centroids[objects[j]]);
+			high = glm::max(high, centroids[objects[j]]);
+		}
+		glm::vec3 extent = high - low;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		int mid = begin + (end - begin) / 2;
+		const std::vector<glm::vec3>& centers = centroids;
+		std::nth_element(objects.begin() + begin, objects.begin() + mid, objects.begin() + end, [&](int a, int b) {
+			return centers[a][axis] < centers[b][axis];
+		});
+		return mid;
+	}
+
+	int buildNode(int begin, int end, int parent, int depth)
+	{
+		assert(depth < BVH_MAX_DEPTH);
+		int node = (int)nodes.size();
+		nodes.push_back(BvhNode());
+		parents.push_back(parent);
+
+		/* Split the largest part until there are 4 or all are leaves */
+		int partBegin[4] = { begin }, partEnd[4] = { end };
+		int parts = 1;
+		while (parts < 4)
+		{
+			int largest = -1;
+			for (int p = 0; p < parts; p++)
+			{
+				int size = partEnd[p] - partBegin[p];
+				if (size > BVH_LEAF_SIZE && (largest < 0 || size > partEnd[largest] - partBegin[largest]))
+				{
+					largest = p;
+				}
+			}
+			if (largest < 0)
+			{
+				break;
+			}
+			int mid = depth < BVH_SAH_DEPTH ? splitSah(partBegin[largest], partEnd[largest])
+				: splitMedian(partBegin[largest], partEnd[largest]);
+			partBegin[parts] = mid;
+			partEnd[parts] = partEnd[largest];
+			partEnd[largest] = mid;
+			parts++;
+		}
+
+		for (int c = 0; c < 4; c++)
+		{
+			BvhNode& slot = nodes[node];
+			slot.child[c] = 0;
+			slot.count[c] = -1;
+			slot.minX[c] = slot.minY[c] = slot.minZ[c] = FLT_MAX;
+			slot.maxX[c] = slot.maxY[c] = slot.maxZ[c] = -FLT_MAX;
+			if (c >= parts)
+			{
+				continue;
+			}
+			Box box = rangeBox(partBegin[c], partEnd[c]);
+			slot.minX[c] = box.low.x; slot.minY[c] = box.low.y; slot.minZ[c] = box.low.z;
+			slot.maxX[c] = box.high.x; slot.maxY[c] = box.high.y; slot.maxZ[c] = box.high.z;
+			int size = partEnd[c] - partBegin[c];
+			if (size <= BVH_LEAF_SIZE)
+			{
+				slot.child[c] = partBegin[c];
+				slot.count[c] = size;
+				for (int j = partBegin[c]; j < partEnd[c]; j++)
+				{
+					objectNode[objects[j]] = node;
+				}
+			}
+			else
+			{
+				int child = buildNode(partBegin[c], partEnd[c], node, depth + 1); // may grow 'nodes'
+				nodes[node].child[c] = child;
+				nodes[node].count[c] = 0;
+			}
+		}
+		return node;
+	}
+
+	/* Ray traversal, nearest children first: 'leaf'(first, count, hits,
+	   entry distances) gets every leaf whose box is hit and returns the
+	   distance beyond which nothing matters anymore */
+	template <class F>
+	void traverseRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, F leaf) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+		glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		int stack[BVH_STACK_SIZE];
+		float stackDistance[BVH_STACK_SIZE];
+		int top = 0;
+		stack[top] = 0;
+		stackDistance[top++] = 0.0f;
+		while (top > 0)
+		{
+			top--;
+			if (stackDistance[top] > maxDistance)
+			{
+				continue;
+			}
+			const BvhNode& node = nodes[stack[top]];
+			float entry[4];
+			int hits = rayMask(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, origin, inverse, maxDistance, entry);
+			/* Push the hit children far to near, the nearest is popped first */
+			int order[4], hitCount = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				if (node.count[c] >= 0 && ((hits >> c) & 1))
+				{
+					int k = hitCount++;
+					while (k > 0 && entry[order[k - 1]] < entry[c])
+					{
+						order[k] = order[k - 1];
+						k--;
+					}
+					order[k] = c;
+				}
+			}
+			for (int h = 0; h < hitCount; h++)
+			{
+				int c = order[h];
+				if (node.count[c] == 0)
+				{
+					stack[top] = node.child[c];
+					stackDistance[top++] = entry[c];
+				}
+			}
+			for (int h = hitCount - 1; h >= 0; h--)
+			{
+				int c = order[h];
+				if (node.count[c] > 0 && entry[c] <= maxDistance)
+				{
+					int first = node.child[c];
+					float objectEntry[4];
+					int objectHits = rayMask(&leafBoxes[0][first], &leafBoxes[1][first], &leafBoxes[2][first],
+						&leafBoxes[3][first], &leafBoxes[4][first], &leafBoxes[5][first], origin, inverse, maxDistance, objectEntry);
+					maxDistance = leaf(first, node.count[c], objectHits, objectEntry);
+				}
+			}
+		}
+	}
+
+	/* 4 boxes at once: bit c of the result is set when box c is in the
+	   frustum (not fully outside a plane), bit c of 'inside' when it is fully
+	   inside all of them */
+	static int frustumMask(const float* minX, const float* minY, const float* minZ,
+		const float* maxX, const float* maxY, const float* maxZ, const Frustum& frustum, int& inside)
+	{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		__m128 lowX = _mm_loadu_ps(minX), lowY = _mm_loadu_ps(minY), lowZ = _mm_loadu_ps(minZ);
+		__m128 highX = _mm_loadu_ps(maxX), highY = _mm_loadu_ps(maxY), highZ = _mm_loadu_ps(maxZ);
+		__m128 outside = _mm_setzero_ps(), crossing = _mm_setzero_ps();
+		const __m128 zero = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			// corner furthest along the normal, and the one furthest against it
+			__m128 farX = plane.x > 0.0f ? highX : lowX, nearX = plane.x > 0.0f ? lowX : highX;
+			__m128 farY = plane.y > 0.0f ? highY : lowY, nearY = plane.y > 0.0f ? lowY : highY;
+			__m128 farZ = plane.z > 0.0f ? highZ : lowZ, nearZ = plane.z > 0.0f ? lowZ : highZ;
+			__m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z), w = _mm_set1_ps(plane.w);
+			__m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, farX), _mm_mul_ps(ny, farY)), _mm_mul_ps(nz, farZ)), w);
+			__m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nearX), _mm_mul_ps(ny, nearY)), _mm_mul_ps(nz, nearZ)), w);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, zero));
+			crossing = _mm_or_ps(crossing, _mm_cmplt_ps(nearDistance, zero));
+		}
+		int outsideMask = _mm_movemask_ps(outside);
+		inside = ~(outsideMask | _mm_movemask_ps(crossing)) & 0xF;
+		return ~outsideMask & 0xF;
+#else
+		int visible = 0;
+		inside = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			bool out = false, crossing = false;
+			for (int p = 0; p < 6; p++)
+			{
+				const glm::vec4& plane = frustum.planes[p];
+				float farDistance = ((plane.x * (plane.x > 0.0f ? maxX[c] : minX[c]) + plane.y * (plane.y > 0.0f ? maxY[c] : minY[c]))
+					+ plane.z * (plane.z > 0.0f ? maxZ[c] : minZ[c])) + plane.w;
+				float nearDistance = ((plane.x * (plane.x > 0.0f ? minX[c] : maxX[c]) + plane.y * (plane.y > 0.0f ? minY[c] : maxY[c]))
+					+ plane.z * (plane.z > 0.0f ? minZ[c] : maxZ[c])) + plane.w;
+				out = out || farDistance < 0.0f;
+				crossing = crossing || nearDistance < 0.0f;
+			}
+			visible |= out ? 0 : 1 << c;
+			inside |= out || crossing ? 0 : 1 << c;
+		}
+		return visible;
+#endif
+	}
+
+	// 4 boxes at once: bit c set when the ray enters box c within 'maxDistance', at entry[c]
+	static int rayMask(const float* minX, const float* minY, const float* minZ,
+		const float* maxX, const float* maxY, const float* maxZ, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance, float* entry)
+	{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		__m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+		__m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+		__m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minX), ox), ix), x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxX), ox), ix);
+		__m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minY), oy), iy), y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxY), oy), iy);
+		__m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minZ), oz), iz), z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxZ), oz), iz);
+		__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+		__m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(maxDistance)));
+		_mm_storeu_ps(entry, enter);
+		return _mm_movemask_ps(_mm_cmple_ps(enter, leave));
+#else
+		int hits = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			float x0 = (minX[c] - origin.x) * inverse.x, x1 = (maxX[c] - origin.x) * inverse.x;
+			float y0 = (minY[c] - origin.y) * inverse.y, y1 = (maxY[c] - origin.y) * inverse.y;
+			float z0 = (minZ[c] - origin.z) * inverse.z, z1 = (maxZ[c] - origin.z) * inverse.z;
+			float enter = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+			float leave = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), maxDistance));
+			entry[c] = enter;
+			hits |= enter <= leave ? 1 << c : 0;
+		}
+		return hits;
+#endif
+	}
+
+	// 4 boxes at once: bit c set when box c is within 'radius' of 'center'
+	static int sphereMask(const float* minX, const float* minY, const float* minZ,
+		const float* maxX, const float* maxY, const float* maxZ, const glm::vec3& center, float radius)
+	{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		const __m128 zero = _mm_setzero_ps();
+		__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+		// distance from the center to the box along each axis, 0 inside the slab
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX), cx), _mm_sub_ps(cx, _mm_loadu_ps(maxX))), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minY), cy), _mm_sub_ps(cy, _mm_loadu_ps(maxY))), zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minZ), cz), _mm_sub_ps(cz, _mm_loadu_ps(maxZ))), zero);
+		__m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return _mm_movemask_ps(_mm_cmple_ps(squared, _mm_set1_ps(radius * radius)));
+#else
+		int hits = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			float dx = std::max(std::max(minX[c] - center.x, center.x - maxX[c]), 0.0f);
+			float dy = std::max(std::max(minY[c] - center.y, center.y - maxY[c]), 0.0f);
+			float dz = std::max(std::max(minZ[c] - center.z, center.z - maxZ[c]), 0.0f);
+			hits |= (dx * dx + dy * dy) + dz * dz <= radius * radius ? 1 << c : 0;
+		}
+		return hits;
+#endif
+	}
+};
+
+#endif
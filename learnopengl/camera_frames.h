@@ -0,0 +1,221 @@
+#ifndef CAMERA_FRAMES_H
+#define CAMERA_FRAMES_H
+
+#include "glm/glm.hpp"
+
+#include "camera_model.h"
+#include "synthetic_cameras.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Pixel formats the cameras deliver, BT.601 limited range like most
+   automotive sensors */
+enum CameraPixelFormat
+{
+	PIXEL_RGB,	// 8-bit RGB, already converted (only the uncompressed reference path)
+	PIXEL_NV12, // Y plane, then a half-size plane of interleaved U, V (4:2:0)
+	PIXEL_YUYV	// Y0 U Y1 V for every 2 pixels of a row (4:2:2)
+};
+
+inline const char* cameraPixelFormatName(CameraPixelFormat format)
+{
+	switch (format)
+	{
+	case PIXEL_NV12: return "nv12";
+	case PIXEL_YUYV: return "yuyv";
+	default: return "rgb";
+	}
+}
+
+inline bool parseCameraPixelFormat(const char* name, CameraPixelFormat& format)
+{
+	const CameraPixelFormat formats[3] = { PIXEL_RGB, PIXEL_NV12, PIXEL_YUYV };
+	for (int f = 0; f < 3; f++)
+	{
+		if (strcmp(name, cameraPixelFormatName(formats[f])) == 0)
+		{
+			format = formats[f];
+			return true;
+		}
+	}
+	return false;
+}
+
+// bytes of one frame (even width and height)
+inline size_t cameraFrameBytes(CameraPixelFormat format, int width, int height)
+{
+	size_t pixels = (size_t)width * height;
+	return format == PIXEL_NV12 ? pixels * 3 / 2 : format == PIXEL_YUYV ? pixels * 2 : pixels * 3;
+}
+
+/* BT.601 limited range (Y in [16, 235], U and V in [16, 240]) of an RGB colour in [0, 255] */
+inline glm::vec3 rgbToYuv601(const glm::vec3& rgb)
+{
+	glm::vec3 c = rgb / 255.0f;
+	return glm::vec3(16.0f + 65.481f * c.r + 128.553f * c.g + 24.966f * c.b,
+		128.0f - 37.797f * c.r - 74.203f * c.g + 112.0f * c.b,
+		128.0f + 112.0f * c.r - 93.786f * c.g - 18.214f * c.b);
+}
+
+// inverse of rgbToYuv601, what the sampling shaders compute
+inline glm::vec3 yuv601ToRgb(const glm::vec3& yuv)
+{
+	float y = 1.164384f * (yuv.x - 16.0f), u = yuv.y - 128.0f, v = yuv.z - 128.0f;
+	return glm::clamp(glm::vec3(y + 1.596027f * v, y - 0.391762f * u - 0.812968f * v, y + 2.017232f * u), 0.0f, 255.0f);
+}
+
+inline unsigned char toByte(float value)
+{
+	return (unsigned char)glm::clamp(value + 0.5f, 0.0f, 255.0f);
+}
+
+/* Encode an RGB image (top row first) into 'format', the chroma averaged
+   over the pixels sharing it. This plays the part of the camera: the
+   render side never converts colours on the CPU. */
+inline void encodeCameraFrame(const unsigned char* rgb, int width, int height, CameraPixelFormat format, unsigned char* frame)
+{
+	if (format == PIXEL_RGB)
+	{
+		memcpy(frame, rgb, (size_t)width * height * 3);
+		return;
+	}
+	auto pixel = [&](int x, int y) {
+		const unsigned char* p = &rgb[((size_t)y * width + x) * 3];
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+	if (format == PIXEL_NV12)
+	{
+		unsigned char* chroma = frame + (size_t)width * height;
+		for (int y = 0; y < height; y += 2)
+		{
+			for (int x = 0; x < width; x += 2)
+			{
+				glm::vec3 sum(0.0f);
+				for (int i = 0; i < 4; i++)
+				{
+					glm::vec3 yuv = rgbToYuv601(pixel(x + (i & 1), y + (i >> 1)));
+					frame[(size_t)(y + (i >> 1)) * width + x + (i & 1)] = toByte(yuv.x);
+					sum += yuv;
+				}
+				unsigned char* uv = &chroma[(size_t)(y / 2) * width + x];
+				uv[0] = toByte(sum.y / 4.0f);
+				uv[1] = toByte(sum.z / 4.0f);
+			}
+		}
+		return;
+	}
+	for (int y = 0; y < height; y++)
+	{
+		unsigned char* row = &frame[(size_t)y * width * 2];
+		for (int x = 0; x < width; x += 2)
+		{
+			glm::vec3 a = rgbToYuv601(pixel(x, y)), b = rgbToYuv601(pixel(x + 1, y));
+			row[x * 2] = toByte(a.x);
+			row[x * 2 + 1] = toByte((a.y + b.y) / 2.0f);
+			row[x * 2 + 2] = toByte(b.x);
+			row[x * 2 + 3] = toByte((a.z + b.z) / 2.0f);
+		}
+	}
+}
+
+/* RGB image of a frame, the chroma of the nearest pixel sharing it: the
+   reference of the sampling shaders, and the CPU conversion the uploads
+   of frame_upload.h avoid */
+inline void decodeCameraFrame(const unsigned char* frame, int width, int height, CameraPixelFormat format, unsigned char* rgb)
+{
+	if (format == PIXEL_RGB)
+	{
+		memcpy(rgb, frame, (size_t)width * height * 3);
+		return;
+	}
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			glm::vec3 yuv;
+			if (format == PIXEL_NV12)
+			{
+				const unsigned char* uv = &frame[(size_t)width * height + (size_t)(y / 2) * width + (x & ~1)];
+				yuv = glm::vec3(frame[(size_t)y * width + x], uv[0], uv[1]);
+			}
+			else
+			{
+				const unsigned char* pair = &frame[((size_t)y * width + (x & ~1)) * 2];
+				yuv = glm::vec3(pair[(x & 1) * 2], pair[1], pair[3]);
+			}
+			glm::vec3 color = yuv601ToRgb(yuv);
+			unsigned char* out = &rgb[((size_t)y * width + x) * 3];
+			out[0] = toByte(color.r);
+			out[1] = toByte(color.g);
+			out[2] = toByte(color.b);
+		}
+	}
+}
+
+/* Frames of the synthetic rig (synthetic_cameras.h) in a camera pixel
+   format, driving forwards at 'fps' camera frames per second. Rendering
+   the fisheye images takes far longer than a frame, so a loop of frames
+   is rendered by create() and replayed: the loop covers 2 m, the period of
+   the ground pattern, so it repeats without a jump. */
+class SyntheticFrameSource
+{
+public:
+	CameraPixelFormat format;
+	int width, height;
+	int cameras;
+	int loopFrames;
+	float fps;
+	size_t frameBytes;
+
+	SyntheticFrameSource() : format(PIXEL_NV12), width(0), height(0), cameras(0), loopFrames(0), fps(30.0f), frameBytes(0)
+	{
+	}
+
+	// render the 'frames' frames of the loop of every camera of 'rig' (same size for all)
+	void create(const CameraModel* rig, int cameraCount, CameraPixelFormat pixelFormat, int frames, float framesPerSecond, ThreadPool* pool)
+	{
+		format = pixelFormat;
+		width = rig[0].width;
+		height = rig[0].height;
+		cameras = cameraCount;
+		loopFrames = frames;
+		fps = framesPerSecond;
+		frameBytes = cameraFrameBytes(format, width, height);
+		data.resize(frameBytes * cameras * loopFrames);
+		std::vector<unsigned char> rgb;
+		for (int f = 0; f < loopFrames; f++)
+		{
+			for (int c = 0; c < cameras; c++)
+			{
+				renderSyntheticCamera(rig[c], 2.0f * f / loopFrames, rgb, pool);
+				encodeCameraFrame(rgb.data(), width, height, format, frame(c, f));
+			}
+		}
+	}
+
+	// frame 'index' (counted from the start, the loop repeats) of camera 'camera'
+	unsigned char* frame(int camera, long long index)
+	{
+		return &data[((size_t)(index % loopFrames) * cameras + camera) * frameBytes];
+	}
+
+	// index of the frame the cameras deliver at 'seconds'
+	long long frameAt(double seconds) const
+	{
+		return (long long)(seconds * fps);
+	}
+
+	// metres per second the car drives
+	float speed() const
+	{
+		return 2.0f / loopFrames * fps;
+	}
+
+private:
+	std::vector<unsigned char> data; // loop frame, then camera
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef CAMERA_MODEL_H
+#define CAMERA_MODEL_H
+
+#include "glm/glm.hpp"
+
+#include <cmath>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#endif
+
+/* Lens model of a camera */
+enum CameraModelType
+{
+	CAMERA_PINHOLE, // OpenCV pinhole: radial k1, k2, k3 and tangential p1, p2 distortion
+	CAMERA_FISHEYE	// Kannala-Brandt (OpenCV fisheye): distorted angle theta * (1 + k1 theta^2 + ... + k4 theta^8)
+};
+
+/* Intrinsics and extrinsics of a calibrated camera, with the OpenCV
+   conventions: camera space x right, y down, z forward, pixel (0, 0) is the
+   center of the top-left pixel.
+
+   World space is the vehicle frame: y up, the car looks down -z, the ground
+   is y = 0. 'rotation' takes world directions to camera space, a world point
+   p is at rotation * (p - position) in the camera. */
+struct CameraModel
+{
+	CameraModelType type;
+	int width, height; // image size in pixels
+	float fx, fy;	   // focal lengths in pixels
+	float cx, cy;	   // principal point in pixels
+	float k[5];		   // pinhole: k1, k2, p1, p2, k3 (OpenCV order); fisheye: k1, k2, k3, k4, unused
+	float maxAngle;	   // fisheye: angle from the axis (radians) beyond which the lens sees nothing
+	glm::mat3 rotation;
+	glm::vec3 position;
+};
+
+// rotation of a camera looking along 'forward' with 'up' pointing up in its image
+inline glm::mat3 cameraLookRotation(const glm::vec3& forward, const glm::vec3& up)
+{
+	glm::vec3 z = glm::normalize(forward);
+	glm::vec3 x = glm::normalize(glm::cross(z, up));
+	glm::vec3 y = glm::cross(z, x); // down in the image
+	return glm::transpose(glm::mat3(x, y, z));
+}
+
+// ideal pinhole camera (no distortion) of 'width' x 'height' pixels and horizontal field of view 'fov' (radians)
+inline CameraModel pinholeCamera(int width, int height, float fov, const glm::mat3& rotation, const glm::vec3& position)
+{
+	CameraModel camera;
+	camera.type = CAMERA_PINHOLE;
+	camera.width = width;
+	camera.height = height;
+	camera.fx = camera.fy = 0.5f * width / tanf(0.5f * fov);
+	camera.cx = 0.5f * width - 0.5f;
+	camera.cy = 0.5f * height - 0.5f;
+	for (int i = 0; i < 5; i++)
+	{
+		camera.k[i] = 0.0f;
+	}
+	camera.maxAngle = 1.5707963f;
+	camera.rotation = rotation;
+	camera.position = position;
+	return camera;
+}
+
+/* Typical surround-view rig: 4 fisheye cameras of 190 degrees on a car of
+   4.6 x 1.9 m, front and rear in the bumpers looking 30 degrees down, left
+   and right under the mirrors looking 60 degrees down. The intrinsics are
+   those of an equidistant lens (~1.4 pixels per milliradian at 1920 pixels)
+   with a few percent of distortion. */
+inline void surroundViewRig(int width, int height, CameraModel cameras[4])
+{
+	const glm::vec3 up(0.0f, 1.0f, 0.0f);
+	const float tilt[4] = { 0.5236f, 0.5236f, 1.0472f, 1.0472f };
+	const glm::vec3 directions[4] = { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+	const glm::vec3 positions[4] = { glm::vec3(0.0f, 0.6f, -2.3f), glm::vec3(0.0f, 0.9f, 2.3f), glm::vec3(-1.0f, 1.0f, -0.9f), glm::vec3(1.0f, 1.0f, -0.9f) };
+	for (int c = 0; c < 4; c++)
+	{
+		CameraModel& camera = cameras[c];
+		camera.type = CAMERA_FISHEYE;
+		camera.width = width;
+		camera.height = height;
+		camera.fx = camera.fy = width / 3.3f; // 190 degrees over a bit more than the width
+		camera.cx = 0.5f * width - 0.5f + 3.0f * c;
+		camera.cy = 0.5f * height - 0.5f - 2.0f * c;
+		camera.k[0] = 0.045f;
+		camera.k[1] = -0.012f;
+		camera.k[2] = 0.003f;
+		camera.k[3] = -0.0004f;
+		camera.k[4] = 0.0f;
+		camera.maxAngle = 1.6581f; // 95 degrees
+		glm::vec3 forward = glm::normalize(cosf(tilt[c]) * directions[c] - sinf(tilt[c]) * up);
+		camera.rotation = cameraLookRotation(forward, up);
+		camera.position = positions[c];
+	}
+}
+
+/* atan(x) for 0 <= x <= 1, odd minimax polynomial (error under 2e-6
+   radians). The SSE2 path evaluates the same operations in the same order,
+   so both give the same bits. */
+inline float cameraAtan01(float x)
+{
+	float x2 = x * x;
+	return x * (0.99997726f + x2 * (-0.33262347f + x2 * (0.19354346f + x2 * (-0.11643287f + x2 * (0.05265332f + x2 * -0.01172120f)))));
+}
+
+/* Pixel of the camera-space point 'p', false when the camera does not see it
+   (behind a pinhole camera, beyond the field of a fisheye, off the image).
+   Scalar reference of projectCameraPoints4(). */
+inline bool projectCameraPoint(const CameraModel& camera, const glm::vec3& p, glm::vec2& pixel)
+{
+	float x, y;
+	bool visible;
+	if (camera.type == CAMERA_FISHEYE)
+	{
+		float r = sqrtf(p.x * p.x + p.y * p.y), z = fabsf(p.z);
+		float low = r < z ? r : z, high = r < z ? z : r;
+		float theta = cameraAtan01(low / high);
+		theta = r > z ? 1.5707964f - theta : theta;
+		theta = p.z < 0.0f ? 3.1415927f - theta : theta;
+		float t2 = theta * theta;
+		float distorted = theta * (1.0f + t2 * (camera.k[0] + t2 * (camera.k[1] + t2 * (camera.k[2] + t2 * camera.k[3]))));
+		float scale = r > 0.0f ? distorted / r : 0.0f;
+		x = p.x * scale;
+		y = p.y * scale;
+		visible = theta <= camera.maxAngle;
+	}
+	else
+	{
+		float a = p.x / p.z, b = p.y / p.z;
+		float r2 = a * a + b * b;
+		float radial = 1.0f + r2 * (camera.k[0] + r2 * (camera.k[1] + r2 * camera.k[4]));
+		x = a * radial + (2.0f * camera.k[2] * a * b + camera.k[3] * (r2 + 2.0f * a * a));
+		y = b * radial + (camera.k[2] * (r2 + 2.0f * b * b) + 2.0f * camera.k[3] * a * b);
+		visible = p.z > 0.0f;
+	}
+	pixel = glm::vec2(camera.fx * x + camera.cx, camera.fy * y + camera.cy);
+	return visible && pixel.x > -0.5f && pixel.x < camera.width - 0.5f && pixel.y > -0.5f && pixel.y < camera.height - 0.5f;
+}
+
+/* Camera-space direction (unit length) seen by 'pixel', inverting the lens
+   model with a few Newton (fisheye) or fixed-point (pinhole) iterations.
+   False beyond the field of a fisheye. */
+inline bool unprojectCameraPixel(const CameraModel& camera, const glm::vec2& pixel, glm::vec3& direction)
+{
+	float x = (pixel.x - camera.cx) / camera.fx, y = (pixel.y - camera.cy) / camera.fy;
+	if (camera.type == CAMERA_FISHEYE)
+	{
+		float distorted = sqrtf(x * x + y * y);
+		float theta = distorted;
+		for (int i = 0; i < 6; i++)
+		{
+			float t2 = theta * theta;
+			float f = theta * (1.0f + t2 * (camera.k[0] + t2 * (camera.k[1] + t2 * (camera.k[2] + t2 * camera.k[3])))) - distorted;
+			float df = 1.0f + t2 * (3.0f * camera.k[0] + t2 * (5.0f * camera.k[1] + t2 * (7.0f * camera.k[2] + t2 * 9.0f * camera.k[3])));
+			theta -= f / df;
+		}
+		float scale = distorted > 0.0f ? sinf(theta) / distorted : 0.0f;
+		direction = glm::vec3(x * scale, y * scale, cosf(theta));
+		return theta <= camera.maxAngle;
+	}
+	float a = x, b = y;
+	for (int i = 0; i < 8; i++)
+	{
+		float r2 = a * a + b * b;
+		float radial = 1.0f + r2 * (camera.k[0] + r2 * (camera.k[1] + r2 * camera.k[4]));
+		a = (x - (2.0f * camera.k[2] * a * b + camera.k[3] * (r2 + 2.0f * a * a))) / radial;
+		b = (y - (camera.k[2] * (r2 + 2.0f * b * b) + 2.0f * camera.k[3] * a * b)) / radial;
+	}
+	direction = glm::normalize(glm::vec3(a, b, 1.0f));
+	return true;
+}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+/* projectCameraPoint() of 4 points at once: the pixels go to 'u' and 'v',
+   bit i of the result is set when point i is visible */
+inline int projectCameraPoints4(const CameraModel& camera, __m128 px, __m128 py, __m128 pz, __m128& u, __m128& v)
+{
+	__m128 x, y, visible;
+	if (camera.type == CAMERA_FISHEYE)
+	{
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 r = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)));
+		__m128 z = _mm_and_ps(pz, absMask);
+		__m128 t = _mm_div_ps(_mm_min_ps(r, z), _mm_max_ps(r, z));
+		__m128 t2 = _mm_mul_ps(t, t);
+		__m128 poly = _mm_add_ps(_mm_set1_ps(0.05265332f), _mm_mul_ps(t2, _mm_set1_ps(-0.01172120f)));
+		poly = _mm_add_ps(_mm_set1_ps(-0.11643287f), _mm_mul_ps(t2, poly));
+		poly = _mm_add_ps(_mm_set1_ps(0.19354346f), _mm_mul_ps(t2, poly));
+		poly = _mm_add_ps(_mm_set1_ps(-0.33262347f), _mm_mul_ps(t2, poly));
+		poly = _mm_add_ps(_mm_set1_ps(0.99997726f), _mm_mul_ps(t2, poly));
+		__m128 theta = _mm_mul_ps(t, poly);
+		__m128 steep = _mm_cmpgt_ps(r, z);
+		theta = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(1.5707964f), theta)), _mm_andnot_ps(steep, theta));
+		__m128 behind = _mm_cmplt_ps(pz, _mm_setzero_ps());
+		theta = _mm_or_ps(_mm_and_ps(behind, _mm_sub_ps(_mm_set1_ps(3.1415927f), theta)), _mm_andnot_ps(behind, theta));
+		__m128 theta2 = _mm_mul_ps(theta, theta);
+		__m128 k = _mm_add_ps(_mm_set1_ps(camera.k[2]), _mm_mul_ps(theta2, _mm_set1_ps(camera.k[3])));
+		k = _mm_add_ps(_mm_set1_ps(camera.k[1]), _mm_mul_ps(theta2, k));
+		k = _mm_add_ps(_mm_set1_ps(camera.k[0]), _mm_mul_ps(theta2, k));
+		__m128 distorted = _mm_mul_ps(theta, _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(theta2, k)));
+		__m128 scale = _mm_and_ps(_mm_cmpgt_ps(r, _mm_setzero_ps()), _mm_div_ps(distorted, r));
+		x = _mm_mul_ps(px, scale);
+		y = _mm_mul_ps(py, scale);
+		visible = _mm_cmple_ps(theta, _mm_set1_ps(camera.maxAngle));
+	}
+	else
+	{
+		__m128 a = _mm_div_ps(px, pz), b = _mm_div_ps(py, pz);
+		__m128 r2 = _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b));
+		__m128 radial = _mm_add_ps(_mm_set1_ps(camera.k[1]), _mm_mul_ps(r2, _mm_set1_ps(camera.k[4])));
+		radial = _mm_add_ps(_mm_set1_ps(camera.k[0]), _mm_mul_ps(r2, radial));
+		radial = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, radial));
+		__m128 p1 = _mm_set1_ps(camera.k[2]), p2 = _mm_set1_ps(camera.k[3]), two = _mm_set1_ps(2.0f);
+		__m128 p1ab = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(two, p1), a), b), p2ab = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(two, p2), a), b);
+		x = _mm_add_ps(_mm_mul_ps(a, radial), _mm_add_ps(p1ab, _mm_mul_ps(p2, _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(two, a), a)))));
+		y = _mm_add_ps(_mm_mul_ps(b, radial), _mm_add_ps(_mm_mul_ps(p1, _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(two, b), b))), p2ab));
+		visible = _mm_cmpgt_ps(pz, _mm_setzero_ps());
+	}
+	u = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(camera.fx), x), _mm_set1_ps(camera.cx));
+	v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(camera.fy), y), _mm_set1_ps(camera.cy));
+	const __m128 half = _mm_set1_ps(-0.5f);
+	visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpgt_ps(u, half), _mm_cmplt_ps(u, _mm_set1_ps(camera.width - 0.5f))));
+	visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpgt_ps(v, half), _mm_cmplt_ps(v, _mm_set1_ps(camera.height - 0.5f))));
+	return _mm_movemask_ps(visible);
+}
+#endif
+
+#endif
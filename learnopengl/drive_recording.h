@@ -0,0 +1,705 @@
+#ifndef DRIVE_RECORDING_H
+#define DRIVE_RECORDING_H
+
+#include "camera_frames.h"
+#include "mapped_file.h"
+#include "file_utils.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Recorded drives: the raw frames of the cameras and the vehicle signals of
+   a drive, with their capture timestamps, replayed in place of live
+   cameras.
+
+   The file is written in one sequential pass, each record as it arrives,
+   and the index is appended when the recording is closed, so recording
+   never seeks. The reader maps the file (MappedFile): the frames are handed
+   out as pointers into the mapping, nothing is read into the heap.
+
+   Layout (little endian):
+     DriveHeader
+     records, each 64 byte aligned: DriveRecordHeader, then its payload
+       (a frame in the header's pixel format, or VehicleSignals)
+     DriveIndexEntry[entryCount], one per record in file order
+     uint64_t[bucketCount]: first entry of each time bucket of bucketUs
+     DriveTrailer, at the very end of the file
+
+   The timestamps never decrease from one record to the next, so the
+   entries are sorted by time and the bucket table maps a timestamp to the
+   entries of its bucket: seek() is O(1), a bucket holds a few records. */
+
+/* Type of a record */
+enum DriveRecordType
+{
+	DRIVE_FRAME = 1,  // raw frame of one camera
+	DRIVE_SIGNALS = 2 // VehicleSignals
+};
+
+struct DriveHeader
+{
+	char magic[4];		  // "LDRV"
+	uint32_t version;
+	uint32_t cameras;
+	uint32_t pixelFormat; // CameraPixelFormat
+	uint32_t width;
+	uint32_t height;
+	uint64_t frameBytes;  // payload of every frame record
+};
+
+struct DriveRecordHeader
+{
+	uint32_t type;		 // DriveRecordType
+	uint32_t camera;	 // frames only
+	int64_t timestampUs; // capture time
+	uint64_t sequence;	 // records of the same camera (or the signals) written before
+	uint64_t size;		 // payload bytes, right after this header
+};
+
+/* CAN bus state of the car, sampled independently of the cameras */
+struct VehicleSignals
+{
+	float speed;		// m/s
+	float steering;		// road wheel angle, radians, positive to the left
+	float yawRate;		// radians/s
+	float acceleration; // m/s^2 along the car
+	uint32_t gear;		// 0 park, 1 drive, 2 reverse
+	uint32_t flags;		// bit 0 left indicator, bit 1 right indicator, bit 2 brake
+};
+
+struct DriveIndexEntry
+{
+	int64_t timestampUs;
+	uint64_t offset; // of the DriveRecordHeader, from the start of the file
+	uint32_t type;
+	uint32_t camera;
+};
+
+struct DriveTrailer
+{
+	uint64_t indexOffset;
+	uint64_t entryCount;
+	uint64_t bucketOffset;
+	uint64_t bucketCount;
+	int64_t bucketUs;
+	int64_t firstUs; // timestamps of the first and the last record
+	int64_t lastUs;
+	char magic[4];	 // "LDRX"
+	uint32_t version;
+};
+
+const uint32_t DRIVE_RECORDING_VERSION = 1;
+const int DRIVE_MAX_CAMERAS = 8;
+const uint64_t DRIVE_RECORD_ALIGNMENT = 64;
+const int64_t DRIVE_SEEK_BUCKET_US = 10000; // 10 ms: about 2 records per bucket for 4 cameras at 30 Hz and signals at 100 Hz
+
+/*********************************************************************/
+/* Writer                                                             */
+/*********************************************************************/
+
+/* Writes a recording record by record, in timestamp order. The file is
+   written as path.tmp and moved to 'path' by close(), so a recording that
+   did not finish never looks like a valid one. */
+class DriveRecorder
+{
+public:
+	DriveRecorder() : position(0), frames(0), signals(0)
+	{
+		memset(&header, 0, sizeof(header));
+	}
+
+	~DriveRecorder()
+	{
+		if (file.is_open())
+		{
+			close();
+		}
+	}
+
+	bool open(const std::string& filePath, int cameras, CameraPixelFormat format, int width, int height)
+	{
+		if (cameras < 1 || cameras > DRIVE_MAX_CAMERAS)
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::BAD_CAMERA_COUNT " << cameras << std::endl;
+			return false;
+		}
+		path = filePath;
+		buffer.resize(1 << 20); // few large writes
+		file.rdbuf()->pubsetbuf(buffer.data(), (std::streamsize)buffer.size());
+		file.open((path + ".tmp").c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::CANNOT_CREATE " << path << std::endl;
+			return false;
+		}
+		memcpy(header.magic, "LDRV", 4);
+		header.version = DRIVE_RECORDING_VERSION;
+		header.cameras = (uint32_t)cameras;
+		header.pixelFormat = (uint32_t)format;
+		header.width = (uint32_t)width;
+		header.height = (uint32_t)height;
+		header.frameBytes = cameraFrameBytes(format, width, height);
+		file.write((const char*)&header, sizeof(header));
+		position = sizeof(header);
+		entries.clear();
+		memset(sequences, 0, sizeof(sequences));
+		frames = signals = 0;
+		return true;
+	}
+
+	// a frame of 'camera' (header.frameBytes bytes)
+	bool writeFrame(int camera, int64_t timestampUs, const unsigned char* frame)
+	{
+		if (camera < 0 || camera >= (int)header.cameras)
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::BAD_CAMERA " << camera << std::endl;
+			return false;
+		}
+		frames++;
+		return writeRecord(DRIVE_FRAME, camera, timestampUs, frame, header.frameBytes);
+	}
+
+	bool writeSignals(int64_t timestampUs, const VehicleSignals& values)
+	{
+		signals++;
+		return writeRecord(DRIVE_SIGNALS, 0, timestampUs, &values, sizeof(values));
+	}
+
+	// append the index and the trailer, then move the file in place
+	bool close()
+	{
+		if (!file.is_open())
+		{
+			return false;
+		}
+		DriveTrailer trailer;
+		memset(&trailer, 0, sizeof(trailer));
+		memcpy(trailer.magic, "LDRX", 4);
+		trailer.version = DRIVE_RECORDING_VERSION;
+		trailer.indexOffset = position;
+		trailer.entryCount = entries.size();
+		trailer.bucketUs = DRIVE_SEEK_BUCKET_US;
+		std::vector<uint64_t> buckets;
+		if (!entries.empty())
+		{
+			trailer.firstUs = entries.front().timestampUs;
+			trailer.lastUs = entries.back().timestampUs;
+			buckets.resize((size_t)((trailer.lastUs - trailer.firstUs) / trailer.bucketUs) + 1);
+			size_t e = 0;
+			for (size_t b = 0; b < buckets.size(); b++)
+			{
+				while (entries[e].timestampUs < trailer.firstUs + (int64_t)b * trailer.bucketUs)
+				{
+					e++;
+				}
+				buckets[b] = e;
+			}
+		}
+		trailer.bucketOffset = trailer.indexOffset + entries.size() * sizeof(DriveIndexEntry);
+		trailer.bucketCount = buckets.size();
+		file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(DriveIndexEntry)));
+		file.write((const char*)buckets.data(), (std::streamsize)(buckets.size() * sizeof(uint64_t)));
+		file.write((const char*)&trailer, sizeof(trailer));
+		position = trailer.bucketOffset + buckets.size() * sizeof(uint64_t) + sizeof(trailer);
+		bool written = !!file;
+		file.close();
+		if (!written || !replaceFile(path + ".tmp", path))
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// bytes written so far
+	uint64_t size() const
+	{
+		return position;
+	}
+
+	long long frameCount() const { return frames; }
+	long long signalCount() const { return signals; }
+
+private:
+	std::string path;
+	std::ofstream file;
+	std::vector<char> buffer;
+	DriveHeader header;
+	uint64_t position;
+	std::vector<DriveIndexEntry> entries;
+	uint64_t sequences[DRIVE_MAX_CAMERAS + 1]; // per camera, then the signals
+	long long frames, signals;
+
+	bool writeRecord(DriveRecordType type, int camera, int64_t timestampUs, const void* payload, uint64_t size)
+	{
+		if (!file.is_open())
+		{
+			return false;
+		}
+		if (!entries.empty() && timestampUs < entries.back().timestampUs)
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::TIMESTAMP_OUT_OF_ORDER " << timestampUs << " < " << entries.back().timestampUs << std::endl;
+			return false;
+		}
+		static const char zeros[DRIVE_RECORD_ALIGNMENT] = { 0 };
+		uint64_t offset = (position + DRIVE_RECORD_ALIGNMENT - 1) & ~(DRIVE_RECORD_ALIGNMENT - 1);
+		file.write(zeros, (std::streamsize)(offset - position));
+
+		uint64_t& sequence = sequences[type == DRIVE_FRAME ? camera : DRIVE_MAX_CAMERAS];
+		DriveRecordHeader record;
+		record.type = (uint32_t)type;
+		record.camera = (uint32_t)camera;
+		record.timestampUs = timestampUs;
+		record.sequence = sequence++;
+		record.size = size;
+		file.write((const char*)&record, sizeof(record));
+		file.write((const char*)payload, (std::streamsize)size);
+		position = offset + sizeof(record) + size;
+
+		DriveIndexEntry entry;
+		entry.timestampUs = timestampUs;
+		entry.offset = offset;
+		entry.type = (uint32_t)type;
+		entry.camera = (uint32_t)camera;
+		entries.push_back(entry);
+		return !!file;
+	}
+};
+
+/*********************************************************************/
+/* Reader                                                             */
+/*********************************************************************/
+
+/* A mapped recording. The index and the bucket table are read in place;
+   the records are only touched when asked for.
+
+   With setReadAhead(bytes) the mapping is marked sequential
+   (MADV_SEQUENTIAL: the OS reads further ahead of the page faults) and
+   readAt(i), called as the replay reaches record i, asks for the next
+   'bytes' after a jump (MADV_WILLNEED; while streaming the OS read-ahead
+   is enough, asking again only costs time) and drops the pages more than
+   'bytes' behind (MADV_DONTNEED), so the resident part of a long
+   recording stays bounded. Dropped pages are read again from the file if
+   touched, a frame pointer stays valid either way. */
+class DriveRecording
+{
+public:
+	DriveRecording() : header(NULL), trailer(NULL), entries(NULL), buckets(NULL), frameRecords(0), intervalUs(0), loopUs(1),
+		readAheadBytes(0), lastPosition(0), releasedTo(0)
+	{
+	}
+
+	bool open(const std::string& path)
+	{
+		close();
+		if (!file.open(path.c_str()) || file.size() < sizeof(DriveHeader) + sizeof(DriveTrailer))
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::CANNOT_OPEN " << path << std::endl;
+			file.close();
+			return false;
+		}
+		header = (const DriveHeader*)file.data();
+		trailer = (const DriveTrailer*)(file.data() + file.size() - sizeof(DriveTrailer));
+		uint64_t end = file.size() - sizeof(DriveTrailer);
+		if (memcmp(header->magic, "LDRV", 4) != 0 || header->version != DRIVE_RECORDING_VERSION
+			|| header->cameras < 1 || header->cameras > DRIVE_MAX_CAMERAS || header->pixelFormat > PIXEL_YUYV
+			|| header->frameBytes != cameraFrameBytes((CameraPixelFormat)header->pixelFormat, (int)header->width, (int)header->height)
+			|| memcmp(trailer->magic, "LDRX", 4) != 0 || trailer->version != DRIVE_RECORDING_VERSION
+			|| trailer->indexOffset > end || trailer->entryCount > (end - trailer->indexOffset) / sizeof(DriveIndexEntry)
+			|| trailer->bucketOffset != trailer->indexOffset + trailer->entryCount * sizeof(DriveIndexEntry)
+			|| trailer->bucketCount > (end - trailer->bucketOffset) / sizeof(uint64_t)
+			|| trailer->bucketUs <= 0 || trailer->lastUs < trailer->firstUs
+			|| (trailer->entryCount > 0 && trailer->bucketCount != (uint64_t)((trailer->lastUs - trailer->firstUs) / trailer->bucketUs) + 1))
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::INVALID_FILE " << path << std::endl;
+			close();
+			return false;
+		}
+		entries = (const DriveIndexEntry*)(file.data() + trailer->indexOffset);
+		buckets = (const uint64_t*)(file.data() + trailer->bucketOffset);
+		long long firstCameraFrames = 0;
+		int64_t firstCameraStartUs = 0, firstCameraEndUs = 0;
+		for (uint64_t i = 0; i < trailer->entryCount; i++)
+		{
+			const DriveIndexEntry& entry = entries[i];
+			if (entry.offset < sizeof(DriveHeader) || entry.offset % DRIVE_RECORD_ALIGNMENT != 0 || entry.offset + sizeof(DriveRecordHeader) > trailer->indexOffset
+				|| (i > 0 && entry.timestampUs < entries[i - 1].timestampUs)
+				|| (entry.type == DRIVE_FRAME && entry.camera >= header->cameras))
+			{
+				std::cout << "ERROR::DRIVE_RECORDING::INVALID_INDEX " << path << std::endl;
+				close();
+				return false;
+			}
+			frameRecords += entry.type == DRIVE_FRAME ? 1 : 0;
+			if (entry.type == DRIVE_FRAME && entry.camera == 0)
+			{
+				firstCameraStartUs = firstCameraFrames == 0 ? entry.timestampUs : firstCameraStartUs;
+				firstCameraEndUs = entry.timestampUs;
+				firstCameraFrames++;
+			}
+		}
+		intervalUs = firstCameraFrames > 1 ? (firstCameraEndUs - firstCameraStartUs) / (firstCameraFrames - 1) : 0;
+		loopUs = intervalUs > 0 ? intervalUs * firstCameraFrames : lastTimestamp() - firstTimestamp() + 1;
+		for (uint64_t b = 0; b < trailer->bucketCount; b++)
+		{
+			if (buckets[b] > trailer->entryCount)
+			{
+				std::cout << "ERROR::DRIVE_RECORDING::INVALID_INDEX " << path << std::endl;
+				close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void close()
+	{
+		file.close();
+		header = NULL;
+		trailer = NULL;
+		entries = NULL;
+		buckets = NULL;
+		frameRecords = 0;
+		intervalUs = 0;
+		loopUs = 1;
+		lastPosition = releasedTo = 0;
+	}
+
+	bool isOpen() const { return header != NULL; }
+	int cameras() const { return (int)header->cameras; }
+	CameraPixelFormat pixelFormat() const { return (CameraPixelFormat)header->pixelFormat; }
+	int width() const { return (int)header->width; }
+	int height() const { return (int)header->height; }
+	size_t frameBytes() const { return (size_t)header->frameBytes; }
+	size_t recordCount() const { return (size_t)trailer->entryCount; }
+	long long frameCount() const { return frameRecords; }
+	int64_t firstTimestamp() const { return trailer->firstUs; }
+	int64_t lastTimestamp() const { return trailer->lastUs; }
+	size_t fileSize() const { return file.size(); }
+	const DriveIndexEntry& entry(size_t i) const { return entries[i]; }
+
+	// time between two frames of a camera, on average (0 with less than 2)
+	int64_t frameIntervalUs() const { return intervalUs; }
+
+	// length of the drive: the frames of a camera and one interval after the last, so a loop keeps the frame rate
+	int64_t durationUs() const { return loopUs; }
+
+	// header of record i, its payload follows; NULL if the record does not fit in the file
+	const DriveRecordHeader* record(size_t i) const
+	{
+		const DriveRecordHeader* record = (const DriveRecordHeader*)(file.data() + entries[i].offset);
+		uint64_t room = trailer->indexOffset - entries[i].offset - sizeof(DriveRecordHeader);
+		if (record->size > room || record->type != entries[i].type
+			|| (record->type == DRIVE_FRAME ? record->size != header->frameBytes : record->size != sizeof(VehicleSignals)))
+		{
+			return NULL;
+		}
+		return record;
+	}
+
+	// first record at or after 'timestampUs' (recordCount() past the end)
+	size_t seek(int64_t timestampUs) const
+	{
+		if (recordCount() == 0 || timestampUs <= trailer->firstUs)
+		{
+			return 0;
+		}
+		if (timestampUs > trailer->lastUs)
+		{
+			return recordCount();
+		}
+		size_t i = (size_t)buckets[(timestampUs - trailer->firstUs) / trailer->bucketUs];
+		while (entries[i].timestampUs < timestampUs)
+		{
+			i++;
+		}
+		return i;
+	}
+
+	// window of the read-ahead in bytes (0: leave it to the OS)
+	void setReadAhead(size_t bytes)
+	{
+		readAheadBytes = bytes;
+		lastPosition = 0;
+		releasedTo = 0;
+		if (bytes > 0)
+		{
+			file.adviseSequential();
+		}
+	}
+
+	// the replay reads record i: load ahead of it after a jump, drop what is far behind
+	void readAt(size_t i)
+	{
+		if (readAheadBytes == 0 || i >= recordCount())
+		{
+			return;
+		}
+		size_t position = (size_t)entries[i].offset;
+		if (position < lastPosition || position > lastPosition + readAheadBytes) // the start, a seek or a loop
+		{
+			file.prefetch(position, readAheadBytes);
+			releasedTo = position;
+		}
+		lastPosition = position;
+		if (position > releasedTo + 2 * readAheadBytes)
+		{
+			file.release(releasedTo, position - readAheadBytes - releasedTo);
+			releasedTo = position - readAheadBytes;
+		}
+	}
+
+private:
+	MappedFile file;
+	const DriveHeader* header;
+	const DriveTrailer* trailer;
+	const DriveIndexEntry* entries;
+	const uint64_t* buckets;
+	long long frameRecords;
+	int64_t intervalUs, loopUs;
+	size_t readAheadBytes;
+	size_t lastPosition, releasedTo; // byte offsets
+};
+
+/*********************************************************************/
+/* Replay                                                             */
+/*********************************************************************/
+
+/* How the replay clock runs */
+enum ReplayMode
+{
+	REPLAY_REALTIME, // the records come at their recorded times on the render clock: a slow consumer drops frames
+	REPLAY_FAST		 // as fast as the consumer asks: each call delivers the next frame of every camera
+};
+
+inline const char* replayModeName(ReplayMode mode)
+{
+	return mode == REPLAY_FAST ? "fast" : "realtime";
+}
+
+inline bool parseReplayMode(const char* name, ReplayMode& mode)
+{
+	const ReplayMode modes[2] = { REPLAY_REALTIME, REPLAY_FAST };
+	for (int m = 0; m < 2; m++)
+	{
+		if (strcmp(name, replayModeName(modes[m])) == 0)
+		{
+			mode = modes[m];
+			return true;
+		}
+	}
+	return false;
+}
+
+/* What one call of DriveReplay::next() delivers. The frames point into the
+   mapping of the recording. */
+struct ReplayFrameSet
+{
+	const unsigned char* frames[DRIVE_MAX_CAMERAS]; // latest frame of each camera (NULL before the first)
+	int64_t timestampUs[DRIVE_MAX_CAMERAS];
+	bool updated[DRIVE_MAX_CAMERAS];				 // new in this call
+	VehicleSignals signals;							 // latest signals
+	int64_t signalsUs;
+
+	ReplayFrameSet() : signalsUs(-1)
+	{
+		memset(frames, 0, sizeof(frames));
+		memset(timestampUs, 0, sizeof(timestampUs));
+		memset(updated, 0, sizeof(updated));
+		memset(&signals, 0, sizeof(signals));
+	}
+};
+
+/* Counters of a DriveReplay */
+struct ReplayStats
+{
+	long long frames;  // frame records read
+	long long drops;   // of those, replaced by a newer frame of the same camera before being delivered
+	long long signals;
+	long long bytes;   // payload bytes read
+	long long loops;   // times the replay went back to the start
+	long long corrupt; // records skipped because they do not fit in the file
+};
+
+/* Replays a DriveRecording, looping at its end */
+class DriveReplay
+{
+public:
+	ReplayMode mode;
+	ReplayStats stats;
+
+	DriveReplay() : mode(REPLAY_REALTIME), recording(NULL), cursor(0), started(false), clockStart(0.0), startUs(0), loopOffsetUs(0)
+	{
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	void start(DriveRecording& drive, ReplayMode replayMode)
+	{
+		recording = &drive;
+		mode = replayMode;
+		memset(&stats, 0, sizeof(stats));
+		seek(0.0);
+	}
+
+	// continue from 'seconds' into the recording, the clock restarting on the next call
+	void seek(double seconds)
+	{
+		cursor = recording->seek(recording->firstTimestamp() + (int64_t)(seconds * 1e6));
+		cursor = cursor < recording->recordCount() ? cursor : 0;
+		started = false;
+		loopOffsetUs = 0;
+	}
+
+	/* Records due at 'seconds' of the render clock (REPLAY_REALTIME), or
+	   the next frame of every camera (REPLAY_FAST, 'seconds' unused). The
+	   frames and signals of 'set' are updated; false when no camera has a
+	   new frame. */
+	bool next(double seconds, ReplayFrameSet& set)
+	{
+		memset(set.updated, 0, sizeof(set.updated));
+		if (!recording || recording->frameCount() == 0)
+		{
+			return false;
+		}
+		if (!started)
+		{
+			started = true;
+			clockStart = seconds;
+			startUs = firstFullSetUs();
+		}
+		int64_t targetUs = startUs + (int64_t)floor((seconds - clockStart) * 1e6);
+		int cameras = recording->cameras(), updatedCameras = 0;
+		for (size_t visited = 0; visited <= recording->recordCount(); visited++) // at most once round
+		{
+			if (cursor == recording->recordCount())
+			{
+				cursor = 0;
+				loopOffsetUs += recording->durationUs();
+				stats.loops++;
+			}
+			const DriveIndexEntry& entry = recording->entry(cursor);
+			if (mode == REPLAY_REALTIME ? entry.timestampUs + loopOffsetUs > targetUs
+				: entry.type == DRIVE_FRAME && set.updated[entry.camera])
+			{
+				break;
+			}
+			recording->readAt(cursor);
+			const DriveRecordHeader* record = recording->record(cursor);
+			cursor++;
+			if (!record)
+			{
+				stats.corrupt++;
+				continue;
+			}
+			stats.bytes += (long long)record->size;
+			if (record->type == DRIVE_SIGNALS)
+			{
+				memcpy(&set.signals, record + 1, sizeof(VehicleSignals));
+				set.signalsUs = record->timestampUs + loopOffsetUs;
+				stats.signals++;
+				continue;
+			}
+			int c = (int)record->camera;
+			stats.frames++;
+			if (set.updated[c])
+			{
+				stats.drops++; // the consumer never saw the previous one
+			}
+			else
+			{
+				updatedCameras++;
+			}
+			set.frames[c] = (const unsigned char*)(record + 1);
+			set.timestampUs[c] = record->timestampUs + loopOffsetUs;
+			set.updated[c] = true;
+			if (mode == REPLAY_FAST && updatedCameras == cameras)
+			{
+				break;
+			}
+		}
+		return updatedCameras > 0;
+	}
+
+private:
+	/* Recording time of the first frame of the last camera from the cursor
+	   on: the clock starts there, so the first call delivers a frame of
+	   every camera even when they are not captured together */
+	int64_t firstFullSetUs() const
+	{
+		bool seen[DRIVE_MAX_CAMERAS] = {};
+		int64_t timestampUs = recording->entry(cursor).timestampUs;
+		int cameras = recording->cameras(), missing = cameras;
+		for (size_t i = cursor; i < recording->recordCount() && missing > 0; i++)
+		{
+			const DriveIndexEntry& entry = recording->entry(i);
+			if (entry.type == DRIVE_FRAME && entry.camera < (uint32_t)cameras && !seen[entry.camera])
+			{
+				seen[entry.camera] = true;
+				timestampUs = entry.timestampUs;
+				missing--;
+			}
+		}
+		return timestampUs;
+	}
+
+	DriveRecording* recording;
+	size_t cursor;		  // next record
+	bool started;
+	double clockStart;	  // render clock of the first call
+	int64_t startUs;	  // recording time at that call
+	int64_t loopOffsetUs; // added to the recorded timestamps, one recording length per loop
+};
+
+/*********************************************************************/
+/* Synthetic drives                                                   */
+/*********************************************************************/
+
+/* Record 'seconds' of the frames of 'source' at its frame rate and of
+   vehicle signals at 'signalHz'. The cameras are not triggered together:
+   camera c is captured c * 250 us after camera 0, as on a real rig. */
+inline bool recordSyntheticDrive(DriveRecorder& recorder, SyntheticFrameSource& source, double seconds, float signalHz)
+{
+	long long frameCount = (long long)(seconds * source.fps), signalCount = (long long)(seconds * signalHz);
+	long long f = 0, s = 0;
+	int camera = 0;
+	while (f < frameCount || s < signalCount)
+	{
+		int64_t frameUs = (int64_t)llround(f * 1e6 / source.fps) + camera * 250;
+		int64_t signalUs = (int64_t)llround(s * 1e6 / signalHz);
+		bool ok;
+		if (f < frameCount && (s == signalCount || frameUs <= signalUs))
+		{
+			ok = recorder.writeFrame(camera, frameUs, source.frame(camera, f));
+			if (++camera == source.cameras)
+			{
+				camera = 0;
+				f++;
+			}
+		}
+		else
+		{
+			VehicleSignals signals;
+			float t = (float)(s / signalHz);
+			signals.speed = source.speed();
+			signals.steering = 0.05f * sinf(0.5f * t);
+			signals.yawRate = signals.speed * tanf(signals.steering) / 2.7f; // 2.7 m wheelbase
+			signals.acceleration = 0.0f;
+			signals.gear = 1;
+			signals.flags = signals.steering > 0.04f ? 1u : signals.steering < -0.04f ? 2u : 0u;
+			ok = recorder.writeSignals(signalUs, signals);
+			s++;
+		}
+		if (!ok)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+#endif
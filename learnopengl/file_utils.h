@@ -0,0 +1,54 @@
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/* Helpers shared by the on-disk caches */
+
+// 64 bit FNV-1a
+inline uint64_t hashBytes(const unsigned char* bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// create the directory and its missing parents
+inline bool makeDirectory(const std::string& path)
+{
+	for (size_t end = path.find_first_of("/\\", 1); ; end = path.find_first_of("/\\", end + 1))
+	{
+		std::string directory = path.substr(0, end);
+#ifdef _WIN32
+		bool created = _mkdir(directory.c_str()) == 0 || errno == EEXIST;
+#else
+		bool created = mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+		if (end == std::string::npos)
+		{
+			return created;
+		}
+	}
+}
+
+/* Move a fully written temporary file over 'path', so readers never see a
+   partial file */
+inline bool replaceFile(const std::string& temporary, const std::string& path)
+{
+	std::remove(path.c_str()); // rename does not replace on Windows
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#if defined(__linux__)
+#define LEARN_FILE_WATCHER_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include <sys/stat.h>
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+/* Reports files which were written since the last poll(), without blocking.
+   On Linux the directories of the files are watched with inotify (editors
+   often save through a temporary file and a rename, which replaces the
+   watched inode, so the file itself is not watched). Elsewhere poll() compares
+   the modification times. */
+class FileWatcher
+{
+public:
+	FileWatcher()
+	{
+#ifdef LEARN_FILE_WATCHER_INOTIFY
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	}
+
+	~FileWatcher()
+	{
+#ifdef LEARN_FILE_WATCHER_INOTIFY
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+#endif
+	}
+
+	bool add(const std::string& path)
+	{
+		WatchedFile file;
+		file.path = path;
+		size_t slash = path.find_last_of("/\\");
+		file.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+		file.name = slash == std::string::npos ? path : path.substr(slash + 1);
+		file.modified = modificationTime(path);
+		file.watch = -1;
+#ifdef LEARN_FILE_WATCHER_INOTIFY
+		if (fd < 0)
+		{
+			return false;
+		}
+		file.watch = inotify_add_watch(fd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (file.watch < 0)
+		{
+			return false;
+		}
+#endif
+		files.push_back(file);
+		return true;
+	}
+
+	// paths of the watched files written since the last call
+	std::vector<std::string> poll()
+	{
+		std::vector<std::string> changed;
+		if (files.empty())
+		{
+			return changed;
+		}
+#ifdef LEARN_FILE_WATCHER_INOTIFY
+		/* The events are variable sized, the buffer is aligned for the header */
+		alignas(struct inotify_event) char buffer[4096];
+		for (;;)
+		{
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			if (length <= 0)
+			{
+				break; // EAGAIN: no more events
+			}
+			for (char* p = buffer; p < buffer + length; )
+			{
+				const struct inotify_event* event = (const struct inotify_event*)p;
+				for (size_t i = 0; i < files.size(); i++)
+				{
+					if (event->len > 0 && files[i].watch == event->wd && files[i].name == event->name)
+					{
+						addOnce(changed, files[i].path);
+					}
+				}
+				p += sizeof(struct inotify_event) + event->len;
+			}
+		}
+#else
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			time_t modified = modificationTime(files[i].path);
+			if (modified != files[i].modified)
+			{
+				files[i].modified = modified;
+				addOnce(changed, files[i].path);
+			}
+		}
+#endif
+		return changed;
+	}
+
+private:
+	struct WatchedFile
+	{
+		std::string path;
+		std::string directory;
+		std::string name;
+		time_t modified; // polling fallback
+		int watch;		 // inotify watch descriptor of the directory
+	};
+	std::vector<WatchedFile> files;
+#ifdef LEARN_FILE_WATCHER_INOTIFY
+	int fd;
+#endif
+
+	static time_t modificationTime(const std::string& path)
+	{
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+	}
+
+	static void addOnce(std::vector<std::string>& paths, const std::string& path)
+	{
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			if (paths[i] == path)
+			{
+				return;
+			}
+		}
+		paths.push_back(path);
+	}
+};
+
+#endif
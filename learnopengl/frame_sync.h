@@ -0,0 +1,500 @@
+#ifndef FRAME_SYNC_H
+#define FRAME_SYNC_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+/* Frames of cameras delivered on their own threads, matched into sets for
+   the render thread without locks.
+
+   Every camera has a FrameSlotRing: a fixed pool of frame buffers passed
+   between its producer thread and the render thread through two
+   single-producer single-consumer index queues, 'filled' (producer to
+   consumer) and 'free' (back). A slot is owned by one side at a time, so
+   the frame bytes need no synchronization of their own; the release store
+   of a queue tail publishes them. Neither side ever waits: a producer
+   that finds no free slot drops its frame, the render thread that finds
+   no new frame keeps the one it has. After create() nothing is
+   allocated, stale frames go back to the free queue. */
+
+/* Queue of slot indices for one producer and one consumer thread. The two
+   ends are on their own cache lines. CAPACITY (a power of 2) is at least
+   the number of slots of a ring, so a push never finds the queue full. */
+class SpscSlotQueue
+{
+public:
+	struct Entry
+	{
+		int slot;
+		int64_t timestampUs;
+	};
+
+	static const uint32_t CAPACITY = 16;
+
+	SpscSlotQueue() : head(0), tail(0)
+	{
+	}
+
+	// producer end
+	bool push(const Entry& entry)
+	{
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == CAPACITY)
+		{
+			return false;
+		}
+		entries[t % CAPACITY] = entry;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer end
+	bool pop(Entry& entry)
+	{
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		entry = entries[h % CAPACITY];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	void reset()
+	{
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	alignas(64) std::atomic<uint32_t> head; // next entry to pop, written by the consumer
+	alignas(64) std::atomic<uint32_t> tail; // next entry to push, written by the producer
+	alignas(64) Entry entries[CAPACITY];
+};
+
+/* The slots of one camera. The producer calls acquire(), writes the frame
+   at data(slot) and publish()es it; the consumer pop()s it, reads it and
+   recycle()s the slot. */
+class FrameSlotRing
+{
+public:
+	static const int SLOTS = 8; // the render thread holds 1, the rest absorb a few late render frames
+
+	FrameSlotRing() : frameBytes(0), published(0), ringFull(0)
+	{
+	}
+
+	// allocate the slots, all free (not while the threads run)
+	void create(size_t bytes)
+	{
+		frameBytes = bytes;
+		storage.assign(frameBytes * SLOTS, 0);
+		filled.reset();
+		free.reset();
+		for (int s = 0; s < SLOTS; s++)
+		{
+			SpscSlotQueue::Entry entry = { s, 0 };
+			free.push(entry);
+		}
+		published.store(0, std::memory_order_relaxed);
+		ringFull.store(0, std::memory_order_relaxed);
+	}
+
+	unsigned char* data(int slot)
+	{
+		return &storage[(size_t)slot * frameBytes];
+	}
+
+	size_t size() const
+	{
+		return frameBytes;
+	}
+
+	/* Producer: a slot to write the next frame into, -1 if the consumer
+	   holds them all (the frame is dropped, counted in ringFull) */
+	int acquire()
+	{
+		SpscSlotQueue::Entry entry;
+		if (!free.pop(entry))
+		{
+			ringFull.fetch_add(1, std::memory_order_relaxed);
+			return -1;
+		}
+		return entry.slot;
+	}
+
+	// producer: the frame in 'slot' is written, captured at 'timestampUs'
+	void publish(int slot, int64_t timestampUs)
+	{
+		SpscSlotQueue::Entry entry = { slot, timestampUs };
+		filled.push(entry);
+		published.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// consumer: the oldest published frame not popped yet
+	bool pop(SpscSlotQueue::Entry& entry)
+	{
+		return filled.pop(entry);
+	}
+
+	// consumer: give a slot back to the producer
+	void recycle(int slot)
+	{
+		SpscSlotQueue::Entry entry = { slot, 0 };
+		free.push(entry);
+	}
+
+	long long publishedFrames() const { return published.load(std::memory_order_relaxed); }
+	long long ringFullEvents() const { return ringFull.load(std::memory_order_relaxed); }
+
+private:
+	size_t frameBytes;
+	std::vector<unsigned char> storage;
+	SpscSlotQueue filled, free;
+	alignas(64) std::atomic<long long> published; // producer counters
+	std::atomic<long long> ringFull;
+};
+
+const int FRAME_SYNC_MAX_CAMERAS = 8;
+
+/* A set of frames chosen by FrameSynchronizer::select(), valid until the
+   next call */
+struct SyncedFrameSet
+{
+	const unsigned char* frames[FRAME_SYNC_MAX_CAMERAS];
+	int64_t timestampUs[FRAME_SYNC_MAX_CAMERAS];
+	bool updated[FRAME_SYNC_MAX_CAMERAS]; // another frame than in the previous set
+	int64_t skewUs;						  // newest - oldest timestamp of the set
+	int64_t latestSkewUs;				  // the skew had the newest frame of every camera been taken
+};
+
+/* Counters of a FrameSynchronizer */
+struct FrameSyncStats
+{
+	long long published;  // frames the producers wrote
+	long long ringFull;	  // frames the producers dropped, the render thread holding every slot (contention)
+	long long sets;		  // sets delivered
+	long long incomplete; // select() calls before every camera had a frame
+	long long delivered;  // new frames in the sets
+	long long repeated;	  // cameras keeping their previous frame in a set (no new frame, or only newer ones)
+	long long stale;	  // frames recycled without being delivered
+	double skewSumUs;
+	int64_t skewMaxUs;
+	double latestSkewSumUs;
+};
+
+/* Matches the frames of the cameras into sets, on the render thread.
+
+   select() takes every frame published since the last call (never
+   waiting) and chooses per camera one of them or the frame it holds. The
+   reference time is the newest one every camera has reached (the oldest
+   of their latest frames), at most 'maxLagUs' (default: 2 frame
+   intervals) behind the newest frame, so a camera that stops delivering
+   is shown frozen but does not hold the others back. Every timestamp up
+   to one frame interval before the reference is tried as the anchor of a
+   set, made of the frame of each camera nearest to it: the newest set
+   whose skew stays within 'toleranceUs' (default: a quarter of the frame
+   interval) wins, else the set of least skew. The frames older than the
+   chosen ones are recycled as stale, the newer ones wait for the next
+   render frame, at most SLOTS / 2 per camera: beyond that the oldest are
+   recycled too, so the producers always find a free slot. */
+class FrameSynchronizer
+{
+public:
+	int cameras;
+	int64_t intervalUs; // between two frames of a camera
+	int64_t toleranceUs;
+	int64_t maxLagUs;
+
+	FrameSynchronizer() : cameras(0), intervalUs(0), toleranceUs(0), maxLagUs(0)
+	{
+		memset(&counters, 0, sizeof(counters));
+		memset(pendingCount, 0, sizeof(pendingCount));
+		for (int c = 0; c < FRAME_SYNC_MAX_CAMERAS; c++)
+		{
+			current[c].slot = -1;
+			current[c].timestampUs = 0;
+		}
+	}
+
+	// 'cameraCount' rings of frames of 'frameBytes', at about 'fps' frames per second
+	void create(int cameraCount, size_t frameBytes, float fps)
+	{
+		cameras = cameraCount;
+		intervalUs = (int64_t)(1e6 / fps);
+		toleranceUs = intervalUs / 4;
+		maxLagUs = 2 * intervalUs;
+		for (int c = 0; c < cameras; c++)
+		{
+			rings[c].create(frameBytes);
+			pendingCount[c] = 0;
+			current[c].slot = -1;
+		}
+		memset(&counters, 0, sizeof(counters));
+	}
+
+	// where the producer thread of 'camera' writes
+	FrameSlotRing& ring(int camera)
+	{
+		return rings[camera];
+	}
+
+	/* Render thread, once per frame: false (and 'set' unchanged) until
+	   every camera has delivered a frame */
+	bool select(SyncedFrameSet& set)
+	{
+		bool complete = true;
+		for (int c = 0; c < cameras; c++)
+		{
+			SpscSlotQueue::Entry entry;
+			while (pendingCount[c] < FrameSlotRing::SLOTS && rings[c].pop(entry))
+			{
+				pending[c][pendingCount[c]++] = entry;
+			}
+			discardBefore(c, pendingCount[c] - FrameSlotRing::SLOTS / 2); // the render thread is behind
+			complete = complete && (current[c].slot >= 0 || pendingCount[c] > 0);
+		}
+		if (!complete)
+		{
+			// keep only the newest frame of the cameras that have some, the producers need the slots
+			for (int c = 0; c < cameras; c++)
+			{
+				discardBefore(c, pendingCount[c] - 1);
+			}
+			counters.incomplete++;
+			return false;
+		}
+
+		/* Best anchor: the newest within the tolerance, else the least skew */
+		int64_t latest[FRAME_SYNC_MAX_CAMERAS], newest = INT64_MIN, oldestLatest = INT64_MAX;
+		for (int c = 0; c < cameras; c++)
+		{
+			latest[c] = pendingCount[c] > 0 ? pending[c][pendingCount[c] - 1].timestampUs : current[c].timestampUs;
+			newest = latest[c] > newest ? latest[c] : newest;
+			oldestLatest = latest[c] < oldestLatest ? latest[c] : oldestLatest;
+		}
+		int64_t reference = oldestLatest > newest - maxLagUs ? oldestLatest : newest - maxLagUs;
+		int64_t bestAnchor = reference, bestSkew = INT64_MAX;
+		bool bestWithin = false;
+		for (int c = 0; c < cameras; c++)
+		{
+			for (int i = -1; i < pendingCount[c]; i++)
+			{
+				if (i < 0 && current[c].slot < 0)
+				{
+					continue;
+				}
+				int64_t anchor = i < 0 ? current[c].timestampUs : pending[c][i].timestampUs;
+				if (anchor > reference || anchor < reference - intervalUs)
+				{
+					continue;
+				}
+				int64_t skew = skewAround(anchor, NULL);
+				bool within = skew <= toleranceUs;
+				bool better = within ? !bestWithin || anchor > bestAnchor
+					: !bestWithin && (skew < bestSkew || (skew == bestSkew && anchor > bestAnchor));
+				if (better)
+				{
+					bestAnchor = anchor;
+					bestSkew = skew;
+					bestWithin = within;
+				}
+			}
+		}
+
+		/* Take it: older frames recycled, the chosen one held, newer ones kept */
+		int chosen[FRAME_SYNC_MAX_CAMERAS];
+		skewAround(bestAnchor, chosen);
+		int64_t setMin = INT64_MAX, setMax = INT64_MIN;
+		for (int c = 0; c < cameras; c++)
+		{
+			set.updated[c] = chosen[c] >= 0;
+			if (chosen[c] >= 0)
+			{
+				discardBefore(c, chosen[c]);
+				if (current[c].slot >= 0)
+				{
+					rings[c].recycle(current[c].slot); // delivered before
+				}
+				current[c] = pending[c][0];
+				removePending(c, 1);
+				counters.delivered++;
+			}
+			else
+			{
+				counters.repeated++;
+			}
+			set.frames[c] = rings[c].data(current[c].slot);
+			set.timestampUs[c] = current[c].timestampUs;
+			setMin = set.timestampUs[c] < setMin ? set.timestampUs[c] : setMin;
+			setMax = set.timestampUs[c] > setMax ? set.timestampUs[c] : setMax;
+		}
+		set.skewUs = setMax - setMin;
+		set.latestSkewUs = newest - oldestLatest;
+		counters.sets++;
+		counters.skewSumUs += (double)set.skewUs;
+		counters.skewMaxUs = set.skewUs > counters.skewMaxUs ? set.skewUs : counters.skewMaxUs;
+		counters.latestSkewSumUs += (double)set.latestSkewUs;
+		return true;
+	}
+
+	// the counters of the render thread and of the producers so far
+	FrameSyncStats stats() const
+	{
+		FrameSyncStats result = counters;
+		for (int c = 0; c < cameras; c++)
+		{
+			result.published += rings[c].publishedFrames();
+			result.ringFull += rings[c].ringFullEvents();
+		}
+		return result;
+	}
+
+private:
+	FrameSlotRing rings[FRAME_SYNC_MAX_CAMERAS];
+	SpscSlotQueue::Entry pending[FRAME_SYNC_MAX_CAMERAS][FrameSlotRing::SLOTS]; // popped, not delivered yet, oldest first
+	int pendingCount[FRAME_SYNC_MAX_CAMERAS];
+	SpscSlotQueue::Entry current[FRAME_SYNC_MAX_CAMERAS]; // delivered in the last set (slot -1 before the first)
+	FrameSyncStats counters;
+
+	/* Skew of the set made of the frame of each camera nearest to 'anchor'
+	   (the held frame or a pending one). 'chosen' gets the pending index
+	   per camera, -1 for the held frame. */
+	int64_t skewAround(int64_t anchor, int* chosen) const
+	{
+		int64_t lowest = INT64_MAX, highest = INT64_MIN;
+		for (int c = 0; c < cameras; c++)
+		{
+			int best = -1;
+			int64_t bestDistance = current[c].slot >= 0 ? llabs(current[c].timestampUs - anchor) : INT64_MAX;
+			for (int i = 0; i < pendingCount[c]; i++)
+			{
+				int64_t distance = llabs(pending[c][i].timestampUs - anchor);
+				if (distance <= bestDistance) // ties: the newer
+				{
+					best = i;
+					bestDistance = distance;
+				}
+			}
+			int64_t timestamp = best >= 0 ? pending[c][best].timestampUs : current[c].timestampUs;
+			lowest = timestamp < lowest ? timestamp : lowest;
+			highest = timestamp > highest ? timestamp : highest;
+			if (chosen)
+			{
+				chosen[c] = best;
+			}
+		}
+		return highest - lowest;
+	}
+
+	// recycle the pending frames of 'camera' before index 'keep', never delivered
+	void discardBefore(int camera, int keep)
+	{
+		for (int i = 0; i < keep; i++)
+		{
+			rings[camera].recycle(pending[camera][i].slot);
+			counters.stale++;
+		}
+		removePending(camera, keep > 0 ? keep : 0);
+	}
+
+	void removePending(int camera, int count)
+	{
+		for (int i = count; i < pendingCount[camera]; i++)
+		{
+			pending[camera][i - count] = pending[camera][i];
+		}
+		pendingCount[camera] -= count;
+	}
+};
+
+/* Free-running cameras simulated on one thread each, for the
+   synchronizer: camera c runs at fps * (1 + c / 1000) (the clocks of real
+   cameras drift apart) from a phase of c * 2 ms, its timestamps and its
+   delivery jittered by up to 'jitterUs' (less than half a frame interval,
+   the timestamps of a camera must increase). With fps 0 they deliver as
+   fast as they can, stamped when delivered. fill(camera, frame, data)
+   writes the frame into its slot; the timestamps are microseconds of the
+   steady clock since start(). */
+class CameraProducerThreads
+{
+public:
+	typedef std::function<void(int camera, long long frame, unsigned char* data)> FillFunction;
+
+	CameraProducerThreads() : stopping(false)
+	{
+	}
+
+	~CameraProducerThreads()
+	{
+		stop();
+	}
+
+	void start(FrameSynchronizer& synchronizer, float fps, int64_t jitterUs, FillFunction fill)
+	{
+		stop();
+		stopping.store(false);
+		epoch = std::chrono::steady_clock::now();
+		for (int c = 0; c < synchronizer.cameras; c++)
+		{
+			threads.push_back(std::thread(&CameraProducerThreads::run, this, &synchronizer.ring(c), c,
+				fps * (1.0 + c / 1000.0), (int64_t)c * 2000, jitterUs, fill));
+		}
+	}
+
+	void stop()
+	{
+		stopping.store(true);
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+		threads.clear();
+	}
+
+	// microseconds since start() on the clock of the timestamps
+	int64_t now() const
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+private:
+	std::vector<std::thread> threads;
+	std::atomic<bool> stopping;
+	std::chrono::steady_clock::time_point epoch;
+
+	void run(FrameSlotRing* ring, int camera, double fps, int64_t phaseUs, int64_t jitterUs, FillFunction fill)
+	{
+		std::mt19937 random(1234 + camera);
+		std::uniform_int_distribution<int64_t> jitter(-jitterUs, jitterUs), delay(0, jitterUs);
+		for (long long frame = 0; !stopping.load(std::memory_order_relaxed); frame++)
+		{
+			int64_t captureUs = fps > 0.0 ? phaseUs + (int64_t)(frame * 1e6 / fps) : now();
+			if (fps > 0.0)
+			{
+				std::this_thread::sleep_until(epoch + std::chrono::microseconds(captureUs + delay(random)));
+			}
+			int slot = ring->acquire();
+			if (slot < 0)
+			{
+				if (fps <= 0.0)
+				{
+					std::this_thread::yield(); // let the render thread run and recycle some
+				}
+				continue; // the render thread holds every slot, this frame is lost
+			}
+			fill(camera, frame, ring->data(slot));
+			ring->publish(slot, fps > 0.0 ? captureUs + jitter(random) : captureUs);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef FRAME_UPLOAD_H
+#define FRAME_UPLOAD_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "camera_frames.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/* Counters of a CameraFrameUploader */
+struct FrameUploadStats
+{
+	long long frames;	  // camera frames uploaded
+	long long bytes;
+	long long fenceWaits; // ring slots the GPU was still reading when they came round
+	double waitMs;		  // blocked on those fences
+	double copyMs;		  // writing the frames into the ring
+	double submitMs;	  // glTexSubImage3D calls
+};
+
+/* Streams raw camera frames (NV12, YUYV or RGB) of several cameras into
+   texture arrays, one layer per camera, without converting them: the
+   sampling shaders (shader_bowl.fs, shader_yuv.fs) turn YUV into RGB.
+
+   NV12 goes to a GL_R8 luma array and a half-size GL_RG8 chroma array,
+   YUYV to a GL_RGBA8 array of half width (Y0 U Y1 V per texel, no chroma
+   array), RGB to a GL_RGB8 luma array. The textures are allocated once by
+   create(), immutable with glTexStorage3D when available.
+
+   The frames go through a pixel unpack buffer split in RING_SIZE slots of
+   one frame of every camera, used round robin with a fence per slot, like
+   the regions of InstanceBuffer: with glBufferStorage the buffer is mapped
+   once, persistently, else each frame is mapped with
+   GL_MAP_UNSYNCHRONIZED_BIT, the fence being what keeps it safe. A source
+   writes a frame in place between map() and commit(), or upload() copies
+   it; the transfer into the texture is done by the GPU, the CPU only
+   waits when the GPU is RING_SIZE frames behind. */
+class CameraFrameUploader
+{
+public:
+	CameraPixelFormat format;
+	int width, height;
+	int layers;
+	size_t frameBytes;
+	GLuint lumaTexture;	  // also the RGB / packed YUYV texture
+	GLuint chromaTexture; // NV12 only
+	bool persistent;	  // ring mapped once with GL_MAP_PERSISTENT_BIT
+	FrameUploadStats stats;
+
+	CameraFrameUploader() : format(PIXEL_NV12), width(0), height(0), layers(0), frameBytes(0), lumaTexture(0), chromaTexture(0),
+		persistent(false), PBO(0), mapped(NULL), slot(0)
+	{
+		memset(&stats, 0, sizeof(stats));
+		for (int i = 0; i < RING_SIZE; i++)
+		{
+			fences[i] = 0;
+		}
+	}
+
+	~CameraFrameUploader()
+	{
+		for (int i = 0; i < RING_SIZE; i++)
+		{
+			if (fences[i])
+			{
+				glDeleteSync(fences[i]);
+			}
+		}
+		if (PBO)
+		{
+			if (persistent)
+			{
+				glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			}
+			glDeleteBuffers(1, &PBO);
+			glState().bufferDeleted(PBO);
+		}
+		GLuint textures[2] = { lumaTexture, chromaTexture };
+		for (int t = 0; t < 2; t++)
+		{
+			if (textures[t])
+			{
+				glDeleteTextures(1, &textures[t]);
+				glState().textureDeleted(textures[t]);
+			}
+		}
+	}
+
+	// allocate the textures and the ring for 'cameraCount' cameras of 'w' x 'h' (even) pixels
+	bool create(CameraPixelFormat pixelFormat, int w, int h, int cameraCount)
+	{
+		format = pixelFormat;
+		width = w;
+		height = h;
+		layers = cameraCount;
+		frameBytes = cameraFrameBytes(format, width, height);
+
+		// black (video range YUV) until a camera delivers its first frame
+		const unsigned char blackLuma[1] = { 16 }, blackChroma[2] = { 128, 128 };
+		const unsigned char blackYuyv[4] = { 16, 128, 16, 128 }, blackRgb[3] = { 0, 0, 0 };
+		if (format == PIXEL_NV12)
+		{
+			lumaTexture = createArray(GL_R8, width, height, blackLuma);
+			chromaTexture = createArray(GL_RG8, width / 2, height / 2, blackChroma);
+		}
+		else if (format == PIXEL_YUYV)
+		{
+			lumaTexture = createArray(GL_RGBA8, width / 2, height, blackYuyv);
+		}
+		else
+		{
+			lumaTexture = createArray(GL_RGB8, width, height, blackRgb);
+		}
+
+		glGenBuffers(1, &PBO);
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		GLsizeiptr size = (GLsizeiptr)(RING_SIZE * slotBytes());
+		persistent = glExtensions().bufferStorage;
+		if (persistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glExtensions().BufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+			mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+			if (!mapped)
+			{
+				std::cout << "ERROR::FRAME_UPLOAD::PERSISTENT_MAP_FAILED" << std::endl;
+				glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				return false;
+			}
+		}
+		else
+		{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		}
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return true;
+	}
+
+	/* Start the frame of all the cameras: move to the next slot of the ring,
+	   waiting for the GPU if it still reads it */
+	void beginFrame()
+	{
+		slot = (slot + 1) % RING_SIZE;
+		if (fences[slot])
+		{
+			if (glClientWaitSync(fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				stats.fenceWaits++;
+				while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				{
+				}
+				stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+			glDeleteSync(fences[slot]);
+			fences[slot] = 0;
+		}
+	}
+
+	// memory for the frame of camera 'layer' in the current slot, valid until commit()
+	unsigned char* map(int layer)
+	{
+		if (persistent)
+		{
+			return mapped + offset(layer);
+		}
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		return (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset(layer), frameBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	}
+
+	// the frame of camera 'layer' is written: copy it into its layer of the textures (on the GPU)
+	void commit(int layer)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		if (!persistent)
+		{
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		size_t base = offset(layer);
+		if (format == PIXEL_NV12)
+		{
+			glState().bindTexture(GL_TEXTURE_2D_ARRAY, lumaTexture);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RED, GL_UNSIGNED_BYTE, (void*)base);
+			glState().bindTexture(GL_TEXTURE_2D_ARRAY, chromaTexture);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width / 2, height / 2, 1, GL_RG, GL_UNSIGNED_BYTE, (void*)(base + (size_t)width * height));
+		}
+		else
+		{
+			glState().bindTexture(GL_TEXTURE_2D_ARRAY, lumaTexture);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, format == PIXEL_YUYV ? width / 2 : width, height, 1,
+				format == PIXEL_YUYV ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, (void*)base);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		stats.frames++;
+		stats.bytes += (long long)frameBytes;
+		stats.submitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// map(), copy 'frame' and commit()
+	void upload(int layer, const unsigned char* frame)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		unsigned char* destination = map(layer);
+		if (!destination)
+		{
+			std::cout << "ERROR::FRAME_UPLOAD::MAP_FAILED" << std::endl;
+			return;
+		}
+		memcpy(destination, frame, frameBytes);
+		stats.copyMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		commit(layer);
+	}
+
+	// after the uploads of the frame: the slot is free again once the GPU has done them
+	void endFrame()
+	{
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// bind the textures for the sampling shaders
+	void bind(unsigned int lumaUnit, unsigned int chromaUnit) const
+	{
+		glState().bindTextureUnit(lumaUnit, GL_TEXTURE_2D_ARRAY, lumaTexture);
+		if (chromaTexture)
+		{
+			glState().bindTextureUnit(chromaUnit, GL_TEXTURE_2D_ARRAY, chromaTexture);
+		}
+	}
+
+	// GPU memory of the textures
+	size_t textureBytes() const
+	{
+		return frameBytes * layers;
+	}
+
+private:
+	static const int RING_SIZE = 3; // frames the CPU may be ahead of the GPU
+	GLuint PBO;
+	unsigned char* mapped;
+	int slot;
+	GLsync fences[RING_SIZE];
+
+	size_t slotBytes() const
+	{
+		return frameBytes * layers;
+	}
+
+	size_t offset(int layer) const
+	{
+		return slot * slotBytes() + layer * frameBytes;
+	}
+
+	/* Texture array of 'layers' layers, GL_LINEAR except the packed YUYV
+	   texels, every texel set to 'clear' (one byte per component) */
+	GLuint createArray(GLenum internalFormat, int w, int h, const unsigned char* clear)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glState().bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		GLint filter = format == PIXEL_YUYV ? GL_NEAREST : GL_LINEAR;
+		int components = internalFormat == GL_R8 ? 1 : internalFormat == GL_RG8 ? 2 : internalFormat == GL_RGB8 ? 3 : 4;
+		GLenum pixelFormat = components == 1 ? GL_RED : components == 2 ? GL_RG : components == 3 ? GL_RGB : GL_RGBA;
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (glExtensions().textureStorage)
+		{
+			glExtensions().TexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internalFormat, w, h, layers);
+		}
+		else
+		{
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0); // complete without mipmaps
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, w, h, layers, 0, pixelFormat, GL_UNSIGNED_BYTE, NULL);
+		}
+		std::vector<unsigned char> texels((size_t)w * h * layers * components);
+		for (size_t i = 0; i < texels.size(); i++)
+		{
+			texels[i] = clear[i % components];
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, w, h, layers, pixelFormat, GL_UNSIGNED_BYTE, texels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		return texture;
+	}
+};
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef FRUSTUM_CULLING_H
+#define FRUSTUM_CULLING_H
+
+#include "glm/glm.hpp"
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#endif
+
+/* The 6 planes of a view frustum (left, right, bottom, top, near, far), the
+   normals point inside and have unit length: dot(plane.xyz, p) + plane.w is
+   the signed distance of p to the plane */
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	bool sphereVisible(const glm::vec3& center, float radius) const
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w + radius < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// axis aligned box of half size 'extent'
+	bool boxVisible(const glm::vec3& center, const glm::vec3& extent) const
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			glm::vec3 normal(planes[p]);
+			if (glm::dot(normal, center) + planes[p].w + glm::dot(glm::abs(normal), extent) < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+/* Planes of the frustum of 'viewProjection' (projection * view) in world
+   space, from the sums and differences of its rows (Gribb and Hartmann, for
+   the OpenGL clip space -w <= z <= w) */
+inline Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+	{
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	}
+	Frustum frustum;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		frustum.planes[axis * 2] = rows[3] + rows[axis];
+		frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+	}
+	for (int p = 0; p < 6; p++)
+	{
+		frustum.planes[p] /= glm::length(glm::vec3(frustum.planes[p]));
+	}
+	return frustum;
+}
+
+/* Bounding volumes of many instances kept as structure of arrays, like
+   TransformBatch: a sphere (center, radius) and an axis aligned box (center,
+   half extent) per instance */
+class BoundsBatch
+{
+public:
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> radius;
+	std::vector<float> extentX, extentY, extentZ;
+
+	int size() const
+	{
+		return (int)centerX.size();
+	}
+
+	void resize(int count)
+	{
+		centerX.resize(count); centerY.resize(count); centerZ.resize(count);
+		radius.resize(count);
+		extentX.resize(count); extentY.resize(count); extentZ.resize(count);
+	}
+
+	void set(int i, const glm::vec3& center, float sphereRadius, const glm::vec3& extent)
+	{
+		centerX[i] = center.x; centerY[i] = center.y; centerZ[i] = center.z;
+		radius[i] = sphereRadius;
+		extentX[i] = extent.x; extentY[i] = extent.y; extentZ[i] = extent.z;
+	}
+};
+
+/* Bounding volume tested against the frustum */
+enum CullShape
+{
+	CULL_SPHERES,
+	CULL_BOXES
+};
+
+/* Frustum culling of a BoundsBatch into a compacted list of the visible
+   instances, in ascending order.
+
+   The batch is cut in blocks of CULL_BLOCK instances, split over a
+   ThreadPool; each block writes its visible indices at its own offset of
+   the list, which is compacted after. Inside a block 8 (AVX) or 4 (SSE2)
+   instances are tested against each plane at once and the visible ones are
+   appended without branches from the sign mask; the scalar path (and the
+   last instances of a block) use the Frustum tests above. */
+class FrustumCuller
+{
+public:
+	static const int CULL_BLOCK = 16384;
+
+	std::vector<int> visible; // indices of the visible instances, the first visibleCount are valid
+	int visibleCount;
+
+	FrustumCuller() : visibleCount(0)
+	{
+	}
+
+	// name of the vector path compiled in ("avx", "sse2" or "scalar")
+	static const char* simdName()
+	{
+#if defined(__AVX__)
+		return "avx";
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		return "sse2";
+#else
+		return "scalar";
+#endif
+	}
+
+	// returns visibleCount, 'simd' false forces the scalar path
+	int cull(const Frustum& frustum, const BoundsBatch& bounds, CullShape shape, ThreadPool* pool = NULL, bool simd = true)
+	{
+		int count = bounds.size();
+		visible.resize(std::max(count, 1));
+		int blocks = (count + CULL_BLOCK - 1) / CULL_BLOCK;
+		blockCounts.assign(blocks, 0);
+		auto cullBlocks = [&](int first, int last) {
+			for (int b = first; b < last; b++)
+			{
+				int begin = b * CULL_BLOCK, end = std::min(count, begin + CULL_BLOCK);
+				blockCounts[b] = cullRange(frustum, bounds, shape, simd, begin, end, visible.data() + begin);
+			}
+		};
+		if (pool && blocks > 1)
+		{
+			pool->parallelFor(blocks, 1, cullBlocks);
+		}
+		else
+		{
+			cullBlocks(0, blocks);
+		}
+
+		visibleCount = 0;
+		for (int b = 0; b < blocks; b++)
+		{
+			if (visibleCount != b * CULL_BLOCK && blockCounts[b] > 0)
+			{
+				memmove(&visible[visibleCount], &visible[(size_t)b * CULL_BLOCK], blockCounts[b] * sizeof(int));
+			}
+			visibleCount += blockCounts[b];
+		}
+		return visibleCount;
+	}
+
+	// cull [begin, end) into 'out', returns the number of visible instances
+	static int cullRange(const Frustum& frustum, const BoundsBatch& bounds, CullShape shape, bool simd, int begin, int end, int* out)
+	{
+		int count = 0;
+		int i = begin;
+#if defined(__AVX__)
+		if (simd)
+		{
+			__m256 planes[6][4], absNormals[6][3];
+			for (int p = 0; p < 6; p++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					absNormals[p][c] = _mm256_set1_ps(std::fabs(frustum.planes[p][c]));
+				}
+			}
+			const __m256 zero = _mm256_setzero_ps();
+			for (; i + 8 <= end; i += 8)
+			{
+				__m256 x = _mm256_loadu_ps(&bounds.centerX[i]);
+				__m256 y = _mm256_loadu_ps(&bounds.centerY[i]);
+				__m256 z = _mm256_loadu_ps(&bounds.centerZ[i]);
+				__m256 r = zero, ex = zero, ey = zero, ez = zero;
+				if (shape == CULL_SPHERES)
+				{
+					r = _mm256_loadu_ps(&bounds.radius[i]);
+				}
+				else
+				{
+					ex = _mm256_loadu_ps(&bounds.extentX[i]);
+					ey = _mm256_loadu_ps(&bounds.extentY[i]);
+					ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+				}
+				__m256 outside = zero;
+				for (int p = 0; p < 6; p++)
+				{
+					__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+						_mm256_mul_ps(planes[p][2], z)), planes[p][3]);
+					if (shape == CULL_BOXES)
+					{
+						// distance of the box corner furthest along the normal
+						r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absNormals[p][0], ex), _mm256_mul_ps(absNormals[p][1], ey)), _mm256_mul_ps(absNormals[p][2], ez));
+					}
+					outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_LT_OQ));
+				}
+				int mask = ~_mm256_movemask_ps(outside);
+				for (int k = 0; k < 8; k++)
+				{
+					out[count] = i + k;
+					count += (mask >> k) & 1;
+				}
+			}
+		}
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		if (simd)
+		{
+			__m128 planes[6][4], absNormals[6][3];
+			for (int p = 0; p < 6; p++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					absNormals[p][c] = _mm_set1_ps(std::fabs(frustum.planes[p][c]));
+				}
+			}
+			const __m128 zero = _mm_setzero_ps();
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(&bounds.centerX[i]);
+				__m128 y = _mm_loadu_ps(&bounds.centerY[i]);
+				__m128 z = _mm_loadu_ps(&bounds.centerZ[i]);
+				__m128 r = zero, ex = zero, ey = zero, ez = zero;
+				if (shape == CULL_SPHERES)
+				{
+					r = _mm_loadu_ps(&bounds.radius[i]);
+				}
+				else
+				{
+					ex = _mm_loadu_ps(&bounds.extentX[i]);
+					ey = _mm_loadu_ps(&bounds.extentY[i]);
+					ez = _mm_loadu_ps(&bounds.extentZ[i]);
+				}
+				__m128 outside = zero;
+				for (int p = 0; p < 6; p++)
+				{
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+						_mm_mul_ps(planes[p][2], z)), planes[p][3]);
+					if (shape == CULL_BOXES)
+					{
+						// distance of the box corner furthest along the normal
+						r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absNormals[p][0], ex), _mm_mul_ps(absNormals[p][1], ey)), _mm_mul_ps(absNormals[p][2], ez));
+					}
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, r), zero));
+				}
+				int mask = ~_mm_movemask_ps(outside);
+				for (int k = 0; k < 4; k++)
+				{
+					out[count] = i + k;
+					count += (mask >> k) & 1;
+				}
+			}
+		}
+#endif
+		/* Scalar path (and the remaining instances of the SIMD path) */
+		for (; i < end; i++)
+		{
+			glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+			bool inside = shape == CULL_SPHERES ? frustum.sphereVisible(center, bounds.radius[i])
+				: frustum.boxVisible(center, glm::vec3(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]));
+			out[count] = i;
+			count += inside ? 1 : 0;
+		}
+		return count;
+	}
+
+private:
+	std::vector<int> blockCounts;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+"""Generate gl_dispatch_list.h from glad.c.
+
+The list holds every OpenGL function pointer glad loads, as
+X(name) entries without the "gl" prefix. gl_dispatch_mock.h expands it into
+a counting stub per function, so code can run against a mock dispatch table
+without an OpenGL context.
+
+Run it again after regenerating glad:  python3 gen_gl_dispatch.py
+"""
+import os
+import re
+
+here = os.path.dirname(os.path.abspath(__file__))
+with open(os.path.join(here, "glad.c")) as f:
+    names = re.findall(r"^PFNGL\w+PROC glad_gl(\w+) = NULL;", f.read(), re.MULTILINE)
+
+lines = [
+    "#ifndef GL_DISPATCH_LIST_H",
+    "#define GL_DISPATCH_LIST_H",
+    "",
+    "/* Generated by gen_gl_dispatch.py from glad.c, do not edit */",
+    "",
+    "#define GL_DISPATCH_FUNCTIONS(X) \\",
+]
+lines += ["\tX(%s) \\" % name for name in names[:-1]]
+lines += ["\tX(%s)" % names[-1], "", "#endif", ""]
+
+with open(os.path.join(here, "gl_dispatch_list.h"), "w", newline="\n") as f:
+    f.write("\n".join(lines))
+print("%d functions" % len(names))
@@ -0,0 +1,732 @@
+#ifndef GL_DISPATCH_LIST_H
+#define GL_DISPATCH_LIST_H
+
+/* Generated by gen_gl_dispatch.py from glad.c, do not edit */
+
+#define GL_DISPATCH_FUNCTIONS(X) \
+	X(Accum) \
+	X(ActiveTexture) \
+	X(AlphaFunc) \
+	X(AreTexturesResident) \
+	X(ArrayElement) \
+	X(AttachShader) \
+	X(Begin) \
+	X(BeginConditionalRender) \
+	X(BeginQuery) \
+	X(BeginTransformFeedback) \
+	X(BindAttribLocation) \
+	X(BindBuffer) \
+	X(BindBufferBase) \
+	X(BindBufferRange) \
+	X(BindFragDataLocation) \
+	X(BindFragDataLocationIndexed) \
+	X(BindFramebuffer) \
+	X(BindRenderbuffer) \
+	X(BindSampler) \
+	X(BindTexture) \
+	X(BindVertexArray) \
+	X(Bitmap) \
+	X(BlendColor) \
+	X(BlendEquation) \
+	X(BlendEquationSeparate) \
+	X(BlendFunc) \
+	X(BlendFuncSeparate) \
+	X(BlitFramebuffer) \
+	X(BufferData) \
+	X(BufferSubData) \
+	X(CallList) \
+	X(CallLists) \
+	X(CheckFramebufferStatus) \
+	X(ClampColor) \
+	X(Clear) \
+	X(ClearAccum) \
+	X(ClearBufferfi) \
+	X(ClearBufferfv) \
+	X(ClearBufferiv) \
+	X(ClearBufferuiv) \
+	X(ClearColor) \
+	X(ClearDepth) \
+	X(ClearIndex) \
+	X(ClearStencil) \
+	X(ClientActiveTexture) \
+	X(ClientWaitSync) \
+	X(ClipPlane) \
+	X(Color3b) \
+	X(Color3bv) \
+	X(Color3d) \
+	X(Color3dv) \
+	X(Color3f) \
+	X(Color3fv) \
+	X(Color3i) \
+	X(Color3iv) \
+	X(Color3s) \
+	X(Color3sv) \
+	X(Color3ub) \
+	X(Color3ubv) \
+	X(Color3ui) \
+	X(Color3uiv) \
+	X(Color3us) \
+	X(Color3usv) \
+	X(Color4b) \
+	X(Color4bv) \
+	X(Color4d) \
+	X(Color4dv) \
+	X(Color4f) \
+	X(Color4fv) \
+	X(Color4i) \
+	X(Color4iv) \
+	X(Color4s) \
+	X(Color4sv) \
+	X(Color4ub) \
+	X(Color4ubv) \
+	X(Color4ui) \
+	X(Color4uiv) \
+	X(Color4us) \
+	X(Color4usv) \
+	X(ColorMask) \
+	X(ColorMaski) \
+	X(ColorMaterial) \
+	X(ColorP3ui) \
+	X(ColorP3uiv) \
+	X(ColorP4ui) \
+	X(ColorP4uiv) \
+	X(ColorPointer) \
+	X(CompileShader) \
+	X(CompressedTexImage1D) \
+	X(CompressedTexImage2D) \
+	X(CompressedTexImage3D) \
+	X(CompressedTexSubImage1D) \
+	X(CompressedTexSubImage2D) \
+	X(CompressedTexSubImage3D) \
+	X(CopyBufferSubData) \
+	X(CopyPixels) \
+	X(CopyTexImage1D) \
+	X(CopyTexImage2D) \
+	X(CopyTexSubImage1D) \
+	X(CopyTexSubImage2D) \
+	X(CopyTexSubImage3D) \
+	X(CreateProgram) \
+	X(CreateShader) \
+	X(CullFace) \
+	X(DeleteBuffers) \
+	X(DeleteFramebuffers) \
+	X(DeleteLists) \
+	X(DeleteProgram) \
+	X(DeleteQueries) \
+	X(DeleteRenderbuffers) \
+	X(DeleteSamplers) \
+	X(DeleteShader) \
+	X(DeleteSync) \
+	X(DeleteTextures) \
+	X(DeleteVertexArrays) \
+	X(DepthFunc) \
+	X(DepthMask) \
+	X(DepthRange) \
+	X(DetachShader) \
+	X(Disable) \
+	X(DisableClientState) \
+	X(DisableVertexAttribArray) \
+	X(Disablei) \
+	X(DrawArrays) \
+	X(DrawArraysInstanced) \
+	X(DrawBuffer) \
+	X(DrawBuffers) \
+	X(DrawElements) \
+	X(DrawElementsBaseVertex) \
+	X(DrawElementsInstanced) \
+	X(DrawElementsInstancedBaseVertex) \
+	X(DrawPixels) \
+	X(DrawRangeElements) \
+	X(DrawRangeElementsBaseVertex) \
+	X(EdgeFlag) \
+	X(EdgeFlagPointer) \
+	X(EdgeFlagv) \
+	X(Enable) \
+	X(EnableClientState) \
+	X(EnableVertexAttribArray) \
+	X(Enablei) \
+	X(End) \
+	X(EndConditionalRender) \
+	X(EndList) \
+	X(EndQuery) \
+	X(EndTransformFeedback) \
+	X(EvalCoord1d) \
+	X(EvalCoord1dv) \
+	X(EvalCoord1f) \
+	X(EvalCoord1fv) \
+	X(EvalCoord2d) \
+	X(EvalCoord2dv) \
+	X(EvalCoord2f) \
+	X(EvalCoord2fv) \
+	X(EvalMesh1) \
+	X(EvalMesh2) \
+	X(EvalPoint1) \
+	X(EvalPoint2) \
+	X(FeedbackBuffer) \
+	X(FenceSync) \
+	X(Finish) \
+	X(Flush) \
+	X(FlushMappedBufferRange) \
+	X(FogCoordPointer) \
+	X(FogCoordd) \
+	X(FogCoorddv) \
+	X(FogCoordf) \
+	X(FogCoordfv) \
+	X(Fogf) \
+	X(Fogfv) \
+	X(Fogi) \
+	X(Fogiv) \
+	X(FramebufferRenderbuffer) \
+	X(FramebufferTexture) \
+	X(FramebufferTexture1D) \
+	X(FramebufferTexture2D) \
+	X(FramebufferTexture3D) \
+	X(FramebufferTextureLayer) \
+	X(FrontFace) \
+	X(Frustum) \
+	X(GenBuffers) \
+	X(GenFramebuffers) \
+	X(GenLists) \
+	X(GenQueries) \
+	X(GenRenderbuffers) \
+	X(GenSamplers) \
+	X(GenTextures) \
+	X(GenVertexArrays) \
+	X(GenerateMipmap) \
+	X(GetActiveAttrib) \
+	X(GetActiveUniform) \
+	X(GetActiveUniformBlockName) \
+	X(GetActiveUniformBlockiv) \
+	X(GetActiveUniformName) \
+	X(GetActiveUniformsiv) \
+	X(GetAttachedShaders) \
+	X(GetAttribLocation) \
+	X(GetBooleani_v) \
+	X(GetBooleanv) \
+	X(GetBufferParameteri64v) \
+	X(GetBufferParameteriv) \
+	X(GetBufferPointerv) \
+	X(GetBufferSubData) \
+	X(GetClipPlane) \
+	X(GetCompressedTexImage) \
+	X(GetDoublev) \
+	X(GetError) \
+	X(GetFloatv) \
+	X(GetFragDataIndex) \
+	X(GetFragDataLocation) \
+	X(GetFramebufferAttachmentParameteriv) \
+	X(GetInteger64i_v) \
+	X(GetInteger64v) \
+	X(GetIntegeri_v) \
+	X(GetIntegerv) \
+	X(GetLightfv) \
+	X(GetLightiv) \
+	X(GetMapdv) \
+	X(GetMapfv) \
+	X(GetMapiv) \
+	X(GetMaterialfv) \
+	X(GetMaterialiv) \
+	X(GetMultisamplefv) \
+	X(GetPixelMapfv) \
+	X(GetPixelMapuiv) \
+	X(GetPixelMapusv) \
+	X(GetPointerv) \
+	X(GetPolygonStipple) \
+	X(GetProgramInfoLog) \
+	X(GetProgramiv) \
+	X(GetQueryObjecti64v) \
+	X(GetQueryObjectiv) \
+	X(GetQueryObjectui64v) \
+	X(GetQueryObjectuiv) \
+	X(GetQueryiv) \
+	X(GetRenderbufferParameteriv) \
+	X(GetSamplerParameterIiv) \
+	X(GetSamplerParameterIuiv) \
+	X(GetSamplerParameterfv) \
+	X(GetSamplerParameteriv) \
+	X(GetShaderInfoLog) \
+	X(GetShaderSource) \
+	X(GetShaderiv) \
+	X(GetString) \
+	X(GetStringi) \
+	X(GetSynciv) \
+	X(GetTexEnvfv) \
+	X(GetTexEnviv) \
+	X(GetTexGendv) \
+	X(GetTexGenfv) \
+	X(GetTexGeniv) \
+	X(GetTexImage) \
+	X(GetTexLevelParameterfv) \
+	X(GetTexLevelParameteriv) \
+	X(GetTexParameterIiv) \
+	X(GetTexParameterIuiv) \
+	X(GetTexParameterfv) \
+	X(GetTexParameteriv) \
+	X(GetTransformFeedbackVarying) \
+	X(GetUniformBlockIndex) \
+	X(GetUniformIndices) \
+	X(GetUniformLocation) \
+	X(GetUniformfv) \
+	X(GetUniformiv) \
+	X(GetUniformuiv) \
+	X(GetVertexAttribIiv) \
+	X(GetVertexAttribIuiv) \
+	X(GetVertexAttribPointerv) \
+	X(GetVertexAttribdv) \
+	X(GetVertexAttribfv) \
+	X(GetVertexAttribiv) \
+	X(Hint) \
+	X(IndexMask) \
+	X(IndexPointer) \
+	X(Indexd) \
+	X(Indexdv) \
+	X(Indexf) \
+	X(Indexfv) \
+	X(Indexi) \
+	X(Indexiv) \
+	X(Indexs) \
+	X(Indexsv) \
+	X(Indexub) \
+	X(Indexubv) \
+	X(InitNames) \
+	X(InterleavedArrays) \
+	X(IsBuffer) \
+	X(IsEnabled) \
+	X(IsEnabledi) \
+	X(IsFramebuffer) \
+	X(IsList) \
+	X(IsProgram) \
+	X(IsQuery) \
+	X(IsRenderbuffer) \
+	X(IsSampler) \
+	X(IsShader) \
+	X(IsSync) \
+	X(IsTexture) \
+	X(IsVertexArray) \
+	X(LightModelf) \
+	X(LightModelfv) \
+	X(LightModeli) \
+	X(LightModeliv) \
+	X(Lightf) \
+	X(Lightfv) \
+	X(Lighti) \
+	X(Lightiv) \
+	X(LineStipple) \
+	X(LineWidth) \
+	X(LinkProgram) \
+	X(ListBase) \
+	X(LoadIdentity) \
+	X(LoadMatrixd) \
+	X(LoadMatrixf) \
+	X(LoadName) \
+	X(LoadTransposeMatrixd) \
+	X(LoadTransposeMatrixf) \
+	X(LogicOp) \
+	X(Map1d) \
+	X(Map1f) \
+	X(Map2d) \
+	X(Map2f) \
+	X(MapBuffer) \
+	X(MapBufferRange) \
+	X(MapGrid1d) \
+	X(MapGrid1f) \
+	X(MapGrid2d) \
+	X(MapGrid2f) \
+	X(Materialf) \
+	X(Materialfv) \
+	X(Materiali) \
+	X(Materialiv) \
+	X(MatrixMode) \
+	X(MultMatrixd) \
+	X(MultMatrixf) \
+	X(MultTransposeMatrixd) \
+	X(MultTransposeMatrixf) \
+	X(MultiDrawArrays) \
+	X(MultiDrawElements) \
+	X(MultiDrawElementsBaseVertex) \
+	X(MultiTexCoord1d) \
+	X(MultiTexCoord1dv) \
+	X(MultiTexCoord1f) \
+	X(MultiTexCoord1fv) \
+	X(MultiTexCoord1i) \
+	X(MultiTexCoord1iv) \
+	X(MultiTexCoord1s) \
+	X(MultiTexCoord1sv) \
+	X(MultiTexCoord2d) \
+	X(MultiTexCoord2dv) \
+	X(MultiTexCoord2f) \
+	X(MultiTexCoord2fv) \
+	X(MultiTexCoord2i) \
+	X(MultiTexCoord2iv) \
+	X(MultiTexCoord2s) \
+	X(MultiTexCoord2sv) \
+	X(MultiTexCoord3d) \
+	X(MultiTexCoord3dv) \
+	X(MultiTexCoord3f) \
+	X(MultiTexCoord3fv) \
+	X(MultiTexCoord3i) \
+	X(MultiTexCoord3iv) \
+	X(MultiTexCoord3s) \
+	X(MultiTexCoord3sv) \
+	X(MultiTexCoord4d) \
+	X(MultiTexCoord4dv) \
+	X(MultiTexCoord4f) \
+	X(MultiTexCoord4fv) \
+	X(MultiTexCoord4i) \
+	X(MultiTexCoord4iv) \
+	X(MultiTexCoord4s) \
+	X(MultiTexCoord4sv) \
+	X(MultiTexCoordP1ui) \
+	X(MultiTexCoordP1uiv) \
+	X(MultiTexCoordP2ui) \
+	X(MultiTexCoordP2uiv) \
+	X(MultiTexCoordP3ui) \
+	X(MultiTexCoordP3uiv) \
+	X(MultiTexCoordP4ui) \
+	X(MultiTexCoordP4uiv) \
+	X(NewList) \
+	X(Normal3b) \
+	X(Normal3bv) \
+	X(Normal3d) \
+	X(Normal3dv) \
+	X(Normal3f) \
+	X(Normal3fv) \
+	X(Normal3i) \
+	X(Normal3iv) \
+	X(Normal3s) \
+	X(Normal3sv) \
+	X(NormalP3ui) \
+	X(NormalP3uiv) \
+	X(NormalPointer) \
+	X(Ortho) \
+	X(PassThrough) \
+	X(PixelMapfv) \
+	X(PixelMapuiv) \
+	X(PixelMapusv) \
+	X(PixelStoref) \
+	X(PixelStorei) \
+	X(PixelTransferf) \
+	X(PixelTransferi) \
+	X(PixelZoom) \
+	X(PointParameterf) \
+	X(PointParameterfv) \
+	X(PointParameteri) \
+	X(PointParameteriv) \
+	X(PointSize) \
+	X(PolygonMode) \
+	X(PolygonOffset) \
+	X(PolygonStipple) \
+	X(PopAttrib) \
+	X(PopClientAttrib) \
+	X(PopMatrix) \
+	X(PopName) \
+	X(PrimitiveRestartIndex) \
+	X(PrioritizeTextures) \
+	X(ProvokingVertex) \
+	X(PushAttrib) \
+	X(PushClientAttrib) \
+	X(PushMatrix) \
+	X(PushName) \
+	X(QueryCounter) \
+	X(RasterPos2d) \
+	X(RasterPos2dv) \
+	X(RasterPos2f) \
+	X(RasterPos2fv) \
+	X(RasterPos2i) \
+	X(RasterPos2iv) \
+	X(RasterPos2s) \
+	X(RasterPos2sv) \
+	X(RasterPos3d) \
+	X(RasterPos3dv) \
+	X(RasterPos3f) \
+	X(RasterPos3fv) \
+	X(RasterPos3i) \
+	X(RasterPos3iv) \
+	X(RasterPos3s) \
+	X(RasterPos3sv) \
+	X(RasterPos4d) \
+	X(RasterPos4dv) \
+	X(RasterPos4f) \
+	X(RasterPos4fv) \
+	X(RasterPos4i) \
+	X(RasterPos4iv) \
+	X(RasterPos4s) \
+	X(RasterPos4sv) \
+	X(ReadBuffer) \
+	X(ReadPixels) \
+	X(Rectd) \
+	X(Rectdv) \
+	X(Rectf) \
+	X(Rectfv) \
+	X(Recti) \
+	X(Rectiv) \
+	X(Rects) \
+	X(Rectsv) \
+	X(RenderMode) \
+	X(RenderbufferStorage) \
+	X(RenderbufferStorageMultisample) \
+	X(Rotated) \
+	X(Rotatef) \
+	X(SampleCoverage) \
+	X(SampleMaski) \
+	X(SamplerParameterIiv) \
+	X(SamplerParameterIuiv) \
+	X(SamplerParameterf) \
+	X(SamplerParameterfv) \
+	X(SamplerParameteri) \
+	X(SamplerParameteriv) \
+	X(Scaled) \
+	X(Scalef) \
+	X(Scissor) \
+	X(SecondaryColor3b) \
+	X(SecondaryColor3bv) \
+	X(SecondaryColor3d) \
+	X(SecondaryColor3dv) \
+	X(SecondaryColor3f) \
+	X(SecondaryColor3fv) \
+	X(SecondaryColor3i) \
+	X(SecondaryColor3iv) \
+	X(SecondaryColor3s) \
+	X(SecondaryColor3sv) \
+	X(SecondaryColor3ub) \
+	X(SecondaryColor3ubv) \
+	X(SecondaryColor3ui) \
+	X(SecondaryColor3uiv) \
+	X(SecondaryColor3us) \
+	X(SecondaryColor3usv) \
+	X(SecondaryColorP3ui) \
+	X(SecondaryColorP3uiv) \
+	X(SecondaryColorPointer) \
+	X(SelectBuffer) \
+	X(ShadeModel) \
+	X(ShaderSource) \
+	X(StencilFunc) \
+	X(StencilFuncSeparate) \
+	X(StencilMask) \
+	X(StencilMaskSeparate) \
+	X(StencilOp) \
+	X(StencilOpSeparate) \
+	X(TexBuffer) \
+	X(TexCoord1d) \
+	X(TexCoord1dv) \
+	X(TexCoord1f) \
+	X(TexCoord1fv) \
+	X(TexCoord1i) \
+	X(TexCoord1iv) \
+	X(TexCoord1s) \
+	X(TexCoord1sv) \
+	X(TexCoord2d) \
+	X(TexCoord2dv) \
+	X(TexCoord2f) \
+	X(TexCoord2fv) \
+	X(TexCoord2i) \
+	X(TexCoord2iv) \
+	X(TexCoord2s) \
+	X(TexCoord2sv) \
+	X(TexCoord3d) \
+	X(TexCoord3dv) \
+	X(TexCoord3f) \
+	X(TexCoord3fv) \
+	X(TexCoord3i) \
+	X(TexCoord3iv) \
+	X(TexCoord3s) \
+	X(TexCoord3sv) \
+	X(TexCoord4d) \
+	X(TexCoord4dv) \
+	X(TexCoord4f) \
+	X(TexCoord4fv) \
+	X(TexCoord4i) \
+	X(TexCoord4iv) \
+	X(TexCoord4s) \
+	X(TexCoord4sv) \
+	X(TexCoordP1ui) \
+	X(TexCoordP1uiv) \
+	X(TexCoordP2ui) \
+	X(TexCoordP2uiv) \
+	X(TexCoordP3ui) \
+	X(TexCoordP3uiv) \
+	X(TexCoordP4ui) \
+	X(TexCoordP4uiv) \
+	X(TexCoordPointer) \
+	X(TexEnvf) \
+	X(TexEnvfv) \
+	X(TexEnvi) \
+	X(TexEnviv) \
+	X(TexGend) \
+	X(TexGendv) \
+	X(TexGenf) \
+	X(TexGenfv) \
+	X(TexGeni) \
+	X(TexGeniv) \
+	X(TexImage1D) \
+	X(TexImage2D) \
+	X(TexImage2DMultisample) \
+	X(TexImage3D) \
+	X(TexImage3DMultisample) \
+	X(TexParameterIiv) \
+	X(TexParameterIuiv) \
+	X(TexParameterf) \
+	X(TexParameterfv) \
+	X(TexParameteri) \
+	X(TexParameteriv) \
+	X(TexSubImage1D) \
+	X(TexSubImage2D) \
+	X(TexSubImage3D) \
+	X(TransformFeedbackVaryings) \
+	X(Translated) \
+	X(Translatef) \
+	X(Uniform1f) \
+	X(Uniform1fv) \
+	X(Uniform1i) \
+	X(Uniform1iv) \
+	X(Uniform1ui) \
+	X(Uniform1uiv) \
+	X(Uniform2f) \
+	X(Uniform2fv) \
+	X(Uniform2i) \
+	X(Uniform2iv) \
+	X(Uniform2ui) \
+	X(Uniform2uiv) \
+	X(Uniform3f) \
+	X(Uniform3fv) \
+	X(Uniform3i) \
+	X(Uniform3iv) \
+	X(Uniform3ui) \
+	X(Uniform3uiv) \
+	X(Uniform4f) \
+	X(Uniform4fv) \
+	X(Uniform4i) \
+	X(Uniform4iv) \
+	X(Uniform4ui) \
+	X(Uniform4uiv) \
+	X(UniformBlockBinding) \
+	X(UniformMatrix2fv) \
+	X(UniformMatrix2x3fv) \
+	X(UniformMatrix2x4fv) \
+	X(UniformMatrix3fv) \
+	X(UniformMatrix3x2fv) \
+	X(UniformMatrix3x4fv) \
+	X(UniformMatrix4fv) \
+	X(UniformMatrix4x2fv) \
+	X(UniformMatrix4x3fv) \
+	X(UnmapBuffer) \
+	X(UseProgram) \
+	X(ValidateProgram) \
+	X(Vertex2d) \
+	X(Vertex2dv) \
+	X(Vertex2f) \
+	X(Vertex2fv) \
+	X(Vertex2i) \
+	X(Vertex2iv) \
+	X(Vertex2s) \
+	X(Vertex2sv) \
+	X(Vertex3d) \
+	X(Vertex3dv) \
+	X(Vertex3f) \
+	X(Vertex3fv) \
+	X(Vertex3i) \
+	X(Vertex3iv) \
+	X(Vertex3s) \
+	X(Vertex3sv) \
+	X(Vertex4d) \
+	X(Vertex4dv) \
+	X(Vertex4f) \
+	X(Vertex4fv) \
+	X(Vertex4i) \
+	X(Vertex4iv) \
+	X(Vertex4s) \
+	X(Vertex4sv) \
+	X(VertexAttrib1d) \
+	X(VertexAttrib1dv) \
+	X(VertexAttrib1f) \
+	X(VertexAttrib1fv) \
+	X(VertexAttrib1s) \
+	X(VertexAttrib1sv) \
+	X(VertexAttrib2d) \
+	X(VertexAttrib2dv) \
+	X(VertexAttrib2f) \
+	X(VertexAttrib2fv) \
+	X(VertexAttrib2s) \
+	X(VertexAttrib2sv) \
+	X(VertexAttrib3d) \
+	X(VertexAttrib3dv) \
+	X(VertexAttrib3f) \
+	X(VertexAttrib3fv) \
+	X(VertexAttrib3s) \
+	X(VertexAttrib3sv) \
+	X(VertexAttrib4Nbv) \
+	X(VertexAttrib4Niv) \
+	X(VertexAttrib4Nsv) \
+	X(VertexAttrib4Nub) \
+	X(VertexAttrib4Nubv) \
+	X(VertexAttrib4Nuiv) \
+	X(VertexAttrib4Nusv) \
+	X(VertexAttrib4bv) \
+	X(VertexAttrib4d) \
+	X(VertexAttrib4dv) \
+	X(VertexAttrib4f) \
+	X(VertexAttrib4fv) \
+	X(VertexAttrib4iv) \
+	X(VertexAttrib4s) \
+	X(VertexAttrib4sv) \
+	X(VertexAttrib4ubv) \
+	X(VertexAttrib4uiv) \
+	X(VertexAttrib4usv) \
+	X(VertexAttribDivisor) \
+	X(VertexAttribI1i) \
+	X(VertexAttribI1iv) \
+	X(VertexAttribI1ui) \
+	X(VertexAttribI1uiv) \
+	X(VertexAttribI2i) \
+	X(VertexAttribI2iv) \
+	X(VertexAttribI2ui) \
+	X(VertexAttribI2uiv) \
+	X(VertexAttribI3i) \
+	X(VertexAttribI3iv) \
+	X(VertexAttribI3ui) \
+	X(VertexAttribI3uiv) \
+	X(VertexAttribI4bv) \
+	X(VertexAttribI4i) \
+	X(VertexAttribI4iv) \
+	X(VertexAttribI4sv) \
+	X(VertexAttribI4ubv) \
+	X(VertexAttribI4ui) \
+	X(VertexAttribI4uiv) \
+	X(VertexAttribI4usv) \
+	X(VertexAttribIPointer) \
+	X(VertexAttribP1ui) \
+	X(VertexAttribP1uiv) \
+	X(VertexAttribP2ui) \
+	X(VertexAttribP2uiv) \
+	X(VertexAttribP3ui) \
+	X(VertexAttribP3uiv) \
+	X(VertexAttribP4ui) \
+	X(VertexAttribP4uiv) \
+	X(VertexAttribPointer) \
+	X(VertexP2ui) \
+	X(VertexP2uiv) \
+	X(VertexP3ui) \
+	X(VertexP3uiv) \
+	X(VertexP4ui) \
+	X(VertexP4uiv) \
+	X(VertexPointer) \
+	X(Viewport) \
+	X(WaitSync) \
+	X(WindowPos2d) \
+	X(WindowPos2dv) \
+	X(WindowPos2f) \
+	X(WindowPos2fv) \
+	X(WindowPos2i) \
+	X(WindowPos2iv) \
+	X(WindowPos2s) \
+	X(WindowPos2sv) \
+	X(WindowPos3d) \
+	X(WindowPos3dv) \
+	X(WindowPos3f) \
+	X(WindowPos3fv) \
+	X(WindowPos3i) \
+	X(WindowPos3iv) \
+	X(WindowPos3s) \
+	X(WindowPos3sv)
+
+#endif
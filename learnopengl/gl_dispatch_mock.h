@@ -0,0 +1,372 @@
+#ifndef GL_DISPATCH_MOCK_H
+#define GL_DISPATCH_MOCK_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "gl_dispatch_list.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* Index of every function of the glad dispatch table */
+enum GLDispatchFunction
+{
+#define GL_DISPATCH_ENUM(name) GL_DISPATCH_##name,
+	GL_DISPATCH_FUNCTIONS(GL_DISPATCH_ENUM)
+#undef GL_DISPATCH_ENUM
+	GL_DISPATCH_COUNT
+};
+
+/* Mock of the whole glad dispatch table (gl_dispatch_list.h is generated from
+   glad.c by gen_gl_dispatch.py). install() points every glad_gl* pointer at a
+   stub which only counts the call and returns 0, so code runs without any
+   OpenGL context and we see exactly which calls would reach the driver.
+
+   The calls Shader makes to build a program and find its uniforms are
+   emulated on top of that (still counted): compiles and links succeed, the
+   program has the active uniforms of 'uniforms' (location = index) and
+   glGetUniformLocation searches them by name. With install(true) the mock
+   also keeps the bindings a driver would have (program, VAO, active unit,
+   textures per unit, buffers with the element array buffer per VAO,
+   enables), unbinding deleted objects like OpenGL does, so they can be
+   compared with what glState() believes is bound. */
+class GLDispatchMock
+{
+public:
+	unsigned long long calls[GL_DISPATCH_COUNT];
+	std::vector<std::string> uniforms; // active uniforms of every program
+
+	/* The bindings of the emulated context (install(true)) */
+	struct Binding
+	{
+		GLenum target;
+		GLuint unit; // texture unit (GL_TEXTURE0 + i), or VAO of an element array buffer
+		GLuint id;
+	};
+	GLuint program;
+	GLuint vertexArray;
+	GLuint activeTexture;
+	std::vector<Binding> textures;
+	std::vector<Binding> buffers;
+	std::vector<GLenum> enabled;
+
+	static GLDispatchMock& instance()
+	{
+		static GLDispatchMock mock;
+		return mock;
+	}
+
+	// 'bindings': emulate the binding state as well (slower, for the checks)
+	void install(bool bindings = false)
+	{
+#define GL_DISPATCH_INSTALL(name) glad_gl##name = &Stub<GL_DISPATCH_##name, decltype(glad_gl##name)>::call;
+		GL_DISPATCH_FUNCTIONS(GL_DISPATCH_INSTALL)
+#undef GL_DISPATCH_INSTALL
+		resetBindings();
+		if (bindings)
+		{
+			glad_glUseProgram = mockUseProgram;
+			glad_glBindVertexArray = mockBindVertexArray;
+			glad_glActiveTexture = mockActiveTexture;
+			glad_glBindTexture = mockBindTexture;
+			glad_glBindBuffer = mockBindBuffer;
+			glad_glEnable = mockEnable;
+			glad_glDisable = mockDisable;
+			glad_glDeleteTextures = mockDeleteTextures;
+			glad_glDeleteBuffers = mockDeleteBuffers;
+			glad_glDeleteVertexArrays = mockDeleteVertexArrays;
+		}
+		glad_glCreateShader = mockCreateShader;
+		glad_glCreateProgram = mockCreateProgram;
+		glad_glGetShaderiv = mockGetShaderiv;
+		glad_glGetShaderInfoLog = mockGetShaderInfoLog;
+		glad_glGetProgramiv = mockGetProgramiv;
+		glad_glGetProgramInfoLog = mockGetProgramInfoLog;
+		glad_glGetActiveUniform = mockGetActiveUniform;
+		glad_glGetUniformLocation = mockGetUniformLocation;
+		resetCounters();
+	}
+
+	void resetCounters()
+	{
+		memset(calls, 0, sizeof(calls));
+	}
+
+	// the state of a new context
+	void resetBindings()
+	{
+		program = 0;
+		vertexArray = 0;
+		activeTexture = GL_TEXTURE0;
+		textures.clear();
+		buffers.clear();
+		enabled.clear();
+	}
+
+	// texture bound to 'target' of 'unit' (GL_TEXTURE0 + i)
+	GLuint texture(GLuint unit, GLenum target) const
+	{
+		const Binding* binding = find(textures, target, unit);
+		return binding ? binding->id : 0;
+	}
+
+	// buffer bound to 'target', the element array buffer of the bound VAO for GL_ELEMENT_ARRAY_BUFFER
+	GLuint buffer(GLenum target) const
+	{
+		const Binding* binding = find(buffers, target, target == GL_ELEMENT_ARRAY_BUFFER ? vertexArray : 0);
+		return binding ? binding->id : 0;
+	}
+
+	bool isEnabled(GLenum cap) const
+	{
+		for (size_t i = 0; i < enabled.size(); i++)
+		{
+			if (enabled[i] == cap)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	unsigned long long totalCalls() const
+	{
+		unsigned long long total = 0;
+		for (int i = 0; i < GL_DISPATCH_COUNT; i++)
+		{
+			total += calls[i];
+		}
+		return total;
+	}
+
+	// glUniform* and glProgramUniform* calls
+	unsigned long long uniformUploads() const
+	{
+		unsigned long long total = 0;
+		for (int i = 0; i < GL_DISPATCH_COUNT; i++)
+		{
+			const char* function = name(i);
+			bool upload = strncmp(function, "glUniform", 9) == 0 || strncmp(function, "glProgramUniform", 16) == 0;
+			if (upload && !strstr(function, "Block") && !strstr(function, "Subroutines"))
+			{
+				total += calls[i];
+			}
+		}
+		return total;
+	}
+
+	static const char* name(int function)
+	{
+		static const char* names[GL_DISPATCH_COUNT] = {
+#define GL_DISPATCH_NAME(name) "gl" #name,
+			GL_DISPATCH_FUNCTIONS(GL_DISPATCH_NAME)
+#undef GL_DISPATCH_NAME
+		};
+		return names[function];
+	}
+
+private:
+	GLDispatchMock()
+	{
+		resetCounters();
+		resetBindings();
+	}
+
+	/* One stub per function, the signature comes from the glad pointer type */
+	template <int INDEX, class F>
+	struct Stub;
+
+	template <int INDEX, class R, class... Args>
+	struct Stub<INDEX, R (APIENTRYP)(Args...)>
+	{
+		static R APIENTRY call(Args...)
+		{
+			instance().calls[INDEX]++;
+			return R();
+		}
+	};
+
+	static const Binding* find(const std::vector<Binding>& bindings, GLenum target, GLuint unit)
+	{
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			if (bindings[i].target == target && bindings[i].unit == unit)
+			{
+				return &bindings[i];
+			}
+		}
+		return NULL;
+	}
+
+	static void bind(std::vector<Binding>& bindings, GLenum target, GLuint unit, GLuint id)
+	{
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			if (bindings[i].target == target && bindings[i].unit == unit)
+			{
+				bindings[i].id = id;
+				return;
+			}
+		}
+		Binding binding = { target, unit, id };
+		bindings.push_back(binding);
+	}
+
+	/* The emulated functions */
+	static GLuint APIENTRY mockCreateShader(GLenum)
+	{
+		instance().calls[GL_DISPATCH_CreateShader]++;
+		return 1;
+	}
+	static GLuint APIENTRY mockCreateProgram()
+	{
+		instance().calls[GL_DISPATCH_CreateProgram]++;
+		return 1;
+	}
+	static void APIENTRY mockGetShaderiv(GLuint, GLenum, GLint* params)
+	{
+		instance().calls[GL_DISPATCH_GetShaderiv]++;
+		*params = GL_TRUE;
+	}
+	static void APIENTRY mockGetShaderInfoLog(GLuint, GLsizei, GLsizei* length, GLchar* log)
+	{
+		instance().calls[GL_DISPATCH_GetShaderInfoLog]++;
+		if (length) *length = 0;
+		if (log) log[0] = '\0';
+	}
+	static void APIENTRY mockGetProgramiv(GLuint, GLenum pname, GLint* params)
+	{
+		instance().calls[GL_DISPATCH_GetProgramiv]++;
+		*params = (pname == GL_ACTIVE_UNIFORMS) ? (GLint)instance().uniforms.size() : GL_TRUE;
+	}
+	static void APIENTRY mockGetProgramInfoLog(GLuint, GLsizei, GLsizei* length, GLchar* log)
+	{
+		instance().calls[GL_DISPATCH_GetProgramInfoLog]++;
+		if (length) *length = 0;
+		if (log) log[0] = '\0';
+	}
+	static void APIENTRY mockGetActiveUniform(GLuint, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* nameBuffer)
+	{
+		instance().calls[GL_DISPATCH_GetActiveUniform]++;
+		const std::string& uniformName = instance().uniforms[index];
+		GLsizei n = (GLsizei)uniformName.size() < bufSize - 1 ? (GLsizei)uniformName.size() : bufSize - 1;
+		memcpy(nameBuffer, uniformName.c_str(), n);
+		nameBuffer[n] = '\0';
+		if (length) *length = n;
+		*size = 1;
+		*type = GL_FLOAT_MAT4;
+	}
+	static GLint APIENTRY mockGetUniformLocation(GLuint, const GLchar* uniformName)
+	{
+		/* Linear search by name, a real driver does at least a string hash + compare */
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_GetUniformLocation]++;
+		for (size_t i = 0; i < mock.uniforms.size(); i++)
+		{
+			if (strcmp(mock.uniforms[i].c_str(), uniformName) == 0)
+			{
+				return (GLint)i;
+			}
+		}
+		return -1;
+	}
+
+	/* Bindings, deleted objects are unbound from the context */
+	static void APIENTRY mockUseProgram(GLuint id)
+	{
+		instance().calls[GL_DISPATCH_UseProgram]++;
+		instance().program = id;
+	}
+	static void APIENTRY mockBindVertexArray(GLuint id)
+	{
+		instance().calls[GL_DISPATCH_BindVertexArray]++;
+		instance().vertexArray = id;
+	}
+	static void APIENTRY mockActiveTexture(GLenum unit)
+	{
+		instance().calls[GL_DISPATCH_ActiveTexture]++;
+		instance().activeTexture = unit;
+	}
+	static void APIENTRY mockBindTexture(GLenum target, GLuint id)
+	{
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_BindTexture]++;
+		bind(mock.textures, target, mock.activeTexture, id);
+	}
+	static void APIENTRY mockBindBuffer(GLenum target, GLuint id)
+	{
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_BindBuffer]++;
+		bind(mock.buffers, target, target == GL_ELEMENT_ARRAY_BUFFER ? mock.vertexArray : 0, id);
+	}
+	static void APIENTRY mockEnable(GLenum cap)
+	{
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_Enable]++;
+		if (!mock.isEnabled(cap))
+		{
+			mock.enabled.push_back(cap);
+		}
+	}
+	static void APIENTRY mockDisable(GLenum cap)
+	{
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_Disable]++;
+		for (size_t i = 0; i < mock.enabled.size(); i++)
+		{
+			if (mock.enabled[i] == cap)
+			{
+				mock.enabled.erase(mock.enabled.begin() + i);
+				break;
+			}
+		}
+	}
+	static void APIENTRY mockDeleteTextures(GLsizei n, const GLuint* ids)
+	{
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_DeleteTextures]++;
+		for (GLsizei i = 0; i < n; i++)
+		{
+			unbind(mock.textures, ids[i], false);
+		}
+	}
+	static void APIENTRY mockDeleteBuffers(GLsizei n, const GLuint* ids)
+	{
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_DeleteBuffers]++;
+		for (GLsizei i = 0; i < n; i++)
+		{
+			unbind(mock.buffers, ids[i], true);
+		}
+	}
+	static void APIENTRY mockDeleteVertexArrays(GLsizei n, const GLuint* ids)
+	{
+		GLDispatchMock& mock = instance();
+		mock.calls[GL_DISPATCH_DeleteVertexArrays]++;
+		for (GLsizei i = 0; i < n; i++)
+		{
+			if (ids[i] != 0 && mock.vertexArray == ids[i])
+			{
+				mock.vertexArray = 0;
+			}
+		}
+	}
+
+	/* A deleted texture is unbound from every unit. A deleted buffer is
+	   unbound from the context and from the bound VAO only, the other VAOs
+	   keep referencing it. */
+	static void unbind(std::vector<Binding>& bindings, GLuint id, bool buffers)
+	{
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			bool attached = buffers && bindings[i].target == GL_ELEMENT_ARRAY_BUFFER && bindings[i].unit != instance().vertexArray;
+			if (id != 0 && bindings[i].id == id && !attached)
+			{
+				bindings[i].id = 0;
+			}
+		}
+	}
+};
+
+#endif
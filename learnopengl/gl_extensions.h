@@ -0,0 +1,192 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include <cstring>
+
+/* The glad loader in this project is generated for OpenGL 3.3 core only. The
+   newer entry points we can use when the driver has them are loaded here, each
+   one guarded by a flag telling if it is available. */
+
+/* GL 4.4 / GL_ARB_buffer_storage */
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+/* GL 4.2 / GL_ARB_texture_storage */
+typedef void (APIENTRYP PFNGLTEXSTORAGE3DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+
+/* GL_EXT_texture_compression_s3tc */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/* GL 4.3 / GL_ARB_ES3_compatibility */
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
+/* GL 4.1 / GL_ARB_get_program_binary */
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+/* GL 4.3 / GL_ARB_compute_shader, GL_ARB_shader_storage_buffer_object */
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+
+/* GL 4.3 / GL_ARB_multi_draw_indirect (GL_DRAW_INDIRECT_BUFFER is GL 4.0) */
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+/* GL 4.6 / GL_ARB_indirect_parameters */
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)(GLenum mode, GLenum type, const void* indirect, GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+
+/* GL_KHR_parallel_shader_compile (or the ARB version) */
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+struct GLExtensions
+{
+	bool bufferStorage; // glBufferStorage, persistent mapping
+	PFNGLBUFFERSTORAGEPROC BufferStorage;
+	bool textureStorage; // glTexStorage3D, immutable texture storage
+	PFNGLTEXSTORAGE3DPROC TexStorage3D;
+	bool textureCompressionS3TC; // BC1 / BC3 textures
+	bool textureCompressionETC2; // ETC2 / EAC textures
+	bool programBinary; // glGetProgramBinary / glProgramBinary with at least one binary format
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary;
+	PFNGLPROGRAMBINARYPROC ProgramBinary;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri;
+	bool parallelShaderCompile; // GL_COMPLETION_STATUS_KHR can be polled
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads;
+	bool computeShader; // compute shaders writing shader storage buffers
+	PFNGLDISPATCHCOMPUTEPROC DispatchCompute;
+	PFNGLMEMORYBARRIERPROC MemoryBarrierGL; // MemoryBarrier is a macro of windows.h
+	bool multiDrawIndirect; // glMultiDrawElementsIndirect
+	PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect;
+	bool indirectParameters; // glMultiDrawElementsIndirectCount, the draw count read from a buffer
+	PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC MultiDrawElementsIndirectCount;
+
+	GLExtensions()
+	{
+		memset(this, 0, sizeof(*this));
+	}
+
+	// load the optional entry points (call once after gladLoadGLLoader)
+	void load(GLADloadproc loader)
+	{
+		memset(this, 0, sizeof(*this));
+		BufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+		bufferStorage = BufferStorage && (version(4, 4) || has("GL_ARB_buffer_storage"));
+		TexStorage3D = (PFNGLTEXSTORAGE3DPROC)loader("glTexStorage3D");
+		textureStorage = TexStorage3D && (version(4, 2) || has("GL_ARB_texture_storage"));
+		textureCompressionS3TC = has("GL_EXT_texture_compression_s3tc");
+		textureCompressionETC2 = version(4, 3) || has("GL_ARB_ES3_compatibility");
+
+		GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+		ProgramBinary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+		ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+		programBinary = GetProgramBinary && ProgramBinary && ProgramParameteri && (version(4, 1) || has("GL_ARB_get_program_binary"));
+		if (programBinary)
+		{
+			int formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			programBinary = formats > 0; // some drivers expose the entry points without any format
+		}
+
+		if (has("GL_KHR_parallel_shader_compile"))
+		{
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsKHR");
+		}
+		else if (has("GL_ARB_parallel_shader_compile"))
+		{
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsARB");
+		}
+		parallelShaderCompile = MaxShaderCompilerThreads != NULL;
+		if (parallelShaderCompile)
+		{
+			MaxShaderCompilerThreads(0xFFFFFFFFu); // let the driver use as many compiler threads as it wants
+		}
+
+		DispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)loader("glDispatchCompute");
+		MemoryBarrierGL = (PFNGLMEMORYBARRIERPROC)loader("glMemoryBarrier");
+		computeShader = DispatchCompute && MemoryBarrierGL
+			&& (version(4, 3) || (has("GL_ARB_compute_shader") && has("GL_ARB_shader_storage_buffer_object")));
+		MultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader("glMultiDrawElementsIndirect");
+		multiDrawIndirect = MultiDrawElementsIndirect && (version(4, 3) || has("GL_ARB_multi_draw_indirect"));
+		if (version(4, 6))
+		{
+			MultiDrawElementsIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)loader("glMultiDrawElementsIndirectCount");
+		}
+		else if (has("GL_ARB_indirect_parameters"))
+		{
+			MultiDrawElementsIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)loader("glMultiDrawElementsIndirectCountARB");
+		}
+		indirectParameters = multiDrawIndirect && MultiDrawElementsIndirectCount != NULL;
+	}
+
+	// is the context at least version major.minor
+	static bool version(int major, int minor)
+	{
+		return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+	}
+
+	// is the extension in the extension list of the context
+	static bool has(const char* name)
+	{
+		int count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (int i = 0; i < count; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension && strcmp(extension, name) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+// optional entry points of the current context
+inline GLExtensions& glExtensions()
+{
+	static GLExtensions extensions;
+	return extensions;
+}
+
+#endif
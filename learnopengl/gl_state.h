@@ -0,0 +1,310 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+/* Shadow copy of the OpenGL binding and enable state of the current context.
+   The calls below only reach the driver when they change something; every
+   filtered call is counted in savedCalls.
+
+   The cache is only right if all the changes of the tracked state go through
+   it. Code which binds directly (the setup code of the scene, other
+   libraries) must be followed by reset(), which forgets everything so the
+   next call of each kind goes to the driver again. */
+class GLStateCache
+{
+public:
+	static const int MAX_TEXTURE_UNITS = 32;
+	static const GLuint UNKNOWN = 0xFFFFFFFFu; // state the cache does not know
+
+	long long issuedCalls; // state calls passed to OpenGL since resetCounters()
+	long long savedCalls;  // redundant state calls filtered out since resetCounters()
+
+	GLStateCache() : issuedCalls(0), savedCalls(0)
+	{
+		reset();
+	}
+
+	// forget the tracked state (new context, or state changed behind the cache)
+	void reset()
+	{
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				textures[unit][target] = UNKNOWN;
+			}
+		}
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		{
+			buffers[target] = UNKNOWN;
+		}
+		for (int cap = 0; cap < CAPABILITY_COUNT; cap++)
+		{
+			enabled[cap] = -1;
+		}
+		clearColorKnown = false;
+	}
+
+	void resetCounters()
+	{
+		issuedCalls = 0;
+		savedCalls = 0;
+	}
+
+	void useProgram(GLuint id)
+	{
+		if (changed(program, id))
+		{
+			glUseProgram(id);
+		}
+	}
+
+	void bindVertexArray(GLuint id)
+	{
+		if (changed(vertexArray, id))
+		{
+			glBindVertexArray(id);
+			buffers[bufferIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN; // part of the VAO state
+		}
+	}
+
+	// unit is GL_TEXTURE0 + i, like glActiveTexture
+	void activeTexture(GLenum unit)
+	{
+		if (changed(activeUnit, unit))
+		{
+			glActiveTexture(unit);
+		}
+	}
+
+	// bind on the active texture unit
+	void bindTexture(GLenum target, GLuint id)
+	{
+		int t = textureIndex(target);
+		unsigned int unit = activeUnit - GL_TEXTURE0;
+		if (t < 0 || activeUnit == UNKNOWN || unit >= (unsigned int)MAX_TEXTURE_UNITS)
+		{
+			issuedCalls++; // not tracked
+			glBindTexture(target, id);
+			return;
+		}
+		if (changed(textures[unit][t], id))
+		{
+			glBindTexture(target, id);
+		}
+	}
+
+	// glActiveTexture(GL_TEXTURE0 + unit) + glBindTexture, skipping the unit switch when the texture is already there
+	void bindTextureUnit(unsigned int unit, GLenum target, GLuint id)
+	{
+		int t = textureIndex(target);
+		if (t >= 0 && unit < (unsigned int)MAX_TEXTURE_UNITS && textures[unit][t] == id)
+		{
+			savedCalls += 2;
+			return;
+		}
+		activeTexture(GL_TEXTURE0 + unit);
+		bindTexture(target, id);
+	}
+
+	void bindBuffer(GLenum target, GLuint id)
+	{
+		int b = bufferIndex(target);
+		if (b < 0)
+		{
+			issuedCalls++; // not tracked
+			glBindBuffer(target, id);
+			return;
+		}
+		if (changed(buffers[b], id))
+		{
+			glBindBuffer(target, id);
+		}
+	}
+
+	void enable(GLenum cap) { setEnabled(cap, true); }
+	void disable(GLenum cap) { setEnabled(cap, false); }
+
+	void setEnabled(GLenum cap, bool value)
+	{
+		int c = capabilityIndex(cap);
+		if (c >= 0 && enabled[c] == (value ? 1 : 0))
+		{
+			savedCalls++;
+			return;
+		}
+		if (c >= 0)
+		{
+			enabled[c] = value ? 1 : 0;
+		}
+		issuedCalls++;
+		if (value)
+		{
+			glEnable(cap);
+		}
+		else
+		{
+			glDisable(cap);
+		}
+	}
+
+	void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+	{
+		if (clearColorKnown && clearColorValue[0] == r && clearColorValue[1] == g && clearColorValue[2] == b && clearColorValue[3] == a)
+		{
+			savedCalls++;
+			return;
+		}
+		clearColorKnown = true;
+		clearColorValue[0] = r; clearColorValue[1] = g; clearColorValue[2] = b; clearColorValue[3] = a;
+		issuedCalls++;
+		glClearColor(r, g, b, a);
+	}
+
+	/* Call after deleting objects: their names may be reused by new objects,
+	   which must not be mistaken for the ones still recorded as bound */
+	void programDeleted(GLuint id)
+	{
+		if (program == id)
+		{
+			program = UNKNOWN;
+		}
+	}
+	void vertexArrayDeleted(GLuint id)
+	{
+		if (vertexArray == id)
+		{
+			vertexArray = UNKNOWN;
+		}
+	}
+	void textureDeleted(GLuint id)
+	{
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				if (textures[unit][target] == id)
+				{
+					textures[unit][target] = UNKNOWN;
+				}
+			}
+		}
+	}
+	void bufferDeleted(GLuint id)
+	{
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		{
+			if (buffers[target] == id)
+			{
+				buffers[target] = UNKNOWN;
+			}
+		}
+	}
+
+	/* The tracked state, UNKNOWN where the next call goes to the driver
+	   (for the checks against the mock dispatch table) */
+	GLuint currentProgram() const { return program; }
+	GLuint currentVertexArray() const { return vertexArray; }
+	GLuint currentActiveTexture() const { return activeUnit; }
+	GLuint currentTexture(unsigned int unit, GLenum target) const
+	{
+		int t = textureIndex(target);
+		return t >= 0 && unit < (unsigned int)MAX_TEXTURE_UNITS ? textures[unit][t] : UNKNOWN;
+	}
+	GLuint currentBuffer(GLenum target) const
+	{
+		int b = bufferIndex(target);
+		return b >= 0 ? buffers[b] : UNKNOWN;
+	}
+	// -1 unknown, 0 disabled, 1 enabled
+	int currentEnabled(GLenum cap) const
+	{
+		int c = capabilityIndex(cap);
+		return c >= 0 ? enabled[c] : -1;
+	}
+
+private:
+	static const int TEXTURE_TARGET_COUNT = 5;
+	static const int BUFFER_TARGET_COUNT = 8;
+	static const int CAPABILITY_COUNT = 8;
+
+	GLuint program;
+	GLuint vertexArray;
+	GLuint activeUnit; // GL_TEXTURE0 + i
+	GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	GLuint buffers[BUFFER_TARGET_COUNT];
+	int enabled[CAPABILITY_COUNT]; // -1 unknown, 0 disabled, 1 enabled
+	bool clearColorKnown;
+	GLfloat clearColorValue[4];
+
+	// update a tracked value, true if the call must reach OpenGL
+	bool changed(GLuint& current, GLuint value)
+	{
+		if (current == value)
+		{
+			savedCalls++;
+			return false;
+		}
+		current = value;
+		issuedCalls++;
+		return true;
+	}
+
+	static int textureIndex(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_BUFFER: return 1;
+		case GL_TEXTURE_CUBE_MAP: return 2;
+		case GL_TEXTURE_2D_ARRAY: return 3;
+		case GL_TEXTURE_3D: return 4;
+		default: return -1;
+		}
+	}
+
+	static int bufferIndex(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_ELEMENT_ARRAY_BUFFER: return 1;
+		case GL_PIXEL_UNPACK_BUFFER: return 2;
+		case GL_PIXEL_PACK_BUFFER: return 3;
+		case GL_UNIFORM_BUFFER: return 4;
+		case GL_TEXTURE_BUFFER: return 5;
+		case GL_COPY_READ_BUFFER: return 6;
+		case GL_COPY_WRITE_BUFFER: return 7;
+		default: return -1;
+		}
+	}
+
+	static int capabilityIndex(GLenum cap)
+	{
+		switch (cap)
+		{
+		case GL_DEPTH_TEST: return 0;
+		case GL_BLEND: return 1;
+		case GL_CULL_FACE: return 2;
+		case GL_SCISSOR_TEST: return 3;
+		case GL_STENCIL_TEST: return 4;
+		case GL_POLYGON_OFFSET_FILL: return 5;
+		case GL_MULTISAMPLE: return 6;
+		case GL_FRAMEBUFFER_SRGB: return 7;
+		default: return -1;
+		}
+	}
+};
+
+// state cache of the current context
+inline GLStateCache& glState()
+{
+	static GLStateCache state;
+	return state;
+}
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "frustum_culling.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+
+#include <iostream>
+#include <vector>
+
+/* One record of glMultiDrawElementsIndirect, laid out as GL 4.3 reads it */
+struct DrawElementsIndirectCommand
+{
+	GLuint count;		  // indices per instance
+	GLuint instanceCount; // 0 skips the record
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance; // first instance, offsets the attributes with a divisor
+};
+
+/* Frustum culling on the GPU, one invocation per object. The visible objects
+   get a draw command with baseInstance set to their index, so the instanced
+   vertex shader reads their model matrix (attributes with divisor 1) without
+   any change. With indirect parameters the commands are packed with an atomic
+   counter, which is also the draw count; without them every object keeps its
+   own record and the culled ones draw 0 instances. */
+const char* const GPU_CULLING_CS =
+	"#version 430 core\n"
+	"layout (local_size_x = 64) in;\n"
+	"struct Command\n"
+	"{\n"
+	"	uint count;\n"
+	"	uint instanceCount;\n"
+	"	uint firstIndex;\n"
+	"	int baseVertex;\n"
+	"	uint baseInstance;\n"
+	"};\n"
+	"layout (std430, binding = 0) readonly buffer Spheres { vec4 spheres[]; }; // center, radius\n"
+	"layout (std430, binding = 1) writeonly buffer Commands { Command commands[]; };\n"
+	"layout (std430, binding = 2) buffer Visible { uint visibleCount; };\n"
+	"uniform vec4 planes[6];\n"
+	"uniform uint objectCount;\n"
+	"uniform uint indexCount;\n"
+	"uniform uint firstIndex;\n"
+	"uniform bool compact;\n"
+	"void main()\n"
+	"{\n"
+	"	uint i = gl_GlobalInvocationID.x;\n"
+	"	if (i >= objectCount)\n"
+	"		return;\n"
+	"	vec4 sphere = spheres[i];\n"
+	"	bool visible = true;\n"
+	"	for (int p = 0; p < 6; p++)\n"
+	"		visible = visible && dot(planes[p].xyz, sphere.xyz) + planes[p].w + sphere.w >= 0.0;\n"
+	"	uint slot = visible ? atomicAdd(visibleCount, 1u) : 0u;\n"
+	"	if (compact)\n"
+	"	{\n"
+	"		if (visible)\n"
+	"			commands[slot] = Command(indexCount, 1u, firstIndex, 0, i);\n"
+	"	}\n"
+	"	else\n"
+	"		commands[i] = Command(indexCount, visible ? 1u : 0u, firstIndex, 0, i);\n"
+	"}\n";
+
+/* GPU-driven culling and submission: the bounding spheres live in a shader
+   storage buffer, cull() runs the compute shader above into the command
+   buffer and draw() submits all the objects with one multi-draw indirect
+   call, without any per-object work on the CPU. Needs GL 4.3 (compute
+   shaders, multi-draw indirect); GL 4.6 or GL_ARB_indirect_parameters packs
+   the commands. */
+class GpuCuller
+{
+public:
+	GLuint program;
+	GLuint sphereBuffer;  // vec4 per object
+	GLuint commandBuffer; // DrawElementsIndirectCommand per object
+	GLuint countBuffer;	  // visible objects of the last cull, the draw count of the packed commands
+	int capacity;
+	bool compact; // the commands are packed, drawn with glMultiDrawElementsIndirectCount
+
+	GpuCuller() : program(0), sphereBuffer(0), commandBuffer(0), countBuffer(0), capacity(0), compact(false), objectCount(0),
+		planesLocation(-1), objectCountLocation(-1), indexCountLocation(-1), firstIndexLocation(-1), compactLocation(-1)
+	{
+	}
+
+	~GpuCuller()
+	{
+		if (program)
+		{
+			glDeleteProgram(program);
+			glState().programDeleted(program);
+		}
+		GLuint buffers[3] = { sphereBuffer, commandBuffer, countBuffer };
+		for (int b = 0; b < 3; b++)
+		{
+			if (buffers[b])
+			{
+				glDeleteBuffers(1, &buffers[b]);
+				glState().bufferDeleted(buffers[b]);
+			}
+		}
+	}
+
+	// does the current context have what the GPU path needs
+	static bool supported()
+	{
+		return glExtensions().computeShader && glExtensions().multiDrawIndirect;
+	}
+
+	// compile the compute shader and allocate the buffers for 'maxObjects'
+	bool create(int maxObjects)
+	{
+		if (!supported())
+		{
+			std::cout << "ERROR::GPU_CULLING::NEEDS_GL_4_3" << std::endl;
+			return false;
+		}
+		capacity = maxObjects;
+		compact = glExtensions().indirectParameters;
+
+		GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(shader, 1, &GPU_CULLING_CS, NULL);
+		glCompileShader(shader);
+		program = glCreateProgram();
+		glAttachShader(program, shader);
+		glDeleteShader(shader); // deleted with the program
+		glLinkProgram(program);
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[1024];
+			glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR::GPU_CULLING::PROGRAM_LINKING_FAILED\n" << infoLog << std::endl;
+			return false;
+		}
+		planesLocation = glGetUniformLocation(program, "planes");
+		objectCountLocation = glGetUniformLocation(program, "objectCount");
+		indexCountLocation = glGetUniformLocation(program, "indexCount");
+		firstIndexLocation = glGetUniformLocation(program, "firstIndex");
+		compactLocation = glGetUniformLocation(program, "compact");
+
+		GLuint buffers[3];
+		glGenBuffers(3, buffers);
+		sphereBuffer = buffers[0];
+		commandBuffer = buffers[1];
+		countBuffer = buffers[2];
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, sphereBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)capacity * sizeof(glm::vec4), NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)capacity * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		return true;
+	}
+
+	// upload the bounding spheres of the first 'count' objects of 'bounds'
+	void setBounds(const BoundsBatch& bounds, int count)
+	{
+		std::vector<glm::vec4> spheres(count);
+		for (int i = 0; i < count; i++)
+		{
+			spheres[i] = glm::vec4(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.radius[i]);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, sphereBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)count * sizeof(glm::vec4), spheres.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	/* Write the draw commands of the first 'count' objects visible in
+	   'frustum' (NULL: all of them), each drawing 'indexCount' indices from
+	   'firstIndex'. Leaves the compute program bound. */
+	void cull(const Frustum* frustum, int count, GLuint indexCount, GLuint firstIndex)
+	{
+		objectCount = count;
+		GLuint zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		glm::vec4 planes[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planes[p] = frustum ? frustum->planes[p] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // always inside
+		}
+		glState().useProgram(program);
+		glUniform4fv(planesLocation, 6, glm::value_ptr(planes[0]));
+		glUniform1ui(objectCountLocation, (GLuint)count);
+		glUniform1ui(indexCountLocation, indexCount);
+		glUniform1ui(firstIndexLocation, firstIndex);
+		glUniform1i(compactLocation, compact ? 1 : 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sphereBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, countBuffer);
+		glExtensions().DispatchCompute((GLuint)(count + 63) / 64, 1, 1);
+		// the draws read the commands and the count written above
+		glExtensions().MemoryBarrierGL(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	// draw the commands of the last cull() with the bound program and VAO, one call
+	void draw()
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		if (compact)
+		{
+			glBindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+			glExtensions().MultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, objectCount, 0);
+			glBindBuffer(GL_PARAMETER_BUFFER, 0);
+		}
+		else
+		{
+			glExtensions().MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, objectCount, 0);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	// visible objects of the last cull(), waits for the GPU
+	int visibleCount() const
+	{
+		GLuint count = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		return (int)count;
+	}
+
+private:
+	int objectCount; // of the last cull()
+	GLint planesLocation, objectCountLocation, indexCountLocation, firstIndexLocation, compactLocation;
+};
+
+#endif
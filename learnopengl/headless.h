@@ -0,0 +1,230 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+
+/* On Linux the headless context is created through EGL with the Mesa
+   surfaceless platform, so it works without any X11/Wayland display
+   (e.g. llvmpipe on CI and render-farm machines). Everywhere else we fall back
+   to an invisible GLFW window, which still gives us a context without showing
+   anything on screen. */
+#if defined(__linux__) && !defined(LEARN_HEADLESS_USE_GLFW)
+#define LEARN_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef LEARN_HEADLESS_EGL
+inline void* headlessGetProcAddress(const char* name)
+{
+	return (void*)eglGetProcAddress(name);
+}
+#endif
+
+/* OpenGL context which is not attached to any visible window */
+class HeadlessContext
+{
+public:
+	HeadlessContext()
+	{
+#ifdef LEARN_HEADLESS_EGL
+		display = EGL_NO_DISPLAY;
+		context = EGL_NO_CONTEXT;
+#else
+		window = NULL;
+#endif
+	}
+
+	~HeadlessContext()
+	{
+		destroy();
+	}
+
+	// create the context and make it current on the calling thread
+	bool create(int major, int minor)
+	{
+#ifdef LEARN_HEADLESS_EGL
+		/* Prefer the surfaceless platform, it does not need a display server */
+		PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (eglGetPlatformDisplayEXT)
+		{
+			display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		}
+		if (display == EGL_NO_DISPLAY)
+		{
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+
+		EGLint eglMajor, eglMinor;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor))
+		{
+			std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+			return false;
+		}
+		if (!eglBindAPI(EGL_OPENGL_API))
+		{
+			std::cout << "ERROR::HEADLESS::EGL_OPENGL_API_NOT_SUPPORTED" << std::endl;
+			return false;
+		}
+
+		/* We never render to an EGL surface (everything goes into an FBO), so a
+		   config is only needed by drivers without EGL_KHR_no_config_context */
+		EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config = (EGLConfig)0;
+		EGLint numConfigs = 0;
+		eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+
+		EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, major,
+			EGL_CONTEXT_MINOR_VERSION, minor,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, numConfigs > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttribs);
+		if (context == EGL_NO_CONTEXT)
+		{
+			std::cout << "ERROR::HEADLESS::EGL_CREATE_CONTEXT_FAILED" << std::endl;
+			return false;
+		}
+		if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		{
+			std::cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT_FAILED" << std::endl;
+			return false;
+		}
+		return true;
+#else
+		if (!glfwInit())
+		{
+			std::cout << "ERROR::HEADLESS::GLFW_INIT_FAILED" << std::endl;
+			return false;
+		}
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // never show the window
+		window = glfwCreateWindow(1, 1, "LearnOpenGL (headless)", NULL, NULL);
+		if (window == NULL)
+		{
+			std::cout << "ERROR::HEADLESS::GLFW_CREATE_WINDOW_FAILED" << std::endl;
+			return false;
+		}
+		glfwMakeContextCurrent(window);
+		return true;
+#endif
+	}
+
+	// function used by GLAD to load the OpenGL entry points
+	GLADloadproc getProcLoader() const
+	{
+#ifdef LEARN_HEADLESS_EGL
+		return (GLADloadproc)headlessGetProcAddress;
+#else
+		return (GLADloadproc)glfwGetProcAddress;
+#endif
+	}
+
+	void destroy()
+	{
+#ifdef LEARN_HEADLESS_EGL
+		if (display != EGL_NO_DISPLAY)
+		{
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (context != EGL_NO_CONTEXT)
+			{
+				eglDestroyContext(display, context);
+			}
+			eglTerminate(display);
+		}
+		display = EGL_NO_DISPLAY;
+		context = EGL_NO_CONTEXT;
+#else
+		if (window != NULL)
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+		window = NULL;
+#endif
+	}
+
+private:
+#ifdef LEARN_HEADLESS_EGL
+	EGLDisplay display;
+	EGLContext context;
+#else
+	GLFWwindow* window;
+#endif
+};
+
+/* Framebuffer object with a color and a depth attachment. Used as the render
+   target when there is no default framebuffer (headless mode). */
+class OffscreenTarget
+{
+public:
+	unsigned int FBO;
+	int width;
+	int height;
+
+	OffscreenTarget() : FBO(0), width(0), height(0), colorRBO(0), depthRBO(0)
+	{
+	}
+
+	~OffscreenTarget()
+	{
+		if (FBO)
+		{
+			glDeleteFramebuffers(1, &FBO);
+			glDeleteRenderbuffers(1, &colorRBO);
+			glDeleteRenderbuffers(1, &depthRBO);
+		}
+	}
+
+	bool create(int w, int h)
+	{
+		width = w;
+		height = h;
+
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+		/* Color attachment */
+		glGenRenderbuffers(1, &colorRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+
+		/* Depth attachment, needed for the depth test of the cube scene */
+		glGenRenderbuffers(1, &depthRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::HEADLESS::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// render into this target instead of the default framebuffer
+	void bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, width, height);
+	}
+
+private:
+	unsigned int colorRBO;
+	unsigned int depthRBO;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+
+#include "gl_extensions.h"
+#include "gl_state.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/* How the cubes of the scene are submitted */
+enum DrawMode
+{
+	DRAW_PER_OBJECT,	// one glUniformMatrix4fv + glDrawElements per cube
+	DRAW_INSTANCED,		// model matrices in an instance VBO, one glDrawElementsInstanced
+	DRAW_INSTANCED_TBO,	// model matrices in a texture buffer, one glDrawElementsInstanced
+	DRAW_INDIRECT		// model matrices in an instance VBO, culled by a compute shader, one glMultiDrawElementsIndirect
+};
+
+inline const char* drawModeName(DrawMode mode)
+{
+	switch (mode)
+	{
+	case DRAW_INSTANCED: return "instanced";
+	case DRAW_INSTANCED_TBO: return "tbo";
+	case DRAW_INDIRECT: return "indirect";
+	default: return "per-object";
+	}
+}
+
+inline bool parseDrawMode(const char* name, DrawMode& mode)
+{
+	const DrawMode modes[] = { DRAW_PER_OBJECT, DRAW_INSTANCED, DRAW_INSTANCED_TBO, DRAW_INDIRECT };
+	for (int i = 0; i < 4; i++)
+	{
+		if (strcmp(name, drawModeName(modes[i])) == 0)
+		{
+			mode = modes[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Vertex shader which reads the model matrix of the instance for each draw mode */
+inline const char* drawModeVertexShader(DrawMode mode)
+{
+	switch (mode)
+	{
+	case DRAW_INSTANCED: return "shader_instanced.vs";
+	case DRAW_INDIRECT: return "shader_instanced.vs"; // baseInstance offsets the matrix attributes
+	case DRAW_INSTANCED_TBO: return "shader_instanced_tbo.vs";
+	default: return "shader.vs";
+	}
+}
+
+/* Fill 'positions' with 'count' world positions: the hand placed ones first,
+   the rest spread deterministically in a box in front of the camera */
+inline void generateInstancePositions(const glm::vec3* placed, int placedCount, int count, std::vector<glm::vec3>& positions)
+{
+	positions.resize(count);
+	unsigned int seed = 12345u;
+	for (int i = 0; i < count; i++)
+	{
+		if (i < placedCount)
+		{
+			positions[i] = placed[i];
+			continue;
+		}
+		float r[3];
+		for (int k = 0; k < 3; k++)
+		{
+			seed = seed * 1664525u + 1013904223u; // LCG, same scene on every run
+			r[k] = (float)(seed >> 8) / 16777216.0f;
+		}
+		positions[i] = glm::vec3(-20.0f + 40.0f * r[0], -15.0f + 30.0f * r[1], -2.0f - 58.0f * r[2]);
+	}
+}
+
+/* Buffer holding one mat4 model matrix per instance. It is either read as 4
+   vec4 vertex attributes with divisor 1 (shader_instanced.vs) or through a
+   texture buffer object (shader_instanced_tbo.vs).
+
+   The matrices are written straight into mapped buffer memory between
+   beginWrite() and endWrite(). When glBufferStorage is available (and the
+   buffer is not a texture buffer) the buffer is mapped once, persistently, and
+   split in REGION_COUNT regions used round robin, with a fence per region so
+   we never overwrite matrices the GPU is still reading. */
+class InstanceBuffer
+{
+public:
+	unsigned int VBO;
+	unsigned int texture; // texture buffer view of the VBO (0 if not used)
+	int capacity;		  // max number of instances
+	bool persistent;	  // mapped once with GL_MAP_PERSISTENT_BIT
+
+	InstanceBuffer() : VBO(0), texture(0), capacity(0), persistent(false), mapped(NULL), region(0), attribLocation(-1)
+	{
+		for (int i = 0; i < REGION_COUNT; i++)
+		{
+			fences[i] = 0;
+		}
+	}
+
+	~InstanceBuffer()
+	{
+		for (int i = 0; i < REGION_COUNT; i++)
+		{
+			if (fences[i])
+			{
+				glDeleteSync(fences[i]);
+			}
+		}
+		if (texture)
+		{
+			glDeleteTextures(1, &texture);
+			glState().textureDeleted(texture);
+		}
+		if (VBO)
+		{
+			if (mapped)
+			{
+				glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+			glDeleteBuffers(1, &VBO);
+			glState().bufferDeleted(VBO);
+		}
+	}
+
+	bool create(int maxInstances, bool asTexture)
+	{
+		capacity = maxInstances;
+		glGenBuffers(1, &VBO);
+		glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+
+		persistent = !asTexture && glExtensions().bufferStorage;
+		if (persistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			GLsizeiptr size = (GLsizeiptr)REGION_COUNT * regionSize();
+			glExtensions().BufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+			mapped = (glm::mat4*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+			if (!mapped)
+			{
+				std::cout << "ERROR::INSTANCING::PERSISTENT_MAP_FAILED" << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			glBufferData(GL_ARRAY_BUFFER, regionSize(), NULL, GL_STREAM_DRAW);
+		}
+
+		if (asTexture)
+		{
+			/* Every matrix is 4 RGBA32F texels */
+			int maxTexels = 0;
+			glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+			if ((long long)capacity * 4 > (long long)maxTexels)
+			{
+				std::cout << "ERROR::INSTANCING::TOO_MANY_INSTANCES_FOR_TEXTURE_BUFFER\n" << capacity << " > " << maxTexels / 4 << std::endl;
+				return false;
+			}
+			glGenTextures(1, &texture);
+			glState().bindTexture(GL_TEXTURE_BUFFER, texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, VBO);
+		}
+		return true;
+	}
+
+	// set up the mat4 attribute at 'location' .. 'location'+3 in the bound VAO
+	void attach(unsigned int location)
+	{
+		attribLocation = (int)location;
+		glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glVertexAttribPointer(location + column,
+				4, GL_FLOAT, GL_FALSE,
+				sizeof(glm::mat4), /* STRIDE: one matrix per instance */
+				(void*)(regionOffset() + column * sizeof(glm::vec4)) /* OFFSET of the column */
+			);
+			glEnableVertexAttribArray(location + column);
+			glVertexAttribDivisor(location + column, 1); // advance once per instance, not per vertex
+		}
+	}
+
+	// memory for 'capacity' model matrices, valid until endWrite()
+	glm::mat4* beginWrite()
+	{
+		if (persistent)
+		{
+			/* Move to the next region and wait until the GPU is done with it */
+			region = (region + 1) % REGION_COUNT;
+			if (fences[region])
+			{
+				while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				{
+				}
+				glDeleteSync(fences[region]);
+				fences[region] = 0;
+			}
+			return mapped + (size_t)region * capacity;
+		}
+
+		/* Invalidate the old content so we do not wait for draws still reading it */
+		glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+		return (glm::mat4*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	}
+
+	// the matrices are written, make them visible to the next draw (VAO must be bound)
+	void endWrite()
+	{
+		if (persistent)
+		{
+			if (attribLocation >= 0)
+			{
+				attach((unsigned int)attribLocation); // point the attributes to the current region
+			}
+			return;
+		}
+		glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+
+	// call after the draw reading the current region
+	void fence()
+	{
+		if (persistent)
+		{
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	// bind the texture buffer view to a texture unit (DRAW_INSTANCED_TBO)
+	void bindTexture(unsigned int unit) const
+	{
+		glState().bindTextureUnit(unit, GL_TEXTURE_BUFFER, texture);
+	}
+
+private:
+	static const int REGION_COUNT = 3; // frames the CPU may be ahead of the GPU
+	glm::mat4* mapped;
+	int region;
+	int attribLocation;
+	GLsync fences[REGION_COUNT];
+
+	GLsizeiptr regionSize() const
+	{
+		return (GLsizeiptr)capacity * sizeof(glm::mat4);
+	}
+
+	size_t regionOffset() const
+	{
+		return persistent ? (size_t)region * regionSize() : 0;
+	}
+};
+
+#endif
@@ -1,4 +1,12 @@
+/* Use the SSE/NEON code paths of glm (glm/simd), needed by TransformBatch */
+#define GLM_FORCE_INTRINSICS
+
 #include <iostream>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
@@ -7,12 +15,268 @@
 #include "glm/gtc/type_ptr.hpp"
 
 #include "shader.h"
+#include "headless.h"
+#include "benchmark.h"
+#include "bench_uniforms.h"
+#include "instancing.h"
+#include "transforms.h"
+#include "frustum_culling.h"
+#include "bvh.h"
+#include "occlusion_culler.h"
+#include "gpu_culling.h"
+#include "meshlets.h"
+#include "bench_transforms.h"
+#include "bench_shaders.h"
+#include "bench_state.h"
+#include "bench_queue.h"
+#include "bench_mesh.h"
+#include "bench_vertex_formats.h"
+#include "bench_models.h"
+#include "bench_lod.h"
+#include "bench_culling.h"
+#include "bench_occlusion.h"
+#include "bench_meshlets.h"
+#include "bench_bvh.h"
+#include "bench_remap.h"
+#include "bench_bowl.h"
+#include "bench_upload.h"
+#include "bench_replay.h"
+#include "bench_sync.h"
+#include "bowl_mesh.h"
+#include "synthetic_cameras.h"
+#include "camera_frames.h"
+#include "frame_upload.h"
+#include "drive_recording.h"
+#include "frame_sync.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "mesh_optimizer.h"
+#include "mesh_lod.h"
+#include "vertex_format.h"
+#include "vertex_layout.h"
+#include "model_loader.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+#include "file_watcher.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 //#define LEARN_GLM
 
+/* Options given on the command line */
+struct AppOptions
+{
+	bool headless;		// render into an FBO without a window
+	int frames;			// number of frames to render in headless mode
+	int warmup;			// frames rendered before profiling starts
+	float timestep;		// fixed time step (seconds) used in headless mode
+	int width;
+	int height;
+	const char* jsonPath; // write the frame timings as JSON ("-" means stdout)
+	const char* bench;	// run a micro-benchmark instead of the scene
+	int iterations;		// iterations of the micro-benchmark (0 = its default)
+	DrawMode drawMode;	// how the cubes are submitted
+	int instances;		// number of cubes in the scene
+	bool cull;			// draw only the cubes in the view frustum
+	bool bvh;			// cull through a BVH of the cubes instead of testing each of them
+	int occluders;		// nearest cubes rasterized for the software occlusion culling (0: off)
+	VertexFormatPreset vertexFormat; // how the cube vertices are stored
+	const char* modelPath;			 // OBJ or GLB model drawn instead of the cube (NULL: the cube)
+	float lodThreshold;				 // screen-space error in pixels of the LOD selection (0: always the full mesh)
+	bool meshlets;					 // per-object draws submit only the clusters facing the camera in the frustum
+	const char* textureCache;		 // texture cache directory (NULL: decode the images on every run)
+	TextureEncoding textureEncoding; // encoding of new texture cache entries
+	const char* shaderCache;		 // program binary cache directory (NULL: compile on every run)
+	bool hotReload;		// watch the shader sources in headless mode too (always on with a window)
+	std::vector<const char*> convertFiles; // images to write to the texture cache instead of running the scene
+	bool surround;		// render the surround-view bowl of the synthetic camera rig instead of the cubes
+	CameraPixelFormat cameraFormat; // pixel format the cameras of --surround deliver
+	const char* recordPath;	// write a recording of the synthetic rig instead of running the scene
+	float recordSeconds;
+	const char* replayPath;	// --surround shows this recording instead of the synthetic cameras
+	ReplayMode replayMode;
+	bool cameraThreads;	// the synthetic cameras of --surround deliver on their own threads, matched by FrameSynchronizer
+};
+
+/* Default texture cache directory of --convert */
+const char* const DEFAULT_TEXTURE_CACHE = "../resources/textures/cache";
+
+/* Frame statistics of one run of the scene, filled for the benchmarks */
+struct SceneResult
+{
+	SampleStats cpu;
+	SampleStats gpu;
+	double framesPerSecond;
+	double drawCalls; // per frame
+};
+
+/* Function to parse the command line, returns false on unknown arguments */
+bool parseOptions(int argc, char* argv[], AppOptions& options)
+{
+	options.headless = false;
+	options.frames = 600;
+	options.warmup = 5;
+	options.timestep = 1.0f / 60.0f;
+	options.width = 800;
+	options.height = 600;
+	options.jsonPath = NULL;
+	options.bench = NULL;
+	options.iterations = 0;
+	options.drawMode = DRAW_PER_OBJECT;
+	options.instances = 10;
+	options.cull = true;
+	options.bvh = false;
+	options.occluders = 0;
+	options.vertexFormat = VERTEX_FORMAT_FLOAT;
+	options.modelPath = NULL;
+	options.lodThreshold = 0.0f;
+	options.meshlets = false;
+	options.textureCache = NULL;
+	options.textureEncoding = ENCODE_RAW;
+	options.shaderCache = NULL;
+	options.hotReload = false;
+	options.surround = false;
+	options.cameraFormat = PIXEL_NV12;
+	options.recordPath = NULL;
+	options.recordSeconds = 0.0f;
+	options.replayPath = NULL;
+	options.replayMode = REPLAY_REALTIME;
+	options.cameraThreads = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1 < argc);
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			options.headless = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+		{
+			options.frames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+		{
+			options.warmup = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--timestep") == 0 && hasValue)
+		{
+			options.timestep = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+		{
+			options.width = atoi(argv[++i]);
+			options.height = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--json") == 0 && hasValue)
+		{
+			options.jsonPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bench") == 0 && hasValue)
+		{
+			options.bench = argv[++i];
+		}
+		else if (strcmp(argv[i], "--iterations") == 0 && hasValue)
+		{
+			options.iterations = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--draw-mode") == 0 && hasValue && parseDrawMode(argv[i + 1], options.drawMode))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--instances") == 0 && hasValue)
+		{
+			options.instances = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-cull") == 0)
+		{
+			options.cull = false;
+		}
+		else if (strcmp(argv[i], "--bvh") == 0)
+		{
+			options.bvh = true;
+		}
+		else if (strcmp(argv[i], "--meshlets") == 0)
+		{
+			options.meshlets = true;
+		}
+		else if (strcmp(argv[i], "--occlusion") == 0 && hasValue)
+		{
+			options.occluders = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--vertex-format") == 0 && hasValue && parseVertexFormat(argv[i + 1], options.vertexFormat))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--model") == 0 && hasValue)
+		{
+			options.modelPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--lod") == 0 && hasValue)
+		{
+			options.lodThreshold = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--texture-cache") == 0 && hasValue)
+		{
+			options.textureCache = argv[++i];
+		}
+		else if (strcmp(argv[i], "--texture-format") == 0 && hasValue && parseTextureEncoding(argv[i + 1], options.textureEncoding))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--shader-cache") == 0 && hasValue)
+		{
+			options.shaderCache = argv[++i];
+		}
+		else if (strcmp(argv[i], "--hot-reload") == 0)
+		{
+			options.hotReload = true;
+		}
+		else if (strcmp(argv[i], "--convert") == 0 && hasValue)
+		{
+			options.convertFiles.push_back(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--surround") == 0)
+		{
+			options.surround = true;
+		}
+		else if (strcmp(argv[i], "--camera-format") == 0 && hasValue && parseCameraPixelFormat(argv[i + 1], options.cameraFormat))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--record") == 0 && i + 2 < argc)
+		{
+			options.recordPath = argv[++i];
+			options.recordSeconds = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && hasValue)
+		{
+			options.replayPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay-mode") == 0 && hasValue && parseReplayMode(argv[i + 1], options.replayMode))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--camera-threads") == 0)
+		{
+			options.cameraThreads = true;
+		}
+		else
+		{
+			std::cout << "Usage: learnopengl [--headless] [--frames N] [--warmup N] [--timestep SECONDS] [--size W H] [--json FILE|-]\n"
+				"                   [--draw-mode per-object|instanced|tbo|indirect] [--instances N] [--no-cull] [--bvh] [--occlusion OCCLUDERS] [--meshlets] [--vertex-format float|half|packed]\n"
+				"                   [--model FILE.obj|FILE.glb] [--lod PIXELS]\n"
+				"                   [--texture-cache DIR] [--texture-format raw|bc|etc2] [--convert IMAGE]...\n"
+				"                   [--shader-cache DIR] [--hot-reload] [--surround] [--camera-format rgb|nv12|yuyv]\n"
+				"                   [--record FILE SECONDS] [--replay FILE] [--replay-mode realtime|fast] [--camera-threads]\n"
+				"                   [--bench uniforms|instancing|transforms|shaders|state|queue|mesh|vertex-formats|models|lod|culling|occlusion|meshlets|bvh|remap|bowl|upload|replay|sync] [--iterations N]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
 /* Function to process the user input using keys to the window */
 void processInput(GLFWwindow* window)
 {
@@ -46,45 +310,100 @@ int main()
 	return 0;
 }
 #else
-/* Main function */
-int main()
+/* One vertex of the vertices[] array of the cube */
+struct CubeVertex
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec2 texCoord;
+};
+static_assert(sizeof(CubeVertex) == 8 * sizeof(float), "CubeVertex must match the vertices[] array");
+
+/* Attributes of CubeVertex, the types and offsets come from the members */
+const VertexLayout& cubeVertexLayout()
 {
+	static const VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(CubeVertex, position, 0, "aPos"),	   // layout (location=0) in Vertex shader
+		VERTEX_ATTRIBUTE(CubeVertex, color, 1, "aColor"),	   // layout (location=1) in Vertex shader
+		VERTEX_ATTRIBUTE(CubeVertex, texCoord, 2, "aTexCoord") // layout (location=2) in Vertex shader
+	};
+	static const VertexLayout layout = vertexLayout<CubeVertex>(attributes);
+	return layout;
+}
+
+/* Function to set up and render the cube scene until the window is closed (or
+   the requested number of frames in headless mode), 'result' is optional */
+int runScene(const AppOptions& options, SceneResult* result)
+{
+	std::chrono::high_resolution_clock::time_point sceneStart = std::chrono::high_resolution_clock::now(); // startup time in the report
+
 	/*****************************/
 	/**** SETUP GLFW AND GLAD ****/
 	/*****************************/
+	GLFWwindow* window = NULL;
+	HeadlessContext headlessContext; // only used with --headless
+	GLADloadproc glLoader = (GLADloadproc)glfwGetProcAddress;
 
-	glfwInit(); // Initialize GLFW
-
-	/* Configure GLFW using glfwWindowHint functions */
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	/* Create a Window object */
-	GLFWwindow* window = glfwCreateWindow(800, /* Width */
-		600, /* Height */
-		"LearnOpenGL", /* Name of the window */
-		NULL, NULL /* Ignore these arguments */
-	);
-	if (window == NULL)
+	if (options.headless)
 	{
-		std::cout << "Failed to create GLFW Window" << std::endl;
-		glfwTerminate();
-		return -1;
+		/* No window at all, everything is rendered into an FBO */
+		if (!headlessContext.create(3, 3))
+		{
+			std::cout << "Failed to create headless OpenGL context" << std::endl;
+			return -1;
+		}
+		glLoader = headlessContext.getProcLoader();
 	}
+	else
+	{
+		glfwInit(); // Initialize GLFW
 
-	/* Make the context of our window the main context on the current thread */
-	glfwMakeContextCurrent(window);
+		/* Configure GLFW using glfwWindowHint functions */
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		/* Create a Window object */
+		window = glfwCreateWindow(options.width, /* Width */
+			options.height, /* Height */
+			"LearnOpenGL", /* Name of the window */
+			NULL, NULL /* Ignore these arguments */
+		);
+		if (window == NULL)
+		{
+			std::cout << "Failed to create GLFW Window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+
+		/* Make the context of our window the main context on the current thread */
+		glfwMakeContextCurrent(window);
+	}
 
 	/* Initialize GLAD */
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	if (!gladLoadGLLoader(glLoader))
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	glExtensions().load(glLoader); // optional entry points newer than GL 3.3
+	glState().reset(); // new context, nothing is known about its state
 
-	/* Set the callback function to GLFW */
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	/* Headless mode renders into an offscreen framebuffer of the requested size */
+	OffscreenTarget offscreen;
+	if (options.headless)
+	{
+		if (!offscreen.create(options.width, options.height))
+		{
+			return -1;
+		}
+		offscreen.bind();
+	}
+	else
+	{
+		/* Set the callback function to GLFW */
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	}
 
 	/*********************************/
 	/**** SETUP GRAPHICS PIPELINE ****/
@@ -172,14 +491,53 @@ int main()
 	};
 #endif
 #endif
+	// positions of all instances, the hand placed cubes above come first
+	std::vector<glm::vec3> positions;
+	generateInstancePositions(cubePositions, 10, options.instances, positions);
+	int instanceCount = (int)positions.size();
+
+	/* The cube above repeats the shared vertices of every triangle: merge
+	   them into an index buffer, then order the triangles for the vertex
+	   cache and the vertices for the vertex fetch */
+	Mesh cubeMesh;
+	MeshOptimizeStats meshStats = optimizeMesh(vertices, (int)(sizeof(vertices) / (8 * sizeof(float))), 8 /* floats per vertex */, cubeMesh);
+
+	/* --lod PIXELS: simplified levels of the mesh follow the full one in the
+	   index buffer, the per-object draws pick one by its projected error.
+	   Every corner of the cube is a colour and UV seam, so it keeps one level;
+	   the models get the whole chain. */
+	int lodLevels = options.lodThreshold > 0.0f ? MESH_LOD_MAX_LEVELS : 1;
+	LodChain meshLod;
+	buildLodChain(cubeMesh.vertices.data(), cubeMesh.vertexCount(), cubeMesh.stride, cubeMesh.indices.data(), cubeMesh.indices.size(), meshLod, 0.5f, lodLevels);
+
+	/* --meshlets: the triangles of the full level are reordered into clusters
+	   with a bounding sphere and a normal cone, the per-object draws submit
+	   only the index ranges of the clusters in the frustum facing the camera.
+	   The colour seams split the cube into 2 halves which share no vertex,
+	   so it makes 2 clusters of 6 triangles; the models are split in many. */
+	MeshletSet meshlets;
+	if (options.meshlets)
+	{
+		buildMeshlets(cubeMesh.vertices.data(), cubeMesh.vertexCount(), cubeMesh.stride,
+			meshLod.indices.data() + meshLod.levels[0].first, meshLod.levels[0].count, meshlets);
+	}
+
+	/* --vertex-format half|packed stores each vertex in 16 bytes instead of
+	   32: half or unorm16 position, unorm8 colour, half tex coords */
+	const VertexSource cubeSource = { 8 /* floats per vertex */, 0 /* position */, -1 /* no normal */, 3 /* color */, 6 /* tex coords */ };
+	bool packedVertices = options.vertexFormat != VERTEX_FORMAT_FLOAT;
+	EncodedVertices cubeVertices;
+	if (packedVertices)
+	{
+		encodeVertices(cubeMesh.vertices.data(), cubeMesh.vertexCount(), cubeSource, vertexFormatFor(options.vertexFormat, cubeSource), cubeVertices);
+	}
 
 	/*********************************************************************/
-	/* 1. Create and bind Vertex Array Object (VAO)                      */
+	/* 1. Describe the vertex layout                                     */
 	/*********************************************************************/
-	/* Use Vertex Array Object (VAOs) to store the Vertex configurations */
-	unsigned int VAO;			// Create a variable to store the VAO object
-	glGenVertexArrays(1, &VAO); // Generate array object
-	glBindVertexArray(VAO);		// Bind the VAO to use it 
+	/* The attributes of CubeVertex, or of the compressed vertex format */
+	const VertexAttributeLocations cubeLocations = { 0 /* position */, -1 /* normal */, 1 /* color */, 2 /* tex coords */ };
+	VertexLayout meshLayout = packedVertices ? vertexFormatLayout(cubeVertices.format, cubeLocations) : cubeVertexLayout();
 
 	/*********************************************************************/
 	/* 2. Create Vertex Buffer Object (VBO) and copy our vertices array  */
@@ -191,8 +549,8 @@ int main()
 	glBindBuffer(GL_ARRAY_BUFFER, VBO); // Bind the newly created buffer object to GL_ARRAY_BUFFER target 
 	/* Copy the vertex data into the currently bound buffer's memory */
 	glBufferData(GL_ARRAY_BUFFER,
-		sizeof(vertices),
-		vertices,
+		packedVertices ? cubeVertices.data.size() : cubeMesh.vertices.size() * sizeof(float),
+		packedVertices ? (const void*)cubeVertices.data.data() : (const void*)cubeMesh.vertices.data(),
 		GL_STATIC_DRAW /* How we want graphics card to manage the data */
 	);
 
@@ -201,137 +559,215 @@ int main()
 	/*    to the EBO for OpenGL to use                                   */
 	/*********************************************************************/
 	/* Create Element Buffer Object (EBO) */
-#if 0 /* undefine this for Cube program */
 	unsigned int EBO;					// Create a variable to store the EBO object
 	glGenBuffers(1, &EBO);				// Generate buffer object with a buffer ID 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO); // Bind the newly created buffer object to GL_ELEMENT_ARRAY_BUFFER target 
-	/* Copy the vertex data into the currently bound buffer's memory */
+	/* Copy the index data into the currently bound buffer's memory (the VAO keeps this binding) */
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		sizeof(indices),
-		indices,
+		meshLod.indices.size() * sizeof(unsigned int),
+		meshLod.indices.data(),
 		GL_STATIC_DRAW /* How we want graphics card to manage the data */
 	);
-#endif
 	/*********************************************************************/
-	/* 4. Set and link Vertex Attribute pointers                         */
+	/* 4. Create the Vertex Array Object (VAO) from the layout           */
 	/*********************************************************************/
-	/* Position Attribute */
-	glVertexAttribPointer(0, /* layout (location=0) in Vertex shader */
-		3,			/* vec3 in vertex shader */
-		GL_FLOAT,	/* vec* in GLSL is a float */
-		GL_FALSE,	/* Normalize? not required for float, only for int*/
-		8 * sizeof(float), /* STRIDE (space between consecutive vertex attributes) */
-		(void*)0 /* OFFSET of where the position data begins in buffer */
-	);
-	glEnableVertexAttribArray(0 /* vertex attribute location (layout (location=0) in Vertex shader) */
-	);
-	/* Color Attribute */
-	glVertexAttribPointer(1, /* layout (location=1) in Vertex shader */
-		3,			/* vec3 in vertex shader */
-		GL_FLOAT,	/* vec* in GLSL is a float */
-		GL_FALSE,	/* Normalize? not required for float, only for int*/
-		8 * sizeof(float), /* STRIDE (space between consecutive vertex attributes) */
-		(void*)(3 * sizeof(float)) /* OFFSET of where the position data begins in buffer */
-	);
-	glEnableVertexAttribArray(1 /* vertex attribute location (layout (location=1) in Vertex shader) */
-	);
-	/* Texture coordinate Attribute */
-	glVertexAttribPointer(2, /* layout (location=2) in Vertex shader */
-		3,			/* vec3 in vertex shader */
-		GL_FLOAT,	/* vec* in GLSL is a float */
-		GL_FALSE,	/* Normalize? not required for float, only for int*/
-		8 * sizeof(float), /* STRIDE (space between consecutive vertex attributes) */
-		(void*)(6 * sizeof(float)) /* OFFSET of where the position data begins in buffer */
-	);
-	glEnableVertexAttribArray(2 /* vertex attribute location (layout (location=2) in Vertex shader) */
-	);
+	/* The VAO stores the Vertex configuration. The cache makes it and sets
+	   up the attributes the first time (layout, buffers) are asked for, and
+	   only binds it afterwards */
+	VertexArrayCache vertexArrays;
+	unsigned int VAO = vertexArrays.get(meshLayout, VBO, EBO);
 
-	/*********************************************************************/
-	/* 5. Create shaders and use this in Render loop below               */
-	/*********************************************************************/
-	Shader ourShader("shader.vs", "shader.fs");
+	/* --model FILE replaces the cube: the file is memory mapped, parsed on the
+	   thread pool and written straight into mapped buffer objects
+	   (model_loader.h), then fitted in the unit cube through the position
+	   decode of the vertex shader */
+	GLsizei indexCount = (GLsizei)cubeMesh.indices.size();
+	float lodErrorScale = 1.0f; // mesh units to world units
+	glm::vec3 positionScale = packedVertices ? cubeVertices.positionScale : glm::vec3(1.0f);
+	glm::vec3 positionOffset = packedVertices ? cubeVertices.positionOffset : glm::vec3(0.0f);
+	ModelBuffers modelBuffers;
+	ModelLoadStats modelStats;
+	memset(&modelStats, 0, sizeof(modelStats));
+	if (options.modelPath)
+	{
+		ModelLoader modelLoader;
+		bool loaded;
+		if (lodLevels > 1 || options.meshlets)
+		{
+			/* The chain and the meshlets are built from a copy in memory, then copied to the buffers */
+			ModelMemory modelMemory;
+			loaded = modelLoader.load(options.modelPath, modelMemory, modelStats, &defaultThreadPool());
+			if (loaded)
+			{
+				buildLodChain((const float*)modelMemory.vertexData(), (int)modelMemory.vertexCount, (int)(sizeof(ModelVertex) / sizeof(float)),
+					modelMemory.indexData(), modelMemory.indexCount, meshLod, 0.5f, lodLevels);
+				if (options.meshlets)
+				{
+					buildMeshlets((const float*)modelMemory.vertexData(), (int)modelMemory.vertexCount, (int)(sizeof(ModelVertex) / sizeof(float)),
+						meshLod.indices.data() + meshLod.levels[0].first, meshLod.levels[0].count, meshlets);
+				}
+				ModelVertex* modelVertices = modelBuffers.vertices(modelMemory.vertexCount);
+				uint32_t* modelIndices = modelBuffers.indices(meshLod.indices.size());
+				loaded = modelVertices && modelIndices;
+				if (loaded)
+				{
+					memcpy(modelVertices, modelMemory.vertexData(), modelMemory.vertexCount * sizeof(ModelVertex));
+					memcpy(modelIndices, meshLod.indices.data(), meshLod.indices.size() * sizeof(uint32_t));
+				}
+			}
+		}
+		else
+		{
+			loaded = modelLoader.load(options.modelPath, modelBuffers, modelStats, &defaultThreadPool());
+			MeshLod full = { 0, (unsigned int)modelBuffers.indexCount, 0.0f };
+			meshLod.indices.clear();
+			meshLod.levels.assign(1, full);
+		}
+		if (!modelBuffers.finish() || !loaded)
+		{
+			std::cout << "ERROR::MODEL::FAILED_TO_LOAD " << options.modelPath << std::endl;
+			return -1;
+		}
+		meshLayout = modelVertexLayout();
+		VAO = vertexArrays.get(meshLayout, modelBuffers.vertexBuffer, modelBuffers.indexBuffer);
+		indexCount = (GLsizei)meshLod.levels[0].count;
+		glm::vec3 size = modelStats.boundsMax - modelStats.boundsMin;
+		float scale = 1.0f / std::max(std::max(size.x, size.y), std::max(size.z, 1e-6f));
+		positionScale = glm::vec3(scale);
+		lodErrorScale = scale;
+		positionOffset = -0.5f * scale * (modelStats.boundsMin + modelStats.boundsMax);
+	}
 
 	/*********************************************************************/
-	/* 6. Load and create a texture                                      */
+	/* 5. Create shaders and use this in Render loop below               */
 	/*********************************************************************/
-	/* TEXTURE 1 */
-	unsigned int texture1;					// Create a variable to store the texture object
-	glGenTextures(1, &texture1);			// Create texture object
-	glBindTexture(GL_TEXTURE_2D, texture1);	// Bind the texture to use it 
-
-	/* Set the texture wrapping and filtering options on the currently bound texture */
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	/* Load an image and generate the texture */
-	int width1, height1, numChannels1;
-	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-	unsigned char* texImage1 = stbi_load("..\\resources\\textures\\container.jpg", &width1, &height1, &numChannels1, 0);
-
-	if (texImage1)
-	{
-		glTexImage2D(GL_TEXTURE_2D, // texture target
-			0, // mipmap level
-			GL_RGB, // texture storage format
-			width1,
-			height1,
-			0, // some legacy stuff
-			GL_RGB, // format of source image
-			GL_UNSIGNED_BYTE, // datatype of source image
-			texImage1
-		);
-		glGenerateMipmap(GL_TEXTURE_2D); // Generate all the required mipmaps for the currently bound texture
+	/* With --shader-cache the linked program is loaded from a binary saved by a previous run */
+	std::chrono::high_resolution_clock::time_point shaderStart = std::chrono::high_resolution_clock::now();
+	ShaderCache shaderCache;
+	if (options.shaderCache)
+	{
+		shaderCache.open(options.shaderCache);
 	}
-	else
+	Shader ourShader(drawModeVertexShader(options.drawMode), "shader.fs", &shaderCache);
+	std::chrono::duration<double, std::milli> shaderTime = std::chrono::high_resolution_clock::now() - shaderStart;
+
+	/* Draw packets of the per-object mode, recorded by the worker threads and
+	   submitted sorted by program, material and depth */
+	RenderQueue renderQueue(defaultThreadPool().size() + 1);
+
+	/* Level of detail of every cube in the per-object mode, the instanced
+	   modes always draw the full mesh */
+	LodSelector lodSelector(options.lodThreshold);
+	lodSelector.resize(instanceCount);
+	const float meshRadius = 0.87f; // bounding sphere of the unit cube, the models are fitted in it
+
+	/* Bounding spheres of the cubes for the frustum culling, the compacted
+	   list of the visible ones feeds the draws */
+	BoundsBatch instanceBounds;
+	instanceBounds.resize(instanceCount);
+	for (int i = 0; i < instanceCount; i++)
 	{
-		std::cout << "Failed to load texture1" << std::endl;
+		instanceBounds.set(i, positions[i], meshRadius, glm::vec3(meshRadius));
 	}
+	FrustumCuller culler;
 
-	stbi_image_free(texImage1); // free the image memory, after generating texture is done
+	/* --bvh: the same boxes in a BVH, whole subtrees are rejected or
+	   accepted with one test (the cubes do not move, it is never refitted) */
+	Bvh sceneBvh;
+	std::vector<int> bvhVisible;
+	if (options.bvh)
+	{
+		sceneBvh.build(instanceBounds);
+	}
 
-	/* TEXTURE 2 */
-	unsigned int texture2;					// Create a variable to store the texture object
-	glGenTextures(1, &texture2);			// Create texture object
-	glBindTexture(GL_TEXTURE_2D, texture2);	// Bind the texture to use it 
+	/* Software occlusion culling of the cubes behind the nearest ones, the
+	   cube itself is the occluder mesh (a model would have to fit inside its
+	   bounds, so it is off with --model) */
+	OcclusionCuller occlusion;
+	std::vector<int> unoccluded;
+	std::vector<std::pair<float, int> > occluderDepths;
+	bool occlusionCulling = options.occluders > 0 && !options.modelPath && options.drawMode != DRAW_INDIRECT;
 
-	/* Set the texture wrapping and filtering options on the currently bound texture */
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	/* The indirect mode culls on the GPU instead, from the same spheres */
+	GpuCuller gpuCuller;
+	if (options.drawMode == DRAW_INDIRECT)
+	{
+		if (!gpuCuller.create(instanceCount))
+		{
+			return -1;
+		}
+		gpuCuller.setBounds(instanceBounds, instanceCount);
+	}
 
-	/* Load an image and generate the texture */
-	int width2, height2, numChannels2;
-	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-	unsigned char* texImage2 = stbi_load("..\\resources\\textures\\awesomeface.png", &width2, &height2, &numChannels2, 0);
+	/* Per-instance model matrices, read by the vertex shader in the instanced draw modes */
+	InstanceBuffer instanceBuffer;
+	TransformBatch instanceTransforms, visibleTransforms; // all the cubes, the visible ones
+	instanceTransforms.resize(instanceCount);
+	for (int i = 0; i < instanceCount; i++)
+	{
+		// Rotate on multiple axis time*-55 degrees, like the per-object path in the render loop
+		instanceTransforms.set(i, positions[i], glm::vec3(0.5f, 1.0f, 1.0f), 0.0f, glm::radians(-55.0f));
+	}
+	if (options.drawMode != DRAW_PER_OBJECT)
+	{
+		if (!instanceBuffer.create(instanceCount, options.drawMode == DRAW_INSTANCED_TBO))
+		{
+			return -1;
+		}
+		if (options.drawMode == DRAW_INSTANCED || options.drawMode == DRAW_INDIRECT)
+		{
+			instanceBuffer.attach(3 /* layout (location=3) in Vertex shader, uses 3 to 6 */);
+		}
+	}
 
-	if (texImage2)
+	/*********************************************************************/
+	/* 6. Load and create a texture                                      */
+	/*********************************************************************/
+	/* The images are read and decoded on the worker threads and uploaded a few
+	   rows per frame through a PBO: the render loop starts right away and
+	   samples a placeholder texture until each image is ready */
+	TextureLoader textureLoader(defaultThreadPool());
+	if (options.textureCache)
 	{
-		glTexImage2D(GL_TEXTURE_2D, // texture target
-			0, // mipmap level
-			GL_RGB, // texture storage format
-			width2,
-			height2,
-			0, // some legacy stuff
-			GL_RGBA, // format of source image
-			GL_UNSIGNED_BYTE, // datatype of source image
-			texImage2
-		);
-		glGenerateMipmap(GL_TEXTURE_2D); // Generate all the required mipmaps for the currently bound texture
+		textureLoader.enableCache(options.textureCache, options.textureEncoding);
 	}
-	else
+	TextureHandle texture1 = textureLoader.load("../resources/textures/container.jpg", true /* flip on the y-axis */);
+	TextureHandle texture2 = textureLoader.load("../resources/textures/awesomeface.png", true /* flip on the y-axis */);
+	if (options.headless)
 	{
-		std::cout << "Failed to load texture2" << std::endl;
+		textureLoader.finish(); // every headless frame must be rendered with the real textures
 	}
 
-	stbi_image_free(texImage2); // free the image memory, after generating texture is done
+	/* Tell OpenGL to which texture each shader sampler belongs to, and look up
+	   the uniform locations once: the render loop only uses the handles. Done
+	   again when a hot-reloaded program replaces the shader. */
+	UniformHandle viewLoc, projectionLoc, modelLoc;
+	auto setupShader = [&]() {
+		ourShader.use();
+		ourShader.setInt("texture1", 0);
+		ourShader.setInt("texture2", 1);
+		ourShader.setInt("instanceModels", 2); // only exists in shader_instanced_tbo.vs
+		viewLoc = ourShader.uniform("view");
+		projectionLoc = ourShader.uniform("projection");
+		modelLoc = ourShader.uniform("model");
+		/* The inputs of the vertex shader must match the layout, the instance matrices come from the instance buffer */
+		validateVertexLayout(meshLayout, ourShader.ID, options.drawMode == DRAW_INSTANCED || options.drawMode == DRAW_INDIRECT ? 0xFu << 3 /* locations 3 to 6 */ : 0);
+		ourShader.setVec3(ourShader.uniform("positionScale"), positionScale);
+		ourShader.setVec3(ourShader.uniform("positionOffset"), positionOffset);
+	};
+	setupShader();
 
-	/* Tell OpenGL to which texture each shader sampler belongs to */
-	ourShader.use();
-	ourShader.setInt("texture1", 0);
-	ourShader.setInt("texture2", 1);
+	/* Shader hot-reload: edits of the sources are picked up while the scene runs */
+	FileWatcher shaderWatcher;
+	if (options.hotReload || !options.headless)
+	{
+		shaderWatcher.add(ourShader.vertexPath());
+		shaderWatcher.add(ourShader.fragmentPath());
+		if (!glExtensions().parallelShaderCompile)
+		{
+			std::cout << "SHADER::HOT_RELOAD without GL_KHR_parallel_shader_compile: a reload stalls its frame for the compile and link" << std::endl;
+		}
+	}
 
 	/*********************************************************************/
 	/* 7. Transformations                                                */
@@ -352,21 +788,55 @@ int main()
 	glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
 #endif
 
+	/* The setup above binds objects directly, so the state cache starts from
+	   scratch: from here on all the state calls go through glState() */
+	glState().reset();
+
 	// Enable Depth test using Z buffer or Depth buffer
-	glEnable(GL_DEPTH_TEST);
+	glState().enable(GL_DEPTH_TEST);
 
 	/*********************************************************************/
 	/* 8. RENDER LOOP                                                    */
 	/*********************************************************************/
-	while (!glfwWindowShouldClose(window))
+	/* Per-frame CPU/GPU timings, only collected when a JSON report is requested */
+	FrameProfiler* profiler = (options.jsonPath || result) ? new FrameProfiler() : NULL;
+	std::vector<double> stateCallsIssued, stateCallsSaved; // per profiled frame
+	std::vector<double> trianglesDrawn; // per profiled frame
+	std::vector<double> visibleInstances, cullTimes; // per profiled frame
+	std::vector<double> occludedPercents, occlusionTimes; // per profiled frame
+	std::vector<double> meshletRejectedPercents; // per profiled frame
+	std::chrono::duration<double, std::milli> startupTime = std::chrono::high_resolution_clock::now() - sceneStart;
+	std::chrono::high_resolution_clock::time_point loopStart = std::chrono::high_resolution_clock::now();
+	int frame = 0;
+
+	while (options.headless ? frame < options.warmup + options.frames : !glfwWindowShouldClose(window))
 	{
+		/* Headless mode drives the animation with a fixed time step, so every
+		   run renders exactly the same frames */
+		float currentTime = options.headless ? frame * options.timestep : (float)glfwGetTime();
+
+		/* The first frames include one-time driver work, keep them out of the report */
+		bool profileFrame = profiler && frame >= options.warmup;
+		if (profileFrame)
+		{
+			if (frame == options.warmup)
+			{
+				loopStart = std::chrono::high_resolution_clock::now();
+			}
+			profiler->beginFrame();
+			glState().resetCounters();
+		}
+
 		/* User input through keys */
-		processInput(window);
+		if (window)
+		{
+			processInput(window);
+		}
 
 		/** Rendering commands **/
 
 		/* Specify the color you want to to clear the screen (state-setting function) */
-		glClearColor(
+		glState().clearColor(
 			0.2f, /* R */
 			0.3f, /* G */
 			0.3f, /* B */
@@ -378,19 +848,34 @@ int main()
 			GL_DEPTH_BUFFER_BIT /* For Depth testing */
 		);
 
-		/* Activate and bind first texture */
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture1);
+		/* Upload the decoded texture rows, within the per-frame budget */
+		textureLoader.update();
+
+		/* Rebuild the shader in the background when a source changed, and
+		   swap the new program in once it is linked (never waits for it) */
+		if (!shaderWatcher.poll().empty())
+		{
+			ourShader.reload();
+		}
+		if (ourShader.pollReload())
+		{
+			setupShader();
+		}
+
+		/* Activate and bind first texture (the state cache drops the calls
+		   when the texture is already bound, which is the case in most frames) */
+		glState().bindTextureUnit(0, GL_TEXTURE_2D, texture1.id());
 		/* Activate and bind second texture */
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, texture2);
+		glState().bindTextureUnit(1, GL_TEXTURE_2D, texture2.id());
 
 		/* Bind the VAO to use it */
-		glBindVertexArray(VAO);
+		glState().bindVertexArray(VAO);
 
 		/* Use our shader */
 		ourShader.use();
 
+		int drawCalls = 0; // number of draw calls issued in this frame
+
 		/* Transformation */
 #if 0
 		glm::mat4 trans = glm::mat4(1.0f); // Initialize 4x4 matrix as Identity matrix
@@ -412,29 +897,185 @@ int main()
 		// View Matrix
 		glm::mat4 view = glm::mat4(1.0f);
 		view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f)); // Move the scene on Z axis in reverse direction
-		unsigned int transformLocView = glGetUniformLocation(ourShader.ID, "view");
-		glUniformMatrix4fv(transformLocView, 1, GL_FALSE, glm::value_ptr(view));
+		ourShader.setMat4(viewLoc, view);
 
 		// Projection Matrix
 		glm::mat4 projection = glm::mat4(1.0f);
-		projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-		unsigned int transformLocProj = glGetUniformLocation(ourShader.ID, "projection");
-		glUniformMatrix4fv(transformLocProj, 1, GL_FALSE, glm::value_ptr(projection));
+		projection = glm::perspective(glm::radians(45.0f), (float)options.width / (float)options.height, 0.1f, 100.0f);
+		ourShader.setMat4(projectionLoc, projection);
+
+		/* Frustum culling: the cubes whose bounding sphere is outside one of
+		   the planes of projection * view are not drawn at all */
+		const int* drawList = NULL; // indices of the cubes to draw, NULL: all of them
+		int drawCount = instanceCount;
+		if (options.cull && options.drawMode != DRAW_INDIRECT)
+		{
+			std::chrono::high_resolution_clock::time_point cullStart = std::chrono::high_resolution_clock::now();
+			if (options.bvh)
+			{
+				bvhVisible.clear();
+				drawCount = sceneBvh.queryFrustum(extractFrustum(projection * view), bvhVisible);
+				drawList = bvhVisible.data();
+			}
+			else
+			{
+				drawCount = culler.cull(extractFrustum(projection * view), instanceBounds, CULL_SPHERES, &defaultThreadPool());
+				drawList = culler.visible.data();
+			}
+			if (profileFrame)
+			{
+				cullTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count());
+			}
+		}
+
+		/* Occlusion culling: the nearest cubes left are rasterized into a
+		   small depth buffer on the CPU, the bounding boxes of all of them are
+		   tested against its Hi-Z pyramid */
+		if (occlusionCulling)
+		{
+			occlusion.beginFrame(projection * view);
+			occluderDepths.clear();
+			for (int k = 0; k < drawCount; k++)
+			{
+				int i = drawList ? drawList[k] : k;
+				occluderDepths.push_back(std::make_pair(-(view * glm::vec4(positions[i], 1.0f)).z, i));
+			}
+			int occluderCount = std::min(options.occluders, drawCount);
+			std::nth_element(occluderDepths.begin(), occluderDepths.begin() + occluderCount, occluderDepths.end());
+			for (int o = 0; o < occluderCount; o++)
+			{
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[occluderDepths[o].second]);
+				model = glm::rotate(model, currentTime * glm::radians(-55.0f), glm::vec3(0.5f, 1.0f, 1.0f)); // same as the draws
+				occlusion.addOccluder(cubeMesh.vertices.data(), cubeMesh.vertexCount(), cubeMesh.stride, cubeMesh.indices.data(), (int)cubeMesh.indices.size(), model);
+			}
+			occlusion.render(&defaultThreadPool());
+			drawCount = occlusion.cullBoxes(instanceBounds, drawList, drawCount, unoccluded, &defaultThreadPool());
+			drawList = unoccluded.data();
+			if (profileFrame)
+			{
+				occludedPercents.push_back(occlusion.stats.occludedPercent());
+				occlusionTimes.push_back(occlusion.stats.totalMs());
+			}
+		}
+		if (profileFrame && options.drawMode != DRAW_INDIRECT)
+		{
+			visibleInstances.push_back((double)drawCount);
+		}
 
 		// Model Matrix
-		// For loop to access each cube according to its position
-		for (unsigned int i = 0; i < 10; i++)
-		{
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			model = glm::rotate(model, (float)glfwGetTime() * glm::radians(-55.0f), glm::vec3(0.5f, 1.0f, 1.0f)); // Rotate on multiple axis time*-55 degrees for Cube
-			unsigned int transformLocModel = glGetUniformLocation(ourShader.ID, "model");
-			glUniformMatrix4fv(transformLocModel, 1, GL_FALSE, glm::value_ptr(model));
-
-			glDrawArrays(GL_TRIANGLES, /* Primitive */
-				0, /* starting index of vertex array*/
-				36 /* num vertices for Cube */
+		if (options.drawMode == DRAW_PER_OBJECT)
+		{
+			/* Record one packet per cube, each worker into its own bucket, then
+			   draw them front to back (all cubes share program and material) */
+			renderQueue.clear();
+			std::atomic<long long> meshletTriangles(0), meshletTrianglesRejected(0);
+			renderQueue.record(drawCount, [&](RenderBucket& bucket, int begin, int end) {
+				std::vector<MeshletRange> ranges;
+				MeshletCullStats meshletStats;
+				memset(&meshletStats, 0, sizeof(meshletStats));
+				// For loop to access each cube according to its position
+				for (int k = begin; k < end; k++)
+				{
+					int i = drawList ? drawList[k] : k;
+					RenderPacket packet;
+					packet.model = glm::mat4(1.0f);
+					packet.model = glm::translate(packet.model, positions[i]);
+					packet.model = glm::rotate(packet.model, currentTime * glm::radians(-55.0f), glm::vec3(0.5f, 1.0f, 1.0f)); // Rotate on multiple axis time*-55 degrees for Cube
+					float depth = -(view * glm::vec4(positions[i], 1.0f)).z; // distance in front of the camera
+					// coarsest level within the error threshold, from the depth of the nearest point of the bounding sphere
+					int level = lodSelector.select(i, meshLod, lodErrorScale * lodPixelsPerUnit(projection, options.height, depth - meshRadius, 0.1f /* near plane */));
+					const MeshLod& lod = meshLod.levels[level];
+					packet.key = RenderKey::opaque(ourShader.ID, texture1.id(), VAO, RenderKey::quantizeDepth(depth, 100.0f /* far plane */));
+					packet.program = ourShader.ID;
+					packet.modelLocation = modelLoc.location;
+					packet.vertexArray = VAO;
+					packet.textures[0] = texture1.id();
+					packet.textures[1] = texture2.id();
+					packet.primitive = GL_TRIANGLES;
+					packet.indexType = GL_UNSIGNED_INT;
+					packet.first = lod.first;	/* starting index of the level in the index buffer */
+					packet.count = lod.count;	/* num indices of the level */
+					if (level > 0 || meshlets.size() == 0)
+					{
+						bucket.add(packet);
+						continue;
+					}
+					/* One packet per range of visible meshlets, culled in the
+					   space of the vertices (before the position decode) */
+					glm::mat4 meshToWorld = glm::scale(glm::translate(packet.model, positionOffset), positionScale);
+					glm::vec3 eye(glm::inverse(view * meshToWorld)[3]);
+					cullMeshlets(meshlets, extractFrustum(projection * view * meshToWorld), eye, lod.first, ranges, &meshletStats);
+					for (size_t r = 0; r < ranges.size(); r++)
+					{
+						packet.first = ranges[r].firstIndex;
+						packet.count = ranges[r].count;
+						bucket.add(packet);
+					}
+				}
+				meshletTriangles += meshletStats.triangles;
+				meshletTrianglesRejected += meshletStats.trianglesRejected;
+			}, &defaultThreadPool());
+			renderQueue.flush();
+			drawCalls += renderQueue.stats.draws;
+			if (profileFrame)
+			{
+				long long triangles = 0;
+				for (int k = 0; k < drawCount; k++)
+				{
+					triangles += meshLod.triangleCount(lodSelector.level(drawList ? drawList[k] : k));
+				}
+				trianglesDrawn.push_back((double)(triangles - meshletTrianglesRejected));
+				if (meshlets.size() > 0)
+				{
+					meshletRejectedPercents.push_back(meshletTriangles > 0 ? 100.0 * (double)meshletTrianglesRejected / (double)meshletTriangles : 0.0);
+				}
+			}
+		}
+		else if (options.drawMode == DRAW_INDIRECT)
+		{
+			/* The model matrices of all the cubes go to the instance buffer, the
+			   compute shader culls their spheres and writes a draw command per
+			   visible cube, all submitted with one call */
+			glm::mat4* models = instanceBuffer.beginWrite();
+			instanceTransforms.update(currentTime, glm::mat4(1.0f), models, &defaultThreadPool());
+			instanceBuffer.endWrite();
+			Frustum frustum = extractFrustum(projection * view);
+			gpuCuller.cull(options.cull ? &frustum : NULL, instanceCount, (GLuint)indexCount, 0);
+			ourShader.use();
+			gpuCuller.draw();
+			drawCalls++;
+			instanceBuffer.fence();
+		}
+		else
+		{
+			/* Compute the model matrices of the visible cubes straight into the
+			   mapped instance buffer and draw them with one call */
+			const TransformBatch* transforms = &instanceTransforms;
+			if (drawList)
+			{
+				visibleTransforms.gather(instanceTransforms, drawList, drawCount);
+				transforms = &visibleTransforms;
+			}
+			glm::mat4* models = instanceBuffer.beginWrite();
+			transforms->update(currentTime, glm::mat4(1.0f), models, &defaultThreadPool());
+			instanceBuffer.endWrite();
+			if (options.drawMode == DRAW_INSTANCED_TBO)
+			{
+				instanceBuffer.bindTexture(2);
+			}
+
+			glDrawElementsInstanced(GL_TRIANGLES, /* Primitive */
+				indexCount, /* num indices of the cube or model */
+				GL_UNSIGNED_INT, /* type of indices */
+				0, /* offset */
+				drawCount /* number of visible cubes */
 			);
+			drawCalls++;
+			instanceBuffer.fence();
+			if (profileFrame)
+			{
+				trianglesDrawn.push_back((double)(indexCount / 3) * drawCount);
+			}
 		}
 #endif
 
@@ -454,18 +1095,770 @@ int main()
 		);
 #endif
 
-		/* Swaps the double buffers */
-		glfwSwapBuffers(window);
+		/* There is no buffer swap in headless mode, flush so the frame is
+		   submitted to the GPU like a swap would do */
+		if (options.headless)
+		{
+			glFlush();
+		}
+
+		if (profileFrame)
+		{
+			profiler->endFrame(drawCalls);
+			stateCallsIssued.push_back((double)glState().issuedCalls);
+			stateCallsSaved.push_back((double)glState().savedCalls);
+		}
+		frame++;
+
+		if (window)
+		{
+			/* Swaps the double buffers */
+			glfwSwapBuffers(window);
+
+			/* checks if any events are triggered (like keyboard or mouse events),
+			   updates the window state, and
+			   calls the corresponding functions via callback methods, which we can define. */
+			glfwPollEvents();
+		}
+	}
+
+	/* Write the frame timing report */
+	if (profiler)
+	{
+		glFinish(); // make sure the wall time includes all the GPU work
+		profiler->finish();
+		std::chrono::duration<double, std::milli> wallTime = std::chrono::high_resolution_clock::now() - loopStart;
+		if (options.drawMode == DRAW_INDIRECT)
+		{
+			/* Only the GPU knows what it drew: read the count of the last frame
+			   once, so the loop itself never waits for it */
+			int visible = gpuCuller.visibleCount();
+			visibleInstances.assign(1, (double)visible);
+			trianglesDrawn.assign(1, (double)(indexCount / 3) * visible);
+		}
+		if (options.jsonPath)
+		{
+			std::ofstream jsonFile;
+			bool toStdout = strcmp(options.jsonPath, "-") == 0;
+			if (!toStdout)
+			{
+				jsonFile.open(options.jsonPath);
+			}
+			std::ostream& out = toStdout ? std::cout : jsonFile;
 
-		/* checks if any events are triggered (like keyboard or mouse events),
-		   updates the window state, and
-		   calls the corresponding functions via callback methods, which we can define. */
-		glfwPollEvents();
+			JsonWriter json(out);
+			json.beginObject();
+			json.value("mode", std::string(options.headless ? "headless" : "window"));
+			json.value("draw_mode", std::string(drawModeName(options.drawMode)));
+			json.value("instances", (long long)instanceCount);
+			json.value("cull", std::string(!options.cull ? "off" : options.drawMode == DRAW_INDIRECT ? (gpuCuller.compact ? "gpu_compact" : "gpu") : options.bvh ? "bvh" : FrustumCuller::simdName()));
+			json.value("visible_instances", computeStats(visibleInstances).mean);
+			if (options.cull && options.drawMode != DRAW_INDIRECT)
+			{
+				json.stats("cull_ms", computeStats(cullTimes));
+			}
+			json.value("occluders", (long long)(occlusionCulling ? options.occluders : 0));
+			if (occlusionCulling)
+			{
+				json.value("occluded_percent", computeStats(occludedPercents).mean);
+				json.stats("occlusion_ms", computeStats(occlusionTimes));
+			}
+			json.value("width", (long long)options.width);
+			json.value("height", (long long)options.height);
+			json.value("timestep", (double)options.timestep);
+			profiler->writeFields(json, wallTime.count());
+			json.value("state_calls_issued_per_frame", computeStats(stateCallsIssued).mean);
+			json.value("state_calls_saved_per_frame", computeStats(stateCallsSaved).mean);
+			json.value("startup_ms", startupTime.count());
+			json.value("shader_ms", shaderTime.count());
+			json.value("mesh_vertices_in", (long long)meshStats.inputVertices);
+			json.value("mesh_vertices", (long long)meshStats.vertices);
+			json.value("mesh_triangles", (long long)meshStats.triangles);
+			json.value("mesh_acmr_before", meshStats.before.acmr);
+			json.value("mesh_acmr_after", meshStats.after.acmr);
+			json.value("mesh_atvr_before", meshStats.before.atvr);
+			json.value("mesh_atvr_after", meshStats.after.atvr);
+			json.value("lod_threshold", (double)options.lodThreshold);
+			json.value("lod_levels", (long long)meshLod.levelCount());
+			json.value("meshlets", (long long)meshlets.size());
+			if (meshlets.size() > 0)
+			{
+				json.value("meshlet_triangles_rejected_percent", computeStats(meshletRejectedPercents).mean);
+			}
+			json.value("triangles_per_frame", computeStats(trianglesDrawn).mean);
+			json.value("vertex_format", std::string(vertexFormatName(options.vertexFormat)));
+			json.value("vertex_bytes", (long long)(packedVertices ? cubeVertices.format.stride : cubeSource.stride * (int)sizeof(float)));
+			if (options.modelPath)
+			{
+				json.value("model", std::string(options.modelPath));
+				json.value("model_vertices", modelStats.vertices);
+				json.value("model_triangles", modelStats.triangles);
+				json.value("model_load_ms", modelStats.totalMs);
+				json.value("model_mb_per_second", modelStats.megabytesPerSecond());
+				json.value("model_triangles_per_second", modelStats.trianglesPerSecond());
+			}
+			json.value("shader_cache_hits", (long long)shaderCache.hits);
+			json.value("shader_cache_misses", (long long)shaderCache.misses);
+			textureLoader.writeReport(json);
+			json.endObject();
+			out << std::endl;
+		}
+		if (result)
+		{
+			result->cpu = computeStats(profiler->cpuTimes);
+			result->gpu = computeStats(profiler->gpuTimes);
+			result->framesPerSecond = wallTime.count() > 0.0 ? 1000.0 * profiler->cpuTimes.size() / wallTime.count() : 0.0;
+			result->drawCalls = computeStats(profiler->drawCalls).mean;
+		}
+		delete profiler;
 	}
 
 	/* Properly clean/delete all of GLFW's resources that were allocated */
-	glfwTerminate();
+	if (window)
+	{
+		glfwTerminate();
+	}
+
+	return 0;
+}
+
+/* Function to render the surround view: the bowl of bowl_mesh.h textured
+   with the frames of the 4 fisheye cameras of the synthetic rig, seen from
+   a camera circling the car. The cameras deliver 30 frames per second in
+   --camera-format, streamed through CameraFrameUploader and converted by
+   shader_bowl.fs. Every 60 frames one camera is recalibrated (its
+   yaw drifts by a fraction of a degree) and the ground height changes; the
+   bowl is updated on a worker thread and swapped in when it is done, the
+   frames keep drawing the old one meanwhile. Headless runs wait for each
+   update on the next frame, so every run renders the same frames.
+   With --replay the frames come from a recorded drive (drive_recording.h)
+   instead, uploaded straight from its mapping: at their recorded times
+   on the render clock, or one frame of every camera per render frame with
+   --replay-mode fast. With --camera-threads the synthetic cameras run on
+   their own threads with drifting clocks and jitter (frame_sync.h) and
+   each render frame takes the best matching set of their frames without
+   waiting for them. */
+int runSurroundView(const AppOptions& options)
+{
+	/*****************************/
+	/**** SETUP GLFW AND GLAD ****/
+	/*****************************/
+	GLFWwindow* window = NULL;
+	HeadlessContext headlessContext; // only used with --headless
+	GLADloadproc glLoader = (GLADloadproc)glfwGetProcAddress;
+	if (options.headless)
+	{
+		if (!headlessContext.create(3, 3))
+		{
+			std::cout << "Failed to create headless OpenGL context" << std::endl;
+			return -1;
+		}
+		glLoader = headlessContext.getProcLoader();
+	}
+	else
+	{
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		window = glfwCreateWindow(options.width, options.height, "LearnOpenGL surround view", NULL, NULL);
+		if (window == NULL)
+		{
+			std::cout << "Failed to create GLFW Window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+	}
+	if (!gladLoadGLLoader(glLoader))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+	glExtensions().load(glLoader);
+	glState().reset();
+	OffscreenTarget offscreen;
+	if (options.headless)
+	{
+		if (!offscreen.create(options.width, options.height))
+		{
+			return -1;
+		}
+		offscreen.bind();
+	}
+	else
+	{
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	}
+
+	/* The cameras: a loop of 4 frames (2 m of road) or the recording, one texture layer each */
+	ThreadPool& pool = defaultThreadPool();
+	CameraModel rig[BOWL_CAMERAS];
+	CameraPixelFormat cameraFormat = options.cameraFormat;
+	SyntheticFrameSource cameraSource;
+	DriveRecording drive;
+	DriveReplay replay;
+	ReplayFrameSet replayFrames;
+	if (options.replayPath)
+	{
+		if (!drive.open(options.replayPath))
+		{
+			return -1;
+		}
+		if (drive.cameras() != BOWL_CAMERAS)
+		{
+			std::cout << "ERROR::DRIVE_RECORDING::NOT_A_SURROUND_RIG " << options.replayPath << std::endl;
+			return -1;
+		}
+		drive.setReadAhead(16 << 20);
+		replay.start(drive, options.replayMode);
+		cameraFormat = drive.pixelFormat();
+		surroundViewRig(drive.width(), drive.height(), rig);
+	}
+	else
+	{
+		surroundViewRig(1280, 720, rig);
+		cameraSource.create(rig, BOWL_CAMERAS, cameraFormat, 4, 30.0f, &pool);
+	}
+	CameraFrameUploader cameraFrames;
+	if (!cameraFrames.create(cameraFormat, rig[0].width, rig[0].height, BOWL_CAMERAS))
+	{
+		return -1;
+	}
+	FrameSynchronizer frameSync;
+	CameraProducerThreads producers;
+	SyncedFrameSet syncedFrames;
+	bool cameraThreads = options.cameraThreads && !options.replayPath;
+	if (cameraThreads)
+	{
+		frameSync.create(BOWL_CAMERAS, cameraSource.frameBytes, cameraSource.fps);
+		producers.start(frameSync, cameraSource.fps, 3000, [&cameraSource](int camera, long long index, unsigned char* data) {
+			memcpy(data, cameraSource.frame(camera, index), cameraSource.frameBytes);
+		});
+	}
 
+	/* The bowl and its program */
+	BowlMesh bowl;
+	bowl.build(defaultBowlParameters(), rig, &pool);
+	bowl.upload();
+	double buildMs = bowl.stats.computeMs;
+	Shader bowlShader("shader_bowl.vs", "shader_bowl.fs");
+	validateVertexLayout(bowlVertexLayout(), bowlShader.ID);
+	bowlShader.use();
+	bowlShader.setInt("cameras", 0);
+	bowlShader.setInt("chroma", 1);
+	bowlShader.setInt("cameraFormat", (int)cameraFormat);
+	UniformHandle viewLoc = bowlShader.uniform("view");
+	UniformHandle projectionLoc = bowlShader.uniform("projection");
+
+	glState().reset();
+	glState().enable(GL_DEPTH_TEST);
+
+	FrameProfiler* profiler = options.jsonPath ? new FrameProfiler() : NULL;
+	std::vector<double> updateTimes, uploadedBytes, changedSectors; // per update finished in a profiled frame
+	std::vector<double> selectTimes, syncSkews, latestSkews;		   // per profiled frame with --camera-threads
+	std::chrono::high_resolution_clock::time_point loopStart = std::chrono::high_resolution_clock::now();
+	int frame = 0, updatesStarted = 0;
+	long long cameraFrame = -1; // last frame uploaded
+	while (options.headless ? frame < options.warmup + options.frames : !glfwWindowShouldClose(window))
+	{
+		float currentTime = options.headless ? frame * options.timestep : (float)glfwGetTime();
+		bool profileFrame = profiler && frame >= options.warmup;
+		if (profileFrame)
+		{
+			if (frame == options.warmup)
+			{
+				loopStart = std::chrono::high_resolution_clock::now();
+			}
+			profiler->beginFrame();
+		}
+		if (window)
+		{
+			processInput(window);
+		}
+
+		/* Simulated recalibration, computed in the background */
+		if (frame % 60 == 59 && !bowl.updating())
+		{
+			int c = updatesStarted % BOWL_CAMERAS;
+			float drift = glm::radians(0.4f) * sinf(1.7f * updatesStarted);
+			CameraModel cameras[BOWL_CAMERAS];
+			for (int i = 0; i < BOWL_CAMERAS; i++)
+			{
+				cameras[i] = bowl.geometry.cameras[i];
+			}
+			cameras[c].rotation = glm::mat3(glm::rotate(glm::mat4(1.0f), drift, glm::vec3(0.0f, 1.0f, 0.0f))) * cameras[c].rotation;
+			bowl.updateAsync(cameras, 0.03f * sinf(0.9f * updatesStarted), pool);
+			updatesStarted++;
+		}
+		if (bowl.finishUpdate(options.headless) && profileFrame)
+		{
+			updateTimes.push_back(bowl.stats.computeMs);
+			uploadedBytes.push_back((double)bowl.stats.uploadedBytes);
+			changedSectors.push_back((double)bowl.stats.changedSectors);
+		}
+
+		/* A new frame of the cameras: into the ring, the GPU copies it to the textures */
+		if (cameraThreads)
+		{
+			std::chrono::high_resolution_clock::time_point selectStart = std::chrono::high_resolution_clock::now();
+			bool selected = frameSync.select(syncedFrames);
+			if (profileFrame)
+			{
+				selectTimes.push_back(std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - selectStart).count());
+			}
+			if (selected)
+			{
+				if (profileFrame)
+				{
+					syncSkews.push_back(syncedFrames.skewUs / 1000.0);
+					latestSkews.push_back(syncedFrames.latestSkewUs / 1000.0);
+				}
+				cameraFrames.beginFrame();
+				for (int c = 0; c < BOWL_CAMERAS; c++)
+				{
+					if (syncedFrames.updated[c])
+					{
+						cameraFrames.upload(c, syncedFrames.frames[c]);
+					}
+				}
+				cameraFrames.endFrame();
+			}
+		}
+		else if (options.replayPath)
+		{
+			if (replay.next(currentTime, replayFrames))
+			{
+				cameraFrames.beginFrame();
+				for (int c = 0; c < BOWL_CAMERAS; c++)
+				{
+					if (replayFrames.updated[c])
+					{
+						cameraFrames.upload(c, replayFrames.frames[c]);
+					}
+				}
+				cameraFrames.endFrame();
+			}
+		}
+		else
+		{
+			long long newestFrame = cameraSource.frameAt(currentTime);
+			if (newestFrame != cameraFrame)
+			{
+				cameraFrames.beginFrame();
+				for (int c = 0; c < BOWL_CAMERAS; c++)
+				{
+					cameraFrames.upload(c, cameraSource.frame(c, newestFrame));
+				}
+				cameraFrames.endFrame();
+				cameraFrame = newestFrame;
+			}
+		}
+
+		glState().clearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		/* Orbit around the car, looking down at it */
+		float angle = 0.25f * currentTime;
+		glm::vec3 eye(9.0f * sinf(angle), 7.0f, 9.0f * cosf(angle));
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)options.width / (float)options.height, 0.1f, 100.0f);
+		bowlShader.use();
+		bowlShader.setMat4(viewLoc, view);
+		bowlShader.setMat4(projectionLoc, projection);
+		cameraFrames.bind(0, 1);
+		bowl.draw(); // the whole bowl in one draw
+
+		if (options.headless)
+		{
+			glFlush();
+		}
+		if (profileFrame)
+		{
+			profiler->endFrame(1);
+		}
+		frame++;
+		if (window)
+		{
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+	}
+
+	producers.stop();
+
+	if (profiler)
+	{
+		glFinish();
+		profiler->finish();
+		std::chrono::duration<double, std::milli> wallTime = std::chrono::high_resolution_clock::now() - loopStart;
+		std::ofstream jsonFile;
+		bool toStdout = strcmp(options.jsonPath, "-") == 0;
+		if (!toStdout)
+		{
+			jsonFile.open(options.jsonPath);
+		}
+		std::ostream& out = toStdout ? std::cout : jsonFile;
+		JsonWriter json(out);
+		json.beginObject();
+		json.value("mode", std::string(options.headless ? "headless" : "window"));
+		json.value("scene", std::string("surround"));
+		json.value("width", (long long)options.width);
+		json.value("height", (long long)options.height);
+		json.value("timestep", (double)options.timestep);
+		profiler->writeFields(json, wallTime.count());
+		json.value("bowl_vertices", (long long)bowl.vertexCount());
+		json.value("bowl_triangles", (long long)(bowl.indexCount / 3));
+		json.value("bowl_vertex_bytes", (long long)sizeof(BowlVertex));
+		json.value("bowl_build_ms", buildMs);
+		json.value("bowl_updates", (long long)updateTimes.size());
+		json.stats("bowl_update_ms", computeStats(updateTimes));
+		json.value("bowl_update_uploaded_bytes", computeStats(uploadedBytes).mean);
+		json.value("bowl_update_changed_sectors", computeStats(changedSectors).mean);
+		json.value("camera_format", std::string(cameraPixelFormatName(cameraFormat)));
+		json.value("camera_frames_uploaded", cameraFrames.stats.frames);
+		json.value("camera_upload_mb", cameraFrames.stats.bytes / (1024.0 * 1024.0));
+		json.value("camera_upload_copy_ms", cameraFrames.stats.copyMs);
+		json.value("camera_upload_submit_ms", cameraFrames.stats.submitMs);
+		json.value("camera_upload_fence_waits", cameraFrames.stats.fenceWaits);
+		json.value("camera_upload_persistent", std::string(cameraFrames.persistent ? "yes" : "no"));
+		if (options.replayPath)
+		{
+			json.value("replay_file", std::string(options.replayPath));
+			json.value("replay_mode", std::string(replayModeName(options.replayMode)));
+			json.value("replay_frames", replay.stats.frames);
+			json.value("replay_drops", replay.stats.drops);
+			json.value("replay_loops", replay.stats.loops);
+			json.value("replay_frames_per_second", replay.stats.frames / (wallTime.count() / 1000.0));
+			json.value("replay_mb_per_second", replay.stats.bytes / (1024.0 * 1024.0) / (wallTime.count() / 1000.0));
+		}
+		if (cameraThreads)
+		{
+			FrameSyncStats sync = frameSync.stats();
+			json.value("camera_sync_published", sync.published);
+			json.value("camera_sync_ring_full", sync.ringFull);
+			json.value("camera_sync_sets", sync.sets);
+			json.value("camera_sync_incomplete", sync.incomplete);
+			json.value("camera_sync_delivered", sync.delivered);
+			json.value("camera_sync_repeated", sync.repeated);
+			json.value("camera_sync_stale", sync.stale);
+			json.stats("camera_sync_select_us", computeStats(selectTimes));
+			json.stats("camera_sync_skew_ms", computeStats(syncSkews));
+			json.stats("camera_sync_latest_frames_skew_ms", computeStats(latestSkews));
+		}
+		json.endObject();
+		out << std::endl;
+		delete profiler;
+	}
+
+	if (window)
+	{
+		glfwTerminate();
+	}
 	return 0;
 }
+
+/* Function to sweep the number of cubes and compare the per-object draws with
+   the instanced draw modes and the GPU-culled indirect one (headless, one
+   entry of results per count, no indirect entry without GL 4.3) */
+int runInstancingBenchmark(std::ostream& out, const AppOptions& options)
+{
+	const int counts[] = { 10, 100, 1000, 10000, 100000 };
+	const DrawMode modes[] = { DRAW_PER_OBJECT, DRAW_INSTANCED, DRAW_INSTANCED_TBO, DRAW_INDIRECT };
+
+	AppOptions runOptions = options;
+	runOptions.headless = true;
+	runOptions.jsonPath = NULL;
+	runOptions.frames = options.iterations > 0 ? options.iterations : 20;
+	runOptions.warmup = 2;
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", std::string("instancing"));
+	json.value("frames", (long long)runOptions.frames);
+	json.beginArray("results");
+	for (int c = 0; c < 5; c++)
+	{
+		SceneResult results[4];
+		bool ran[4] = { true, true, true, true };
+		runOptions.instances = counts[c];
+		for (int m = 0; m < 4; m++)
+		{
+			runOptions.drawMode = modes[m];
+			if (runScene(runOptions, &results[m]) != 0)
+			{
+				if (modes[m] != DRAW_INDIRECT)
+				{
+					return -1;
+				}
+				ran[m] = false; // no compute shaders
+			}
+		}
+
+		json.beginObject();
+		json.value("instances", (long long)counts[c]);
+		for (int m = 0; m < 4; m++)
+		{
+			if (!ran[m])
+			{
+				continue;
+			}
+			json.beginObject(drawModeName(modes[m]));
+			json.value("draw_calls_per_frame", results[m].drawCalls);
+			json.value("cpu_ms", results[m].cpu.mean);
+			json.value("gpu_ms", results[m].gpu.mean);
+			json.value("frame_ms", results[m].framesPerSecond > 0.0 ? 1000.0 / results[m].framesPerSecond : 0.0);
+			json.endObject();
+		}
+		/* Savings of the instance VBO path relative to one draw per cube */
+		json.value("draw_calls_saved", results[0].drawCalls - results[1].drawCalls);
+		json.value("cpu_speedup", results[1].cpu.mean > 0.0 ? results[0].cpu.mean / results[1].cpu.mean : 0.0);
+		json.value("frame_speedup", results[0].framesPerSecond > 0.0 ? results[1].framesPerSecond / results[0].framesPerSecond : 0.0);
+		json.endObject();
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+/* Function to run the micro-benchmark selected with --bench, the JSON report
+   goes to the --json file or to stdout */
+int runBenchmark(const AppOptions& options)
+{
+	std::ofstream jsonFile;
+	bool toFile = options.jsonPath && strcmp(options.jsonPath, "-") != 0;
+	if (toFile)
+	{
+		jsonFile.open(options.jsonPath);
+	}
+	std::ostream& out = toFile ? jsonFile : std::cout;
+
+	if (strcmp(options.bench, "uniforms") == 0)
+	{
+		return runUniformBenchmark(out, options.iterations > 0 ? options.iterations : 200000);
+	}
+	if (strcmp(options.bench, "transforms") == 0)
+	{
+		return runTransformBenchmark(out, options.iterations > 0 ? options.iterations : 100);
+	}
+	if (strcmp(options.bench, "instancing") == 0)
+	{
+		return runInstancingBenchmark(out, options);
+	}
+	if (strcmp(options.bench, "shaders") == 0)
+	{
+		return runShaderBenchmark(out, options.iterations > 0 ? options.iterations : 10, options.shaderCache ? options.shaderCache : "shader_cache");
+	}
+
+	if (strcmp(options.bench, "state") == 0)
+	{
+		return runStateBenchmark(out, options.iterations > 0 ? options.iterations : 200000);
+	}
+
+	if (strcmp(options.bench, "queue") == 0)
+	{
+		return runQueueBenchmark(out, options.iterations > 0 ? options.iterations : 200, 5000);
+	}
+
+	if (strcmp(options.bench, "mesh") == 0)
+	{
+		return runMeshBenchmark(out, options.iterations > 0 ? options.iterations : 5);
+	}
+
+	if (strcmp(options.bench, "vertex-formats") == 0)
+	{
+		return runVertexFormatBenchmark(out, options.iterations > 0 ? options.iterations : 20, 8);
+	}
+
+	if (strcmp(options.bench, "models") == 0)
+	{
+		return runModelBenchmark(out, options.iterations > 0 ? options.iterations : 3, DEFAULT_MODEL_CORPUS);
+	}
+
+	if (strcmp(options.bench, "lod") == 0)
+	{
+		return runLodBenchmark(out, options.iterations > 0 ? options.iterations : 10, 400);
+	}
+
+	if (strcmp(options.bench, "culling") == 0)
+	{
+		return runCullingBenchmark(out, options.iterations > 0 ? options.iterations : 20);
+	}
+	if (strcmp(options.bench, "occlusion") == 0)
+	{
+		return runOcclusionBenchmark(out, options.iterations > 0 ? options.iterations : 20);
+	}
+	if (strcmp(options.bench, "meshlets") == 0)
+	{
+		return runMeshletBenchmark(out, options.iterations > 0 ? options.iterations : 24);
+	}
+	if (strcmp(options.bench, "bvh") == 0)
+	{
+		return runBvhBenchmark(out, options.iterations > 0 ? options.iterations : 120);
+	}
+	if (strcmp(options.bench, "remap") == 0)
+	{
+		return runRemapBenchmark(out, options.iterations > 0 ? options.iterations : 5, 1920, 1080);
+	}
+	if (strcmp(options.bench, "bowl") == 0)
+	{
+		return runBowlBenchmark(out, options.iterations > 0 ? options.iterations : 5);
+	}
+	if (strcmp(options.bench, "upload") == 0)
+	{
+		return runUploadBenchmark(out, options.iterations > 0 ? options.iterations : 120, 1280, 720);
+	}
+	if (strcmp(options.bench, "replay") == 0)
+	{
+		return runReplayBenchmark(out, options.iterations > 0 ? options.iterations : 5, DEFAULT_DRIVE_CORPUS);
+	}
+	if (strcmp(options.bench, "sync") == 0)
+	{
+		return runSyncBenchmark(out, options.iterations > 0 ? options.iterations : 3);
+	}
+
+	std::cout << "ERROR::BENCHMARK::UNKNOWN_BENCHMARK " << options.bench << std::endl;
+	return -1;
+}
+
+/* Function to write the images given with --convert to the texture cache, so
+   the next runs upload them without decoding. The images are flipped like in
+   runScene(). */
+int runTextureConverter(const AppOptions& options)
+{
+	std::string directory = options.textureCache ? options.textureCache : DEFAULT_TEXTURE_CACHE;
+	if (!makeDirectory(directory))
+	{
+		std::cout << "ERROR::TEXTURE_CACHE::CANNOT_CREATE_DIRECTORY " << directory << std::endl;
+		return -1;
+	}
+
+	std::ofstream jsonFile;
+	bool toFile = options.jsonPath && strcmp(options.jsonPath, "-") != 0;
+	if (toFile)
+	{
+		jsonFile.open(options.jsonPath);
+	}
+	std::ostream& out = toFile ? jsonFile : std::cout;
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("encoding", std::string(textureEncodingName(options.textureEncoding)));
+	json.beginArray("textures");
+
+	int result = 0;
+	for (size_t i = 0; i < options.convertFiles.size(); i++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		std::ifstream file(options.convertFiles[i], std::ios::binary);
+		std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		int width = 0, height = 0, channels = 0;
+		stbi_set_flip_vertically_on_load(true);
+		unsigned char* pixels = bytes.empty() ? NULL : stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &channels, 0);
+		if (!pixels)
+		{
+			std::cout << "ERROR::TEXTURE::FAILED_TO_LOAD\n" << options.convertFiles[i] << std::endl;
+			result = -1;
+			continue;
+		}
+
+		uint64_t key = textureCacheKey(bytes.data(), bytes.size(), true);
+		std::string cachePath = textureCachePath(directory, key);
+		bool written = writeTextureCache(cachePath, key, pixels, width, height, channels, options.textureEncoding);
+		stbi_image_free(pixels);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		TextureCacheFile entry;
+		if (!written || !entry.open(cachePath, key))
+		{
+			std::cout << "ERROR::TEXTURE_CACHE::WRITE_FAILED " << cachePath << std::endl;
+			result = -1;
+			continue;
+		}
+		json.beginObject();
+		json.value("source", std::string(options.convertFiles[i]));
+		json.value("cache_file", cachePath);
+		json.value("format", std::string(textureCacheFormatName(entry.format())));
+		json.value("width", (long long)width);
+		json.value("height", (long long)height);
+		json.value("levels", (long long)entry.levelCount());
+		json.value("source_bytes", (long long)bytes.size());
+		json.value("gpu_bytes", (long long)entry.dataSize());
+		json.value("gpu_bytes_uncompressed", (long long)((size_t)width * height * channels * 4 / 3));
+		json.value("convert_ms", elapsed.count());
+		json.endObject();
+	}
+	json.endArray();
+	json.endObject();
+	out << std::endl;
+	return result;
+}
+
+/* Function to write --record SECONDS of the synthetic rig (1280 x 720,
+   --camera-format, 30 frames per second, vehicle signals at 100 Hz) to a
+   drive recording, replayed by --surround --replay */
+int runDriveRecorder(const AppOptions& options)
+{
+	CameraModel rig[BOWL_CAMERAS];
+	surroundViewRig(1280, 720, rig);
+	SyntheticFrameSource source;
+	source.create(rig, BOWL_CAMERAS, options.cameraFormat, 4, 30.0f, &defaultThreadPool());
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	DriveRecorder recorder;
+	if (!recorder.open(options.recordPath, BOWL_CAMERAS, options.cameraFormat, rig[0].width, rig[0].height)
+		|| !recordSyntheticDrive(recorder, source, options.recordSeconds, 100.0f) || !recorder.close())
+	{
+		return -1;
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	std::ofstream jsonFile;
+	bool toFile = options.jsonPath && strcmp(options.jsonPath, "-") != 0;
+	if (toFile)
+	{
+		jsonFile.open(options.jsonPath);
+	}
+	std::ostream& out = toFile ? jsonFile : std::cout;
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("recording", std::string(options.recordPath));
+	json.value("seconds", (double)options.recordSeconds);
+	json.value("camera_format", std::string(cameraPixelFormatName(options.cameraFormat)));
+	json.value("frames", recorder.frameCount());
+	json.value("signals", recorder.signalCount());
+	json.value("file_mb", recorder.size() / (1024.0 * 1024.0));
+	json.value("write_ms", elapsed.count());
+	json.value("write_mb_per_second", recorder.size() / (1024.0 * 1024.0) / (elapsed.count() / 1000.0));
+	json.endObject();
+	out << std::endl;
+	return 0;
+}
+
+/* Main function */
+int main(int argc, char* argv[])
+{
+	AppOptions options;
+	if (!parseOptions(argc, argv, options))
+	{
+		return -1;
+	}
+	if (options.bench)
+	{
+		return runBenchmark(options);
+	}
+	if (!options.convertFiles.empty())
+	{
+		return runTextureConverter(options);
+	}
+	if (options.recordPath)
+	{
+		return runDriveRecorder(options);
+	}
+	if (options.surround)
+	{
+		return runSurroundView(options);
+	}
+	return runScene(options, NULL);
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+
+/* Read-only memory mapping of a whole file. The pages are loaded by the OS
+   on first access, nothing is copied into the process heap. */
+class MappedFile
+{
+public:
+	MappedFile() : bytes(NULL), length(0)
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		fd = -1;
+#endif
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	bool open(const char* path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		length = (size_t)fileSize.QuadPart;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		bytes = mapping ? (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+		fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			close();
+			return false;
+		}
+		length = (size_t)info.st_size;
+		void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		bytes = address == MAP_FAILED ? NULL : (const unsigned char*)address;
+#endif
+		if (!bytes)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (bytes)
+		{
+			UnmapViewOfFile(bytes);
+		}
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+		}
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		if (bytes)
+		{
+			munmap((void*)bytes, length);
+		}
+		if (fd >= 0)
+		{
+			::close(fd);
+		}
+		fd = -1;
+#endif
+		bytes = NULL;
+		length = 0;
+	}
+
+	bool isOpen() const
+	{
+		return bytes != NULL;
+	}
+
+	const unsigned char* data() const
+	{
+		return bytes;
+	}
+
+	size_t size() const
+	{
+		return length;
+	}
+
+	/* Read-ahead hints (madvise), ignored on Windows. The ranges are widened
+	   to whole pages. */
+
+	// the file is read in order: the OS reads further ahead and may drop the pages behind
+	void adviseSequential()
+	{
+#ifndef _WIN32
+		advise(0, length, MADV_SEQUENTIAL);
+#endif
+	}
+
+	// start loading [offset, offset + size) in the background
+	void prefetch(size_t offset, size_t size)
+	{
+#ifndef _WIN32
+		advise(offset, size, MADV_WILLNEED);
+#endif
+	}
+
+	// [offset, offset + size) is not needed any more, its pages can leave the process (they are read again if touched)
+	void release(size_t offset, size_t size)
+	{
+#ifndef _WIN32
+		advise(offset, size, MADV_DONTNEED);
+#endif
+	}
+
+private:
+	const unsigned char* bytes;
+	size_t length;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+
+#ifndef _WIN32
+	void advise(size_t offset, size_t size, int advice)
+	{
+		if (!bytes || offset >= length)
+		{
+			return;
+		}
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		size_t begin = offset / page * page, end = offset + size < length ? offset + size : length;
+		madvise((void*)(bytes + begin), end - begin, advice);
+	}
+#endif
+
+	MappedFile(const MappedFile&);			  // not copyable
+	MappedFile& operator=(const MappedFile&);
+};
+
+#endif
@@ -0,0 +1,528 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include "glm/glm.hpp"
+
+#include "mesh_optimizer.h"
+#include "file_utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Quadric of a set of planes (Garland and Heckbert): the sum of the squared
+   distances of a point to the planes, weighted by the area they come from */
+struct MeshQuadric
+{
+	double a00, a11, a22, a01, a02, a12; // sum of w * n * n^T (symmetric)
+	double b0, b1, b2;					 // sum of w * d * n
+	double c;							 // sum of w * d^2
+	double w;							 // sum of the weights
+
+	void clear()
+	{
+		memset(this, 0, sizeof(*this));
+	}
+
+	// plane dot(n, p) + d = 0, 'n' of unit length
+	void addPlane(const glm::dvec3& n, double d, double weight)
+	{
+		a00 += weight * n.x * n.x; a11 += weight * n.y * n.y; a22 += weight * n.z * n.z;
+		a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a12 += weight * n.y * n.z;
+		b0 += weight * d * n.x; b1 += weight * d * n.y; b2 += weight * d * n.z;
+		c += weight * d * d;
+		w += weight;
+	}
+
+	void add(const MeshQuadric& q)
+	{
+		a00 += q.a00; a11 += q.a11; a22 += q.a22; a01 += q.a01; a02 += q.a02; a12 += q.a12;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+		w += q.w;
+	}
+
+	// weighted mean of the squared distances of 'p' to the planes
+	double error(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return w > 0.0 ? std::max(e, 0.0) / w : 0.0;
+	}
+};
+
+/* What the simplifier may do with a vertex */
+enum MeshVertexKind
+{
+	MESH_VERTEX_MANIFOLD, // inside a closed surface: may collapse along any edge
+	MESH_VERTEX_BORDER,	  // on one open border: may only collapse along it
+	MESH_VERTEX_LOCKED	  // seam (several vertices at its position), corner of borders or non-manifold
+};
+
+const double MESH_BORDER_WEIGHT = 10.0; // weight of the planes keeping the borders in place
+
+const uint64_t MESH_EDGE_EMPTY = ~0ull;
+
+/* Open addressing set of directed edges, the key is (from << 32) | to */
+class MeshEdgeSet
+{
+public:
+	explicit MeshEdgeSet(size_t count)
+	{
+		size_t size = 1;
+		while (size < count * 2)
+		{
+			size *= 2;
+		}
+		keys.assign(size, MESH_EDGE_EMPTY);
+		mask = size - 1;
+	}
+
+	// false when the edge was already in the set
+	bool insert(unsigned int from, unsigned int to)
+	{
+		uint64_t key = ((uint64_t)from << 32) | to;
+		for (size_t slot = hash(key);; slot = (slot + 1) & mask)
+		{
+			if (keys[slot] == key)
+			{
+				return false;
+			}
+			if (keys[slot] == MESH_EDGE_EMPTY)
+			{
+				keys[slot] = key;
+				return true;
+			}
+		}
+	}
+
+	bool contains(unsigned int from, unsigned int to) const
+	{
+		uint64_t key = ((uint64_t)from << 32) | to;
+		for (size_t slot = hash(key);; slot = (slot + 1) & mask)
+		{
+			if (keys[slot] == key)
+			{
+				return true;
+			}
+			if (keys[slot] == MESH_EDGE_EMPTY)
+			{
+				return false;
+			}
+		}
+	}
+
+private:
+	std::vector<uint64_t> keys;
+	size_t mask;
+
+	size_t hash(uint64_t key) const
+	{
+		return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+	}
+};
+
+/* Simplify the triangle list 'indices' to about 'targetIndexCount' indices
+   by edge collapses in the order of their quadric error, never above
+   'maxError' (distance in mesh units). The vertices are not changed: the
+   result indexes the same vertex buffer and each collapse moves a vertex
+   onto one of its neighbours, so the attributes stay exact. Vertices with
+   several attribute sets at the same position (UV or colour seams) stay in
+   place and border vertices only move along their border. Collapses which
+   would flip a triangle are skipped. Returns the index count written to
+   'destination', 'resultError' gets the largest error of the collapses. */
+inline size_t meshSimplify(const float* vertices, int vertexCount, int stride, const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, std::vector<unsigned int>& destination, float* resultError = NULL)
+{
+	destination.assign(indices, indices + indexCount);
+	if (resultError)
+	{
+		*resultError = 0.0f;
+	}
+	if (indexCount <= targetIndexCount || vertexCount == 0)
+	{
+		return destination.size();
+	}
+	auto position = [&](unsigned int v) { return glm::vec3(vertices[(size_t)v * stride], vertices[(size_t)v * stride + 1], vertices[(size_t)v * stride + 2]); };
+
+	/* Vertices at the same position share a representative (the first one),
+	   the edges and borders are found on the representatives */
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<int> wedges(vertexCount, 0); // referenced vertices per representative
+	{
+		std::vector<unsigned char> used(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			used[indices[i]] = 1;
+		}
+		size_t tableSize = 1;
+		while (tableSize < (size_t)vertexCount * 2)
+		{
+			tableSize *= 2;
+		}
+		std::vector<int> table(tableSize, -1);
+		for (int v = 0; v < vertexCount; v++)
+		{
+			const float* p = vertices + (size_t)v * stride;
+			size_t slot = (size_t)hashBytes((const unsigned char*)p, 3 * sizeof(float)) & (tableSize - 1);
+			while (table[slot] >= 0 && memcmp(vertices + (size_t)table[slot] * stride, p, 3 * sizeof(float)) != 0)
+			{
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] < 0)
+			{
+				table[slot] = v;
+			}
+			remap[v] = (unsigned int)table[slot];
+			wedges[remap[v]] += used[v];
+		}
+	}
+
+	MeshEdgeSet edges(indexCount);
+	std::vector<unsigned char> nonManifold(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = remap[indices[i + e]], b = remap[indices[i + (e + 1) % 3]];
+			if (!edges.insert(a, b))
+			{
+				nonManifold[a] = nonManifold[b] = 1; // the same directed edge twice
+			}
+		}
+	}
+	std::vector<unsigned char> openOut(vertexCount, 0), openIn(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = remap[indices[i + e]], b = remap[indices[i + (e + 1) % 3]];
+			if (!edges.contains(b, a))
+			{
+				openOut[a] = (unsigned char)std::min(openOut[a] + 1, 2);
+				openIn[b] = (unsigned char)std::min(openIn[b] + 1, 2);
+			}
+		}
+	}
+	std::vector<unsigned char> kind(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		unsigned int r = remap[v];
+		if (wedges[r] > 1 || nonManifold[r])
+		{
+			kind[v] = MESH_VERTEX_LOCKED;
+		}
+		else if (openOut[r] == 0 && openIn[r] == 0)
+		{
+			kind[v] = MESH_VERTEX_MANIFOLD;
+		}
+		else
+		{
+			kind[v] = openOut[r] == 1 && openIn[r] == 1 ? MESH_VERTEX_BORDER : MESH_VERTEX_LOCKED;
+		}
+	}
+
+	/* Quadrics of the triangle planes, weighted by area, plus planes through
+	   the border edges perpendicular to their triangle */
+	std::vector<MeshQuadric> quadrics(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		quadrics[v].clear();
+	}
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		unsigned int t[3] = { indices[i], indices[i + 1], indices[i + 2] };
+		glm::dvec3 p[3] = { glm::dvec3(position(t[0])), glm::dvec3(position(t[1])), glm::dvec3(position(t[2])) };
+		glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+		double length = glm::length(normal);
+		if (length == 0.0)
+		{
+			continue;
+		}
+		normal /= length;
+		for (int e = 0; e < 3; e++)
+		{
+			quadrics[t[e]].addPlane(normal, -glm::dot(normal, p[0]), 0.5 * length);
+			unsigned int a = remap[t[e]], b = remap[t[(e + 1) % 3]];
+			if (!edges.contains(b, a))
+			{
+				glm::dvec3 edge = p[(e + 1) % 3] - p[e];
+				glm::dvec3 side = glm::cross(edge, normal);
+				double sideLength = glm::length(side);
+				if (sideLength > 0.0)
+				{
+					side /= sideLength;
+					double weight = MESH_BORDER_WEIGHT * glm::dot(edge, edge);
+					quadrics[t[e]].addPlane(side, -glm::dot(side, p[e]), weight);
+					quadrics[t[(e + 1) % 3]].addPlane(side, -glm::dot(side, p[e]), weight);
+				}
+			}
+		}
+	}
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseTarget(vertexCount);
+	std::vector<unsigned char> moved(vertexCount);
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1), adjacency;
+	double limit = (double)maxError * (double)maxError;
+	double largest = 0.0;
+
+	/* Passes of independent collapses: the vertex and the one-ring of every
+	   collapse are left alone by the others of the pass, so the flip checks
+	   see the real neighbourhood */
+	while (destination.size() > targetIndexCount)
+	{
+		size_t count = destination.size();
+		collapses.clear();
+		for (size_t i = 0; i < count; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int v0 = destination[i + e], v1 = destination[i + (e + 1) % 3];
+				unsigned int r0 = remap[v0], r1 = remap[v1];
+				bool open = !edges.contains(r1, r0);
+				if (!open && r0 > r1)
+				{
+					continue; // inner edges are seen from both triangles, keep one
+				}
+				bool forward = kind[v0] == MESH_VERTEX_MANIFOLD || (kind[v0] == MESH_VERTEX_BORDER && open);
+				bool backward = kind[v1] == MESH_VERTEX_MANIFOLD || (kind[v1] == MESH_VERTEX_BORDER && open);
+				double forwardCost = forward ? quadrics[v0].error(position(v1)) : DBL_MAX;
+				double backwardCost = backward ? quadrics[v1].error(position(v0)) : DBL_MAX;
+				if (forward || backward)
+				{
+					Collapse collapse = { forwardCost <= backwardCost ? v0 : v1, forwardCost <= backwardCost ? v1 : v0, std::min(forwardCost, backwardCost) };
+					if (collapse.cost <= limit)
+					{
+						collapses.push_back(collapse);
+					}
+				}
+			}
+		}
+		if (collapses.empty())
+		{
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (size_t i = 0; i < count; i++)
+		{
+			adjacencyOffsets[destination[i] + 1]++;
+		}
+		for (int v = 0; v < vertexCount; v++)
+		{
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		adjacency.resize(count);
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < count; i++)
+		{
+			adjacency[fill[destination[i]]++] = (unsigned int)(i / 3);
+		}
+
+		for (int v = 0; v < vertexCount; v++)
+		{
+			collapseTarget[v] = (unsigned int)v;
+		}
+		std::fill(moved.begin(), moved.end(), 0);
+		size_t goal = (count - targetIndexCount) / 3; // triangles left to remove
+		size_t removed = 0;
+		for (size_t c = 0; c < collapses.size() && removed < goal; c++)
+		{
+			const Collapse& collapse = collapses[c];
+			unsigned int v0 = collapse.from, v1 = collapse.to;
+			if (moved[v0] || moved[v1])
+			{
+				continue;
+			}
+			glm::vec3 target = position(v1);
+			bool valid = true;
+			for (unsigned int a = adjacencyOffsets[v0]; a < adjacencyOffsets[v0 + 1] && valid; a++)
+			{
+				const unsigned int* t = &destination[(size_t)adjacency[a] * 3];
+				if (moved[t[0]] || moved[t[1]] || moved[t[2]])
+				{
+					valid = false; // a neighbour collapsed in this pass
+					break;
+				}
+				if (t[0] == v1 || t[1] == v1 || t[2] == v1)
+				{
+					continue; // removed by the collapse
+				}
+				glm::vec3 p0 = position(t[0]), p1 = position(t[1]), p2 = position(t[2]);
+				glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+				(t[0] == v0 ? p0 : t[1] == v0 ? p1 : p2) = target;
+				glm::vec3 after = glm::cross(p1 - p0, p2 - p0);
+				valid = glm::dot(before, after) > 0.25f * glm::length(before) * glm::length(after);
+			}
+			if (!valid)
+			{
+				continue;
+			}
+			collapseTarget[v0] = v1;
+			moved[v0] = 1;
+			quadrics[v1].add(quadrics[v0]);
+			largest = std::max(largest, collapse.cost);
+			removed += kind[v0] == MESH_VERTEX_BORDER ? 1 : 2;
+		}
+		if (removed == 0)
+		{
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < count; i += 3)
+		{
+			unsigned int a = collapseTarget[destination[i]], b = collapseTarget[destination[i + 1]], c = collapseTarget[destination[i + 2]];
+			if (a != b && b != c && c != a)
+			{
+				destination[write++] = a;
+				destination[write++] = b;
+				destination[write++] = c;
+			}
+		}
+		destination.resize(write);
+	}
+
+	if (resultError)
+	{
+		*resultError = (float)sqrt(largest);
+	}
+	return destination.size();
+}
+
+/* One level of a LodChain: a range of its index buffer */
+struct MeshLod
+{
+	unsigned int first; // first index
+	unsigned int count;
+	float error;		// distance in mesh units to the full mesh (0 for level 0)
+};
+
+const int MESH_LOD_MAX_LEVELS = 8;
+
+/* Levels of detail of a mesh sharing its vertex buffer: the indices of all
+   the levels in one buffer, the full mesh first */
+struct LodChain
+{
+	std::vector<unsigned int> indices;
+	std::vector<MeshLod> levels;
+
+	int levelCount() const
+	{
+		return (int)levels.size();
+	}
+
+	int triangleCount(int level) const
+	{
+		return (int)(levels[level].count / 3);
+	}
+};
+
+/* Build the chain of 'indices' with up to 'maxLevels' levels: level 0 is the
+   mesh as given, every next one is simplified from the previous one to
+   'ratio' of its triangles and reordered for the vertex cache. The error of
+   a level is the sum of the errors of the steps from level 0. Stops when a
+   step removes less than 10% of the triangles (the seams and borders are
+   all that is left) or at 'minTriangles'. */
+inline void buildLodChain(const float* vertices, int vertexCount, int stride, const unsigned int* indices, size_t indexCount,
+	LodChain& chain, float ratio = 0.5f, int maxLevels = MESH_LOD_MAX_LEVELS, size_t minTriangles = 64)
+{
+	chain.indices.assign(indices, indices + indexCount);
+	chain.levels.clear();
+	MeshLod full = { 0, (unsigned int)indexCount, 0.0f };
+	chain.levels.push_back(full);
+
+	std::vector<unsigned int> source(indices, indices + indexCount), simplified;
+	while ((int)chain.levels.size() < maxLevels && source.size() / 3 > minTriangles)
+	{
+		size_t target = std::max((size_t)(source.size() / 3 * ratio), minTriangles) * 3;
+		float error = 0.0f;
+		meshSimplify(vertices, vertexCount, stride, source.data(), source.size(), target, FLT_MAX, simplified, &error);
+		if (simplified.empty() || simplified.size() > source.size() * 9 / 10)
+		{
+			break;
+		}
+		meshOptimizeVertexCache(simplified, vertexCount);
+
+		MeshLod level = { (unsigned int)chain.indices.size(), (unsigned int)simplified.size(), chain.levels.back().error + error };
+		chain.levels.push_back(level);
+		chain.indices.insert(chain.indices.end(), simplified.begin(), simplified.end());
+		source.swap(simplified);
+	}
+}
+
+/* Pixels per world unit at 'depth' in front of the camera: the projection
+   scale of the vertical axis (projection[1][1]) times half the viewport
+   height over the depth, clamped to the near plane */
+inline float lodPixelsPerUnit(const glm::mat4& projection, int viewportHeight, float depth, float nearPlane)
+{
+	return projection[1][1] * 0.5f * (float)viewportHeight / std::max(depth, nearPlane);
+}
+
+/* Per-object choice of the level by its error projected on the screen: the
+   coarsest level within 'threshold' pixels. An object goes to a finer level
+   as soon as its error is above the threshold, but to a coarser one only
+   when that level is within threshold * (1 - hysteresis), so objects near a
+   switching distance do not pop between two levels every frame. The objects
+   may be selected from several threads, each object by one of them. */
+class LodSelector
+{
+public:
+	float threshold;  // pixels
+	float hysteresis; // fraction of the threshold
+
+	LodSelector(float threshold = 1.0f, float hysteresis = 0.25f) : threshold(threshold), hysteresis(hysteresis)
+	{
+	}
+
+	void resize(int objects)
+	{
+		current.assign(objects, 0);
+	}
+
+	int level(int object) const
+	{
+		return current[object];
+	}
+
+	// 'pixelsPerUnit' of the object: lodPixelsPerUnit() times its scale
+	int select(int object, const LodChain& chain, float pixelsPerUnit)
+	{
+		int last = chain.levelCount() - 1;
+		int level = std::min((int)current[object], last);
+		if (chain.levels[level].error * pixelsPerUnit > threshold)
+		{
+			while (level > 0 && chain.levels[level].error * pixelsPerUnit > threshold)
+			{
+				level--;
+			}
+		}
+		else
+		{
+			float coarser = threshold * (1.0f - hysteresis);
+			while (level < last && chain.levels[level + 1].error * pixelsPerUnit <= coarser)
+			{
+				level++;
+			}
+		}
+		current[object] = (unsigned char)level;
+		return level;
+	}
+
+private:
+	std::vector<unsigned char> current;
+};
+
+#endif
@@ -0,0 +1,525 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "file_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Indexed triangle list with interleaved float vertices, the position in the
+   first 3 floats of each vertex */
+struct Mesh
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	int stride; // floats per vertex
+
+	Mesh() : stride(0)
+	{
+	}
+
+	int vertexCount() const
+	{
+		return stride > 0 ? (int)(vertices.size() / stride) : 0;
+	}
+
+	int triangleCount() const
+	{
+		return (int)(indices.size() / 3);
+	}
+};
+
+/* Post-transform vertex cache and vertex fetch statistics of an index buffer */
+struct MeshCacheStats
+{
+	double acmr;	 // average cache miss ratio: transformed vertices per triangle (0.5 is the best for big grids, 3 the worst)
+	double atvr;	 // average transformed to vertex ratio: transformed vertices per vertex (1 is the best)
+	double overfetch; // bytes read from the vertex buffer per byte of vertex data (1 is the best)
+};
+
+const int MESH_CACHE_SIZE = 16;		// FIFO post-transform cache used for the statistics
+const int MESH_OPTIMIZER_CACHE = 32; // LRU cache modelled by the vertex cache optimization
+
+/* Build a mesh from a non-indexed triangle list ('vertexCount' vertices of
+   'stride' floats, 3 per triangle): bitwise identical vertices are merged,
+   the unique vertices keep the order of their first use */
+inline void meshGenerateIndices(const float* vertices, int vertexCount, int stride, Mesh& mesh)
+{
+	mesh.stride = stride;
+	mesh.vertices.clear();
+	mesh.indices.resize(vertexCount);
+
+	/* Open addressing table of unique vertex indices, at most half full */
+	size_t tableSize = 1;
+	while (tableSize < (size_t)vertexCount * 2)
+	{
+		tableSize *= 2;
+	}
+	std::vector<int> table(tableSize, -1);
+	size_t vertexBytes = stride * sizeof(float);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertices + (size_t)i * stride;
+		size_t slot = (size_t)hashBytes((const unsigned char*)vertex, vertexBytes) & (tableSize - 1);
+		for (;;)
+		{
+			int unique = table[slot];
+			if (unique < 0)
+			{
+				unique = (int)(mesh.vertices.size() / stride);
+				table[slot] = unique;
+				mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + stride);
+				mesh.indices[i] = unique;
+				break;
+			}
+			if (memcmp(&mesh.vertices[(size_t)unique * stride], vertex, vertexBytes) == 0)
+			{
+				mesh.indices[i] = unique;
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+}
+
+/* Vertex cache statistics of 'indices' with a FIFO cache of 'cacheSize'
+   vertices (the usual model of the post-transform cache), and the vertex
+   fetch overfetch with a direct mapped cache of 256 lines of 64 bytes */
+inline MeshCacheStats meshAnalyzeCache(const std::vector<unsigned int>& indices, int vertexCount, int vertexBytes, int cacheSize = MESH_CACHE_SIZE)
+{
+	MeshCacheStats stats = {};
+	if (indices.empty() || vertexCount == 0)
+	{
+		return stats;
+	}
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	size_t misses = 0;
+
+	const int lines = 256, lineBytes = 64;
+	std::vector<long long> fetchCache(lines, -1);
+	size_t fetchedBytes = 0;
+	std::vector<bool> used(vertexCount, false);
+	int usedVertices = 0;
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int v = indices[i];
+		if (!used[v])
+		{
+			used[v] = true;
+			usedVertices++;
+		}
+		// a vertex is in a FIFO of N entries if it entered less than N misses ago
+		if (time - timestamps[v] <= (unsigned int)cacheSize)
+		{
+			continue;
+		}
+		timestamps[v] = time++;
+		misses++;
+
+		long long first = (long long)v * vertexBytes / lineBytes;
+		long long last = ((long long)v * vertexBytes + vertexBytes - 1) / lineBytes;
+		for (long long line = first; line <= last; line++)
+		{
+			if (fetchCache[line % lines] != line)
+			{
+				fetchCache[line % lines] = line;
+				fetchedBytes += lineBytes;
+			}
+		}
+	}
+
+	stats.acmr = (double)misses / (double)(indices.size() / 3);
+	stats.atvr = (double)misses / (double)usedVertices;
+	stats.overfetch = (double)fetchedBytes / ((double)usedVertices * vertexBytes);
+	return stats;
+}
+
+/* Triangle order for the post-transform vertex cache, after Tom Forsyth's
+   "Linear-Speed Vertex Cache Optimisation": an LRU cache is simulated and
+   the next triangle is always the best scoring one among the triangles of
+   the cached vertices. A vertex scores by its cache position (the last
+   triangle's vertices a bit less, so strips do not ping-pong) plus a bonus
+   for few remaining triangles, so no lonely triangles are left behind. */
+inline void meshOptimizeVertexCache(std::vector<unsigned int>& indices, int vertexCount)
+{
+	const int cacheSize = MESH_OPTIMIZER_CACHE;
+	int triangleCount = (int)(indices.size() / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	/* Score tables: cache position and remaining triangle count */
+	float cacheScores[cacheSize];
+	for (int p = 0; p < cacheSize; p++)
+	{
+		cacheScores[p] = p < 3 ? 0.75f : powf(1.0f - (float)(p - 3) / (float)(cacheSize - 3), 1.5f);
+	}
+	const int valenceTable = 32;
+	float valenceScores[valenceTable];
+	for (int n = 0; n < valenceTable; n++)
+	{
+		valenceScores[n] = n == 0 ? 0.0f : 2.0f / sqrtf((float)n);
+	}
+
+	/* Triangles of every vertex (compressed rows), the first 'remaining[v]' ones still to emit */
+	std::vector<int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		remaining[indices[i]]++;
+	}
+	std::vector<int> offsets(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<int> vertexTriangles(indices.size());
+	{
+		std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (int t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				vertexTriangles[fill[v]++] = t;
+			}
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	auto score = [&](unsigned int v) {
+		int n = remaining[v];
+		if (n == 0)
+		{
+			return -1.0f; // no triangle left, never selects anything
+		}
+		float s = cachePosition[v] >= 0 ? cacheScores[cachePosition[v]] : 0.0f;
+		return s + valenceScores[std::min(n, valenceTable - 1)];
+	};
+	for (int v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = score(v);
+	}
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> cache, newCache;
+	cache.reserve(cacheSize + 3);
+	newCache.reserve(cacheSize + 3);
+	int best = -1;
+	int cursor = 0; // first triangle which may not be emitted yet, for restarts
+
+	while ((int)result.size() < (int)indices.size())
+	{
+		if (best < 0)
+		{
+			/* Nothing in the cache has triangles left: take the best of the
+			   next few unemitted triangles in input order */
+			while (emitted[cursor])
+			{
+				cursor++;
+			}
+			best = cursor;
+			for (int t = cursor + 1; t < std::min(triangleCount, cursor + 64); t++)
+			{
+				if (!emitted[t] && triangleScore[t] > triangleScore[best])
+				{
+					best = t;
+				}
+			}
+		}
+
+		const unsigned int* triangle = &indices[best * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+		emitted[best] = true;
+
+		/* Move the vertices of the triangle to the front of the LRU cache */
+		newCache.assign(triangle, triangle + 3);
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+			{
+				newCache.push_back(cache[i]);
+			}
+		}
+		cache.swap(newCache);
+
+		/* Remove the triangle from the lists of its vertices */
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = triangle[k];
+			int* list = &vertexTriangles[offsets[v]];
+			for (int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == best)
+				{
+					std::swap(list[i], list[remaining[v] - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		/* Rescore the cached vertices (and the ones pushed out), then their
+		   triangles, and pick the best one for the next step */
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			cachePosition[v] = i < (size_t)cacheSize ? (int)i : -1;
+			vertexScore[v] = score(v);
+		}
+		best = -1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			const int* list = &vertexTriangles[offsets[v]];
+			for (int j = 0; j < remaining[v]; j++)
+			{
+				int t = list[j];
+				float s = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = s;
+				if (s > bestScore)
+				{
+					bestScore = s;
+					best = t;
+				}
+			}
+		}
+		if (cache.size() > (size_t)cacheSize)
+		{
+			cache.resize(cacheSize);
+		}
+	}
+	indices.swap(result);
+}
+
+/* Triangle order against overdraw, after Sander, Nehab and Barczak, "Fast
+   Triangle Reordering for Vertex Locality and Reduced Overdraw": the cache
+   optimized list is cut into clusters, and the clusters facing away from the
+   center of the mesh are drawn first, as they are the most likely to occlude
+   the rest. The cuts are made where the FIFO cache starts over anyway (a
+   triangle with 3 misses), then inside those clusters wherever the cluster
+   so far, drawn with a cold cache, stays within 'threshold' times the ACMR
+   of the whole list (e.g. 1.05). The new order is kept only if the ACMR of
+   the whole list grows by less than 'threshold'. */
+inline void meshOptimizeOverdraw(Mesh& mesh, float threshold)
+{
+	std::vector<unsigned int>& indices = mesh.indices;
+	int triangleCount = mesh.triangleCount();
+	int vertexCount = mesh.vertexCount();
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	/* Cluster boundaries */
+	std::vector<int> clusterStarts;
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = MESH_CACHE_SIZE + 1;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			if (time - timestamps[v] > (unsigned int)MESH_CACHE_SIZE)
+			{
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3)
+		{
+			clusterStarts.push_back(t);
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+	int vertexBytes = mesh.stride * (int)sizeof(float);
+	double targetAcmr = meshAnalyzeCache(indices, vertexCount, vertexBytes).acmr * threshold;
+	std::vector<int> hardStarts;
+	hardStarts.swap(clusterStarts);
+	for (size_t c = 0; c + 1 < hardStarts.size(); c++)
+	{
+		clusterStarts.push_back(hardStarts[c]);
+		time += MESH_CACHE_SIZE + 1; // cold cache
+		int clusterStart = hardStarts[c];
+		int misses = 0;
+		for (int t = hardStarts[c]; t < hardStarts[c + 1]; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (time - timestamps[v] > (unsigned int)MESH_CACHE_SIZE)
+				{
+					timestamps[v] = time++;
+					misses++;
+				}
+			}
+			int triangles = t + 1 - clusterStart;
+			if (triangles >= MESH_CACHE_SIZE && t + 1 < hardStarts[c + 1] && misses <= targetAcmr * triangles)
+			{
+				clusterStarts.push_back(t + 1);
+				clusterStart = t + 1;
+				misses = 0;
+				time += MESH_CACHE_SIZE + 1;
+			}
+		}
+	}
+	int clusterCount = (int)clusterStarts.size();
+	clusterStarts.push_back(triangleCount);
+	if (clusterCount < 2)
+	{
+		return;
+	}
+
+	/* Mesh center: area weighted centroid */
+	const float* p = mesh.vertices.data();
+	int stride = mesh.stride;
+	auto position = [&](unsigned int v, int axis) { return p[(size_t)v * stride + axis]; };
+	double center[3] = { 0.0, 0.0, 0.0 };
+	double totalArea = 0.0;
+	std::vector<double> clusterArea(clusterCount, 0.0);
+	std::vector<double> clusterCentroid(clusterCount * 3, 0.0), clusterNormal(clusterCount * 3, 0.0);
+	for (int c = 0; c < clusterCount; c++)
+	{
+		for (int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			unsigned int a = indices[t * 3], b = indices[t * 3 + 1], d = indices[t * 3 + 2];
+			double e1[3], e2[3], n[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				e1[axis] = position(b, axis) - position(a, axis);
+				e2[axis] = position(d, axis) - position(a, axis);
+			}
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			double area = 0.5 * sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				double centroid = (position(a, axis) + position(b, axis) + position(d, axis)) / 3.0;
+				clusterCentroid[c * 3 + axis] += centroid * area;
+				clusterNormal[c * 3 + axis] += n[axis]; // length is twice the area: area weighted
+				center[axis] += centroid * area;
+			}
+			clusterArea[c] += area;
+			totalArea += area;
+		}
+	}
+	if (totalArea <= 0.0)
+	{
+		return;
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis] /= totalArea;
+	}
+
+	/* Sort key: how much the cluster faces away from the mesh center */
+	std::vector<double> keys(clusterCount, 0.0);
+	for (int c = 0; c < clusterCount; c++)
+	{
+		if (clusterArea[c] <= 0.0)
+		{
+			continue;
+		}
+		double dot = 0.0, length = 0.0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			double offset = clusterCentroid[c * 3 + axis] / clusterArea[c] - center[axis];
+			dot += offset * clusterNormal[c * 3 + axis];
+			length += clusterNormal[c * 3 + axis] * clusterNormal[c * 3 + axis];
+		}
+		keys[c] = length > 0.0 ? dot / sqrt(length) : 0.0;
+	}
+	std::vector<int> order(clusterCount);
+	for (int c = 0; c < clusterCount; c++)
+	{
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] > keys[b]; });
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (int i = 0; i < clusterCount; i++)
+	{
+		int c = order[i];
+		sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+	}
+
+	if (meshAnalyzeCache(sorted, vertexCount, vertexBytes).acmr <= targetAcmr)
+	{
+		indices.swap(sorted);
+	}
+}
+
+/* Vertex order for fetch locality: the vertices are renumbered in the order
+   the index buffer first uses them, so the vertex fetch walks the buffer
+   forward. Unreferenced vertices are dropped. */
+inline void meshOptimizeVertexFetch(Mesh& mesh)
+{
+	int vertexCount = mesh.vertexCount();
+	int stride = mesh.stride;
+	std::vector<int> remap(vertexCount, -1);
+	std::vector<float> vertices;
+	vertices.reserve(mesh.vertices.size());
+	int next = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		unsigned int v = mesh.indices[i];
+		if (remap[v] < 0)
+		{
+			remap[v] = next++;
+			vertices.insert(vertices.end(), mesh.vertices.begin() + (size_t)v * stride, mesh.vertices.begin() + (size_t)(v + 1) * stride);
+		}
+		mesh.indices[i] = remap[v];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+/* Statistics of one run of optimizeMesh() */
+struct MeshOptimizeStats
+{
+	int inputVertices;
+	int vertices;
+	int triangles;
+	MeshCacheStats before; // indexed, in the input triangle order
+	MeshCacheStats after;
+};
+
+/* The whole pipeline for a non-indexed triangle list: index, vertex cache
+   order, overdraw order (within 5% of the cache optimized ACMR), vertex
+   fetch order */
+inline MeshOptimizeStats optimizeMesh(const float* vertices, int vertexCount, int stride, Mesh& mesh)
+{
+	MeshOptimizeStats stats = {};
+	stats.inputVertices = vertexCount;
+	meshGenerateIndices(vertices, vertexCount, stride, mesh);
+	int vertexBytes = stride * (int)sizeof(float);
+	stats.before = meshAnalyzeCache(mesh.indices, mesh.vertexCount(), vertexBytes);
+
+	meshOptimizeVertexCache(mesh.indices, mesh.vertexCount());
+	meshOptimizeOverdraw(mesh, 1.05f);
+	meshOptimizeVertexFetch(mesh);
+
+	stats.vertices = mesh.vertexCount();
+	stats.triangles = mesh.triangleCount();
+	stats.after = meshAnalyzeCache(mesh.indices, mesh.vertexCount(), vertexBytes);
+	return stats;
+}
+
+#endif
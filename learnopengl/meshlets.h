@@ -0,0 +1,344 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include "glm/glm.hpp"
+
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#endif
+
+const int MESHLET_MAX_VERTICES = 64;   // default vertex limit of a meshlet
+const int MESHLET_MAX_TRIANGLES = 124; // default triangle limit of a meshlet
+
+/* Cluster of triangles, contiguous in the index range reordered by
+   buildMeshlets() */
+struct Meshlet
+{
+	unsigned int firstIndex; // relative to the start of the range
+	unsigned int triangleCount;
+	unsigned int vertexCount; // distinct vertices
+};
+
+/* Culling data of the meshlets of a mesh, as structure of arrays like
+   BoundsBatch: a bounding sphere and a normal cone (axis, cutoff) each. All
+   the triangles of a meshlet face away from a camera at c when
+   dot(center - c, axis) >= cutoff * length(center - c) + radius; a cutoff of
+   1 never culls (triangles facing more than ~84 degrees apart). */
+class MeshletSet
+{
+public:
+	std::vector<Meshlet> meshlets;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> axisX, axisY, axisZ, cutoff;
+
+	int size() const
+	{
+		return (int)meshlets.size();
+	}
+
+	void clear()
+	{
+		meshlets.clear();
+		centerX.clear(); centerY.clear(); centerZ.clear(); radius.clear();
+		axisX.clear(); axisY.clear(); axisZ.clear(); cutoff.clear();
+	}
+
+	void add(const Meshlet& meshlet, const glm::vec3& center, float sphereRadius, const glm::vec3& axis, float coneCutoff)
+	{
+		meshlets.push_back(meshlet);
+		centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+		radius.push_back(sphereRadius);
+		axisX.push_back(axis.x); axisY.push_back(axis.y); axisZ.push_back(axis.z);
+		cutoff.push_back(coneCutoff);
+	}
+};
+
+/* Split the triangles 'indices' [0, indexCount) into meshlets of at most
+   'maxVertices' vertices and 'maxTriangles' triangles, reordering the indices
+   so each meshlet is one contiguous range. Positions are the first 3 of
+   'stride' floats of each vertex, the front faces counter-clockwise.
+
+   Greedy growth over the vertex adjacency: each step adds the triangle
+   touching the meshlet which brings the fewest new vertices, ties broken by
+   how close its normal is to the average normal so far (tighter cones). A
+   meshlet is closed when it is full or has no neighbour left; the next one
+   starts at the first triangle not taken, in index order, which the vertex
+   cache optimizer already made local. */
+inline void buildMeshlets(const float* vertices, int vertexCount, int stride, unsigned int* indices, size_t indexCount, MeshletSet& set,
+	int maxVertices = MESHLET_MAX_VERTICES, int maxTriangles = MESHLET_MAX_TRIANGLES)
+{
+	set.clear();
+	size_t triangleCount = indexCount / 3;
+	auto position = [&](unsigned int v) {
+		const float* p = vertices + (size_t)v * stride;
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+
+	std::vector<glm::vec3> normals(triangleCount);
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), c = position(indices[t * 3 + 2]);
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f); // degenerate: no direction
+		for (int k = 0; k < 3; k++)
+		{
+			adjacencyOffsets[indices[t * 3 + k] + 1]++;
+		}
+	}
+	for (int v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	std::vector<unsigned int> adjacency(adjacencyOffsets[vertexCount]);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<unsigned char> taken(triangleCount, 0);
+	std::vector<int> vertexMeshlet(vertexCount, -1); // last meshlet which used the vertex
+	std::vector<unsigned int> order;
+	order.reserve(triangleCount * 3);
+	std::vector<unsigned int> meshletVertices, meshletTriangles;
+	glm::vec3 normalSum(0.0f);
+	size_t seed = 0;
+
+	auto finish = [&]() {
+		Meshlet meshlet = { (unsigned int)order.size(), (unsigned int)meshletTriangles.size(), (unsigned int)meshletVertices.size() };
+		glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+		for (size_t v = 0; v < meshletVertices.size(); v++)
+		{
+			low = glm::min(low, position(meshletVertices[v]));
+			high = glm::max(high, position(meshletVertices[v]));
+		}
+		glm::vec3 center = 0.5f * (low + high);
+		float radius = 0.0f;
+		for (size_t v = 0; v < meshletVertices.size(); v++)
+		{
+			radius = std::max(radius, glm::length(position(meshletVertices[v]) - center));
+		}
+
+		float axisLength = glm::length(normalSum);
+		glm::vec3 axis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(1.0f, 0.0f, 0.0f);
+		float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+		for (size_t t = 0; t < meshletTriangles.size(); t++)
+		{
+			unsigned int triangle = meshletTriangles[t];
+			if (normals[triangle] != glm::vec3(0.0f))
+			{
+				minDot = std::min(minDot, glm::dot(normals[triangle], axis));
+			}
+			order.push_back(indices[triangle * 3]);
+			order.push_back(indices[triangle * 3 + 1]);
+			order.push_back(indices[triangle * 3 + 2]);
+		}
+		// sine of the spread of the normals, the backfacing directions are within 90 degrees minus it of the axis
+		float cutoff = minDot <= 0.1f ? 1.0f : sqrtf(1.0f - minDot * minDot);
+		set.add(meshlet, center, radius, axis, cutoff);
+		meshletVertices.clear();
+		meshletTriangles.clear();
+		normalSum = glm::vec3(0.0f);
+	};
+
+	for (;;)
+	{
+		int meshletId = set.size();
+		long long best = -1;
+		if (!meshletTriangles.empty())
+		{
+			float bestScore = FLT_MAX;
+			glm::vec3 averageNormal = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+			for (size_t v = 0; v < meshletVertices.size(); v++)
+			{
+				unsigned int vertex = meshletVertices[v];
+				for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+				{
+					unsigned int triangle = adjacency[a];
+					if (taken[triangle])
+					{
+						continue;
+					}
+					int extra = 0;
+					for (int k = 0; k < 3; k++)
+					{
+						extra += vertexMeshlet[indices[triangle * 3 + k]] != meshletId ? 1 : 0;
+					}
+					if ((int)meshletVertices.size() + extra > maxVertices)
+					{
+						continue;
+					}
+					float score = (float)extra + 0.5f * (1.0f - glm::dot(normals[triangle], averageNormal));
+					if (score < bestScore)
+					{
+						bestScore = score;
+						best = triangle;
+					}
+				}
+			}
+			if (best < 0)
+			{
+				finish();
+				continue;
+			}
+		}
+		else
+		{
+			while (seed < triangleCount && taken[seed])
+			{
+				seed++;
+			}
+			if (seed == triangleCount)
+			{
+				break;
+			}
+			best = (long long)seed;
+		}
+
+		taken[best] = 1;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int vertex = indices[best * 3 + k];
+			if (vertexMeshlet[vertex] != meshletId)
+			{
+				vertexMeshlet[vertex] = meshletId;
+				meshletVertices.push_back(vertex);
+			}
+		}
+		meshletTriangles.push_back((unsigned int)best);
+		normalSum += normals[best];
+		if ((int)meshletTriangles.size() == maxTriangles)
+		{
+			finish();
+		}
+	}
+	std::copy(order.begin(), order.end(), indices);
+}
+
+/* Index range of the visible meshlets, adjacent meshlets merged */
+struct MeshletRange
+{
+	unsigned int firstIndex;
+	unsigned int count;
+};
+
+/* What cullMeshlets() rejected, accumulated over calls */
+struct MeshletCullStats
+{
+	long long meshlets;
+	long long frustumCulled;
+	long long coneCulled; // in the frustum but back-facing
+	long long triangles;
+	long long trianglesRejected;
+	long long ranges; // emitted
+};
+
+/* Meshlet culling for one view, in the space of the mesh: 'frustum' from
+   projection * view * model and 'camera' the eye position in that space.
+   The visible meshlets are appended to 'ranges' as index ranges offset by
+   'baseIndex', merged when contiguous. 4 meshlets are tested at once with
+   SSE2 ('simd' false forces the scalar path, which gives the same result).
+   Returns the number of ranges. */
+inline int cullMeshlets(const MeshletSet& set, const Frustum& frustum, const glm::vec3& camera, unsigned int baseIndex,
+	std::vector<MeshletRange>& ranges, MeshletCullStats* stats = NULL, bool simd = true)
+{
+	ranges.clear();
+	int count = set.size();
+	long long frustumCulled = 0, coneCulled = 0, trianglesRejected = 0, triangles = 0;
+	auto emit = [&](int m, int culled) {
+		const Meshlet& meshlet = set.meshlets[m];
+		triangles += meshlet.triangleCount;
+		if (culled)
+		{
+			frustumCulled += culled == 1 ? 1 : 0;
+			coneCulled += culled == 2 ? 1 : 0;
+			trianglesRejected += meshlet.triangleCount;
+			return;
+		}
+		unsigned int first = baseIndex + meshlet.firstIndex;
+		if (!ranges.empty() && ranges.back().firstIndex + ranges.back().count == first)
+		{
+			ranges.back().count += meshlet.triangleCount * 3;
+		}
+		else
+		{
+			MeshletRange range = { first, meshlet.triangleCount * 3 };
+			ranges.push_back(range);
+		}
+	};
+
+	int i = 0;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	if (simd)
+	{
+		__m128 planes[6][4];
+		for (int p = 0; p < 6; p++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+			}
+		}
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 cameraX = _mm_set1_ps(camera.x), cameraY = _mm_set1_ps(camera.y), cameraZ = _mm_set1_ps(camera.z);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&set.centerX[i]);
+			__m128 y = _mm_loadu_ps(&set.centerY[i]);
+			__m128 z = _mm_loadu_ps(&set.centerZ[i]);
+			__m128 r = _mm_loadu_ps(&set.radius[i]);
+			__m128 outside = zero;
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+					_mm_mul_ps(planes[p][2], z)), planes[p][3]);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, r), zero));
+			}
+			__m128 dx = _mm_sub_ps(x, cameraX), dy = _mm_sub_ps(y, cameraY), dz = _mm_sub_ps(z, cameraZ);
+			__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&set.axisX[i])), _mm_mul_ps(dy, _mm_loadu_ps(&set.axisY[i]))),
+				_mm_mul_ps(dz, _mm_loadu_ps(&set.axisZ[i])));
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			__m128 backfacing = _mm_cmpge_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&set.cutoff[i]), length), r));
+			int outsideMask = _mm_movemask_ps(outside), backfacingMask = _mm_movemask_ps(backfacing);
+			for (int k = 0; k < 4; k++)
+			{
+				emit(i + k, (outsideMask >> k) & 1 ? 1 : (backfacingMask >> k) & 1 ? 2 : 0);
+			}
+		}
+	}
+#endif
+	/* Scalar path (and the remaining meshlets of the SIMD path) */
+	for (; i < count; i++)
+	{
+		glm::vec3 center(set.centerX[i], set.centerY[i], set.centerZ[i]);
+		float dx = center.x - camera.x, dy = center.y - camera.y, dz = center.z - camera.z;
+		float along = (dx * set.axisX[i] + dy * set.axisY[i]) + dz * set.axisZ[i];
+		float length = sqrtf((dx * dx + dy * dy) + dz * dz);
+		emit(i, !frustum.sphereVisible(center, set.radius[i]) ? 1 : along >= set.cutoff[i] * length + set.radius[i] ? 2 : 0);
+	}
+
+	if (stats)
+	{
+		stats->meshlets += count;
+		stats->frustumCulled += frustumCulled;
+		stats->coneCulled += coneCulled;
+		stats->triangles += triangles;
+		stats->trianglesRejected += trianglesRejected;
+		stats->ranges += (long long)ranges.size();
+	}
+	return (int)ranges.size();
+}
+
+#endif
@@ -0,0 +1,1136 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "gl_state.h"
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Vertex of the loaded models. Missing normals and tex coords are zero. */
+struct ModelVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+// position at location 0, normal at 1 and tex coords at 2
+inline const VertexLayout& modelVertexLayout()
+{
+	static const VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(ModelVertex, position, 0, "aPos"),
+		VERTEX_ATTRIBUTE(ModelVertex, normal, 1, "aNormal"),
+		VERTEX_ATTRIBUTE(ModelVertex, texCoord, 2, "aTexCoord")
+	};
+	static const VertexLayout layout = vertexLayout<ModelVertex>(attributes);
+	return layout;
+}
+
+/* Timings and size of the last ModelLoader::load() */
+struct ModelLoadStats
+{
+	size_t fileBytes;
+	long long vertices;
+	long long triangles;
+	int chunks;		 // parallel work items of the parse
+	double mapMs;	 // open and map the file
+	double countMs;	 // OBJ: count the elements of every chunk, glTF: parse the JSON
+	double parseMs;	 // OBJ: parse the numbers and merge the vertices of every chunk
+	double writeMs;	 // write the output buffers
+	double totalMs;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	double megabytesPerSecond() const
+	{
+		return totalMs > 0.0 ? (double)fileBytes / (1024.0 * 1024.0) / (totalMs / 1000.0) : 0.0;
+	}
+
+	double trianglesPerSecond() const
+	{
+		return totalMs > 0.0 ? (double)triangles / (totalMs / 1000.0) : 0.0;
+	}
+};
+
+/* Output of the loaders in ordinary memory, kept from load to load */
+class ModelMemory
+{
+public:
+	size_t vertexCount;
+	size_t indexCount;
+
+	ModelMemory() : vertexCount(0), indexCount(0), vertexCapacity(0), indexCapacity(0)
+	{
+	}
+
+	// the loaders ask for the indices first, then the vertices; both are only written to
+	uint32_t* indices(size_t count)
+	{
+		if (count > indexCapacity)
+		{
+			indexStorage.reset(new uint32_t[count]);
+			indexCapacity = count;
+		}
+		indexCount = count;
+		return indexStorage.get();
+	}
+
+	ModelVertex* vertices(size_t count)
+	{
+		if (count > vertexCapacity)
+		{
+			vertexStorage.reset(new ModelVertex[count]);
+			vertexCapacity = count;
+		}
+		vertexCount = count;
+		return vertexStorage.get();
+	}
+
+	const ModelVertex* vertexData() const { return vertexStorage.get(); }
+	const uint32_t* indexData() const { return indexStorage.get(); }
+
+private:
+	std::unique_ptr<ModelVertex[]> vertexStorage;
+	std::unique_ptr<uint32_t[]> indexStorage;
+	size_t vertexCapacity;
+	size_t indexCapacity;
+};
+
+/* Output of the loaders straight into a vertex and an index buffer object:
+   both are mapped (through the copy targets, so no VAO is needed) and the
+   parser threads write into the mappings. The mappings are write-only (and
+   often write-combined): the loaders write every element once and never
+   read it back. Call finish() on the GL thread after the load. */
+class ModelBuffers
+{
+public:
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	size_t vertexCount;
+	size_t indexCount;
+
+	ModelBuffers() : vertexBuffer(0), indexBuffer(0), vertexCount(0), indexCount(0), vertexMapped(false), indexMapped(false)
+	{
+	}
+
+	~ModelBuffers()
+	{
+		finish();
+		if (vertexBuffer)
+		{
+			glDeleteBuffers(1, &vertexBuffer);
+			glState().bufferDeleted(vertexBuffer);
+		}
+		if (indexBuffer)
+		{
+			glDeleteBuffers(1, &indexBuffer);
+			glState().bufferDeleted(indexBuffer);
+		}
+	}
+
+	uint32_t* indices(size_t count)
+	{
+		indexCount = count;
+		return (uint32_t*)map(GL_COPY_WRITE_BUFFER, indexBuffer, count * sizeof(uint32_t));
+	}
+
+	ModelVertex* vertices(size_t count)
+	{
+		vertexCount = count;
+		return (ModelVertex*)map(GL_COPY_READ_BUFFER, vertexBuffer, count * sizeof(ModelVertex));
+	}
+
+	// unmap the buffers, false if the data was lost (glUnmapBuffer)
+	bool finish()
+	{
+		bool valid = true;
+		if (vertexMapped)
+		{
+			glState().bindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+			valid = glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_TRUE && valid;
+			vertexMapped = false;
+		}
+		if (indexMapped)
+		{
+			glState().bindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+			valid = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE && valid;
+			indexMapped = false;
+		}
+		return valid;
+	}
+
+private:
+	bool vertexMapped;
+	bool indexMapped;
+
+	void* map(GLenum target, GLuint& buffer, size_t bytes)
+	{
+		if (!buffer)
+		{
+			glGenBuffers(1, &buffer);
+		}
+		glState().bindBuffer(target, buffer);
+		glBufferData(target, (GLsizeiptr)std::max(bytes, (size_t)4), NULL, GL_STATIC_DRAW);
+		void* mapped = glMapBufferRange(target, 0, (GLsizeiptr)std::max(bytes, (size_t)4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		(target == GL_COPY_READ_BUFFER ? vertexMapped : indexMapped) = mapped != NULL;
+		return mapped;
+	}
+};
+
+/* Minimal JSON document, enough for the glTF header */
+struct GltfJson
+{
+	enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+	Type type;
+	double number;			   // JSON_NUMBER, JSON_BOOL (0 / 1)
+	std::string string;		   // JSON_STRING
+	std::vector<GltfJson> items; // JSON_ARRAY elements, JSON_OBJECT values
+	std::vector<std::string> keys; // JSON_OBJECT keys
+
+	GltfJson() : type(JSON_NULL), number(0.0)
+	{
+	}
+
+	const GltfJson* get(const char* key) const
+	{
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			if (keys[i] == key)
+			{
+				return &items[i];
+			}
+		}
+		return NULL;
+	}
+
+	const GltfJson* at(double index) const
+	{
+		return type == JSON_ARRAY && index >= 0.0 && index < (double)items.size() ? &items[(size_t)index] : NULL;
+	}
+
+	// number member, 'fallback' if it is missing
+	double get(const char* key, double fallback) const
+	{
+		const GltfJson* value = get(key);
+		return value && value->type == JSON_NUMBER ? value->number : fallback;
+	}
+
+	static bool parse(const char* text, size_t size, GltfJson& document)
+	{
+		const char* p = text;
+		const char* end = text + size;
+		return parseValue(p, end, document, 0) && (skipSpace(p, end), p == end || *p == '\0');
+	}
+
+private:
+	static void skipSpace(const char*& p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+		{
+			p++;
+		}
+	}
+
+	static bool parseString(const char*& p, const char* end, std::string& out)
+	{
+		p++; // opening quote
+		out.clear();
+		while (p < end && *p != '"')
+		{
+			if (*p == '\\' && p + 1 < end)
+			{
+				p++;
+				switch (*p)
+				{
+				case 'n': out += '\n'; break;
+				case 't': out += '\t'; break;
+				case 'r': out += '\r'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'u': out += '?'; p += std::min((ptrdiff_t)4, end - p - 1); break; // names only, no need to decode
+				default: out += *p; break;
+				}
+				p++;
+			}
+			else
+			{
+				out += *p++;
+			}
+		}
+		if (p >= end)
+		{
+			return false;
+		}
+		p++; // closing quote
+		return true;
+	}
+
+	static bool parseValue(const char*& p, const char* end, GltfJson& value, int depth)
+	{
+		skipSpace(p, end);
+		if (p >= end || depth > 64)
+		{
+			return false;
+		}
+		if (*p == '{' || *p == '[')
+		{
+			bool object = *p == '{';
+			char close = object ? '}' : ']';
+			value.type = object ? JSON_OBJECT : JSON_ARRAY;
+			p++;
+			skipSpace(p, end);
+			if (p < end && *p == close)
+			{
+				p++;
+				return true;
+			}
+			while (p < end)
+			{
+				if (object)
+				{
+					skipSpace(p, end);
+					value.keys.push_back(std::string());
+					if (p >= end || *p != '"' || !parseString(p, end, value.keys.back()))
+					{
+						return false;
+					}
+					skipSpace(p, end);
+					if (p >= end || *p != ':')
+					{
+						return false;
+					}
+					p++;
+				}
+				value.items.push_back(GltfJson());
+				if (!parseValue(p, end, value.items.back(), depth + 1))
+				{
+					return false;
+				}
+				skipSpace(p, end);
+				if (p < end && *p == ',')
+				{
+					p++;
+					continue;
+				}
+				if (p < end && *p == close)
+				{
+					p++;
+					return true;
+				}
+				return false;
+			}
+			return false;
+		}
+		if (*p == '"')
+		{
+			value.type = JSON_STRING;
+			return parseString(p, end, value.string);
+		}
+		if (end - p >= 4 && strncmp(p, "true", 4) == 0) { value.type = JSON_BOOL; value.number = 1.0; p += 4; return true; }
+		if (end - p >= 5 && strncmp(p, "false", 5) == 0) { value.type = JSON_BOOL; p += 5; return true; }
+		if (end - p >= 4 && strncmp(p, "null", 4) == 0) { value.type = JSON_NULL; p += 4; return true; }
+
+		char* numberEnd = NULL;
+		std::string number(p, std::min((size_t)(end - p), (size_t)64));
+		value.type = JSON_NUMBER;
+		value.number = strtod(number.c_str(), &numberEnd);
+		if (numberEnd == number.c_str())
+		{
+			return false;
+		}
+		p += numberEnd - number.c_str();
+		return true;
+	}
+};
+
+/* Loads Wavefront OBJ and binary glTF (.glb) files from a memory mapping,
+   straight into the output (ModelMemory, ModelBuffers, or any class with the
+   same indices() and vertices() members).
+
+   OBJ is parsed in chunks of whole lines on the thread pool. A first pass
+   counts the v / vt / vn / f lines of every chunk, so every chunk knows
+   where its attributes go and how to resolve relative (negative) indices.
+   The second pass parses the numbers and merges the identical v/vt/vn
+   corners of each chunk, keeping the triangles in chunk-local indices. The
+   last pass writes the vertices and the indices, moved to the first vertex
+   of their chunk, into the output: each element is written once, the
+   output is never read. Corners shared by two chunks are stored twice, which
+   costs a few vertices per chunk. Faces with more than 3 corners are fanned.
+   Groups, materials, lines and points are ignored.
+
+   glTF binary buffers are read in place: the accessors point into the
+   mapping and are interleaved into the output in parallel, nothing else is
+   copied. The triangle primitives of all meshes are concatenated, the node
+   transforms are not applied. Only the GLB buffer is supported, not
+   external .bin files or data URIs. */
+class ModelLoader
+{
+public:
+	static const size_t OBJ_CHUNK_BYTES = 4 << 20;
+
+	template <class Output>
+	bool load(const char* path, Output& output, ModelLoadStats& stats, ThreadPool* pool = NULL)
+	{
+		std::string name(path);
+		std::string extension = name.size() >= 4 ? name.substr(name.size() - 4) : std::string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == ".glb")
+		{
+			return loadGlb(path, output, stats, pool);
+		}
+		if (extension == ".obj")
+		{
+			return loadObj(path, output, stats, pool);
+		}
+		std::cout << "ERROR::MODEL::UNKNOWN_FORMAT " << path << std::endl;
+		return false;
+	}
+
+	template <class Output>
+	bool loadObj(const char* path, Output& output, ModelLoadStats& stats, ThreadPool* pool = NULL)
+	{
+		Clock::time_point start = Clock::now();
+		memset(&stats, 0, sizeof(stats));
+		MappedFile file;
+		if (!file.open(path))
+		{
+			std::cout << "ERROR::MODEL::CANNOT_OPEN " << path << std::endl;
+			return false;
+		}
+		stats.fileBytes = file.size();
+		Clock::time_point mapped = Clock::now();
+
+		/* Chunks of whole lines */
+		const char* text = (const char*)file.data();
+		const char* textEnd = text + file.size();
+		size_t chunkCount = std::max((size_t)1, (file.size() + OBJ_CHUNK_BYTES - 1) / OBJ_CHUNK_BYTES);
+		chunks.resize(chunkCount);
+		const char* begin = text;
+		for (size_t c = 0; c < chunkCount; c++)
+		{
+			const char* end = c + 1 == chunkCount ? textEnd : std::max(begin, text + (c + 1) * file.size() / chunkCount);
+			while (end < textEnd && end[-1] != '\n')
+			{
+				end++;
+			}
+			chunks[c].begin = begin;
+			chunks[c].end = end;
+			begin = end;
+		}
+		stats.chunks = (int)chunkCount;
+
+		/* 1. Count the elements of every chunk */
+		forChunks(pool, [&](size_t c) { countObjChunk(chunks[c]); });
+		uint32_t positions = 0, texCoords = 0, normals = 0, triangles = 0;
+		for (size_t c = 0; c < chunkCount; c++)
+		{
+			ObjChunk& chunk = chunks[c];
+			chunk.positionBase = positions;
+			chunk.texCoordBase = texCoords;
+			chunk.normalBase = normals;
+			chunk.triangleBase = triangles;
+			positions += chunk.positions;
+			texCoords += chunk.texCoords;
+			normals += chunk.normals;
+			triangles += chunk.triangles;
+		}
+		objPositions.resize(positions);
+		objTexCoords.resize(texCoords);
+		objNormals.resize(normals);
+		Clock::time_point counted = Clock::now();
+
+		/* 2. Parse the attributes, merge the corners and keep the local indices */
+		std::atomic<bool> valid(true);
+		forChunks(pool, [&](size_t c) {
+			if (!parseObjChunk(chunks[c], positions, texCoords, normals))
+			{
+				valid = false;
+			}
+		});
+		if (!valid)
+		{
+			std::cout << "ERROR::MODEL::INVALID_OBJ " << path << std::endl;
+			return false;
+		}
+		uint32_t vertexCount = 0;
+		stats.boundsMin = glm::vec3(0.0f);
+		stats.boundsMax = glm::vec3(0.0f);
+		for (size_t c = 0; c < chunkCount; c++)
+		{
+			chunks[c].vertexBase = vertexCount;
+			vertexCount += (uint32_t)chunks[c].corners.size();
+		}
+		boundsOf(objPositions.data(), objPositions.size(), stats);
+		uint32_t* indices = output.indices((size_t)triangles * 3);
+		ModelVertex* vertices = output.vertices(vertexCount);
+		if ((!indices && triangles > 0) || (!vertices && vertexCount > 0))
+		{
+			std::cout << "ERROR::MODEL::OUT_OF_MEMORY " << path << std::endl;
+			return false;
+		}
+		Clock::time_point parsed = Clock::now();
+
+		/* 3. Write the vertices and the offset indices */
+		forChunks(pool, [&](size_t c) { writeObjChunk(chunks[c], vertices, indices); });
+		Clock::time_point written = Clock::now();
+
+		stats.vertices = vertexCount;
+		stats.triangles = triangles;
+		stats.mapMs = milliseconds(start, mapped);
+		stats.countMs = milliseconds(mapped, counted);
+		stats.parseMs = milliseconds(counted, parsed);
+		stats.writeMs = milliseconds(parsed, written);
+		stats.totalMs = milliseconds(start, written);
+		return true;
+	}
+
+	template <class Output>
+	bool loadGlb(const char* path, Output& output, ModelLoadStats& stats, ThreadPool* pool = NULL)
+	{
+		Clock::time_point start = Clock::now();
+		memset(&stats, 0, sizeof(stats));
+		MappedFile file;
+		if (!file.open(path))
+		{
+			std::cout << "ERROR::MODEL::CANNOT_OPEN " << path << std::endl;
+			return false;
+		}
+		stats.fileBytes = file.size();
+		Clock::time_point mapped = Clock::now();
+
+		/* Header, JSON chunk and BIN chunk */
+		const unsigned char* bytes = file.data();
+		uint32_t header[5];
+		if (file.size() < 20 || (memcpy(header, bytes, 20), header[0] != 0x46546C67u /* glTF */) || header[1] != 2 || header[2] > file.size()
+			|| header[4] != 0x4E4F534Au /* JSON */ || 20 + (size_t)header[3] > header[2])
+		{
+			std::cout << "ERROR::MODEL::INVALID_GLB " << path << std::endl;
+			return false;
+		}
+		GltfJson document;
+		if (!GltfJson::parse((const char*)bytes + 20, header[3], document))
+		{
+			std::cout << "ERROR::MODEL::INVALID_GLTF_JSON " << path << std::endl;
+			return false;
+		}
+		const unsigned char* bin = NULL;
+		size_t binSize = 0;
+		size_t binHeader = 20 + ((header[3] + 3) & ~3u);
+		if (binHeader + 8 <= header[2])
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, bytes + binHeader, 8);
+			if (chunk[1] == 0x004E4942u /* BIN */ && binHeader + 8 + (size_t)chunk[0] <= header[2])
+			{
+				bin = bytes + binHeader + 8;
+				binSize = chunk[0];
+			}
+		}
+
+		/* The triangle primitives and their accessors */
+		primitives.clear();
+		size_t vertexCount = 0, indexCount = 0;
+		const GltfJson* meshes = document.get("meshes");
+		for (size_t m = 0; meshes && m < meshes->items.size(); m++)
+		{
+			const GltfJson* list = meshes->items[m].get("primitives");
+			for (size_t p = 0; list && p < list->items.size(); p++)
+			{
+				const GltfJson& primitive = list->items[p];
+				if (primitive.get("mode", 4.0) != 4.0)
+				{
+					continue; // not GL_TRIANGLES
+				}
+				const GltfJson* attributes = primitive.get("attributes");
+				GlbPrimitive view;
+				if (!attributes || !accessor(document, attributes->get("POSITION"), bin, binSize, 5126, 3, view.position)
+					|| !accessor(document, attributes->get("NORMAL"), bin, binSize, 5126, 3, view.normal, true)
+					|| !accessor(document, attributes->get("TEXCOORD_0"), bin, binSize, 5126, 2, view.texCoord, true)
+					|| !accessor(document, primitive.get("indices"), bin, binSize, 0, 1, view.indices, true)
+					|| (view.normal.data && view.normal.count != view.position.count)
+					|| (view.texCoord.data && view.texCoord.count != view.position.count)
+					|| (view.indices.data ? view.indices.count : view.position.count) % 3 != 0)
+				{
+					std::cout << "ERROR::MODEL::UNSUPPORTED_GLTF_PRIMITIVE " << path << " mesh " << m << " primitive " << p << std::endl;
+					return false;
+				}
+				view.vertexBase = vertexCount;
+				view.indexBase = indexCount;
+				vertexCount += view.position.count;
+				indexCount += view.indices.data ? view.indices.count : view.position.count;
+				primitives.push_back(view);
+			}
+		}
+		Clock::time_point counted = Clock::now();
+
+		uint32_t* indices = output.indices(indexCount);
+		ModelVertex* vertices = output.vertices(vertexCount);
+		if ((!indices && indexCount > 0) || (!vertices && vertexCount > 0))
+		{
+			std::cout << "ERROR::MODEL::OUT_OF_MEMORY " << path << std::endl;
+			return false;
+		}
+
+		/* Interleave the attributes and rebase the indices, in blocks of one primitive */
+		const size_t BLOCK = 65536;
+		blocks.clear();
+		for (size_t p = 0; p < primitives.size(); p++)
+		{
+			size_t count = std::max(primitives[p].position.count, primitives[p].indices.data ? primitives[p].indices.count : 0);
+			for (size_t first = 0; first < count; first += BLOCK)
+			{
+				GlbBlock block = { p, first, std::min(count, first + BLOCK) };
+				blocks.push_back(block);
+			}
+		}
+		std::atomic<bool> valid(true);
+		auto writeBlocks = [&](int blockBegin, int blockEnd) {
+			for (int b = blockBegin; b < blockEnd; b++)
+			{
+				if (!writeGlbBlock(primitives[blocks[b].primitive], blocks[b].begin, blocks[b].end, vertices, indices, indexCount))
+				{
+					valid = false;
+				}
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor((int)blocks.size(), 1, writeBlocks);
+		}
+		else
+		{
+			writeBlocks(0, (int)blocks.size());
+		}
+		if (!valid)
+		{
+			std::cout << "ERROR::MODEL::INVALID_GLTF_INDEX " << path << std::endl;
+			return false;
+		}
+		Clock::time_point written = Clock::now();
+		for (size_t p = 0; p < primitives.size(); p++) // from the file, the output is write-only
+		{
+			boundsOf(primitives[p].position, p == 0, stats);
+		}
+
+		stats.vertices = (long long)vertexCount;
+		stats.triangles = (long long)(indexCount / 3);
+		stats.chunks = (int)blocks.size();
+		stats.mapMs = milliseconds(start, mapped);
+		stats.countMs = milliseconds(mapped, counted);
+		stats.writeMs = milliseconds(counted, written);
+		stats.totalMs = milliseconds(start, written);
+		return true;
+	}
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	/* v/vt/vn of one OBJ corner, 0 based, -1 when absent */
+	struct ObjCorner
+	{
+		int32_t position;
+		int32_t texCoord;
+		int32_t normal;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+		uint32_t positions, texCoords, normals, triangles; // elements in the chunk
+		uint32_t positionBase, texCoordBase, normalBase;   // elements before the chunk
+		uint32_t triangleBase;
+		uint32_t vertexBase;
+		std::vector<uint32_t> indices;	// the triangles, index in corners
+		std::vector<ObjCorner> corners; // the merged corners, vertices of the chunk
+		std::vector<uint32_t> table;	// hash table of the merge, index in corners
+	};
+
+	/* A mapped glTF accessor */
+	struct GlbView
+	{
+		const unsigned char* data; // NULL if absent
+		size_t stride;
+		size_t count;
+		int componentType;
+	};
+
+	struct GlbPrimitive
+	{
+		GlbView position, normal, texCoord, indices;
+		size_t vertexBase;
+		size_t indexBase;
+	};
+
+	struct GlbBlock
+	{
+		size_t primitive;
+		size_t begin;
+		size_t end;
+	};
+
+	std::vector<ObjChunk> chunks;
+	std::vector<glm::vec3> objPositions;
+	std::vector<glm::vec2> objTexCoords;
+	std::vector<glm::vec3> objNormals;
+	std::vector<GlbPrimitive> primitives;
+	std::vector<GlbBlock> blocks;
+
+	static double milliseconds(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+	template <class F>
+	void forChunks(ThreadPool* pool, F fn)
+	{
+		if (!pool)
+		{
+			for (size_t c = 0; c < chunks.size(); c++)
+			{
+				fn(c);
+			}
+			return;
+		}
+		pool->parallelFor((int)chunks.size(), 1, [&](int begin, int end) {
+			for (int c = begin; c < end; c++)
+			{
+				fn((size_t)c);
+			}
+		});
+	}
+
+	static void boundsOf(const glm::vec3* positions, size_t count, ModelLoadStats& stats)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			stats.boundsMin = i == 0 ? positions[i] : glm::min(stats.boundsMin, positions[i]);
+			stats.boundsMax = i == 0 ? positions[i] : glm::max(stats.boundsMax, positions[i]);
+		}
+	}
+
+	// add the positions of 'view' to the bounds ('first': start them over)
+	static void boundsOf(const GlbView& view, bool first, ModelLoadStats& stats)
+	{
+		for (size_t i = 0; i < view.count; i++)
+		{
+			glm::vec3 position;
+			memcpy(&position, view.data + i * view.stride, sizeof(position));
+			stats.boundsMin = first && i == 0 ? position : glm::min(stats.boundsMin, position);
+			stats.boundsMax = first && i == 0 ? position : glm::max(stats.boundsMax, position);
+		}
+	}
+
+	/* OBJ tokens. The lines are never copied, the parsers run on the mapping. */
+	static const char* skipBlank(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	static const char* nextLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+		return newline ? newline + 1 : end;
+	}
+
+	/* Decimal number with optional fraction and exponent. Up to 15
+	   significant digits and 22 decimal places the double is correctly
+	   rounded (one product or quotient of exact values); it is rounded again
+	   to float, which can be 1 ulp off strtof in rare halfway cases. Longer
+	   numbers and digits past the 19th are only approximate: exact to float
+	   precision for typical OBJ data, not correctly rounded. */
+	static const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		static const double powers[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		p = skipBlank(p, end);
+		bool negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			p++;
+		}
+		uint64_t mantissa = 0;
+		int exponent = 0, digits = 0;
+		const char* first = p;
+		for (; p < end && *p >= '0' && *p <= '9'; p++)
+		{
+			if (digits < 19) { mantissa = mantissa * 10 + (uint64_t)(*p - '0'); digits += mantissa > 0; }
+			else { exponent++; }
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+			{
+				if (digits < 19) { mantissa = mantissa * 10 + (uint64_t)(*p - '0'); digits += mantissa > 0; exponent--; }
+			}
+		}
+		if (p == first)
+		{
+			value = 0.0f;
+			return NULL;
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* q = p + 1;
+			bool negativeExponent = q < end && *q == '-';
+			if (q < end && (*q == '-' || *q == '+'))
+			{
+				q++;
+			}
+			int e = 0;
+			for (; q < end && *q >= '0' && *q <= '9'; q++)
+			{
+				e = std::min(e * 10 + (*q - '0'), 1000);
+			}
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+		double result = (double)mantissa;
+		if (exponent >= 0)
+		{
+			result = exponent <= 22 ? result * powers[exponent] : result * pow(10.0, exponent);
+		}
+		else
+		{
+			result = exponent >= -22 ? result / powers[-exponent] : result * pow(10.0, exponent);
+		}
+		value = (float)(negative ? -result : result);
+		return p;
+	}
+
+	static const char* parseInt(const char* p, const char* end, int64_t& value)
+	{
+		bool negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			p++;
+		}
+		const char* first = p;
+		int64_t result = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; p++)
+		{
+			result = std::min(result * 10 + (*p - '0'), (int64_t)1 << 40);
+		}
+		value = negative ? -result : result;
+		return p == first ? NULL : p;
+	}
+
+	// OBJ index (1 based, or negative from the end) to 0 based, -1 if invalid
+	static int32_t resolveIndex(int64_t index, uint32_t before, uint32_t total)
+	{
+		int64_t resolved = index > 0 ? index - 1 : (int64_t)before + index;
+		return index != 0 && resolved >= 0 && resolved < (int64_t)total ? (int32_t)resolved : -1;
+	}
+
+	// kind of the OBJ line at 'p': 'v', 't' (vt), 'n' (vn), 'f' or 0
+	static char lineType(const char* p, const char* end)
+	{
+		if (end - p < 2)
+		{
+			return 0;
+		}
+		if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			return 'f';
+		}
+		if (p[0] != 'v')
+		{
+			return 0;
+		}
+		if (p[1] == ' ' || p[1] == '\t')
+		{
+			return 'v';
+		}
+		if (end - p >= 3 && (p[2] == ' ' || p[2] == '\t') && (p[1] == 't' || p[1] == 'n'))
+		{
+			return p[1];
+		}
+		return 0;
+	}
+
+	static void countObjChunk(ObjChunk& chunk)
+	{
+		chunk.positions = chunk.texCoords = chunk.normals = chunk.triangles = 0;
+		for (const char* p = chunk.begin; p < chunk.end;)
+		{
+			const char* line = skipBlank(p, chunk.end);
+			p = nextLine(line, chunk.end);
+			switch (lineType(line, p))
+			{
+			case 'v': chunk.positions++; break;
+			case 't': chunk.texCoords++; break;
+			case 'n': chunk.normals++; break;
+			case 'f':
+			{
+				int corners = 0;
+				for (const char* q = line + 1; q < p; )
+				{
+					q = skipBlank(q, p);
+					if (q >= p || *q == '\r' || *q == '\n' || *q == '#')
+					{
+						break;
+					}
+					corners++;
+					while (q < p && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n')
+					{
+						q++;
+					}
+				}
+				chunk.triangles += corners >= 3 ? corners - 2 : 0;
+				break;
+			}
+			default: break;
+			}
+		}
+	}
+
+	bool parseObjChunk(ObjChunk& chunk, uint32_t totalPositions, uint32_t totalTexCoords, uint32_t totalNormals)
+	{
+		glm::vec3* positions = objPositions.data() + chunk.positionBase;
+		glm::vec2* texCoords = objTexCoords.data() + chunk.texCoordBase;
+		glm::vec3* normals = objNormals.data() + chunk.normalBase;
+		chunk.indices.resize((size_t)chunk.triangles * 3);
+		uint32_t* out = chunk.indices.data();
+		uint32_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+
+		/* Hash table of the corners: at most 3 per triangle, kept under half full */
+		size_t tableSize = 64;
+		while (tableSize < (size_t)chunk.triangles * 3 * 2)
+		{
+			tableSize *= 2;
+		}
+		chunk.table.assign(tableSize, 0xFFFFFFFFu);
+		chunk.corners.clear();
+
+		for (const char* p = chunk.begin; p < chunk.end;)
+		{
+			const char* line = skipBlank(p, chunk.end);
+			p = nextLine(line, chunk.end);
+			char type = lineType(line, p);
+			if (type == 'v' || type == 'n')
+			{
+				glm::vec3 v(0.0f);
+				const char* q = line + (type == 'v' ? 1 : 2);
+				for (int k = 0; k < 3 && q; k++)
+				{
+					q = parseFloat(q, p, v[k]);
+				}
+				if (!q)
+				{
+					return false;
+				}
+				if (type == 'v')
+				{
+					positions[positionCount++] = v;
+				}
+				else
+				{
+					normals[normalCount++] = v;
+				}
+			}
+			else if (type == 't')
+			{
+				glm::vec2 t(0.0f);
+				const char* q = parseFloat(line + 2, p, t.x);
+				if (!q)
+				{
+					return false;
+				}
+				const char* r = parseFloat(q, p, t.y); // v is optional
+				texCoords[texCoordCount++] = r ? t : glm::vec2(t.x, 0.0f);
+			}
+			else if (type == 'f')
+			{
+				uint32_t first = 0, previous = 0;
+				int corner = 0;
+				for (const char* q = skipBlank(line + 1, p); q < p && *q != '\r' && *q != '\n' && *q != '#'; q = skipBlank(q, p), corner++)
+				{
+					int64_t v = 0, t = 0, n = 0;
+					q = parseInt(q, p, v);
+					if (q && q < p && *q == '/')
+					{
+						q++;
+						if (q < p && *q != '/')
+						{
+							q = parseInt(q, p, t);
+						}
+						if (q && q < p && *q == '/')
+						{
+							q = parseInt(q + 1, p, n);
+						}
+					}
+					ObjCorner c;
+					c.position = q ? resolveIndex(v, chunk.positionBase + positionCount, totalPositions) : -1;
+					c.texCoord = t ? resolveIndex(t, chunk.texCoordBase + texCoordCount, totalTexCoords) : -1;
+					c.normal = n ? resolveIndex(n, chunk.normalBase + normalCount, totalNormals) : -1;
+					if (c.position < 0 || (t && c.texCoord < 0) || (n && c.normal < 0))
+					{
+						return false;
+					}
+					uint32_t vertex = mergeCorner(chunk, c);
+					if (corner == 0)
+					{
+						first = vertex;
+					}
+					else if (corner >= 2)
+					{
+						*out++ = first;
+						*out++ = previous;
+						*out++ = vertex;
+					}
+					previous = vertex;
+				}
+			}
+		}
+		std::vector<uint32_t>().swap(chunk.table); // only needed by the parse
+		return true;
+	}
+
+	static uint32_t mergeCorner(ObjChunk& chunk, const ObjCorner& c)
+	{
+		size_t mask = chunk.table.size() - 1;
+		size_t slot = ((uint32_t)c.position * 73856093u ^ (uint32_t)c.texCoord * 19349663u ^ (uint32_t)c.normal * 83492791u) & mask;
+		for (;;)
+		{
+			uint32_t index = chunk.table[slot];
+			if (index == 0xFFFFFFFFu)
+			{
+				index = (uint32_t)chunk.corners.size();
+				chunk.corners.push_back(c);
+				chunk.table[slot] = index;
+				return index;
+			}
+			const ObjCorner& existing = chunk.corners[index];
+			if (existing.position == c.position && existing.texCoord == c.texCoord && existing.normal == c.normal)
+			{
+				return index;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	void writeObjChunk(const ObjChunk& chunk, ModelVertex* vertices, uint32_t* indices) const
+	{
+		ModelVertex* out = vertices + chunk.vertexBase;
+		for (size_t i = 0; i < chunk.corners.size(); i++)
+		{
+			const ObjCorner& c = chunk.corners[i];
+			out[i].position = objPositions[c.position];
+			out[i].normal = c.normal >= 0 ? objNormals[c.normal] : glm::vec3(0.0f);
+			out[i].texCoord = c.texCoord >= 0 ? objTexCoords[c.texCoord] : glm::vec2(0.0f);
+		}
+		uint32_t* index = indices + (size_t)chunk.triangleBase * 3;
+		for (size_t i = 0; i < chunk.indices.size(); i++)
+		{
+			index[i] = chunk.indices[i] + chunk.vertexBase;
+		}
+	}
+
+	/* Accessor 'reference' of 'document' in the BIN chunk. componentType 0
+	   accepts the index types (5121, 5123, 5125). */
+	static bool accessor(const GltfJson& document, const GltfJson* reference, const unsigned char* bin, size_t binSize,
+		int componentType, int components, GlbView& view, bool optional = false)
+	{
+		memset(&view, 0, sizeof(view));
+		if (!reference)
+		{
+			return optional;
+		}
+		const GltfJson* accessors = document.get("accessors");
+		const GltfJson* a = accessors ? accessors->at(reference->number) : NULL;
+		const GltfJson* views = document.get("bufferViews");
+		const GltfJson* bufferView = a && views ? views->at(a->get("bufferView", -1.0)) : NULL;
+		if (!a || !bufferView || !bin || a->get("sparse") || bufferView->get("buffer", 0.0) != 0.0)
+		{
+			return false;
+		}
+		static const char* typeNames[5] = { "", "SCALAR", "VEC2", "VEC3", "VEC4" };
+		const GltfJson* type = a->get("type");
+		int accessorType = (int)a->get("componentType", 0.0);
+		if (!type || type->string != typeNames[components]
+			|| (componentType ? accessorType != componentType : (accessorType != 5121 && accessorType != 5123 && accessorType != 5125)))
+		{
+			return false;
+		}
+		size_t componentSize = accessorType == 5121 ? 1 : (accessorType == 5123 ? 2 : 4);
+		size_t elementSize = componentSize * components;
+		size_t offset = (size_t)bufferView->get("byteOffset", 0.0) + (size_t)a->get("byteOffset", 0.0);
+		size_t length = (size_t)bufferView->get("byteLength", 0.0);
+		view.count = (size_t)a->get("count", 0.0);
+		view.stride = (size_t)bufferView->get("byteStride", (double)elementSize);
+		view.componentType = accessorType;
+		size_t viewEnd = (size_t)bufferView->get("byteOffset", 0.0) + length;
+		if (view.count == 0 || view.stride < elementSize || viewEnd > binSize
+			|| offset + view.stride * (view.count - 1) + elementSize > viewEnd)
+		{
+			return false;
+		}
+		view.data = bin + offset;
+		return true;
+	}
+
+	/* Vertices and indices [begin, end) of a primitive */
+	static bool writeGlbBlock(const GlbPrimitive& p, size_t begin, size_t end, ModelVertex* vertices, uint32_t* indices, size_t indexCount)
+	{
+		for (size_t i = begin; i < std::min(end, p.position.count); i++)
+		{
+			ModelVertex& v = vertices[p.vertexBase + i];
+			memcpy(&v.position, p.position.data + i * p.position.stride, sizeof(glm::vec3));
+			if (p.normal.data)
+			{
+				memcpy(&v.normal, p.normal.data + i * p.normal.stride, sizeof(glm::vec3));
+			}
+			else
+			{
+				v.normal = glm::vec3(0.0f);
+			}
+			if (p.texCoord.data)
+			{
+				memcpy(&v.texCoord, p.texCoord.data + i * p.texCoord.stride, sizeof(glm::vec2));
+			}
+			else
+			{
+				v.texCoord = glm::vec2(0.0f);
+			}
+		}
+		size_t primitiveIndices = p.indices.data ? p.indices.count : p.position.count;
+		bool valid = true;
+		for (size_t i = begin; i < std::min(end, primitiveIndices) && p.indexBase + i < indexCount; i++)
+		{
+			uint32_t index = (uint32_t)i;
+			if (p.indices.data)
+			{
+				const unsigned char* source = p.indices.data + i * p.indices.stride;
+				if (p.indices.componentType == 5121) { index = source[0]; }
+				else if (p.indices.componentType == 5123) { uint16_t value; memcpy(&value, source, 2); index = value; }
+				else { memcpy(&index, source, 4); }
+			}
+			valid = valid && index < p.position.count;
+			indices[p.indexBase + i] = (uint32_t)p.vertexBase + (index < p.position.count ? index : 0);
+		}
+		return valid;
+	}
+};
+
+#endif
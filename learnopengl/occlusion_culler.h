@@ -0,0 +1,437 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include "glm/glm.hpp"
+
+#include "frustum_culling.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#endif
+
+const int OCCLUSION_TILE = 32; // width and height of the raster tiles in pixels
+
+/* Work of the last frame of an OcclusionCuller */
+struct OcclusionStats
+{
+	long long occluderTriangles; // given to addOccluder()
+	long long rasterTriangles;	 // left after clipping and back face culling
+	long long binnedTriangles;	 // sum over the tiles
+	long long tested;			 // boxes given to cullBoxes()
+	long long occluded;
+	double binMs;	  // transform, clip and bin the occluders
+	double rasterMs;  // rasterize the tiles
+	double pyramidMs; // build the Hi-Z pyramid
+	double testMs;	  // test the boxes
+
+	double totalMs() const
+	{
+		return binMs + rasterMs + pyramidMs + testMs;
+	}
+
+	double occludedPercent() const
+	{
+		return tested > 0 ? 100.0 * (double)occluded / (double)tested : 0.0;
+	}
+};
+
+/* Software occlusion culling on the CPU.
+
+   A frame starts with beginFrame(viewProjection). addOccluder() transforms
+   the triangles of an occluder mesh, clips them against the near plane,
+   drops the back faces and bins them into the tiles of OCCLUSION_TILE
+   pixels they touch. render() rasterizes the tiles in parallel on the
+   thread pool (each tile owns its pixels, SSE2 for 4 pixels at once, with a
+   scalar fallback), keeping the nearest depth, then builds the Hi-Z pyramid
+   where every texel is the farthest depth of the 2x2 texels below it.
+   boxVisible() and cullBoxes() then test world space boxes: a box is hidden
+   when its nearest depth is behind the farthest occluder depth of the
+   pyramid texels covering its screen rectangle, read at the level where
+   that rectangle is at most 2x2 texels.
+
+   The depth is the window depth z/w in [0, 1] (1 is the far plane). Boxes
+   crossing the near plane are always visible. The width and height must be
+   powers of two and multiples of OCCLUSION_TILE. A pixel counts as covered
+   when its center is, so an occluder may hide an object visible through
+   gaps thinner than a pixel of the buffer: keep the occluders inside the
+   rendered meshes. */
+class OcclusionCuller
+{
+public:
+	OcclusionStats stats;
+
+	OcclusionCuller(int width = 256, int height = 128) : bufferWidth(width), bufferHeight(height)
+	{
+		tilesX = width / OCCLUSION_TILE;
+		tilesY = height / OCCLUSION_TILE;
+		bins.resize(tilesX * tilesY);
+		for (int w = width, h = height; w > 0 && h > 0; w /= 2, h /= 2)
+		{
+			pyramid.push_back(std::vector<float>((size_t)w * h, 1.0f));
+		}
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	int width() const { return bufferWidth; }
+	int height() const { return bufferHeight; }
+	int levels() const { return (int)pyramid.size(); }
+
+	// depth of the texel (x, y) of the pyramid level 'level' (0: the depth buffer)
+	float depth(int x, int y, int level = 0) const
+	{
+		return pyramid[level][(size_t)y * (bufferWidth >> level) + x];
+	}
+
+	// clear the occluders, 'viewProjection' is projection * view
+	void beginFrame(const glm::mat4& viewProjection)
+	{
+		matrix = viewProjection;
+		triangles.clear();
+		for (size_t b = 0; b < bins.size(); b++)
+		{
+			bins[b].clear();
+		}
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	/* Add the triangles 'indices' of an occluder mesh, the position in the
+	   first 3 of 'stride' floats of each vertex, placed by 'model'. The front
+	   faces are counter-clockwise. */
+	void addOccluder(const float* vertices, int vertexCount, int stride, const unsigned int* indices, int indexCount, const glm::mat4& model)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		glm::mat4 transform = matrix * model;
+		clip.resize(vertexCount);
+		for (int v = 0; v < vertexCount; v++)
+		{
+			const float* p = vertices + (size_t)v * stride;
+			clip[v] = transform * glm::vec4(p[0], p[1], p[2], 1.0f);
+		}
+		for (int i = 0; i + 2 < indexCount; i += 3)
+		{
+			glm::vec4 polygon[4];
+			int count = clipNear(clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]], polygon);
+			for (int k = 2; k < count; k++)
+			{
+				binTriangle(polygon[0], polygon[k - 1], polygon[k]);
+			}
+		}
+		stats.occluderTriangles += indexCount / 3;
+		stats.binMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// rasterize the binned occluders and build the pyramid
+	void render(ThreadPool* pool = NULL)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		int tiles = tilesX * tilesY;
+		auto rasterTiles = [this](int begin, int end) {
+			for (int t = begin; t < end; t++)
+			{
+				rasterTile(t);
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(tiles, 4, rasterTiles);
+		}
+		else
+		{
+			rasterTiles(0, tiles);
+		}
+		for (int t = 0; t < tiles; t++)
+		{
+			stats.binnedTriangles += (long long)bins[t].size();
+		}
+		std::chrono::high_resolution_clock::time_point rastered = std::chrono::high_resolution_clock::now();
+
+		for (int level = 1; level < levels(); level++)
+		{
+			int w = bufferWidth >> level, h = bufferHeight >> level;
+			const float* below = pyramid[level - 1].data();
+			float* texels = pyramid[level].data();
+			for (int y = 0; y < h; y++)
+			{
+				const float* row0 = below + (size_t)(2 * y) * (2 * w);
+				const float* row1 = row0 + 2 * w;
+				for (int x = 0; x < w; x++)
+				{
+					texels[(size_t)y * w + x] = std::max(std::max(row0[2 * x], row0[2 * x + 1]), std::max(row1[2 * x], row1[2 * x + 1]));
+				}
+			}
+		}
+		std::chrono::high_resolution_clock::time_point built = std::chrono::high_resolution_clock::now();
+		stats.rasterMs = std::chrono::duration<double, std::milli>(rastered - start).count();
+		stats.pyramidMs = std::chrono::duration<double, std::milli>(built - rastered).count();
+	}
+
+	// axis aligned box of half size 'extent' in world space
+	bool boxVisible(const glm::vec3& center, const glm::vec3& extent) const
+	{
+		// the corners are the transformed center plus or minus the transformed half axes
+		glm::vec4 middle = matrix * glm::vec4(center, 1.0f);
+		glm::vec4 axisX = matrix[0] * extent.x, axisY = matrix[1] * extent.y, axisZ = matrix[2] * extent.z;
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = FLT_MAX;
+		for (int c = 0; c < 8; c++)
+		{
+			glm::vec4 p = middle + (c & 1 ? axisX : -axisX) + (c & 2 ? axisY : -axisY) + (c & 4 ? axisZ : -axisZ);
+			if (p.z < -p.w || p.w <= 0.0f)
+			{
+				return true; // crosses the near plane
+			}
+			float inverseW = 1.0f / p.w;
+			float x = (p.x * inverseW * 0.5f + 0.5f) * bufferWidth, y = (p.y * inverseW * 0.5f + 0.5f) * bufferHeight;
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+			nearest = std::min(nearest, p.z * inverseW * 0.5f + 0.5f);
+		}
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)bufferWidth || minY >= (float)bufferHeight)
+		{
+			return false; // off screen
+		}
+		int x0 = std::max((int)minX, 0), x1 = std::min((int)maxX, bufferWidth - 1);
+		int y0 = std::max((int)minY, 0), y1 = std::min((int)maxY, bufferHeight - 1);
+		int level = 0;
+		while (level + 1 < levels() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		{
+			level++;
+		}
+		for (int y = y0 >> level; y <= y1 >> level; y++)
+		{
+			for (int x = x0 >> level; x <= x1 >> level; x++)
+			{
+				if (depth(x, y, level) >= nearest)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	/* Test the boxes list[0 .. count) of 'bounds' (all of them when 'list'
+	   is NULL) and write the visible ones to 'visible', in the same order.
+	   Returns their number. */
+	int cullBoxes(const BoundsBatch& bounds, const int* list, int count, std::vector<int>& visible, ThreadPool* pool = NULL)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		const int block = 4096;
+		visible.resize(std::max(count, 1));
+		int blocks = (count + block - 1) / block;
+		blockCounts.assign(blocks, 0);
+		auto testBlocks = [&](int first, int last) {
+			for (int b = first; b < last; b++)
+			{
+				int visibleCount = 0;
+				int* out = visible.data() + (size_t)b * block;
+				for (int k = b * block; k < std::min(count, (b + 1) * block); k++)
+				{
+					int i = list ? list[k] : k;
+					out[visibleCount] = i;
+					visibleCount += boxVisible(glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]),
+						glm::vec3(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i])) ? 1 : 0;
+				}
+				blockCounts[b] = visibleCount;
+			}
+		};
+		if (pool && blocks > 1)
+		{
+			pool->parallelFor(blocks, 1, testBlocks);
+		}
+		else
+		{
+			testBlocks(0, blocks);
+		}
+
+		int visibleCount = 0;
+		for (int b = 0; b < blocks; b++)
+		{
+			if (visibleCount != b * block && blockCounts[b] > 0)
+			{
+				memmove(&visible[visibleCount], &visible[(size_t)b * block], blockCounts[b] * sizeof(int));
+			}
+			visibleCount += blockCounts[b];
+		}
+		stats.tested += count;
+		stats.occluded += count - visibleCount;
+		stats.testMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return visibleCount;
+	}
+
+private:
+	/* Triangle ready for the rasterizer: the edge functions A * x + B * y + C
+	   (positive inside) at the pixel centers and the depth plane */
+	struct RasterTriangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthX, depthY, depthC; // depth = depthX * x + depthY * y + depthC
+		int minX, minY, maxX, maxY;	  // pixel bounds, inclusive
+	};
+
+	int bufferWidth, bufferHeight;
+	int tilesX, tilesY;
+	glm::mat4 matrix;
+	std::vector<glm::vec4> clip;
+	std::vector<RasterTriangle> triangles;
+	std::vector<std::vector<int> > bins;		// triangles of each tile
+	std::vector<std::vector<float> > pyramid; // level 0 is the depth buffer
+	std::vector<int> blockCounts;
+
+	// clip the triangle against the near plane (z >= -w), returns the number of vertices (0, 3 or 4)
+	static int clipNear(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, glm::vec4* out)
+	{
+		const glm::vec4 input[3] = { a, b, c };
+		float distance[3] = { a.z + a.w, b.z + b.w, c.z + c.w };
+		if (distance[0] >= 0.0f && distance[1] >= 0.0f && distance[2] >= 0.0f)
+		{
+			out[0] = a; out[1] = b; out[2] = c;
+			return 3;
+		}
+		int count = 0;
+		for (int v = 0; v < 3; v++)
+		{
+			int next = (v + 1) % 3;
+			if (distance[v] >= 0.0f)
+			{
+				out[count++] = input[v];
+			}
+			if ((distance[v] >= 0.0f) != (distance[next] >= 0.0f))
+			{
+				float t = distance[v] / (distance[v] - distance[next]);
+				out[count++] = input[v] + t * (input[next] - input[v]);
+			}
+		}
+		return count;
+	}
+
+	void binTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+	{
+		const glm::vec4* clipped[3] = { &a, &b, &c };
+		float x[3], y[3], z[3];
+		for (int v = 0; v < 3; v++)
+		{
+			const glm::vec4& p = *clipped[v];
+			if (p.w <= 0.0f)
+			{
+				return;
+			}
+			x[v] = (p.x / p.w * 0.5f + 0.5f) * bufferWidth;
+			y[v] = (p.y / p.w * 0.5f + 0.5f) * bufferHeight;
+			z[v] = p.z / p.w * 0.5f + 0.5f;
+		}
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area <= 0.0f)
+		{
+			return; // back face or degenerate
+		}
+
+		RasterTriangle triangle;
+		// pixels whose center (x + 0.5, y + 0.5) may be inside
+		triangle.minX = std::max((int)std::ceil(std::min(x[0], std::min(x[1], x[2])) - 0.5f), 0);
+		triangle.maxX = std::min((int)std::floor(std::max(x[0], std::max(x[1], x[2])) - 0.5f), bufferWidth - 1);
+		triangle.minY = std::max((int)std::ceil(std::min(y[0], std::min(y[1], y[2])) - 0.5f), 0);
+		triangle.maxY = std::min((int)std::floor(std::max(y[0], std::max(y[1], y[2])) - 0.5f), bufferHeight - 1);
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		{
+			return;
+		}
+		for (int e = 0; e < 3; e++)
+		{
+			int from = e, to = (e + 1) % 3;
+			// (to - from) x (p - from), evaluated at the pixel centers
+			triangle.edgeA[e] = -(y[to] - y[from]);
+			triangle.edgeB[e] = x[to] - x[from];
+			triangle.edgeC[e] = (y[to] - y[from]) * (x[from] - 0.5f) - (x[to] - x[from]) * (y[from] - 0.5f);
+		}
+		triangle.depthX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+		triangle.depthY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+		triangle.depthC = z[0] - triangle.depthX * (x[0] - 0.5f) - triangle.depthY * (y[0] - 0.5f);
+
+		int index = (int)triangles.size();
+		triangles.push_back(triangle);
+		stats.rasterTriangles++;
+		for (int ty = triangle.minY / OCCLUSION_TILE; ty <= triangle.maxY / OCCLUSION_TILE; ty++)
+		{
+			for (int tx = triangle.minX / OCCLUSION_TILE; tx <= triangle.maxX / OCCLUSION_TILE; tx++)
+			{
+				bins[ty * tilesX + tx].push_back(index);
+			}
+		}
+	}
+
+	void rasterTile(int tile)
+	{
+		int tileX = (tile % tilesX) * OCCLUSION_TILE, tileY = (tile / tilesX) * OCCLUSION_TILE;
+		float* buffer = pyramid[0].data();
+		for (int y = tileY; y < tileY + OCCLUSION_TILE; y++)
+		{
+			std::fill(buffer + (size_t)y * bufferWidth + tileX, buffer + (size_t)y * bufferWidth + tileX + OCCLUSION_TILE, 1.0f);
+		}
+		const std::vector<int>& bin = bins[tile];
+		for (size_t t = 0; t < bin.size(); t++)
+		{
+			const RasterTriangle& tri = triangles[bin[t]];
+			int x0 = std::max(tri.minX, tileX), x1 = std::min(tri.maxX, tileX + OCCLUSION_TILE - 1);
+			int y0 = std::max(tri.minY, tileY), y1 = std::min(tri.maxY, tileY + OCCLUSION_TILE - 1);
+			for (int y = y0; y <= y1; y++)
+			{
+				float* row = buffer + (size_t)y * bufferWidth;
+				float fy = (float)y;
+				int x = x0;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+				/* 4 pixels at once from a multiple of 4, which stays inside the
+				   tile; the lanes outside [x0, x1] are masked */
+				x = x0 & ~3;
+				const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+				const __m128 zero = _mm_setzero_ps();
+				__m128 rowEdge[3], stepEdge[3];
+				for (int e = 0; e < 3; e++)
+				{
+					rowEdge[e] = _mm_set1_ps(tri.edgeB[e] * fy + tri.edgeC[e]);
+					stepEdge[e] = _mm_set1_ps(tri.edgeA[e]);
+				}
+				__m128 rowDepth = _mm_set1_ps(tri.depthY * fy + tri.depthC);
+				__m128 stepDepth = _mm_set1_ps(tri.depthX);
+				__m128 first = _mm_set1_ps((float)x0 - 0.5f), last = _mm_set1_ps((float)x1 + 0.5f);
+				for (; x <= x1; x += 4)
+				{
+					__m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+					__m128 inside = _mm_and_ps(_mm_cmpgt_ps(px, first), _mm_cmplt_ps(px, last));
+					for (int e = 0; e < 3; e++)
+					{
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[e], px), rowEdge[e]), zero));
+					}
+					__m128 z = _mm_add_ps(_mm_mul_ps(stepDepth, px), rowDepth);
+					__m128 stored = _mm_loadu_ps(row + x);
+					__m128 nearer = _mm_min_ps(stored, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+				}
+#endif
+				/* Scalar path */
+				for (; x <= x1; x++)
+				{
+					float fx = (float)x;
+					bool inside = true;
+					for (int e = 0; e < 3; e++)
+					{
+						inside = inside && tri.edgeA[e] * fx + tri.edgeB[e] * fy + tri.edgeC[e] >= 0.0f;
+					}
+					if (inside)
+					{
+						row[x] = std::min(row[x], tri.depthX * fx + tri.depthY * fy + tri.depthC);
+					}
+				}
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef REMAP_LUT_H
+#define REMAP_LUT_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include "camera_model.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* How a remap LUT stores its source texture coordinates */
+enum LutEncoding
+{
+	LUT_UNORM16, // GL_RG16: coordinate * 65534, 65535 marks the pixels the camera does not see (1/65534 texel steps)
+	LUT_HALF	 // GL_RG16F: coordinate as half float, -1 marks the pixels the camera does not see (11 bit mantissa)
+};
+
+inline const char* lutEncodingName(LutEncoding encoding)
+{
+	return encoding == LUT_HALF ? "half" : "unorm16";
+}
+
+/* Per-pixel remap table of a view: for every pixel (top row first) the
+   texture coordinates in the camera image to sample, two 16-bit values.
+   shader_remap.fs samples it with GL_NEAREST and then the camera image, so
+   an undistorted view costs two texture fetches per pixel. */
+class RemapLut
+{
+public:
+	int width, height;
+	LutEncoding encoding;
+	std::vector<uint16_t> texels; // u, v per pixel
+	GLuint texture;				  // 0 until the first upload()
+
+	RemapLut() : width(0), height(0), encoding(LUT_UNORM16), texture(0)
+	{
+	}
+
+	~RemapLut()
+	{
+		if (texture)
+		{
+			glDeleteTextures(1, &texture);
+			glState().textureDeleted(texture);
+		}
+	}
+
+	void resize(int w, int h, LutEncoding e)
+	{
+		width = w;
+		height = h;
+		encoding = e;
+		texels.resize((size_t)w * h * 2);
+	}
+
+	// texture coordinates of pixel (x, y) in the camera image, false where the camera sees nothing
+	bool lookup(int x, int y, glm::vec2& coordinates) const
+	{
+		const uint16_t* texel = &texels[((size_t)y * width + x) * 2];
+		if (encoding == LUT_HALF)
+		{
+			coordinates = glm::vec2(glm::unpackHalf1x16(texel[0]), glm::unpackHalf1x16(texel[1]));
+			return coordinates.x >= 0.0f;
+		}
+		coordinates = glm::vec2(texel[0], texel[1]) / 65534.0f;
+		return texel[0] != 65535;
+	}
+
+	// multiplier turning a texel sampled from the texture into texture coordinates (the 'lutScale' uniform)
+	float shaderScale() const
+	{
+		return encoding == LUT_HALF ? 1.0f : 65535.0f / 65534.0f;
+	}
+
+	/* Send the table to its texture, allocated on the first call only: a
+	   new calibration of the same view is a glTexSubImage2D */
+	void upload()
+	{
+		GLenum internalFormat = encoding == LUT_HALF ? GL_RG16F : GL_RG16;
+		GLenum type = encoding == LUT_HALF ? GL_HALF_FLOAT : GL_UNSIGNED_SHORT;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (texture == 0)
+		{
+			glGenTextures(1, &texture);
+			glState().bindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RG, type, texels.data());
+			return;
+		}
+		glState().bindTexture(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RG, type, texels.data());
+	}
+};
+
+/* Half float of a texture coordinate in [0, 1], rounded to nearest even
+   (values under 2^-14 become denormals). Integer operations only, so the
+   SSE2 path below gives the same bits. */
+inline uint16_t lutHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	if (bits < (113u << 23))
+	{
+		// denormal: let the float adder align the mantissa
+		float aligned = value + 0.5f; // 2^-1, the exponent of the half denormals shifted by the 13 dropped bits
+		uint32_t alignedBits;
+		memcpy(&alignedBits, &aligned, 4);
+		return (uint16_t)(alignedBits - 0x3f000000u);
+	}
+	uint32_t odd = (bits >> 13) & 1;
+	return (uint16_t)((bits + 0xc8000fffu + odd) >> 13);
+}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+/* lutHalf() of 4 values in the low 16 bits of each lane */
+inline __m128i halfs4(__m128 values)
+{
+	__m128i bits = _mm_castps_si128(values);
+	__m128i denormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+	__m128i aligned = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(values, _mm_set1_ps(0.5f))), _mm_set1_epi32(0x3f000000));
+	__m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+	__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32((int)0xc8000fffu)), odd), 13);
+	return _mm_and_si128(_mm_or_si128(_mm_and_si128(denormal, aligned), _mm_andnot_si128(denormal, normal)), _mm_set1_epi32(0xffff));
+}
+#endif
+
+/* Fill the rows [begin, end) of 'lut' with the coordinates in 'camera' of
+   the pixels of the ideal pinhole 'view' (its distortion is ignored). */
+inline void buildRemapRows(const CameraModel& camera, const CameraModel& view, RemapLut& lut, int begin, int end, bool simd)
+{
+	/* The ray of view pixel (x, y) in camera space is linear in x: start + x * step */
+	glm::mat3 toCamera = camera.rotation * glm::transpose(view.rotation);
+	glm::vec3 step = toCamera * glm::vec3(1.0f / view.fx, 0.0f, 0.0f);
+	const float invWidth = 1.0f / camera.width, invHeight = 1.0f / camera.height;
+	for (int y = begin; y < end; y++)
+	{
+		glm::vec3 start = toCamera * glm::vec3(-view.cx / view.fx, (y - view.cy) / view.fy, 1.0f);
+		uint16_t* row = &lut.texels[(size_t)y * lut.width * 2];
+		int x = 0;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		if (simd)
+		{
+			const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			const __m128i bias = _mm_set1_epi32(32768);
+			for (; x + 4 <= lut.width; x += 4)
+			{
+				__m128 xs = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+				__m128 px = _mm_add_ps(_mm_set1_ps(start.x), _mm_mul_ps(xs, _mm_set1_ps(step.x)));
+				__m128 py = _mm_add_ps(_mm_set1_ps(start.y), _mm_mul_ps(xs, _mm_set1_ps(step.y)));
+				__m128 pz = _mm_add_ps(_mm_set1_ps(start.z), _mm_mul_ps(xs, _mm_set1_ps(step.z)));
+				__m128 u, v;
+				int visible = projectCameraPoints4(camera, px, py, pz, u, v);
+				// pixel centers to texture coordinates
+				u = _mm_mul_ps(_mm_add_ps(u, _mm_set1_ps(0.5f)), _mm_set1_ps(invWidth));
+				v = _mm_mul_ps(_mm_add_ps(v, _mm_set1_ps(0.5f)), _mm_set1_ps(invHeight));
+				const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+				__m128i mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(visible), bits), bits);
+				__m128i eu, ev, invalid;
+				if (lut.encoding == LUT_HALF)
+				{
+					eu = halfs4(u);
+					ev = halfs4(v);
+					invalid = _mm_set1_epi32(0xbc00); // -1
+				}
+				else
+				{
+					eu = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(65534.0f)), _mm_set1_ps(0.5f)));
+					ev = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(65534.0f)), _mm_set1_ps(0.5f)));
+					invalid = _mm_set1_epi32(65535);
+				}
+				eu = _mm_or_si128(_mm_and_si128(mask, eu), _mm_andnot_si128(mask, invalid));
+				ev = _mm_or_si128(_mm_and_si128(mask, ev), _mm_andnot_si128(mask, invalid));
+				// 32 to 16 bits without the signed saturation of packs: shift the range down and back
+				eu = _mm_packs_epi32(_mm_sub_epi32(eu, bias), _mm_sub_epi32(eu, bias));
+				ev = _mm_packs_epi32(_mm_sub_epi32(ev, bias), _mm_sub_epi32(ev, bias));
+				__m128i uv = _mm_xor_si128(_mm_unpacklo_epi16(eu, ev), _mm_set1_epi16((short)0x8000));
+				_mm_storeu_si128((__m128i*)(row + x * 2), uv);
+			}
+		}
+#endif
+		for (; x < lut.width; x++)
+		{
+			float xf = (float)x;
+			glm::vec3 p(start.x + xf * step.x, start.y + xf * step.y, start.z + xf * step.z);
+			glm::vec2 pixel;
+			bool visible = projectCameraPoint(camera, p, pixel);
+			float u = (pixel.x + 0.5f) * invWidth, v = (pixel.y + 0.5f) * invHeight;
+			if (lut.encoding == LUT_HALF)
+			{
+				row[x * 2] = visible ? lutHalf(u) : 0xbc00;
+				row[x * 2 + 1] = visible ? lutHalf(v) : 0xbc00;
+			}
+			else
+			{
+				row[x * 2] = visible ? (uint16_t)(int)(u * 65534.0f + 0.5f) : 65535;
+				row[x * 2 + 1] = visible ? (uint16_t)(int)(v * 65534.0f + 0.5f) : 65535;
+			}
+		}
+	}
+}
+
+/* Remap LUT of 'view' (an ideal pinhole camera) from the image of 'camera',
+   for an undistorted view or a virtual camera looking elsewhere from the
+   same place. The rows are split over 'pool' (NULL: the calling thread),
+   4 pixels at a time with SSE2; the scalar path gives the same table. */
+inline void buildRemapLut(const CameraModel& camera, const CameraModel& view, LutEncoding encoding, RemapLut& lut, ThreadPool* pool, bool simd = true)
+{
+	lut.resize(view.width, view.height, encoding);
+	auto buildRows = [&](int begin, int end) {
+		buildRemapRows(camera, view, lut, begin, end, simd);
+	};
+	if (pool)
+	{
+		pool->parallelFor(view.height, 16, buildRows);
+	}
+	else
+	{
+		buildRows(0, view.height);
+	}
+}
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "gl_state.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Passes of the render queue, submitted in this order */
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE = 0,		 // depth tested and written, front to back
+	RENDER_PASS_TRANSPARENT = 1, // blended without depth writes, back to front
+	RENDER_PASS_OVERLAY = 2		 // drawn last in recording order
+};
+
+/* 64-bit sort keys, the most significant bits are sorted first:
+
+   opaque:       pass:2 | program:10 | material:14 | mesh:10 | depth:24 | unused:4
+   transparent:  pass:2 | far depth:24 | program:10 | material:14 | mesh:10 | unused:4
+   overlay:      pass:2 | unused:62
+
+   Opaque packets are grouped by program, material and mesh (vertex array),
+   the most expensive state change first, and go front to back inside a
+   group so early depth rejects the hidden fragments. Transparent packets
+   must be blended back to front, so depth comes first there. Program,
+   material and mesh are small ids chosen by the caller (GL object names are
+   fine while they stay below 1024 / 16384 / 1024). */
+namespace RenderKey
+{
+	const int DEPTH_BITS = 24;
+	const uint32_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+
+	// view space distance to 24 bits, linear in [0, farPlane]
+	inline uint32_t quantizeDepth(float distance, float farPlane)
+	{
+		float t = distance / farPlane;
+		t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+		return (uint32_t)(t * (float)DEPTH_MAX);
+	}
+
+	inline uint64_t opaque(uint32_t program, uint32_t material, uint32_t mesh, uint32_t depth)
+	{
+		return ((uint64_t)RENDER_PASS_OPAQUE << 62) | ((uint64_t)(program & 0x3FF) << 52) | ((uint64_t)(material & 0x3FFF) << 38)
+			| ((uint64_t)(mesh & 0x3FF) << 28) | ((uint64_t)(depth & DEPTH_MAX) << 4);
+	}
+
+	inline uint64_t transparent(uint32_t program, uint32_t material, uint32_t mesh, uint32_t depth)
+	{
+		return ((uint64_t)RENDER_PASS_TRANSPARENT << 62) | ((uint64_t)(DEPTH_MAX - (depth & DEPTH_MAX)) << 38)
+			| ((uint64_t)(program & 0x3FF) << 28) | ((uint64_t)(material & 0x3FFF) << 14) | ((uint64_t)(mesh & 0x3FF) << 4);
+	}
+
+	inline uint64_t overlay()
+	{
+		return (uint64_t)RENDER_PASS_OVERLAY << 62;
+	}
+
+	inline RenderPass pass(uint64_t key)
+	{
+		return (RenderPass)(key >> 62);
+	}
+}
+
+/* Everything needed for one draw. The state is resolved when the packet is
+   recorded, submission only compares it with the previous packet. */
+struct RenderPacket
+{
+	uint64_t key;
+	GLuint program;
+	GLint modelLocation; // -1: no model matrix upload
+	GLuint vertexArray;
+	GLuint textures[2];	 // GL_TEXTURE_2D on units 0 and 1, 0 = unit not used
+	GLenum primitive;
+	GLenum indexType;	 // 0: glDrawArrays, else glDrawElements with the indices of the vertex array
+	GLint first;		 // first vertex, or first index
+	GLsizei count;
+	glm::mat4 model;
+};
+
+/* Packets recorded by one thread. Each thread must record into its own
+   bucket, no locking is done. */
+class RenderBucket
+{
+public:
+	std::vector<RenderPacket> packets;
+
+	void add(const RenderPacket& packet)
+	{
+		packets.push_back(packet);
+	}
+};
+
+/* Counts of the last submit() */
+struct RenderQueueStats
+{
+	int packets;
+	int draws;
+	int programChanges;
+	int textureChanges; // changes of the texture pair
+	int vertexArrayChanges;
+	int passChanges;
+};
+
+/* Deferred draw submission: packets are recorded (from several threads into
+   per-thread buckets), sorted by their key with a radix sort and submitted in
+   that order through glState(), so consecutive packets share as much state as
+   possible. The buckets and the sort buffers keep their memory from frame to
+   frame. */
+class RenderQueue
+{
+public:
+	static const int MAX_BUCKETS = 256;
+
+	RenderQueueStats stats;
+
+	explicit RenderQueue(int bucketCount = 1)
+	{
+		buckets.resize(std::max(1, std::min(bucketCount, MAX_BUCKETS)));
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	int bucketCount() const
+	{
+		return (int)buckets.size();
+	}
+
+	RenderBucket& bucket(int index)
+	{
+		return buckets[index];
+	}
+
+	// forget the packets of the previous frame
+	void clear()
+	{
+		for (size_t b = 0; b < buckets.size(); b++)
+		{
+			buckets[b].packets.clear();
+		}
+		order.clear();
+	}
+
+	/* Call fn(bucket, begin, end) on ranges of [0, count), one range per
+	   bucket, spread over the pool. Recording order inside the merged queue
+	   is the order of [0, count), equal keys keep it. */
+	template <class F>
+	void record(int count, F fn, ThreadPool* pool = NULL)
+	{
+		int ranges = (int)buckets.size();
+		if (!pool || count < 2 * ranges)
+		{
+			fn(buckets[0], 0, count);
+			return;
+		}
+		pool->parallelFor(ranges, 1, [&](int begin, int end) {
+			for (int b = begin; b < end; b++)
+			{
+				fn(buckets[b], (int)((long long)count * b / ranges), (int)((long long)count * (b + 1) / ranges));
+			}
+		});
+	}
+
+	// merge the buckets and sort the packets by key
+	void sort()
+	{
+		order.clear();
+		for (size_t b = 0; b < buckets.size(); b++)
+		{
+			const std::vector<RenderPacket>& packets = buckets[b].packets;
+			for (size_t i = 0; i < packets.size(); i++)
+			{
+				SortItem item;
+				item.key = packets[i].key;
+				item.packet = ((uint32_t)b << 24) | (uint32_t)i;
+				order.push_back(item);
+			}
+		}
+		radixSort(order, scratch);
+	}
+
+	int size() const
+	{
+		return (int)order.size();
+	}
+
+	// i-th packet in sorted order, valid after sort()
+	const RenderPacket& packet(int i) const
+	{
+		return buckets[order[i].packet >> 24].packets[order[i].packet & 0xFFFFFF];
+	}
+
+	/* Draw the sorted packets. Blending is enabled and depth writes are
+	   disabled for the transparent pass only, both are restored after it. */
+	void submit()
+	{
+		memset(&stats, 0, sizeof(stats));
+		stats.packets = (int)order.size();
+		const RenderPacket* previous = NULL;
+		int pass = -1;
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const RenderPacket& p = packet((int)i);
+			int packetPass = RenderKey::pass(p.key);
+			if (packetPass != pass)
+			{
+				setPassState(pass, packetPass);
+				pass = packetPass;
+				stats.passChanges++;
+			}
+			if (!previous || previous->program != p.program)
+			{
+				glState().useProgram(p.program);
+				stats.programChanges++;
+			}
+			if (!previous || previous->textures[0] != p.textures[0] || previous->textures[1] != p.textures[1])
+			{
+				for (int unit = 0; unit < 2; unit++)
+				{
+					if (p.textures[unit])
+					{
+						glState().bindTextureUnit(unit, GL_TEXTURE_2D, p.textures[unit]);
+					}
+				}
+				stats.textureChanges++;
+			}
+			if (!previous || previous->vertexArray != p.vertexArray)
+			{
+				glState().bindVertexArray(p.vertexArray);
+				stats.vertexArrayChanges++;
+			}
+			if (p.modelLocation >= 0)
+			{
+				glUniformMatrix4fv(p.modelLocation, 1, GL_FALSE, glm::value_ptr(p.model));
+			}
+			if (p.indexType)
+			{
+				size_t indexSize = p.indexType == GL_UNSIGNED_INT ? 4 : (p.indexType == GL_UNSIGNED_SHORT ? 2 : 1);
+				glDrawElements(p.primitive, p.count, p.indexType, (void*)(p.first * indexSize));
+			}
+			else
+			{
+				glDrawArrays(p.primitive, p.first, p.count);
+			}
+			stats.draws++;
+			previous = &p;
+		}
+		if (pass >= 0)
+		{
+			setPassState(pass, -1);
+		}
+	}
+
+	// sort() then submit(), the order is kept until the next clear()
+	void flush()
+	{
+		sort();
+		submit();
+	}
+
+	/* Least significant digit radix sort of the keys, 8 bits per pass. All
+	   the histograms are built in one read of the keys and the passes where
+	   every key has the same digit are skipped (the unused low bits, or the
+	   program bits when every packet uses the same program). Stable. */
+	struct SortItem
+	{
+		uint64_t key;
+		uint32_t packet; // bucket:8 | index in the bucket:24
+	};
+
+	static void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+	{
+		size_t count = items.size();
+		if (count < 2)
+		{
+			return;
+		}
+		size_t histograms[8][256];
+		memset(histograms, 0, sizeof(histograms));
+		for (size_t i = 0; i < count; i++)
+		{
+			uint64_t key = items[i].key;
+			for (int digit = 0; digit < 8; digit++)
+			{
+				histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+			}
+		}
+
+		scratch.resize(count);
+		SortItem* source = items.data();
+		SortItem* target = scratch.data();
+		for (int digit = 0; digit < 8; digit++)
+		{
+			size_t* histogram = histograms[digit];
+			if (histogram[(source[0].key >> (digit * 8)) & 0xFF] == count)
+			{
+				continue; // every key has this digit
+			}
+			size_t offset = 0;
+			for (int value = 0; value < 256; value++)
+			{
+				size_t n = histogram[value];
+				histogram[value] = offset;
+				offset += n;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				target[histogram[(source[i].key >> (digit * 8)) & 0xFF]++] = source[i];
+			}
+			std::swap(source, target);
+		}
+		if (source != items.data())
+		{
+			memcpy(items.data(), source, count * sizeof(SortItem));
+		}
+	}
+
+private:
+	std::vector<RenderBucket> buckets;
+	std::vector<SortItem> order;
+	std::vector<SortItem> scratch;
+
+	// leave pass 'from' (-1: none) and enter pass 'to' (-1: done)
+	static void setPassState(int from, int to)
+	{
+		if (from == RENDER_PASS_TRANSPARENT)
+		{
+			glDepthMask(GL_TRUE);
+			glState().disable(GL_BLEND);
+		}
+		if (to == RENDER_PASS_TRANSPARENT)
+		{
+			glState().enable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+		}
+	}
+};
+
+#endif
@@ -3,10 +3,40 @@
 
 #include <glad/glad.h> // include glad to get the required OpenGL headers
 
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "gl_extensions.h"
+#include "shader_cache.h"
+#include "gl_state.h"
+
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <vector>
+
+/* FNV-1a hash of a uniform name. It is constexpr, so the hash of a string
+   literal can be computed by the compiler. */
+constexpr unsigned int uniformHash(const char* name)
+{
+	unsigned int hash = 2166136261u;
+	while (*name)
+	{
+		hash = (hash ^ (unsigned char)(*name++)) * 16777619u;
+	}
+	return hash;
+}
+
+/* Pre-resolved uniform location, get it once with Shader::uniform() and use it
+   with the typed setters in the render loop */
+struct UniformHandle
+{
+	int location; // -1 if the uniform is not active in the program
+
+	bool valid() const { return location >= 0; }
+};
 
 class Shader
 {
@@ -14,9 +44,211 @@ public:
 	// the shader program ID
 	unsigned int ID;
 
-	// constructor reads and builds the shader
-	Shader(const char* vertexPath, const char* fragmentpath) 
+	// constructor reads and builds the shader (with 'cache', the linked program is loaded/saved as a binary)
+	Shader(const char* vertexPath, const char* fragmentpath, ShaderCache* cache = NULL) : ID(0), cache(NULL), linked(false)
+	{
+		start(vertexPath, fragmentpath, cache);
+		finish();
+	}
+
+	// empty shader, build it with start() and finish()
+	Shader() : ID(0), cache(NULL), linked(false)
+	{
+	}
+
+	/* Read the sources and submit the compile and link, without waiting for
+	   them. With GL_KHR_parallel_shader_compile the driver builds the programs
+	   started this way on its own threads, so start() all of them first and
+	   finish() them afterwards. */
+	void start(const char* vertexPath, const char* fragmentpath, ShaderCache* programCache = NULL)
+	{
+		vertexSource = vertexPath;
+		fragmentSource = fragmentpath;
+		cache = (programCache && programCache->isOpen()) ? programCache : NULL;
+		linked = false;
+		build = submit();
+		ID = build.program;
+	}
+
+	// has the driver finished the program started with start() (never blocks)
+	bool isReady() const
+	{
+		return isBuilt(build);
+	}
+
+	// wait for the program started with start(), report errors and read the uniforms
+	bool finish()
+	{
+		if (!build.active)
+		{
+			return linked;
+		}
+		linked = complete(build);
+		if (linked)
+		{
+			loadUniforms();
+		}
+		return linked;
+	}
+
+	// was the program loaded from the ShaderCache
+	bool fromCache() const
+	{
+		return build.cached;
+	}
+
+	// paths given to start()
+	const std::string& vertexPath() const { return vertexSource; }
+	const std::string& fragmentPath() const { return fragmentSource; }
+
+	/* Hot-reload: read the sources again and build a new program in the
+	   background. ID keeps the current program until pollReload() sees the
+	   new one linked; a reload already in flight is dropped. Only the
+	   driver threads of GL_KHR_parallel_shader_compile build it in the
+	   background: without the extension this and the next pollReload()
+	   compile and link on the render thread, so that frame stalls. */
+	void reload()
+	{
+		if (reloadBuild.active)
+		{
+			discard(reloadBuild);
+		}
+		reloadBuild = submit();
+	}
+
+	/* Call once per frame. Returns true when a reloaded program replaced ID:
+	   the uniforms are read again and the handles from uniform() must be
+	   looked up again, and the uniform values set again. A program which
+	   fails to compile or link is reported and dropped, the old one stays.
+	   Never waits for the driver when GL_KHR_parallel_shader_compile is
+	   available; without it there is no way to ask whether the build is
+	   done, so the status queries wait for the compile and link. */
+	bool pollReload()
 	{
+		if (!reloadBuild.active || !isBuilt(reloadBuild))
+		{
+			return false;
+		}
+		if (!complete(reloadBuild))
+		{
+			std::cout << "ERROR::SHADER::RELOAD_FAILED " << vertexSource << " " << fragmentSource << " (keeping the previous program)" << std::endl;
+			discard(reloadBuild); // also forgets the ID in the state cache, the driver may hand it out again
+			return false;
+		}
+
+		/* Swap in the new program */
+		glDeleteProgram(ID); // deleted once it is not in use anymore
+		glState().programDeleted(ID);
+		build = reloadBuild;
+		ID = build.program;
+		linked = true;
+		loadUniforms();
+		std::cout << "SHADER::RELOADED " << vertexSource << " " << fragmentSource << std::endl;
+		return true;
+	}
+
+	// use/activate the Shader
+	void use()
+	{
+		glState().useProgram(ID); // skipped when the program is already in use
+	}
+
+	// find the location of an active uniform (no OpenGL call, uses the table built after linking)
+	UniformHandle uniform(const char* name) const
+	{
+		return findUniform(uniformHash(name), name);
+	}
+	/* The same by a precomputed uniformHash(). Only the hash is compared, so
+	   a name which is not active in the program may get the location of
+	   another uniform with the same hash: use it for names the program has. */
+	UniformHandle uniformByHash(unsigned int hash) const
+	{
+		return findUniform(hash, NULL);
+	}
+
+	// utility uniform functions
+	void setBool(const char* name, bool value) const
+	{
+		glUniform1i(uniform(name).location, (int)value);
+	}
+	void setInt(const char* name, int value) const
+	{
+		glUniform1i(uniform(name).location, value);
+	}
+	void setFloat(const char* name, float value) const
+	{
+		glUniform1f(uniform(name).location, value);
+	}
+	void setBool(const std::string& name, bool value) const { setBool(name.c_str(), value); }
+	void setInt(const std::string& name, int value) const { setInt(name.c_str(), value); }
+	void setFloat(const std::string& name, float value) const { setFloat(name.c_str(), value); }
+
+	// typed uniform functions using a pre-resolved handle (no string work, no lookup)
+	void setInt(UniformHandle handle, int value) const
+	{
+		glUniform1i(handle.location, value);
+	}
+	void setFloat(UniformHandle handle, float value) const
+	{
+		glUniform1f(handle.location, value);
+	}
+	void setVec3(UniformHandle handle, const glm::vec3& value) const
+	{
+		glUniform3fv(handle.location, 1, glm::value_ptr(value));
+	}
+	void setVec4(UniformHandle handle, const glm::vec4& value) const
+	{
+		glUniform4fv(handle.location, 1, glm::value_ptr(value));
+	}
+	void setMat4(UniformHandle handle, const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+	void setFloatArray(UniformHandle handle, const float* values, int count) const
+	{
+		glUniform1fv(handle.location, count, values);
+	}
+	void setVec3Array(UniformHandle handle, const glm::vec3* values, int count) const
+	{
+		glUniform3fv(handle.location, count, glm::value_ptr(values[0]));
+	}
+	void setVec4Array(UniformHandle handle, const glm::vec4* values, int count) const
+	{
+		glUniform4fv(handle.location, count, glm::value_ptr(values[0]));
+	}
+	void setMat4Array(UniformHandle handle, const glm::mat4* values, int count) const
+	{
+		glUniformMatrix4fv(handle.location, count, GL_FALSE, glm::value_ptr(values[0]));
+	}
+
+private:
+	/* A program between submit() and complete() */
+	struct Build
+	{
+		unsigned int program;
+		unsigned int vertexShader;	 // 0 when loaded from the cache
+		unsigned int fragmentShader;
+		uint64_t cacheKey;
+		bool cached;				 // loaded from the ShaderCache
+		bool active;				 // submitted, not completed yet
+
+		Build() : program(0), vertexShader(0), fragmentShader(0), cacheKey(0), cached(false), active(false)
+		{
+		}
+	};
+	Build build;		// the program of ID
+	Build reloadBuild;	// the next program, see reload()
+	std::string vertexSource;
+	std::string fragmentSource;
+	ShaderCache* cache;
+	bool linked;
+
+	// read the sources and submit the compile and link of a new program
+	Build submit()
+	{
+		Build result;
+		result.active = true;
+
 		/*************************************************************/
 		/* 1. Retrieve the vertex/fragment source code from filepath */
 		/*************************************************************/
@@ -32,8 +264,8 @@ public:
 		try
 		{
 			// open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentpath);
+			vShaderFile.open(vertexSource.c_str());
+			fShaderFile.open(fragmentSource.c_str());
 
 			// read file's buffer contents into stream
 			std::stringstream vShaderStream, fShaderStream;
@@ -48,11 +280,25 @@ public:
 			vertexCode = vShaderStream.str();
 			fragmentCode = fShaderStream.str();
 		}
-		catch(std::ifstream::failure e)
+		catch(const std::ifstream::failure&)
 		{
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 		}
 
+		result.program = glCreateProgram();	// Generate/Create shaderProgram object
+
+		/* A cached binary replaces the whole compile and link */
+		if (cache)
+		{
+			result.cacheKey = cache->key(vertexCode, fragmentCode);
+			if (cache->load(result.cacheKey, result.program))
+			{
+				result.cached = true;
+				return result;
+			}
+			cache->misses++;
+		}
+
 		// convert string to char buffer
 		const char* vShaderCode = vertexCode.c_str();
 		const char* fShaderCode = fragmentCode.c_str();
@@ -60,95 +306,210 @@ public:
 		/*************************************************************/
 		/* 2. Compile and link shaders                               */
 		/*************************************************************/
-		int success;
-		char infoLog[512];
-
 	    /** VERTEX SHADER **/
-		unsigned int vertexShader;							// Create a variable to store the vertexShader object
-		vertexShader = glCreateShader(GL_VERTEX_SHADER);	// Generate/Create vertexShader object
+		result.vertexShader = glCreateShader(GL_VERTEX_SHADER);	// Generate/Create vertexShader object
 		/* Attach the source code to shader object and compile (run-time) the shader */
-		glShaderSource(vertexShader,
+		glShaderSource(result.vertexShader,
 			1, /* Number of strings to pass*/
 			&vShaderCode,
 			NULL
 		);
-		glCompileShader(vertexShader);
-		/* Check compilation status */
-		
-		/* This function returns a parameter from a shader object */
-		glGetShaderiv(vertexShader,
-			GL_COMPILE_STATUS,
-			&success
-		);
-		if (!success)
-		{
-			glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
+		glCompileShader(result.vertexShader);
 
 		/** FRAGMENT SHADER **/
-		unsigned int fragmentShader;						// Create a variable to store the fragmentShader object
-		fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);// Generate/Create fragmentShader object
+		result.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);// Generate/Create fragmentShader object
 		/* Attach the source code to shader object and compile (run-time) the shader */
-		glShaderSource(fragmentShader,
+		glShaderSource(result.fragmentShader,
 			1, /* Number of strings to pass*/
 			&fShaderCode,
 			NULL
 		);
-		glCompileShader(fragmentShader);
+		glCompileShader(result.fragmentShader);
+
+		/** SHADER PROGRAM **/
+		/* Attach the shaders to the program and link it */
+		glAttachShader(result.program, result.vertexShader);
+		glAttachShader(result.program, result.fragmentShader);
+		if (cache)
+		{
+			glExtensions().ProgramParameteri(result.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); // we want to save it
+		}
+		glLinkProgram(result.program);
+		return result;
+	}
+
+	/* Has the driver finished 'b' (never blocks). Without the extension
+	   there is no status to poll: true at once, and complete() then waits
+	   for the compile and link on the calling thread. */
+	static bool isBuilt(const Build& b)
+	{
+		if (!b.active || b.cached || !glExtensions().parallelShaderCompile)
+		{
+			return true;
+		}
+		int done = 0;
+		glGetProgramiv(b.program, GL_COMPLETION_STATUS_KHR, &done);
+		return done != 0;
+	}
+
+	// check the compile and link status of 'b', report errors, save the binary; true if linked
+	bool complete(Build& b)
+	{
+		b.active = false;
+		if (b.cached)
+		{
+			return true;
+		}
+
+		int success;
+		char infoLog[512];
+		bool programLinked = true;
+
 		/* Check compilation status */
 		/* This function returns a parameter from a shader object */
-		glGetShaderiv(fragmentShader,
+		glGetShaderiv(b.vertexShader,
+			GL_COMPILE_STATUS,
+			&success
+		);
+		if (!success)
+		{
+			glGetShaderInfoLog(b.vertexShader, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		}
+		glGetShaderiv(b.fragmentShader,
 			GL_COMPILE_STATUS,
 			&success
 		);
 		if (!success)
 		{
-			glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+			glGetShaderInfoLog(b.fragmentShader, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
 		}
 
-		/** SHADER PROGRAM **/
-		ID = glCreateProgram();	// Generate/Create shaderProgram object
-		/* Attach the shaders to the program and link it */
-		glAttachShader(ID, vertexShader);
-		glAttachShader(ID, fragmentShader);
-		glLinkProgram(ID);
 		/* Check linking status of the shader program */
 		/* This function returns a parameter from a shader object */
-		glGetProgramiv(ID,
+		glGetProgramiv(b.program,
 			GL_LINK_STATUS,
 			&success
 		);
 		if (!success)
 		{
-			glGetProgramInfoLog(ID, 512, NULL, infoLog);
+			glGetProgramInfoLog(b.program, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+			programLinked = false;
+		}
+		else if (cache)
+		{
+			cache->save(b.cacheKey, b.program);
 		}
 
 		/* Delete the shader objects after linking, as we do not need this anymore */
-		glDeleteShader(ID);
-		glDeleteShader(ID);
+		glDeleteShader(b.vertexShader);
+		glDeleteShader(b.fragmentShader);
+		b.vertexShader = 0;
+		b.fragmentShader = 0;
+		return programLinked;
 	}
 
-	// use/activate the Shader
-	void use()
+	// drop a build which is not needed anymore
+	static void discard(Build& b)
 	{
-		glUseProgram(ID);
+		if (b.vertexShader)
+		{
+			glDeleteShader(b.vertexShader);
+			glDeleteShader(b.fragmentShader);
+		}
+		glDeleteProgram(b.program);
+		glState().programDeleted(b.program);
+		b = Build();
 	}
 
-	// utility uniform functions
-	void setBool(const std::string& name, bool value) const
+	/* One slot of the open addressing hash table of active uniforms. The
+	   name tells apart the uniforms whose hashes collide. */
+	struct UniformSlot
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		unsigned int hash;
+		int location;
+		bool used;
+		std::string name;
+	};
+	std::vector<UniformSlot> uniformTable; // size is a power of two
+
+	// the slot of 'hash' and 'name' (any name when NULL)
+	UniformHandle findUniform(unsigned int hash, const char* name) const
+	{
+		UniformHandle handle = { -1 };
+		if (uniformTable.empty())
+		{
+			return handle;
+		}
+		size_t mask = uniformTable.size() - 1;
+		for (size_t slot = hash & mask; uniformTable[slot].used; slot = (slot + 1) & mask)
+		{
+			if (uniformTable[slot].hash == hash && (!name || uniformTable[slot].name == name))
+			{
+				handle.location = uniformTable[slot].location;
+				break;
+			}
+		}
+		return handle;
 	}
-	void setInt(const std::string& name, int value) const
+
+	// query all active uniforms once after linking
+	void loadUniforms()
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		int count = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+
+		/* Keep the table at most half full, arrays are inserted twice ("a" and "a[0]") */
+		size_t capacity = 8;
+		while (capacity < (size_t)count * 4)
+		{
+			capacity *= 2;
+		}
+		UniformSlot empty = { 0, -1, false, std::string() };
+		uniformTable.assign(capacity, empty);
+
+		char name[256];
+		for (int i = 0; i < count; i++)
+		{
+			int length = 0, size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, (GLuint)i, sizeof(name), &length, &size, &type, name);
+			int location = glGetUniformLocation(ID, name);
+			if (location < 0)
+			{
+				continue; // uniforms inside uniform blocks have no location
+			}
+			insertUniform(name, location);
+
+			/* Arrays are reported as "name[0]", make them reachable as "name" as well */
+			if (length > 3 && strcmp(name + length - 3, "[0]") == 0)
+			{
+				name[length - 3] = '\0';
+				insertUniform(name, location);
+			}
+		}
 	}
-	void setFloat(const std::string& name, float value) const
+
+	void insertUniform(const char* name, int location)
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		unsigned int hash = uniformHash(name);
+		size_t mask = uniformTable.size() - 1;
+		size_t slot = hash & mask;
+		while (uniformTable[slot].used)
+		{
+			if (uniformTable[slot].hash == hash && uniformTable[slot].name != name)
+			{
+				// found by name, uniformByHash() gets the first one only
+				std::cout << "SHADER::UNIFORM_HASH_COLLISION " << uniformTable[slot].name << " " << name << std::endl;
+			}
+			slot = (slot + 1) & mask;
+		}
+		uniformTable[slot].hash = hash;
+		uniformTable[slot].location = location;
+		uniformTable[slot].used = true;
+		uniformTable[slot].name = name;
 	}
 };
 
@@ -9,12 +9,14 @@ out vec2 TexCoord; // To pass the texture to Fragment Shader
 
 //uniform mat4 transform; // Transformation matrix to be set in the application
 uniform mat4 model;
+uniform vec3 positionScale = vec3(1.0); // quantized positions: positionOffset + positionScale * aPos (vertex_format.h)
+uniform vec3 positionOffset = vec3(0.0);
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = projection * view * model * vec4(positionOffset + positionScale * aPos, 1.0f);
 	//gl_Position = vec4(aPos, 1.0f);
 	ourColor = aColor; //set ourColor to the input color from the vertex data
 	TexCoord = aTexCoord;
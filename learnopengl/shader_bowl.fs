@@ -0,0 +1,51 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 CameraCoord[4];
+in vec4 Weights;
+
+uniform sampler2DArray cameras; // one layer per camera, in the order of the rig: RGB, NV12 luma or packed YUYV (frame_upload.h)
+uniform sampler2DArray chroma;	// NV12 chroma, half size
+uniform int cameraFormat = 0;	// CameraPixelFormat: 0 RGB, 1 NV12, 2 YUYV
+
+// BT.601 limited range to RGB
+vec3 yuvToRgb(vec3 yuv)
+{
+	float y = 1.164384 * (yuv.x - 16.0 / 255.0);
+	float u = yuv.y - 128.0 / 255.0, v = yuv.z - 128.0 / 255.0;
+	return clamp(vec3(y + 1.596027 * v, y - 0.391762 * u - 0.812968 * v, y + 2.017232 * u), 0.0, 1.0);
+}
+
+vec3 cameraColor(vec2 coord, int layer)
+{
+	if (cameraFormat == 1)
+	{
+		return yuvToRgb(vec3(texture(cameras, vec3(coord, layer)).r, texture(chroma, vec3(coord, layer)).rg));
+	}
+	if (cameraFormat == 2)
+	{
+		// a texel holds 2 pixels: the luma of the nearest one, the chroma they share
+		ivec3 size = textureSize(cameras, 0);
+		ivec2 pixel = clamp(ivec2(coord * vec2(size.x * 2, size.y)), ivec2(0), ivec2(size.x * 2 - 1, size.y - 1));
+		vec4 texel = texelFetch(cameras, ivec3(pixel.x / 2, pixel.y, layer), 0);
+		return yuvToRgb(vec3((pixel.x & 1) == 0 ? texel.r : texel.b, texel.g, texel.a));
+	}
+	return texture(cameras, vec3(coord, layer)).rgb;
+}
+
+void main()
+{
+	// only the cameras that see this point are sampled, 1 or 2 on most of the bowl
+	vec3 color = vec3(0.0);
+	float total = 0.0;
+	for (int c = 0; c < 4; c++)
+	{
+		if (Weights[c] > 0.002)
+		{
+			color += Weights[c] * cameraColor(CameraCoord[c], c);
+			total += Weights[c];
+		}
+	}
+	FragColor = vec4(total > 0.0 ? color / total : vec3(0.0), 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+layout(location = 0) in vec4 aPos;	   // half floats, vehicle frame (bowl_mesh.h)
+layout(location = 1) in vec2 aCamera0; // texture coordinates in each camera image
+layout(location = 2) in vec2 aCamera1;
+layout(location = 3) in vec2 aCamera2;
+layout(location = 4) in vec2 aCamera3;
+layout(location = 5) in vec4 aWeights; // blend weight of each camera, adding up to 1 (0 where none sees the vertex)
+
+out vec2 CameraCoord[4];
+out vec4 Weights;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	gl_Position = projection * view * vec4(aPos.xyz, 1.0);
+	CameraCoord[0] = aCamera0;
+	CameraCoord[1] = aCamera1;
+	CameraCoord[2] = aCamera2;
+	CameraCoord[3] = aCamera3;
+	Weights = aWeights;
+}
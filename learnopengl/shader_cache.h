@@ -0,0 +1,164 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "gl_extensions.h"
+#include "file_utils.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/* Header of a cached program binary, followed by 'length' bytes */
+struct ShaderCacheHeader
+{
+	char magic[4];		   // "LPRG"
+	uint32_t version;
+	uint64_t key;		   // same as the file name
+	uint32_t binaryFormat; // from glGetProgramBinary
+	uint32_t length;
+};
+
+const uint32_t SHADER_CACHE_VERSION = 1;
+
+/* Linked program binaries on disk (GL_ARB_get_program_binary). The key of a
+   program hashes its sources together with the GL vendor, renderer and
+   version strings: binaries are only valid for the driver that wrote them,
+   so a driver update simply misses the cache. */
+class ShaderCache
+{
+public:
+	int hits;	// programs loaded from a binary
+	int misses; // programs compiled from source
+
+	ShaderCache() : hits(0), misses(0), driverHash(0)
+	{
+	}
+
+	// use 'directory' for the binaries, false if the driver cannot give us binaries
+	bool open(const std::string& cacheDirectory)
+	{
+		if (!glExtensions().programBinary)
+		{
+			std::cout << "ERROR::SHADER_CACHE::PROGRAM_BINARY_NOT_SUPPORTED" << std::endl;
+			return false;
+		}
+		if (!makeDirectory(cacheDirectory))
+		{
+			std::cout << "ERROR::SHADER_CACHE::CANNOT_CREATE_DIRECTORY " << cacheDirectory << std::endl;
+			return false;
+		}
+		directory = cacheDirectory;
+
+		driverHash = hashBytes(NULL, 0);
+		const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (int i = 0; i < 3; i++)
+		{
+			const char* value = (const char*)glGetString(names[i]);
+			driverHash = hashString(value ? value : "", driverHash);
+		}
+		return true;
+	}
+
+	bool isOpen() const
+	{
+		return !directory.empty();
+	}
+
+	uint64_t key(const std::string& vertexCode, const std::string& fragmentCode) const
+	{
+		return hashString(fragmentCode, hashString(vertexCode, driverHash));
+	}
+
+	// give 'program' the cached binary of 'key', false on a miss or a rejected binary
+	bool load(uint64_t key, unsigned int program)
+	{
+		std::ifstream file(path(key).c_str(), std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		ShaderCacheHeader header;
+		if (bytes.size() < sizeof(header))
+		{
+			return false;
+		}
+		memcpy(&header, bytes.data(), sizeof(header));
+		if (memcmp(header.magic, "LPRG", 4) != 0 || header.version != SHADER_CACHE_VERSION || header.key != key
+			|| bytes.size() != sizeof(header) + header.length)
+		{
+			return false;
+		}
+
+		glExtensions().ProgramBinary(program, header.binaryFormat, bytes.data() + sizeof(header), (GLsizei)header.length);
+		int success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success); // the driver may refuse an old binary
+		if (success)
+		{
+			hits++;
+		}
+		return success != 0;
+	}
+
+	// write the binary of the linked 'program' (linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+	bool save(uint64_t key, unsigned int program) const
+	{
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+		{
+			return false;
+		}
+		std::vector<char> binary(length);
+		GLenum binaryFormat = 0;
+		GLsizei written = 0;
+		glExtensions().GetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+
+		ShaderCacheHeader header;
+		memcpy(header.magic, "LPRG", 4);
+		header.version = SHADER_CACHE_VERSION;
+		header.key = key;
+		header.binaryFormat = binaryFormat;
+		header.length = (uint32_t)written;
+
+		std::string temporary = path(key) + ".tmp";
+		{
+			std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(header));
+			file.write(binary.data(), written);
+			if (!file)
+			{
+				return false;
+			}
+		}
+		return replaceFile(temporary, path(key));
+	}
+
+	// forget the binary of 'key'
+	void remove(uint64_t key) const
+	{
+		std::remove(path(key).c_str());
+	}
+
+private:
+	std::string directory;
+	uint64_t driverHash;
+
+	static uint64_t hashString(const std::string& text, uint64_t hash)
+	{
+		hash = hashBytes((const unsigned char*)text.data(), text.size(), hash);
+		return hashBytes((const unsigned char*)"", 1, hash); // separator, "ab" + "c" != "a" + "bc"
+	}
+
+	std::string path(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return directory + "/" + name;
+	}
+};
+
+#endif
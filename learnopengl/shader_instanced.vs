@@ -0,0 +1,21 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos; // position has attribute location 0
+layout(location = 1) in vec3 aColor; // color has attribute location 1
+layout(location = 2) in vec2 aTexCoord; // texture has attribute location 2
+layout(location = 3) in mat4 aModel; // per-instance model matrix, uses locations 3 to 6
+
+out vec3 ourColor; // specify a color output to the Fragment shader
+out vec2 TexCoord; // To pass the texture to Fragment Shader
+
+uniform vec3 positionScale = vec3(1.0); // quantized positions: positionOffset + positionScale * aPos (vertex_format.h)
+uniform vec3 positionOffset = vec3(0.0);
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	gl_Position = projection * view * aModel * vec4(positionOffset + positionScale * aPos, 1.0f);
+	ourColor = aColor; //set ourColor to the input color from the vertex data
+	TexCoord = aTexCoord;
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos; // position has attribute location 0
+layout(location = 1) in vec3 aColor; // color has attribute location 1
+layout(location = 2) in vec2 aTexCoord; // texture has attribute location 2
+
+out vec3 ourColor; // specify a color output to the Fragment shader
+out vec2 TexCoord; // To pass the texture to Fragment Shader
+
+uniform samplerBuffer instanceModels; // 4 texels (matrix columns) per instance
+uniform vec3 positionScale = vec3(1.0); // quantized positions: positionOffset + positionScale * aPos (vertex_format.h)
+uniform vec3 positionOffset = vec3(0.0);
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	int base = gl_InstanceID * 4;
+	mat4 model = mat4(texelFetch(instanceModels, base + 0),
+	                  texelFetch(instanceModels, base + 1),
+	                  texelFetch(instanceModels, base + 2),
+	                  texelFetch(instanceModels, base + 3));
+	gl_Position = projection * view * model * vec4(positionOffset + positionScale * aPos, 1.0f);
+	ourColor = aColor; //set ourColor to the input color from the vertex data
+	TexCoord = aTexCoord;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec3 ourColor; 
+in vec2 TexCoord;
+
+uniform sampler2D texture1; // camera image
+uniform sampler2D remapLut; // per output pixel, where to sample texture1 (remap_lut.h), GL_NEAREST
+uniform float lutScale;		// texel of remapLut to texture coordinates: 65535/65534 for unorm16, 1 for half
+
+void main()
+{
+	vec2 source = texture(remapLut, TexCoord).rg * lutScale;
+	// outside [0, 1]: the camera does not see this pixel
+	if (source.x < 0.0 || source.x > 1.0)
+	{
+		FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+	FragColor = texture(texture1, source);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec3 ourColor; 
+in vec2 TexCoord;
+
+uniform sampler2DArray cameras; // RGB, NV12 luma or packed YUYV frames, one layer per camera (frame_upload.h)
+uniform sampler2DArray chroma;	// NV12 chroma, half size
+uniform int cameraFormat = 0;	// CameraPixelFormat: 0 RGB, 1 NV12, 2 YUYV
+uniform int layer;				// camera shown
+
+// BT.601 limited range to RGB
+vec3 yuvToRgb(vec3 yuv)
+{
+	float y = 1.164384 * (yuv.x - 16.0 / 255.0);
+	float u = yuv.y - 128.0 / 255.0, v = yuv.z - 128.0 / 255.0;
+	return clamp(vec3(y + 1.596027 * v, y - 0.391762 * u - 0.812968 * v, y + 2.017232 * u), 0.0, 1.0);
+}
+
+void main()
+{
+	if (cameraFormat == 1)
+	{
+		FragColor = vec4(yuvToRgb(vec3(texture(cameras, vec3(TexCoord, layer)).r, texture(chroma, vec3(TexCoord, layer)).rg)), 1.0);
+		return;
+	}
+	if (cameraFormat == 2)
+	{
+		// a texel holds 2 pixels: the luma of the nearest one, the chroma they share
+		ivec3 size = textureSize(cameras, 0);
+		ivec2 pixel = clamp(ivec2(TexCoord * vec2(size.x * 2, size.y)), ivec2(0), ivec2(size.x * 2 - 1, size.y - 1));
+		vec4 texel = texelFetch(cameras, ivec3(pixel.x / 2, pixel.y, layer), 0);
+		FragColor = vec4(yuvToRgb(vec3((pixel.x & 1) == 0 ? texel.r : texel.b, texel.g, texel.a)), 1.0);
+		return;
+	}
+	FragColor = vec4(texture(cameras, vec3(TexCoord, layer)).rgb, 1.0);
+}
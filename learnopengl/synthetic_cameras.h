@@ -0,0 +1,79 @@
+#ifndef SYNTHETIC_CAMERAS_H
+#define SYNTHETIC_CAMERAS_H
+
+#include "glm/glm.hpp"
+
+#include "camera_model.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <vector>
+
+/* Colour seen along a world ray in the synthetic surround scene: a ground
+   of 1 m grey tiles with dashed white lane markings 1.7 m left and right of
+   the car and a coloured disk in front, behind, left and right of it, under
+   a sky gradient. 'travelled' metres of driving scroll the ground towards
+   +z, so consecutive frames differ like those of a moving car; the ground
+   repeats every 2 m. */
+inline glm::vec3 syntheticSceneColor(const glm::vec3& origin, const glm::vec3& direction, float travelled)
+{
+	if (direction.y >= -1.0e-4f)
+	{
+		return glm::mix(glm::vec3(0.75f, 0.82f, 0.95f), glm::vec3(0.25f, 0.45f, 0.85f), glm::min(direction.y * 2.0f, 1.0f));
+	}
+	float t = -origin.y / direction.y;
+	float x = origin.x + t * direction.x, z = origin.z + t * direction.z;
+	float groundZ = z - travelled;
+	glm::vec3 color = ((int)floorf(x) + (int)floorf(groundZ)) & 1 ? glm::vec3(0.55f) : glm::vec3(0.35f);
+	float lane = fabsf(fabsf(x) - 1.7f);
+	if (lane < 0.08f && groundZ - 2.0f * floorf(groundZ / 2.0f) < 1.0f)
+	{
+		color = glm::vec3(0.95f);
+	}
+	const glm::vec2 markers[4] = { glm::vec2(0.0f, -5.0f), glm::vec2(0.0f, 5.0f), glm::vec2(-3.5f, 0.0f), glm::vec2(3.5f, 0.0f) };
+	const glm::vec3 markerColors[4] = { glm::vec3(0.9f, 0.15f, 0.1f), glm::vec3(0.1f, 0.3f, 0.9f), glm::vec3(0.1f, 0.75f, 0.2f), glm::vec3(0.95f, 0.8f, 0.1f) };
+	for (int m = 0; m < 4; m++)
+	{
+		if (glm::length(glm::vec2(x, z) - markers[m]) < 0.8f)
+		{
+			color = markerColors[m];
+		}
+	}
+	return color;
+}
+
+/* RGB image (top row first) of 'camera' looking at the synthetic scene, the
+   rows split over 'pool' (NULL: the calling thread) */
+inline void renderSyntheticCamera(const CameraModel& camera, float travelled, std::vector<unsigned char>& rgb, ThreadPool* pool)
+{
+	rgb.resize((size_t)camera.width * camera.height * 3);
+	glm::mat3 toWorld = glm::transpose(camera.rotation);
+	auto renderRows = [&](int begin, int end) {
+		for (int y = begin; y < end; y++)
+		{
+			unsigned char* row = &rgb[(size_t)y * camera.width * 3];
+			for (int x = 0; x < camera.width; x++)
+			{
+				glm::vec3 direction;
+				glm::vec3 color(0.0f); // outside the field of the lens
+				if (unprojectCameraPixel(camera, glm::vec2((float)x, (float)y), direction))
+				{
+					color = syntheticSceneColor(camera.position, toWorld * direction, travelled);
+				}
+				row[x * 3] = (unsigned char)(color.r * 255.0f + 0.5f);
+				row[x * 3 + 1] = (unsigned char)(color.g * 255.0f + 0.5f);
+				row[x * 3 + 2] = (unsigned char)(color.b * 255.0f + 0.5f);
+			}
+		}
+	};
+	if (pool)
+	{
+		pool->parallelFor(camera.height, 8, renderRows);
+	}
+	else
+	{
+		renderRows(0, camera.height);
+	}
+}
+
+#endif
@@ -0,0 +1,723 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "gl_extensions.h"
+#include "mapped_file.h"
+#include "file_utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* GPU-ready texture cache.
+
+   A cache file holds the whole mip chain of one image in the layout it is
+   uploaded with, so a cache hit is a memory mapping plus one
+   glTexImage2D / glCompressedTexImage2D per level: no image decode and no
+   glGenerateMipmap. The file name is the hash of the source file bytes (and
+   the vertical flip), so an edited source simply misses the cache.
+
+   Layout (little endian):
+     TextureCacheHeader
+     TextureCacheLevel[levelCount]
+     level data, each level 16 byte aligned */
+
+/* How the levels are stored */
+enum TextureEncoding
+{
+	ENCODE_RAW,	 // RGB8 / RGBA8, no compression
+	ENCODE_BC,	 // BC1 (opaque) or BC3 (with alpha), GL_EXT_texture_compression_s3tc
+	ENCODE_ETC2	 // ETC2 RGB8 (opaque) or ETC2 RGBA8 + EAC alpha, GL 4.3
+};
+
+inline const char* textureEncodingName(TextureEncoding encoding)
+{
+	switch (encoding)
+	{
+	case ENCODE_BC: return "bc";
+	case ENCODE_ETC2: return "etc2";
+	default: return "raw";
+	}
+}
+
+inline bool parseTextureEncoding(const char* name, TextureEncoding& encoding)
+{
+	const TextureEncoding encodings[] = { ENCODE_RAW, ENCODE_BC, ENCODE_ETC2 };
+	for (int i = 0; i < 3; i++)
+	{
+		if (strcmp(name, textureEncodingName(encodings[i])) == 0)
+		{
+			encoding = encodings[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+// can the current context sample textures stored with 'encoding'
+inline bool textureEncodingSupported(TextureEncoding encoding)
+{
+	switch (encoding)
+	{
+	case ENCODE_BC: return glExtensions().textureCompressionS3TC;
+	case ENCODE_ETC2: return glExtensions().textureCompressionETC2;
+	default: return true;
+	}
+}
+
+/* Format of the levels in a cache file */
+enum TextureCacheFormat
+{
+	TEXCACHE_RGB8 = 1,
+	TEXCACHE_RGBA8,
+	TEXCACHE_BC1,
+	TEXCACHE_BC3,
+	TEXCACHE_ETC2_RGB8,
+	TEXCACHE_ETC2_RGBA8
+};
+
+struct TextureCacheHeader
+{
+	char magic[4];		 // "LTEX"
+	uint32_t version;
+	uint64_t sourceHash; // same as the file name
+	uint32_t format;	 // TextureCacheFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+};
+
+struct TextureCacheLevel
+{
+	uint64_t offset; // from the start of the file
+	uint64_t size;	 // bytes
+	uint32_t width;
+	uint32_t height;
+};
+
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+// cache key of a source image file loaded with the given vertical flip
+inline uint64_t textureCacheKey(const unsigned char* bytes, size_t size, bool flipVertically)
+{
+	unsigned char flip = flipVertically ? 1 : 0;
+	return hashBytes(&flip, 1, hashBytes(bytes, size));
+}
+
+inline std::string textureCachePath(const std::string& directory, uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.ltex", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+inline GLenum textureCacheInternalFormat(uint32_t format)
+{
+	switch (format)
+	{
+	case TEXCACHE_RGB8: return GL_RGB8;
+	case TEXCACHE_RGBA8: return GL_RGBA8;
+	case TEXCACHE_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TEXCACHE_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TEXCACHE_ETC2_RGB8: return GL_COMPRESSED_RGB8_ETC2;
+	case TEXCACHE_ETC2_RGBA8: return GL_COMPRESSED_RGBA8_ETC2_EAC;
+	default: return 0;
+	}
+}
+
+inline const char* textureCacheFormatName(uint32_t format)
+{
+	switch (format)
+	{
+	case TEXCACHE_RGB8: return "rgb8";
+	case TEXCACHE_RGBA8: return "rgba8";
+	case TEXCACHE_BC1: return "bc1";
+	case TEXCACHE_BC3: return "bc3";
+	case TEXCACHE_ETC2_RGB8: return "etc2_rgb8";
+	case TEXCACHE_ETC2_RGBA8: return "etc2_rgba8_eac";
+	default: return "unknown";
+	}
+}
+
+/*********************************************************************/
+/* Block encoders. Input is one 4x4 RGBA8 block, row by row.         */
+/*********************************************************************/
+
+inline unsigned short packRGB565(const int* rgb)
+{
+	return (unsigned short)(((rgb[0] * 31 + 127) / 255) << 11 | ((rgb[1] * 63 + 127) / 255) << 5 | ((rgb[2] * 31 + 127) / 255));
+}
+
+inline void unpackRGB565(unsigned short c, int* rgb)
+{
+	int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 colour block (8 bytes), also the colour half of BC3
+inline void encodeBC1Block(const unsigned char* block, unsigned char* out)
+{
+	/* End points: the bounding box of the colours, inset by 1/16 */
+	int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			low[c] = std::min(low[c], (int)block[i * 4 + c]);
+			high[c] = std::max(high[c], (int)block[i * 4 + c]);
+		}
+	}
+	for (int c = 0; c < 3; c++)
+	{
+		int inset = (high[c] - low[c]) / 16;
+		low[c] += inset;
+		high[c] -= inset;
+	}
+	unsigned short c0 = packRGB565(high), c1 = packRGB565(low);
+	if (c0 < c1)
+	{
+		std::swap(c0, c1); // c0 > c1 selects the 4 colour mode
+	}
+
+	int palette[4][3];
+	unpackRGB565(c0, palette[0]);
+	unpackRGB565(c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1) // equal end points: every pixel is index 0
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 4; p++)
+			{
+				int error = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int d = (int)block[i * 4 + c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < bestError)
+				{
+					best = p;
+					bestError = error;
+				}
+			}
+			indices |= (uint32_t)best << (2 * i);
+		}
+	}
+	out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+	for (int k = 0; k < 4; k++)
+	{
+		out[4 + k] = (unsigned char)(indices >> (8 * k));
+	}
+}
+
+// BC3 block (16 bytes): interpolated alpha block then BC1 colour block
+inline void encodeBC3Block(const unsigned char* block, unsigned char* out)
+{
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		a0 = std::max(a0, (int)block[i * 4 + 3]);
+		a1 = std::min(a1, (int)block[i * 4 + 3]);
+	}
+	int palette[8] = { a0, a1 };
+	for (int p = 1; p < 7; p++)
+	{
+		palette[p + 1] = ((7 - p) * a0 + p * a1) / 7; // a0 > a1: 6 interpolated values
+	}
+
+	uint64_t indices = 0;
+	if (a0 != a1)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 8; p++)
+			{
+				int error = std::abs((int)block[i * 4 + 3] - palette[p]);
+				if (error < bestError)
+				{
+					best = p;
+					bestError = error;
+				}
+			}
+			indices |= (uint64_t)best << (3 * i);
+		}
+	}
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int k = 0; k < 6; k++)
+	{
+		out[2 + k] = (unsigned char)(indices >> (8 * k));
+	}
+	encodeBC1Block(block, out + 8);
+}
+
+inline void storeBigEndian64(uint64_t value, unsigned char* out)
+{
+	for (int k = 0; k < 8; k++)
+	{
+		out[k] = (unsigned char)(value >> (56 - 8 * k));
+	}
+}
+
+// ETC2 RGB8 block (8 bytes), ETC1 "individual" mode which ETC2 decodes unchanged
+inline void encodeETC2RGBBlock(const unsigned char* block, unsigned char* out)
+{
+	static const int modifiers[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+
+	uint64_t bestBits = 0;
+	long long bestError = -1;
+	for (int flip = 0; flip < 2; flip++) // 0: 2x4 sub-blocks side by side, 1: 4x2 sub-blocks on top of each other
+	{
+		uint64_t bits = (uint64_t)flip << 32;
+		long long totalError = 0;
+		for (int sub = 0; sub < 2; sub++)
+		{
+			/* Pixels of the sub-block */
+			int pixels[8], count = 0;
+			for (int x = 0; x < 4; x++)
+			{
+				for (int y = 0; y < 4; y++)
+				{
+					if ((flip ? y / 2 : x / 2) == sub)
+					{
+						pixels[count++] = x * 4 + y; // ETC pixel order is column major
+					}
+				}
+			}
+
+			/* Base colour: the average in 4 bits per channel */
+			int base4[3], base[3];
+			for (int c = 0; c < 3; c++)
+			{
+				int sum = 0;
+				for (int k = 0; k < 8; k++)
+				{
+					int x = pixels[k] / 4, y = pixels[k] % 4;
+					sum += block[(y * 4 + x) * 4 + c];
+				}
+				base4[c] = ((sum / 8) * 15 + 127) / 255;
+				base[c] = base4[c] << 4 | base4[c];
+			}
+
+			/* Modifier table with the smallest error */
+			int bestTable = 0;
+			long long bestTableError = -1;
+			int bestSelectors[8] = { 0 };
+			for (int table = 0; table < 8; table++)
+			{
+				const int deltas[4] = { modifiers[table][0], modifiers[table][1], -modifiers[table][0], -modifiers[table][1] };
+				long long error = 0;
+				int selectors[8];
+				for (int k = 0; k < 8; k++)
+				{
+					int x = pixels[k] / 4, y = pixels[k] % 4;
+					const unsigned char* pixel = &block[(y * 4 + x) * 4];
+					int bestSelectorError = 1 << 30;
+					for (int s = 0; s < 4; s++)
+					{
+						int e = 0;
+						for (int c = 0; c < 3; c++)
+						{
+							int d = (int)pixel[c] - std::min(255, std::max(0, base[c] + deltas[s]));
+							e += d * d;
+						}
+						if (e < bestSelectorError)
+						{
+							bestSelectorError = e;
+							selectors[k] = s;
+						}
+					}
+					error += bestSelectorError;
+				}
+				if (bestTableError < 0 || error < bestTableError)
+				{
+					bestTableError = error;
+					bestTable = table;
+					memcpy(bestSelectors, selectors, sizeof(selectors));
+				}
+			}
+			totalError += bestTableError;
+
+			bits |= (uint64_t)base4[0] << (60 - 4 * sub);
+			bits |= (uint64_t)base4[1] << (52 - 4 * sub);
+			bits |= (uint64_t)base4[2] << (44 - 4 * sub);
+			bits |= (uint64_t)bestTable << (37 - 3 * sub);
+			for (int k = 0; k < 8; k++)
+			{
+				bits |= (uint64_t)(bestSelectors[k] >> 1) << (16 + pixels[k]); // most significant bit
+				bits |= (uint64_t)(bestSelectors[k] & 1) << pixels[k];			// least significant bit
+			}
+		}
+		if (bestError < 0 || totalError < bestError)
+		{
+			bestError = totalError;
+			bestBits = bits;
+		}
+	}
+	storeBigEndian64(bestBits, out);
+}
+
+// ETC2 RGBA8 block (16 bytes): EAC alpha block then ETC2 RGB8 block
+inline void encodeETC2RGBABlock(const unsigned char* block, unsigned char* out)
+{
+	static const int modifiers[16][8] = {
+		{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+		{ -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+		{ -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+		{ -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+		{ -2, -6, -8, -10, 1, 5, 7, 9 },  { -2, -5, -8, -10, 1, 4, 7, 9 },
+		{ -2, -4, -8, -10, 1, 3, 7, 9 },  { -2, -5, -7, -10, 1, 4, 6, 9 },
+		{ -3, -4, -7, -10, 2, 3, 6, 9 },  { -1, -2, -3, -10, 0, 1, 2, 9 },
+		{ -4, -6, -8, -9, 3, 5, 7, 8 },   { -3, -5, -7, -9, 2, 4, 6, 8 }
+	};
+
+	int alpha[16]; // ETC pixel order (column major)
+	int low = 255, high = 0;
+	for (int x = 0; x < 4; x++)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			alpha[x * 4 + y] = block[(y * 4 + x) * 4 + 3];
+			low = std::min(low, alpha[x * 4 + y]);
+			high = std::max(high, alpha[x * 4 + y]);
+		}
+	}
+
+	/* Search table and multiplier, the base is centred on the alpha range */
+	int bestBase = low, bestMultiplier = 1, bestTable = 13; // table 13 has a 0 modifier: exact for flat blocks
+	long long bestError = -1;
+	for (int table = 0; table < 16 && bestError != 0; table++)
+	{
+		for (int multiplier = 1; multiplier < 16 && bestError != 0; multiplier++)
+		{
+			int base = (low + high + 1) / 2 - (modifiers[table][3] + modifiers[table][7]) * multiplier / 2;
+			base = std::min(255, std::max(0, base));
+			long long error = 0;
+			for (int i = 0; i < 16 && (bestError < 0 || error < bestError); i++)
+			{
+				int bestPixelError = 1 << 30;
+				for (int s = 0; s < 8; s++)
+				{
+					int d = alpha[i] - std::min(255, std::max(0, base + modifiers[table][s] * multiplier));
+					bestPixelError = std::min(bestPixelError, d * d);
+				}
+				error += bestPixelError;
+			}
+			if (bestError < 0 || error < bestError)
+			{
+				bestError = error;
+				bestBase = base;
+				bestMultiplier = multiplier;
+				bestTable = table;
+			}
+		}
+	}
+
+	uint64_t bits = (uint64_t)bestBase << 56 | (uint64_t)bestMultiplier << 52 | (uint64_t)bestTable << 48;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestPixelError = 1 << 30;
+		for (int s = 0; s < 8; s++)
+		{
+			int d = alpha[i] - std::min(255, std::max(0, bestBase + modifiers[bestTable][s] * bestMultiplier));
+			if (d * d < bestPixelError)
+			{
+				bestPixelError = d * d;
+				best = s;
+			}
+		}
+		bits |= (uint64_t)best << (45 - 3 * i);
+	}
+	storeBigEndian64(bits, out);
+	encodeETC2RGBBlock(block, out + 8);
+}
+
+/*********************************************************************/
+/* Cache file writer                                                  */
+/*********************************************************************/
+
+// half size RGBA8 image with a 2x2 box filter (odd edges are clamped)
+inline void downsampleRGBA(const std::vector<unsigned char>& source, int width, int height, std::vector<unsigned char>& destination, int& outWidth, int& outHeight)
+{
+	outWidth = std::max(1, width / 2);
+	outHeight = std::max(1, height / 2);
+	destination.resize((size_t)outWidth * outHeight * 4);
+	for (int y = 0; y < outHeight; y++)
+	{
+		int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		for (int x = 0; x < outWidth; x++)
+		{
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c]
+					+ source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+				destination[((size_t)y * outWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+// one level of an RGBA8 image in the cache format
+inline void encodeLevel(const std::vector<unsigned char>& rgba, int width, int height, uint32_t format, std::vector<unsigned char>& out)
+{
+	if (format == TEXCACHE_RGB8 || format == TEXCACHE_RGBA8)
+	{
+		int channels = format == TEXCACHE_RGB8 ? 3 : 4;
+		out.resize((size_t)width * height * channels);
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			memcpy(&out[i * channels], &rgba[i * 4], channels);
+		}
+		return;
+	}
+
+	int blockBytes = (format == TEXCACHE_BC1 || format == TEXCACHE_ETC2_RGB8) ? 8 : 16;
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	out.resize((size_t)blocksX * blocksY * blockBytes);
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			/* Gather the 4x4 block, the edge pixels are repeated on partial blocks */
+			unsigned char block[16 * 4];
+			for (int y = 0; y < 4; y++)
+			{
+				for (int x = 0; x < 4; x++)
+				{
+					int sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+					memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+				}
+			}
+			unsigned char* destination = &out[((size_t)by * blocksX + bx) * blockBytes];
+			switch (format)
+			{
+			case TEXCACHE_BC1: encodeBC1Block(block, destination); break;
+			case TEXCACHE_BC3: encodeBC3Block(block, destination); break;
+			case TEXCACHE_ETC2_RGB8: encodeETC2RGBBlock(block, destination); break;
+			default: encodeETC2RGBABlock(block, destination); break;
+			}
+		}
+	}
+}
+
+/* Build the mip chain of a decoded image (1 to 4 channels), encode it and
+   write the cache file. The file is written under a temporary name and
+   renamed, so readers never map a partial file. */
+inline bool writeTextureCache(const std::string& path, uint64_t key, const unsigned char* pixels, int width, int height, int channels, TextureEncoding encoding)
+{
+	/* Work on RGBA8 */
+	std::vector<unsigned char> rgba((size_t)width * height * 4);
+	bool opaque = true;
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		const unsigned char* p = pixels + i * channels;
+		unsigned char* q = &rgba[i * 4];
+		q[0] = p[0];
+		q[1] = channels >= 3 ? p[1] : p[0];
+		q[2] = channels >= 3 ? p[2] : p[0];
+		q[3] = channels == 4 ? p[3] : (channels == 2 ? p[1] : 255);
+		opaque = opaque && q[3] == 255;
+	}
+
+	uint32_t format;
+	switch (encoding)
+	{
+	case ENCODE_BC: format = opaque ? TEXCACHE_BC1 : TEXCACHE_BC3; break;
+	case ENCODE_ETC2: format = opaque ? TEXCACHE_ETC2_RGB8 : TEXCACHE_ETC2_RGBA8; break;
+	default: format = channels == 3 ? TEXCACHE_RGB8 : TEXCACHE_RGBA8; break;
+	}
+
+	std::vector<std::vector<unsigned char> > data;
+	std::vector<TextureCacheLevel> levels;
+	int levelWidth = width, levelHeight = height;
+	for (;;)
+	{
+		TextureCacheLevel level;
+		level.width = (uint32_t)levelWidth;
+		level.height = (uint32_t)levelHeight;
+		data.push_back(std::vector<unsigned char>());
+		encodeLevel(rgba, levelWidth, levelHeight, format, data.back());
+		level.size = data.back().size();
+		levels.push_back(level);
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		std::vector<unsigned char> smaller;
+		downsampleRGBA(rgba, levelWidth, levelHeight, smaller, levelWidth, levelHeight);
+		rgba.swap(smaller);
+	}
+
+	TextureCacheHeader header;
+	memcpy(header.magic, "LTEX", 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.sourceHash = key;
+	header.format = format;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.levelCount = (uint32_t)levels.size();
+
+	uint64_t offset = sizeof(header) + levels.size() * sizeof(TextureCacheLevel);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		offset = (offset + 15) & ~(uint64_t)15;
+		levels[i].offset = offset;
+		offset += levels[i].size;
+	}
+
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)levels.data(), levels.size() * sizeof(TextureCacheLevel));
+		const char zeros[16] = { 0 };
+		uint64_t position = sizeof(header) + levels.size() * sizeof(TextureCacheLevel);
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			file.write(zeros, (std::streamsize)(levels[i].offset - position));
+			file.write((const char*)data[i].data(), (std::streamsize)data[i].size());
+			position = levels[i].offset + levels[i].size;
+		}
+		if (!file)
+		{
+			return false;
+		}
+	}
+	return replaceFile(temporary, path);
+}
+
+/*********************************************************************/
+/* Cache file reader                                                  */
+/*********************************************************************/
+
+/* A mapped cache file. The level data points into the mapping and is
+   passed to OpenGL as is. */
+class TextureCacheFile
+{
+public:
+	TextureCacheFile() : header(NULL), levels(NULL)
+	{
+	}
+
+	// map the file and check it belongs to 'key'
+	bool open(const std::string& path, uint64_t key)
+	{
+		if (!file.open(path.c_str()) || file.size() < sizeof(TextureCacheHeader))
+		{
+			return false;
+		}
+		header = (const TextureCacheHeader*)file.data();
+		if (memcmp(header->magic, "LTEX", 4) != 0 || header->version != TEXTURE_CACHE_VERSION || header->sourceHash != key
+			|| textureCacheInternalFormat(header->format) == 0 || header->levelCount == 0
+			|| file.size() < sizeof(TextureCacheHeader) + header->levelCount * sizeof(TextureCacheLevel))
+		{
+			close();
+			return false;
+		}
+		levels = (const TextureCacheLevel*)(file.data() + sizeof(TextureCacheHeader));
+		for (uint32_t i = 0; i < header->levelCount; i++)
+		{
+			if (levels[i].offset + levels[i].size > file.size())
+			{
+				close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void close()
+	{
+		file.close();
+		header = NULL;
+		levels = NULL;
+	}
+
+	int width() const { return (int)header->width; }
+	int height() const { return (int)header->height; }
+	uint32_t format() const { return header->format; }
+	int levelCount() const { return (int)header->levelCount; }
+	const TextureCacheLevel& level(int i) const { return levels[i]; }
+	const unsigned char* levelData(int i) const { return file.data() + levels[i].offset; }
+
+	bool compressed() const
+	{
+		return header->format != TEXCACHE_RGB8 && header->format != TEXCACHE_RGBA8;
+	}
+
+	// encoding the file was written with
+	TextureEncoding encoding() const
+	{
+		switch (header->format)
+		{
+		case TEXCACHE_BC1: case TEXCACHE_BC3: return ENCODE_BC;
+		case TEXCACHE_ETC2_RGB8: case TEXCACHE_ETC2_RGBA8: return ENCODE_ETC2;
+		default: return ENCODE_RAW;
+		}
+	}
+
+	// bytes of all the levels
+	size_t dataSize() const
+	{
+		size_t size = 0;
+		for (int i = 0; i < levelCount(); i++)
+		{
+			size += (size_t)levels[i].size;
+		}
+		return size;
+	}
+
+	/* Create the levels of the texture bound to GL_TEXTURE_2D straight from
+	   the mapping (no GL_PIXEL_UNPACK_BUFFER may be bound) */
+	void upload() const
+	{
+		GLenum internalFormat = textureCacheInternalFormat(header->format);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int i = 0; i < levelCount(); i++)
+		{
+			const TextureCacheLevel& l = levels[i];
+			if (compressed())
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, l.width, l.height, 0, (GLsizei)l.size, levelData(i));
+			}
+			else
+			{
+				GLenum format = header->format == TEXCACHE_RGB8 ? GL_RGB : GL_RGBA;
+				glTexImage2D(GL_TEXTURE_2D, i, internalFormat, l.width, l.height, 0, format, GL_UNSIGNED_BYTE, levelData(i));
+			}
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount() - 1);
+	}
+
+private:
+	MappedFile file;
+	const TextureCacheHeader* header;
+	const TextureCacheLevel* levels;
+};
+
+#endif
@@ -0,0 +1,422 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "stb_image.h"
+#include "thread_pool.h"
+#include "benchmark.h"
+#include "texture_cache.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Everything known about one texture requested from the TextureLoader */
+struct TextureState
+{
+	std::string path;
+	bool flipVertically;
+	unsigned int texture;	// real texture object, 0 until the upload starts
+	bool ready;				// all levels uploaded, 'texture' can be sampled
+	bool failed;			// decode failed, the placeholder stays bound
+
+	/* Written by the worker thread, read on the GL thread once 'decoded' is ready */
+	unsigned char* pixels;
+	int width, height, channels;
+	std::shared_ptr<TextureCacheFile> cache; // set on a cache hit instead of 'pixels'
+	std::shared_future<bool> decoded;
+
+	int uploadedRows;		// rows of level 0 already sent to OpenGL
+	std::chrono::high_resolution_clock::time_point requested;
+	double decodeMs;		// worker time spent reading and decoding the file
+	double uploadMs;		// GL thread time spent in the uploads
+	double readyMs;			// from load() until the texture is ready
+	bool cached;			// uploaded from the texture cache
+	std::string format;		// format of the texture in GPU memory
+	size_t gpuBytes;		// size of all the levels
+
+	TextureState() : flipVertically(false), texture(0), ready(false), failed(false),
+		pixels(NULL), width(0), height(0), channels(0), uploadedRows(0), decodeMs(0.0), uploadMs(0.0), readyMs(0.0),
+		cached(false), gpuBytes(0)
+	{
+	}
+
+	~TextureState()
+	{
+		if (pixels)
+		{
+			stbi_image_free(pixels);
+		}
+	}
+};
+
+/* Returned by TextureLoader::load(). id() is the placeholder texture until the
+   real one is uploaded, so it can be bound from the first frame. */
+class TextureHandle
+{
+public:
+	TextureHandle() : placeholder(0)
+	{
+	}
+
+	TextureHandle(std::shared_ptr<TextureState> state, unsigned int placeholder) : state(state), placeholder(placeholder)
+	{
+	}
+
+	unsigned int id() const
+	{
+		return (state && state->ready) ? state->texture : placeholder;
+	}
+
+	bool ready() const
+	{
+		return state && state->ready;
+	}
+
+	// becomes ready when the decode is done (true if it succeeded)
+	std::shared_future<bool> decoded() const
+	{
+		return state->decoded;
+	}
+
+private:
+	std::shared_ptr<TextureState> state;
+	unsigned int placeholder;
+};
+
+/* Loads 2D textures without blocking the GL thread:
+   - files are read and decoded with stbi_load_from_memory on a ThreadPool,
+   - update() (GL thread, once per frame) streams the decoded rows through a
+     pixel buffer object, at most 'uploadBudget' bytes per call, and generates
+     the mipmaps when the last row is in.
+   With enableCache() the workers look for the file in the texture cache
+   first: a hit is mapped and uploaded level by level with no decode (see
+   texture_cache.h), a miss is decoded as usual and written to the cache. */
+class TextureLoader
+{
+public:
+	size_t uploadBudget; // bytes uploaded per update()
+
+	TextureLoader(ThreadPool& pool, size_t uploadBudget = 4 * 1024 * 1024) : uploadBudget(uploadBudget), pool(pool), PBO(0), pboSize(0), cacheEncoding(ENCODE_RAW)
+	{
+		/* 1x1 grey texture bound in place of the textures still loading */
+		const unsigned char grey[4] = { 128, 128, 128, 255 };
+		glGenTextures(1, &placeholder);
+		glState().bindTexture(GL_TEXTURE_2D, placeholder);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glGenBuffers(1, &PBO);
+	}
+
+	~TextureLoader()
+	{
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			if (textures[i]->texture)
+			{
+				glDeleteTextures(1, &textures[i]->texture);
+				glState().textureDeleted(textures[i]->texture);
+			}
+		}
+		glDeleteTextures(1, &placeholder);
+		glDeleteBuffers(1, &PBO);
+		glState().textureDeleted(placeholder);
+		glState().bufferDeleted(PBO);
+	}
+
+	/* Use the texture cache in 'directory' for the next load() calls, new
+	   entries are written with 'encoding' (call on the GL thread) */
+	bool enableCache(const std::string& directory, TextureEncoding encoding)
+	{
+		if (!textureEncodingSupported(encoding))
+		{
+			std::cout << "ERROR::TEXTURE_CACHE::ENCODING_NOT_SUPPORTED " << textureEncodingName(encoding) << std::endl;
+			return false;
+		}
+		if (!makeDirectory(directory))
+		{
+			std::cout << "ERROR::TEXTURE_CACHE::CANNOT_CREATE_DIRECTORY " << directory << std::endl;
+			return false;
+		}
+		cacheDirectory = directory;
+		cacheEncoding = encoding;
+		return true;
+	}
+
+	// start loading an image file, returns immediately
+	TextureHandle load(const std::string& path, bool flipVertically)
+	{
+		std::shared_ptr<TextureState> state = std::make_shared<TextureState>();
+		state->path = path;
+		state->flipVertically = flipVertically;
+		state->requested = std::chrono::high_resolution_clock::now();
+
+		/* What the worker needs to know about the cache, the GL state is checked here */
+		CacheRequest cache;
+		cache.directory = cacheDirectory;
+		cache.encoding = cacheEncoding;
+		for (int e = 0; e < 3; e++)
+		{
+			cache.supported[e] = textureEncodingSupported((TextureEncoding)e);
+		}
+		cache.pool = &pool;
+		state->decoded = pool.submit([state, cache]() { return decode(*state, cache); }).share();
+
+		textures.push_back(state);
+		pending.push_back(state);
+		return TextureHandle(state, placeholder);
+	}
+
+	// upload decoded textures within the budget (call once per frame on the GL thread)
+	void update()
+	{
+		upload(uploadBudget, false);
+	}
+
+	// block until every requested texture is uploaded
+	void finish()
+	{
+		upload(0, true);
+	}
+
+	bool busy() const
+	{
+		return !pending.empty();
+	}
+
+	// add the timings of every texture to an open JSON object
+	void writeReport(JsonWriter& json) const
+	{
+		json.beginArray("textures");
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			const TextureState& t = *textures[i];
+			json.beginObject();
+			json.value("path", t.path);
+			json.value("width", (long long)t.width);
+			json.value("height", (long long)t.height);
+			json.value("decode_ms", t.decodeMs);
+			json.value("upload_ms", t.uploadMs);
+			json.value("ready_ms", t.readyMs);
+			json.value("cached", (long long)t.cached);
+			json.value("format", t.format);
+			json.value("gpu_bytes", (long long)t.gpuBytes);
+			json.value("failed", (long long)t.failed);
+			json.endObject();
+		}
+		json.endArray();
+	}
+
+private:
+	ThreadPool& pool;
+	unsigned int placeholder;
+	unsigned int PBO;
+	size_t pboSize;
+	std::vector<std::shared_ptr<TextureState> > textures; // all requested textures
+	std::vector<std::shared_ptr<TextureState> > pending;  // not ready yet, in request order
+	std::string cacheDirectory; // empty: no texture cache
+	TextureEncoding cacheEncoding;
+
+	struct CacheRequest
+	{
+		std::string directory;
+		TextureEncoding encoding;
+		bool supported[3]; // per TextureEncoding, for the context of the loader
+		ThreadPool* pool;
+	};
+
+	// worker thread: read the file and map its cache entry, or decode it
+	static bool decode(TextureState& state, const CacheRequest& cache)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		std::ifstream file(state.path.c_str(), std::ios::binary);
+		std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		uint64_t key = 0;
+		std::string cachePath;
+		if (!cache.directory.empty() && !bytes.empty())
+		{
+			key = textureCacheKey(bytes.data(), bytes.size(), state.flipVertically);
+			cachePath = textureCachePath(cache.directory, key);
+			std::shared_ptr<TextureCacheFile> entry = std::make_shared<TextureCacheFile>();
+			if (entry->open(cachePath, key) && cache.supported[entry->encoding()])
+			{
+				state.cache = entry;
+				state.width = entry->width();
+				state.height = entry->height();
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+				state.decodeMs = elapsed.count();
+				return true;
+			}
+		}
+
+		stbi_set_flip_vertically_on_load_thread(state.flipVertically); // per thread, other workers are not affected
+		if (!bytes.empty())
+		{
+			state.pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &state.width, &state.height, &state.channels, 0);
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		state.decodeMs = elapsed.count();
+
+		if (state.pixels && !cachePath.empty())
+		{
+			/* Fill the cache for the next run, without delaying this texture */
+			std::shared_ptr<std::vector<unsigned char> > pixels = std::make_shared<std::vector<unsigned char> >(
+				state.pixels, state.pixels + (size_t)state.width * state.height * state.channels);
+			int width = state.width, height = state.height, channels = state.channels;
+			TextureEncoding encoding = cache.encoding;
+			cache.pool->submit([cachePath, key, pixels, width, height, channels, encoding]() {
+				if (!writeTextureCache(cachePath, key, pixels->data(), width, height, channels, encoding))
+				{
+					std::cout << "ERROR::TEXTURE_CACHE::WRITE_FAILED " << cachePath << std::endl;
+				}
+			});
+		}
+		return state.pixels != NULL;
+	}
+
+	static GLenum formatOf(int channels)
+	{
+		switch (channels)
+		{
+		case 1: return GL_RED;
+		case 2: return GL_RG;
+		case 3: return GL_RGB;
+		default: return GL_RGBA;
+		}
+	}
+
+	// upload rows of the decoded textures, 'budget' bytes at most unless 'all'
+	void upload(size_t budget, bool all)
+	{
+		size_t budgetLeft = budget;
+		while (!pending.empty() && (all || budgetLeft > 0))
+		{
+			TextureState& state = *pending.front();
+			if (!all && state.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				return; // keep the request order, the next one waits for this decode
+			}
+			if (!state.decoded.get())
+			{
+				std::cout << "ERROR::TEXTURE::FAILED_TO_LOAD\n" << state.path << std::endl;
+				state.failed = true;
+				pending.erase(pending.begin());
+				continue;
+			}
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			if (state.cache)
+			{
+				/* Cache hit: all the levels at once, straight from the mapping */
+				uploadCached(state);
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+				state.uploadMs += elapsed.count();
+				budgetLeft -= std::min(budgetLeft, state.gpuBytes);
+				finishTexture(state);
+				continue;
+			}
+
+			size_t rowBytes = (size_t)state.width * state.channels;
+			int rows = state.height - state.uploadedRows;
+			if (!all)
+			{
+				rows = std::min(rows, std::max(1, (int)(budgetLeft / rowBytes)));
+				budgetLeft -= std::min(budgetLeft, rows * rowBytes);
+			}
+			uploadRows(state, rows);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			state.uploadMs += elapsed.count();
+
+			if (state.uploadedRows == state.height)
+			{
+				/* Generate all the required mipmaps once the whole level 0 is there */
+				glState().bindTexture(GL_TEXTURE_2D, state.texture);
+				glGenerateMipmap(GL_TEXTURE_2D);
+				stbi_image_free(state.pixels); // the texture holds the data now
+				state.pixels = NULL;
+				state.format = state.channels == 3 ? "rgb8" : "rgba8";
+				state.gpuBytes = (size_t)state.width * state.height * state.channels * 4 / 3; // with the mip chain
+				finishTexture(state);
+			}
+		}
+	}
+
+	// the front pending texture is complete
+	void finishTexture(TextureState& state)
+	{
+		state.ready = true;
+		std::chrono::duration<double, std::milli> sinceRequest = std::chrono::high_resolution_clock::now() - state.requested;
+		state.readyMs = sinceRequest.count();
+		pending.erase(pending.begin());
+	}
+
+	void createTexture(TextureState& state)
+	{
+		glGenTextures(1, &state.texture);
+		glState().bindTexture(GL_TEXTURE_2D, state.texture);
+		/* Set the texture wrapping and filtering options */
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+
+	void uploadCached(TextureState& state)
+	{
+		createTexture(state);
+		state.cache->upload();
+		state.cached = true;
+		state.format = textureCacheFormatName(state.cache->format());
+		state.gpuBytes = state.cache->dataSize();
+		state.uploadedRows = state.height;
+		state.cache.reset(); // unmap the file
+	}
+
+	void uploadRows(TextureState& state, int rows)
+	{
+		GLenum format = formatOf(state.channels);
+		if (state.texture == 0)
+		{
+			createTexture(state);
+			/* Allocate level 0, the rows come through the PBO */
+			glTexImage2D(GL_TEXTURE_2D, 0, format, state.width, state.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+		}
+
+		size_t rowBytes = (size_t)state.width * state.channels;
+		size_t bytes = rowBytes * rows;
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		if (bytes > pboSize)
+		{
+			pboSize = bytes;
+		}
+		/* Orphan the previous storage, the driver may still be copying from it */
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, pboSize, NULL, GL_STREAM_DRAW);
+		void* destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (destination)
+		{
+			memcpy(destination, state.pixels + rowBytes * state.uploadedRows, bytes);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+
+		glState().bindTexture(GL_TEXTURE_2D, state.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // rows of RGB images are not 4 byte aligned
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, state.uploadedRows, state.width, rows, format, GL_UNSIGNED_BYTE, (void*)0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		state.uploadedRows += rows;
+	}
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads pulling tasks from one shared queue */
+class ThreadPool
+{
+public:
+	// threads = 0 uses one worker per hardware thread minus the calling thread (at least 1)
+	explicit ThreadPool(unsigned int threads = 0) : stopping(false)
+	{
+		if (threads == 0)
+		{
+			unsigned int hardware = std::thread::hardware_concurrency();
+			threads = hardware > 1 ? hardware - 1 : 1;
+		}
+		for (unsigned int i = 0; i < threads; i++)
+		{
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+	}
+
+	unsigned int size() const
+	{
+		return (unsigned int)workers.size();
+	}
+
+	// run 'task' on a worker, the future holds its result
+	template <class F>
+	auto submit(F task) -> std::future<decltype(task())>
+	{
+		typedef decltype(task()) Result;
+		std::shared_ptr<std::packaged_task<Result()> > packaged = std::make_shared<std::packaged_task<Result()> >(task);
+		std::future<Result> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back([packaged]() { (*packaged)(); });
+		}
+		condition.notify_one();
+		return result;
+	}
+
+	/* Call fn(begin, end) on ranges of [0, count) of at least 'minBatch' items.
+	   The calling thread takes the first range and the call returns when all
+	   ranges are done. */
+	template <class F>
+	void parallelFor(int count, int minBatch, F fn)
+	{
+		int batches = std::min((int)size() + 1, std::max(1, count / std::max(1, minBatch)));
+		if (batches <= 1)
+		{
+			fn(0, count);
+			return;
+		}
+
+		int batchSize = (count + batches - 1) / batches;
+		std::vector<std::future<void> > pending;
+		for (int begin = batchSize; begin < count; begin += batchSize)
+		{
+			int end = std::min(count, begin + batchSize);
+			pending.push_back(submit([fn, begin, end]() { fn(begin, end); }));
+		}
+		fn(0, std::min(count, batchSize));
+		for (size_t i = 0; i < pending.size(); i++)
+		{
+			pending[i].get();
+		}
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (stopping && tasks.empty())
+				{
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
+
+// pool shared by the subsystems of the application
+inline ThreadPool& defaultThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/simd/matrix.h"
+
+#include "thread_pool.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/* Transforms of many instances kept as structure of arrays. Every instance is
+   translate(position) * rotate(angle + time * angularSpeed, axis), optionally
+   put under a common parent matrix.
+
+   update() writes the model matrices (column major mat4, ready for the
+   instance buffer) for the whole batch in one pass. With SSE2 (GLM_ARCH,
+   see GLM_FORCE_INTRINSICS) 4 instances are built at once and multiplied by
+   the parent with glm_mat4_mul from glm/simd/matrix.h; otherwise a scalar
+   loop with the same math is used. Large batches are split over a ThreadPool. */
+class TransformBatch
+{
+public:
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> axisX, axisY, axisZ; // normalized rotation axis
+	std::vector<float> angle;				// radians at time 0
+	std::vector<float> angularSpeed;		// radians per second
+
+	int size() const
+	{
+		return (int)positionX.size();
+	}
+
+	void resize(int count)
+	{
+		positionX.resize(count); positionY.resize(count); positionZ.resize(count);
+		axisX.resize(count); axisY.resize(count); axisZ.resize(count);
+		angle.resize(count);
+		angularSpeed.resize(count);
+	}
+
+	void set(int i, const glm::vec3& position, const glm::vec3& axis, float angle0, float speed)
+	{
+		glm::vec3 n = glm::normalize(axis);
+		positionX[i] = position.x; positionY[i] = position.y; positionZ[i] = position.z;
+		axisX[i] = n.x; axisY[i] = n.y; axisZ[i] = n.z;
+		angle[i] = angle0;
+		angularSpeed[i] = speed;
+	}
+
+	// copy the instances indices[0 .. count) of 'source', in that order (the visible ones after culling)
+	void gather(const TransformBatch& source, const int* indices, int count)
+	{
+		resize(count);
+		for (int k = 0; k < count; k++)
+		{
+			int i = indices[k];
+			positionX[k] = source.positionX[i]; positionY[k] = source.positionY[i]; positionZ[k] = source.positionZ[i];
+			axisX[k] = source.axisX[i]; axisY[k] = source.axisY[i]; axisZ[k] = source.axisZ[i];
+			angle[k] = source.angle[i];
+			angularSpeed[k] = source.angularSpeed[i];
+		}
+	}
+
+	// write the model matrices of all instances at 'time' into 'out'
+	void update(float time, const glm::mat4& parent, glm::mat4* out, ThreadPool* pool) const
+	{
+		const int minBatch = 4096; // below this the thread hand-off costs more than it saves
+		if (pool)
+		{
+			pool->parallelFor(size(), minBatch, [this, time, &parent, out](int begin, int end) {
+				updateRange(time, parent, out, begin, end);
+			});
+		}
+		else
+		{
+			updateRange(time, parent, out, 0, size());
+		}
+	}
+
+	void updateRange(float time, const glm::mat4& parent, glm::mat4* out, int begin, int end) const
+	{
+		bool hasParent = parent != glm::mat4(1.0f);
+		int i = begin;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		/* The destination is often write-combined mapped memory: bypass the
+		   cache with streaming stores when it is 16 byte aligned */
+		bool aligned = ((uintptr_t)out & 15) == 0;
+		glm_vec4 parentColumns[4];
+		for (int c = 0; c < 4; c++)
+		{
+			parentColumns[c] = _mm_loadu_ps(&parent[c][0]);
+		}
+
+		for (; i + 4 <= end; i += 4)
+		{
+			float sines[4], cosines[4];
+			for (int k = 0; k < 4; k++)
+			{
+				float a = angle[i + k] + time * angularSpeed[i + k];
+				sines[k] = std::sin(a);
+				cosines[k] = std::cos(a);
+			}
+			__m128 s = _mm_loadu_ps(sines);
+			__m128 c = _mm_loadu_ps(cosines);
+			__m128 x = _mm_loadu_ps(&axisX[i]);
+			__m128 y = _mm_loadu_ps(&axisY[i]);
+			__m128 z = _mm_loadu_ps(&axisZ[i]);
+
+			/* Same terms as glm::rotate: temp = (1 - c) * axis */
+			__m128 oneMinusC = _mm_sub_ps(_mm_set1_ps(1.0f), c);
+			__m128 tx = _mm_mul_ps(oneMinusC, x);
+			__m128 ty = _mm_mul_ps(oneMinusC, y);
+			__m128 tz = _mm_mul_ps(oneMinusC, z);
+			__m128 sx = _mm_mul_ps(s, x);
+			__m128 sy = _mm_mul_ps(s, y);
+			__m128 sz = _mm_mul_ps(s, z);
+			__m128 zero = _mm_setzero_ps();
+
+			/* One register per matrix element for the 4 instances, then
+			   transpose to get the columns of each instance */
+			glm_vec4 columns[4][4]; // [column][instance]
+			columns[0][0] = _mm_add_ps(c, _mm_mul_ps(tx, x));
+			columns[0][1] = _mm_add_ps(_mm_mul_ps(tx, y), sz);
+			columns[0][2] = _mm_sub_ps(_mm_mul_ps(tx, z), sy);
+			columns[0][3] = zero;
+			columns[1][0] = _mm_sub_ps(_mm_mul_ps(ty, x), sz);
+			columns[1][1] = _mm_add_ps(c, _mm_mul_ps(ty, y));
+			columns[1][2] = _mm_add_ps(_mm_mul_ps(ty, z), sx);
+			columns[1][3] = zero;
+			columns[2][0] = _mm_add_ps(_mm_mul_ps(tz, x), sy);
+			columns[2][1] = _mm_sub_ps(_mm_mul_ps(tz, y), sx);
+			columns[2][2] = _mm_add_ps(c, _mm_mul_ps(tz, z));
+			columns[2][3] = zero;
+			columns[3][0] = _mm_loadu_ps(&positionX[i]);
+			columns[3][1] = _mm_loadu_ps(&positionY[i]);
+			columns[3][2] = _mm_loadu_ps(&positionZ[i]);
+			columns[3][3] = _mm_set1_ps(1.0f);
+			for (int col = 0; col < 4; col++)
+			{
+				_MM_TRANSPOSE4_PS(columns[col][0], columns[col][1], columns[col][2], columns[col][3]);
+			}
+
+			for (int k = 0; k < 4; k++)
+			{
+				glm_vec4 local[4] = { columns[0][k], columns[1][k], columns[2][k], columns[3][k] };
+				glm_vec4 model[4];
+				if (hasParent)
+				{
+					glm_mat4_mul(parentColumns, local, model);
+				}
+				else
+				{
+					model[0] = local[0]; model[1] = local[1]; model[2] = local[2]; model[3] = local[3];
+				}
+
+				float* destination = &out[i + k][0][0];
+				for (int col = 0; col < 4; col++)
+				{
+					if (aligned)
+					{
+						_mm_stream_ps(destination + col * 4, model[col]);
+					}
+					else
+					{
+						_mm_storeu_ps(destination + col * 4, model[col]);
+					}
+				}
+			}
+		}
+		_mm_sfence(); // make the streaming stores visible before the draw reads them
+#endif
+		/* Scalar path (and the remaining instances of the SIMD path) */
+		for (; i < end; i++)
+		{
+			float a = angle[i] + time * angularSpeed[i];
+			float s = std::sin(a);
+			float c = std::cos(a);
+			glm::vec3 axis(axisX[i], axisY[i], axisZ[i]);
+			glm::vec3 temp = (1.0f - c) * axis;
+
+			glm::mat4 model(1.0f);
+			model[0] = glm::vec4(c + temp.x * axis.x, temp.x * axis.y + s * axis.z, temp.x * axis.z - s * axis.y, 0.0f);
+			model[1] = glm::vec4(temp.y * axis.x - s * axis.z, c + temp.y * axis.y, temp.y * axis.z + s * axis.x, 0.0f);
+			model[2] = glm::vec4(temp.z * axis.x + s * axis.y, temp.z * axis.y - s * axis.x, c + temp.z * axis.z, 0.0f);
+			model[3] = glm::vec4(positionX[i], positionY[i], positionZ[i], 1.0f);
+			out[i] = hasParent ? parent * model : model;
+		}
+	}
+};
+
+#endif
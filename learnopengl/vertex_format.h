@@ -0,0 +1,397 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Compressed vertex formats.
+
+   Every attribute is fetched with a normalized or half float
+   glVertexAttribPointer (vertexFormatLayout()), so the shader reads floats
+   like before and only the unorm16 position (positionOffset + positionScale
+   * aPos, the mesh bounds) and the octahedral normal (octDecode() below)
+   need decoding. The attributes start on 4 byte boundaries, as most vertex
+   fetch units want.
+
+   Positions are quantized as unorm16 rather than snorm16: GL 4.2 changed how
+   normalized signed integers convert to float (c / 32767 instead of
+   (2c + 1) / 65535), so snorm16 would decode differently on 3.3 and 4.x
+   contexts. Unsigned normalization is c / 65535 everywhere, with one more
+   bit of precision. The octahedral normals stay snorm16, the old conversion
+   only moves them by 1/65535 before the normalize(). */
+
+enum PositionFormat
+{
+	POSITION_FLOAT3,	 // 12 bytes
+	POSITION_HALF4,		 // 8 bytes (w unused), relative error 2^-11
+	POSITION_UNORM16x4	 // 8 bytes (w unused), quantized in the bounds of the mesh
+};
+
+enum NormalFormat
+{
+	NORMAL_NONE,
+	NORMAL_FLOAT3, // 12 bytes
+	NORMAL_OCT16   // 4 bytes, octahedral mapping in 2 snorm16
+};
+
+enum ColorFormat
+{
+	COLOR_NONE,
+	COLOR_FLOAT3,  // 12 bytes
+	COLOR_UNORM8x4 // 4 bytes (alpha 1)
+};
+
+enum TexCoordFormat
+{
+	TEXCOORD_NONE,
+	TEXCOORD_FLOAT2, // 8 bytes
+	TEXCOORD_HALF2	 // 4 bytes
+};
+
+/* Where the attributes are in the float vertices given to the encoder
+   (offsets in floats, -1 if the mesh does not have the attribute) */
+struct VertexSource
+{
+	int stride; // floats per vertex
+	int position;
+	int normal;
+	int color;
+	int texCoord;
+};
+
+/* Layout of one encoded vertex */
+struct VertexFormat
+{
+	PositionFormat position;
+	NormalFormat normal;
+	ColorFormat color;
+	TexCoordFormat texCoord;
+	int positionOffset, normalOffset, colorOffset, texCoordOffset; // bytes, -1 if absent
+	int stride;														// bytes
+
+	VertexFormat(PositionFormat p = POSITION_FLOAT3, NormalFormat n = NORMAL_NONE, ColorFormat c = COLOR_NONE, TexCoordFormat t = TEXCOORD_NONE)
+		: position(p), normal(n), color(c), texCoord(t)
+	{
+		stride = 0;
+		positionOffset = place(p == POSITION_FLOAT3 ? 12 : 8);
+		normalOffset = n == NORMAL_NONE ? -1 : place(n == NORMAL_FLOAT3 ? 12 : 4);
+		colorOffset = c == COLOR_NONE ? -1 : place(c == COLOR_FLOAT3 ? 12 : 4);
+		texCoordOffset = t == TEXCOORD_NONE ? -1 : place(t == TEXCOORD_FLOAT2 ? 8 : 4);
+	}
+
+private:
+	int place(int size)
+	{
+		int offset = stride;
+		stride += size;
+		return offset;
+	}
+};
+
+/* Formats selected with --vertex-format */
+enum VertexFormatPreset
+{
+	VERTEX_FORMAT_FLOAT,  // everything float (the tutorial layout)
+	VERTEX_FORMAT_HALF,	  // half positions, octahedral normals, unorm8 colours, half UVs
+	VERTEX_FORMAT_PACKED  // same with unorm16 positions
+};
+
+inline const char* vertexFormatName(VertexFormatPreset preset)
+{
+	switch (preset)
+	{
+	case VERTEX_FORMAT_HALF: return "half";
+	case VERTEX_FORMAT_PACKED: return "packed";
+	default: return "float";
+	}
+}
+
+inline bool parseVertexFormat(const char* name, VertexFormatPreset& preset)
+{
+	const VertexFormatPreset presets[] = { VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_HALF, VERTEX_FORMAT_PACKED };
+	for (int i = 0; i < 3; i++)
+	{
+		if (strcmp(name, vertexFormatName(presets[i])) == 0)
+		{
+			preset = presets[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+// format of 'preset' for the attributes the source has
+inline VertexFormat vertexFormatFor(VertexFormatPreset preset, const VertexSource& source)
+{
+	bool isFloat = preset == VERTEX_FORMAT_FLOAT;
+	PositionFormat position = isFloat ? POSITION_FLOAT3 : (preset == VERTEX_FORMAT_HALF ? POSITION_HALF4 : POSITION_UNORM16x4);
+	NormalFormat normal = source.normal < 0 ? NORMAL_NONE : (isFloat ? NORMAL_FLOAT3 : NORMAL_OCT16);
+	ColorFormat color = source.color < 0 ? COLOR_NONE : (isFloat ? COLOR_FLOAT3 : COLOR_UNORM8x4);
+	TexCoordFormat texCoord = source.texCoord < 0 ? TEXCOORD_NONE : (isFloat ? TEXCOORD_FLOAT2 : TEXCOORD_HALF2);
+	return VertexFormat(position, normal, color, texCoord);
+}
+
+/* Largest difference between the source and the decoded attributes */
+struct VertexError
+{
+	float position;		 // object space units, per component
+	float normalDegrees; // angle between the normals
+	float color;		 // per component, colours in [0, 1]
+	float texCoord;		 // per component
+};
+
+/* Vertices in a VertexFormat, ready for glBufferData. 'bound' is what the
+   formats guarantee for the encoded data, 'measured' what the encoder saw. */
+struct EncodedVertices
+{
+	VertexFormat format;
+	std::vector<unsigned char> data;
+	int count;
+	glm::vec3 positionOffset; // position = positionOffset + positionScale * decoded
+	glm::vec3 positionScale;
+	VertexError bound;
+	VertexError measured;
+};
+
+// octahedral mapping of a unit vector to [-1, 1]^2
+inline glm::vec2 octEncode(glm::vec3 n)
+{
+	n /= fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	glm::vec2 p(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		p = glm::vec2((1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return p;
+}
+
+inline glm::vec3 octDecode(glm::vec2 e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+/* Same decode for the vertex shaders reading NORMAL_OCT16 */
+const char* const OCT_DECODE_GLSL =
+	"vec3 octDecode(vec2 e)\n"
+	"{\n"
+	"	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+	"	float t = max(-n.z, 0.0);\n"
+	"	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);\n"
+	"	return normalize(n);\n"
+	"}\n";
+
+/* Octahedral normal in 2 snorm16. Plain rounding of both coordinates is not
+   the closest code: the 4 floor/ceil neighbours are decoded and the best one
+   is kept, which lowers the worst angle error by a third (0.0025 degrees). */
+inline void encodeOct16(const glm::vec3& normal, int16_t out[2])
+{
+	glm::vec3 n = glm::normalize(normal);
+	glm::vec2 p = octEncode(n) * 32767.0f;
+	float bestError = 1e30f;
+	out[0] = out[1] = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		float x = (i & 1) ? ceilf(p.x) : floorf(p.x);
+		float y = (i & 2) ? ceilf(p.y) : floorf(p.y);
+		x = std::min(std::max(x, -32767.0f), 32767.0f);
+		y = std::min(std::max(y, -32767.0f), 32767.0f);
+		glm::vec3 difference = octDecode(glm::vec2(x, y) / 32767.0f) - n; // not the dot product, too close to 1 for floats
+		float error = glm::dot(difference, difference);
+		if (error < bestError)
+		{
+			bestError = error;
+			out[0] = (int16_t)x;
+			out[1] = (int16_t)y;
+		}
+	}
+}
+
+/* Encode 'count' float vertices laid out like 'source' into 'format' */
+inline void encodeVertices(const float* vertices, int count, const VertexSource& source, const VertexFormat& format, EncodedVertices& out)
+{
+	out.format = format;
+	out.count = count;
+	out.data.assign((size_t)count * format.stride, 0);
+	memset(&out.bound, 0, sizeof(out.bound));
+	memset(&out.measured, 0, sizeof(out.measured));
+
+	/* Bounds of the positions, the unorm16 range covers them */
+	glm::vec3 low(0.0f), high(0.0f);
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 p = glm::make_vec3(vertices + (size_t)i * source.stride + source.position);
+		low = i == 0 ? p : glm::min(low, p);
+		high = i == 0 ? p : glm::max(high, p);
+	}
+	out.positionOffset = glm::vec3(0.0f);
+	out.positionScale = glm::vec3(1.0f);
+	if (format.position == POSITION_UNORM16x4)
+	{
+		out.positionOffset = low;
+		out.positionScale = glm::max(high - low, glm::vec3(1e-20f));
+		glm::vec3 step = out.positionScale / 65535.0f;
+		glm::vec3 largest = glm::max(glm::abs(low), glm::abs(high));
+		// half a step, plus a few float ulps for the offset + scale * x of the decode
+		out.bound.position = 0.5f * std::max(step.x, std::max(step.y, step.z)) + 4.0f * FLT_EPSILON * std::max(largest.x, std::max(largest.y, largest.z));
+	}
+	else if (format.position == POSITION_HALF4)
+	{
+		glm::vec3 largest = glm::max(glm::abs(low), glm::abs(high));
+		out.bound.position = std::max(largest.x, std::max(largest.y, largest.z)) / 2048.0f; // half: 11 significant bits
+	}
+	if (format.normal == NORMAL_OCT16)
+	{
+		out.bound.normalDegrees = 0.003f; // worst case of encodeOct16() over the sphere
+	}
+	if (format.color == COLOR_UNORM8x4)
+	{
+		out.bound.color = 0.5f / 255.0f;
+	}
+	if (format.texCoord == TEXCOORD_HALF2)
+	{
+		float largest = 0.0f;
+		for (int i = 0; i < count; i++)
+		{
+			const float* uv = vertices + (size_t)i * source.stride + source.texCoord;
+			largest = std::max(largest, std::max(fabsf(uv[0]), fabsf(uv[1])));
+		}
+		out.bound.texCoord = largest / 2048.0f;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		const float* src = vertices + (size_t)i * source.stride;
+		unsigned char* dst = out.data.data() + (size_t)i * format.stride;
+
+		glm::vec3 p = glm::make_vec3(src + source.position);
+		glm::vec3 decoded;
+		if (format.position == POSITION_FLOAT3)
+		{
+			memcpy(dst + format.positionOffset, &p, 12);
+			decoded = p;
+		}
+		else if (format.position == POSITION_HALF4)
+		{
+			uint16_t h[4] = { glm::packHalf1x16(p.x), glm::packHalf1x16(p.y), glm::packHalf1x16(p.z), 0 };
+			memcpy(dst + format.positionOffset, h, 8);
+			decoded = glm::vec3(glm::unpackHalf1x16(h[0]), glm::unpackHalf1x16(h[1]), glm::unpackHalf1x16(h[2]));
+		}
+		else
+		{
+			glm::vec3 n = (p - out.positionOffset) / out.positionScale;
+			uint16_t u[4] = { glm::packUnorm1x16(n.x), glm::packUnorm1x16(n.y), glm::packUnorm1x16(n.z), 0 };
+			memcpy(dst + format.positionOffset, u, 8);
+			decoded = out.positionOffset + out.positionScale * glm::vec3(glm::unpackUnorm1x16(u[0]), glm::unpackUnorm1x16(u[1]), glm::unpackUnorm1x16(u[2]));
+		}
+		glm::vec3 error = glm::abs(decoded - p);
+		out.measured.position = std::max(out.measured.position, std::max(error.x, std::max(error.y, error.z)));
+
+		if (format.normal == NORMAL_FLOAT3)
+		{
+			memcpy(dst + format.normalOffset, src + source.normal, 12);
+		}
+		else if (format.normal == NORMAL_OCT16)
+		{
+			glm::vec3 n = glm::normalize(glm::make_vec3(src + source.normal));
+			int16_t e[2];
+			encodeOct16(n, e);
+			memcpy(dst + format.normalOffset, e, 4);
+			glm::vec3 decodedNormal = octDecode(glm::vec2(e[0], e[1]) / 32767.0f);
+			float degrees = glm::degrees(atan2f(glm::length(glm::cross(decodedNormal, n)), glm::dot(decodedNormal, n))); // acos is too coarse near 1
+			out.measured.normalDegrees = std::max(out.measured.normalDegrees, degrees);
+		}
+
+		if (format.color == COLOR_FLOAT3)
+		{
+			memcpy(dst + format.colorOffset, src + source.color, 12);
+		}
+		else if (format.color == COLOR_UNORM8x4)
+		{
+			const float* c = src + source.color;
+			uint8_t u[4] = { glm::packUnorm1x8(c[0]), glm::packUnorm1x8(c[1]), glm::packUnorm1x8(c[2]), 255 };
+			memcpy(dst + format.colorOffset, u, 4);
+			for (int k = 0; k < 3; k++)
+			{
+				out.measured.color = std::max(out.measured.color, fabsf(glm::unpackUnorm1x8(u[k]) - std::min(std::max(c[k], 0.0f), 1.0f)));
+			}
+		}
+
+		if (format.texCoord == TEXCOORD_FLOAT2)
+		{
+			memcpy(dst + format.texCoordOffset, src + source.texCoord, 8);
+		}
+		else if (format.texCoord == TEXCOORD_HALF2)
+		{
+			const float* uv = src + source.texCoord;
+			uint16_t h[2] = { glm::packHalf1x16(uv[0]), glm::packHalf1x16(uv[1]) };
+			memcpy(dst + format.texCoordOffset, h, 4);
+			for (int k = 0; k < 2; k++)
+			{
+				out.measured.texCoord = std::max(out.measured.texCoord, fabsf(glm::unpackHalf1x16(h[k]) - uv[k]));
+			}
+		}
+	}
+}
+
+/* Attribute locations of the vertex shader, -1 to skip an attribute */
+struct VertexAttributeLocations
+{
+	int position;
+	int normal;
+	int color;
+	int texCoord;
+};
+
+/* Layout of the attributes of 'format' (vertex_layout.h). All the
+   compressed formats are normalized or half floats, no integer attribute
+   is needed. The padding of the 4 component formats is not fetched: the
+   positions and colours are read as vec3, like the shaders declare them. */
+inline VertexLayout vertexFormatLayout(const VertexFormat& format, const VertexAttributeLocations& locations)
+{
+	VertexAttribute attributes[4];
+	int count = 0;
+	if (locations.position >= 0)
+	{
+		VertexAttribute position = { "position", locations.position, 3,
+			(GLenum)(format.position == POSITION_FLOAT3 ? GL_FLOAT : (format.position == POSITION_HALF4 ? GL_HALF_FLOAT : GL_UNSIGNED_SHORT)),
+			format.position == POSITION_UNORM16x4, false, (size_t)format.positionOffset };
+		attributes[count++] = position;
+	}
+	if (locations.normal >= 0 && format.normal != NORMAL_NONE)
+	{
+		VertexAttribute normal = { "normal", locations.normal, format.normal == NORMAL_FLOAT3 ? 3 : 2,
+			(GLenum)(format.normal == NORMAL_FLOAT3 ? GL_FLOAT : GL_SHORT), format.normal == NORMAL_OCT16, false, (size_t)format.normalOffset };
+		attributes[count++] = normal;
+	}
+	if (locations.color >= 0 && format.color != COLOR_NONE)
+	{
+		VertexAttribute color = { "color", locations.color, 3,
+			(GLenum)(format.color == COLOR_FLOAT3 ? GL_FLOAT : GL_UNSIGNED_BYTE), format.color == COLOR_UNORM8x4, false, (size_t)format.colorOffset };
+		attributes[count++] = color;
+	}
+	if (locations.texCoord >= 0 && format.texCoord != TEXCOORD_NONE)
+	{
+		VertexAttribute texCoord = { "texCoord", locations.texCoord, 2,
+			(GLenum)(format.texCoord == TEXCOORD_FLOAT2 ? GL_FLOAT : GL_HALF_FLOAT), false, false, (size_t)format.texCoordOffset };
+		attributes[count++] = texCoord;
+	}
+	return VertexLayout(format.stride, attributes, (size_t)count);
+}
+
+#endif
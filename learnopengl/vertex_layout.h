@@ -0,0 +1,395 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+
+#include "glm/glm.hpp"
+
+#include "gl_state.h"
+#include "file_utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Vertex layouts derived from the C++ vertex struct: the type of each member
+   gives the number of components, the GL type and how the shader reads it, and
+   offsetof() gives the offset, so the glVertexAttribPointer arguments can not
+   drift away from the data.
+
+	   struct CubeVertex { glm::vec3 position; glm::vec3 color; glm::vec2 texCoord; };
+	   const VertexAttribute cubeAttributes[] = {
+		   VERTEX_ATTRIBUTE(CubeVertex, position, 0, "aPos"),
+		   VERTEX_ATTRIBUTE(CubeVertex, color, 1, "aColor"),
+		   VERTEX_ATTRIBUTE(CubeVertex, texCoord, 2, "aTexCoord")
+	   };
+	   VertexLayout layout = vertexLayout<CubeVertex>(cubeAttributes);
+
+   Float and glm::vec members are read as floats, integer members as int /
+   uint (glVertexAttribIPointer), Normalized<> integers as floats in [0, 1] or
+   [-1, 1], HalfVec<> as half floats. */
+
+template <class T>
+struct VertexComponent; // only the types below can be vertex components
+
+template <> struct VertexComponent<float>    { static const GLenum type = GL_FLOAT;          static const bool integer = false; };
+template <> struct VertexComponent<int8_t>   { static const GLenum type = GL_BYTE;           static const bool integer = true; };
+template <> struct VertexComponent<uint8_t>  { static const GLenum type = GL_UNSIGNED_BYTE;  static const bool integer = true; };
+template <> struct VertexComponent<int16_t>  { static const GLenum type = GL_SHORT;          static const bool integer = true; };
+template <> struct VertexComponent<uint16_t> { static const GLenum type = GL_UNSIGNED_SHORT; static const bool integer = true; };
+template <> struct VertexComponent<int32_t>  { static const GLenum type = GL_INT;            static const bool integer = true; };
+template <> struct VertexComponent<uint32_t> { static const GLenum type = GL_UNSIGNED_INT;   static const bool integer = true; };
+
+// integer components read as floats in [0, 1] (unsigned) or [-1, 1] (signed)
+template <class V>
+struct Normalized
+{
+	V value;
+};
+
+// half float components (glm::packHalf1x16)
+template <int N>
+struct HalfVec
+{
+	uint16_t value[N];
+};
+
+/* Components, GL type and conversion of a vertex struct member */
+template <class T>
+struct VertexAttributeTraits
+{
+	static const GLint components = 1;
+	static const GLenum type = VertexComponent<T>::type;
+	static const bool normalized = false;
+	static const bool integer = VertexComponent<T>::integer;
+};
+
+template <glm::length_t L, class T, glm::qualifier Q>
+struct VertexAttributeTraits<glm::vec<L, T, Q> >
+{
+	static const GLint components = L;
+	static const GLenum type = VertexComponent<T>::type;
+	static const bool normalized = false;
+	static const bool integer = VertexComponent<T>::integer;
+};
+
+template <class V>
+struct VertexAttributeTraits<Normalized<V> >
+{
+	static_assert(VertexAttributeTraits<V>::integer, "only integer components can be normalized");
+	static const GLint components = VertexAttributeTraits<V>::components;
+	static const GLenum type = VertexAttributeTraits<V>::type;
+	static const bool normalized = true;
+	static const bool integer = false;
+};
+
+template <int N>
+struct VertexAttributeTraits<HalfVec<N> >
+{
+	static const GLint components = N;
+	static const GLenum type = GL_HALF_FLOAT;
+	static const bool normalized = false;
+	static const bool integer = false;
+};
+
+/* One glVertexAttribPointer of a layout */
+struct VertexAttribute
+{
+	const char* name;	 // input of the vertex shader
+	GLint location;		 // -1: looked up by name in the program
+	GLint components;
+	GLenum type;
+	bool normalized;
+	bool integer;		 // glVertexAttribIPointer, read as int / uint
+	size_t offset;		 // bytes from the start of the vertex
+};
+
+template <class T>
+inline VertexAttribute vertexAttribute(const char* name, GLint location, size_t offset)
+{
+	typedef VertexAttributeTraits<T> Traits;
+	VertexAttribute attribute = { name, location, Traits::components, Traits::type, Traits::normalized, Traits::integer, offset };
+	return attribute;
+}
+
+// attribute for the member 'member' of the struct 'Vertex'
+#define VERTEX_ATTRIBUTE(Vertex, member, location, name) \
+	vertexAttribute<decltype(Vertex::member)>(name, location, offsetof(Vertex, member))
+
+/* Interleaved attributes of one vertex buffer */
+class VertexLayout
+{
+public:
+	GLsizei stride;
+	std::vector<VertexAttribute> attributes;
+
+	VertexLayout() : stride(0), hash(0)
+	{
+	}
+
+	VertexLayout(GLsizei vertexStride, const VertexAttribute* list, size_t count)
+		: stride(vertexStride), attributes(list, list + count)
+	{
+		/* Same attributes, same id: the VAO cache shares the VAOs of equal layouts */
+		hash = hashBytes((const unsigned char*)&stride, sizeof(stride));
+		for (size_t i = 0; i < attributes.size(); i++)
+		{
+			const VertexAttribute& a = attributes[i];
+			int64_t fields[6] = { a.location, a.components, (int64_t)a.type, a.normalized, a.integer, (int64_t)a.offset };
+			hash = hashBytes((const unsigned char*)fields, sizeof(fields), hash);
+			hash = hashBytes((const unsigned char*)a.name, strlen(a.name) + 1, hash);
+		}
+	}
+
+	uint64_t id() const
+	{
+		return hash;
+	}
+
+	// some attribute is located by name, the VAO depends on the program
+	bool usesNames() const
+	{
+		for (size_t i = 0; i < attributes.size(); i++)
+		{
+			if (attributes[i].location < 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/* Set up the attributes in the bound VAO, reading the buffer bound to
+	   GL_ARRAY_BUFFER. 'program' resolves the attributes without location,
+	   those it does not read are skipped. */
+	void apply(GLuint program = 0) const
+	{
+		for (size_t i = 0; i < attributes.size(); i++)
+		{
+			const VertexAttribute& a = attributes[i];
+			GLint location = a.location >= 0 ? a.location : (program ? glGetAttribLocation(program, a.name) : -1);
+			if (location < 0)
+			{
+				continue;
+			}
+			if (a.integer)
+			{
+				glVertexAttribIPointer((GLuint)location, a.components, a.type, stride, (void*)a.offset);
+			}
+			else
+			{
+				glVertexAttribPointer((GLuint)location, a.components, a.type, a.normalized ? GL_TRUE : GL_FALSE, stride, (void*)a.offset);
+			}
+			glEnableVertexAttribArray((GLuint)location);
+		}
+	}
+
+private:
+	uint64_t hash;
+};
+
+// layout of the vertex struct 'Vertex', the attributes come from VERTEX_ATTRIBUTE()
+template <class Vertex, size_t N>
+inline VertexLayout vertexLayout(const VertexAttribute (&attributes)[N])
+{
+	return VertexLayout((GLsizei)sizeof(Vertex), attributes, N);
+}
+
+/* GLSL type of an active attribute: components per location, locations
+   (matrix columns) and how it is read ('f' float, 'i' int, 'u' uint) */
+struct GLSLAttributeType
+{
+	GLenum type;
+	const char* name;
+	int components;
+	int locations;
+	char base;
+};
+
+inline GLSLAttributeType glslAttributeType(GLenum type)
+{
+	static const GLSLAttributeType types[] = {
+		{ GL_FLOAT, "float", 1, 1, 'f' }, { GL_FLOAT_VEC2, "vec2", 2, 1, 'f' }, { GL_FLOAT_VEC3, "vec3", 3, 1, 'f' }, { GL_FLOAT_VEC4, "vec4", 4, 1, 'f' },
+		{ GL_INT, "int", 1, 1, 'i' }, { GL_INT_VEC2, "ivec2", 2, 1, 'i' }, { GL_INT_VEC3, "ivec3", 3, 1, 'i' }, { GL_INT_VEC4, "ivec4", 4, 1, 'i' },
+		{ GL_UNSIGNED_INT, "uint", 1, 1, 'u' }, { GL_UNSIGNED_INT_VEC2, "uvec2", 2, 1, 'u' }, { GL_UNSIGNED_INT_VEC3, "uvec3", 3, 1, 'u' }, { GL_UNSIGNED_INT_VEC4, "uvec4", 4, 1, 'u' },
+		{ GL_FLOAT_MAT2, "mat2", 2, 2, 'f' }, { GL_FLOAT_MAT3, "mat3", 3, 3, 'f' }, { GL_FLOAT_MAT4, "mat4", 4, 4, 'f' }
+	};
+	for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+	{
+		if (types[i].type == type)
+		{
+			return types[i];
+		}
+	}
+	GLSLAttributeType unknown = { type, "unknown type", 0, 1, '?' };
+	return unknown;
+}
+
+/* Check 'layout' against the active attributes of the linked 'program'
+   (glGetActiveAttrib). Every input the shader reads must come from the
+   layout, or from another buffer set in 'externalLocations' (one bit per
+   location, e.g. the instance matrices), with as many components as its GLSL
+   type and read as float or integer like it is declared. Attributes of the
+   layout the shader does not read are fine, unused inputs are removed by the
+   compiler. Prints every problem, returns false if there was one. */
+inline bool validateVertexLayout(const VertexLayout& layout, GLuint program, uint32_t externalLocations = 0)
+{
+	bool valid = true;
+	GLint count = 0;
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		char name[256];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(program, (GLuint)i, sizeof(name), &length, &size, &type, name);
+		GLint location = glGetAttribLocation(program, name);
+		if (location < 0)
+		{
+			continue; // gl_VertexID and the other built-ins
+		}
+		if (location < 32 && (externalLocations & (1u << location)))
+		{
+			continue;
+		}
+
+		const VertexAttribute* attribute = NULL;
+		for (size_t a = 0; a < layout.attributes.size() && !attribute; a++)
+		{
+			const VertexAttribute& candidate = layout.attributes[a];
+			if (candidate.location >= 0 ? candidate.location == location : strcmp(candidate.name, name) == 0)
+			{
+				attribute = &candidate;
+			}
+		}
+		GLSLAttributeType glsl = glslAttributeType(type);
+		if (!attribute || glsl.locations > 1)
+		{
+			std::cout << "ERROR::VERTEX_LAYOUT::MISSING_ATTRIBUTE " << glsl.name << " " << name << " (location " << location << ")" << std::endl;
+			valid = false;
+			continue;
+		}
+		if (attribute->components != glsl.components)
+		{
+			std::cout << "ERROR::VERTEX_LAYOUT::COMPONENT_MISMATCH " << attribute->name << ": " << attribute->components
+				<< " components for " << glsl.name << " " << name << " (location " << location << ")" << std::endl;
+			valid = false;
+		}
+		if (attribute->integer != (glsl.base != 'f'))
+		{
+			std::cout << "ERROR::VERTEX_LAYOUT::TYPE_MISMATCH " << attribute->name << ": " << (attribute->integer ? "integer" : "float")
+				<< " attribute for " << glsl.name << " " << name << " (location " << location << ")" << std::endl;
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+/* One VAO per (layout, program, vertex buffer, index buffer): switching
+   meshes binds a VAO made the first time instead of specifying the
+   attributes again. The program is only part of the key for layouts with
+   attributes located by name, explicit locations give the same VAO for every
+   program. */
+class VertexArrayCache
+{
+public:
+	int hits;
+	int misses;
+
+	VertexArrayCache() : hits(0), misses(0)
+	{
+	}
+
+	~VertexArrayCache()
+	{
+		clear();
+	}
+
+	// the VAO reading 'vertexBuffer' with 'layout', bound on return
+	GLuint get(const VertexLayout& layout, GLuint vertexBuffer, GLuint indexBuffer = 0, GLuint program = 0)
+	{
+		Key key = { layout.id(), layout.usesNames() ? program : 0, vertexBuffer, indexBuffer };
+		std::map<Key, GLuint>::const_iterator found = vertexArrays.find(key);
+		if (found != vertexArrays.end())
+		{
+			hits++;
+			glState().bindVertexArray(found->second);
+			return found->second;
+		}
+
+		misses++;
+		GLuint vertexArray = 0;
+		glGenVertexArrays(1, &vertexArray);
+		glState().bindVertexArray(vertexArray);
+		glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		if (indexBuffer)
+		{
+			glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		}
+		layout.apply(program);
+		vertexArrays[key] = vertexArray;
+		return vertexArray;
+	}
+
+	int size() const
+	{
+		return (int)vertexArrays.size();
+	}
+
+	// delete the VAOs made for 'program' (hot-reload replaced it)
+	void programDeleted(GLuint program)
+	{
+		for (std::map<Key, GLuint>::iterator it = vertexArrays.begin(); it != vertexArrays.end();)
+		{
+			if (it->first.program == program && program != 0)
+			{
+				destroy(it->second);
+				it = vertexArrays.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void clear()
+	{
+		for (std::map<Key, GLuint>::iterator it = vertexArrays.begin(); it != vertexArrays.end(); ++it)
+		{
+			destroy(it->second);
+		}
+		vertexArrays.clear();
+	}
+
+private:
+	struct Key
+	{
+		uint64_t layout;
+		GLuint program;
+		GLuint vertexBuffer;
+		GLuint indexBuffer;
+
+		bool operator<(const Key& other) const
+		{
+			if (layout != other.layout) return layout < other.layout;
+			if (program != other.program) return program < other.program;
+			if (vertexBuffer != other.vertexBuffer) return vertexBuffer < other.vertexBuffer;
+			return indexBuffer < other.indexBuffer;
+		}
+	};
+	std::map<Key, GLuint> vertexArrays;
+
+	static void destroy(GLuint vertexArray)
+	{
+		glDeleteVertexArrays(1, &vertexArray);
+		glState().vertexArrayDeleted(vertexArray);
+	}
+};
+
+#endif